@@ -121,7 +121,15 @@ typedef struct ci_acmod_s {
     ci_acmod_id_t id;		/* The ID of this acoustic model */
 } ci_acmod_t;
 
-#include <s3/itree.h>
+/* An undefined state or parameter ID (e.g. the state past the last
+ * emitting state of a model definition) */
+#define NO_ID		(0xffffffff)
+
+/* triphone index slot; empty slots have id == NO_ACMOD */
+typedef struct acmod_tri_slot_s {
+    uint32 key;
+    acmod_id_t id;
+} acmod_tri_slot_t;
 
 typedef struct acmod_set_s {
     ci_acmod_t *ci;		/* base phone and filler model list.
@@ -145,8 +153,10 @@ typedef struct acmod_set_s {
     uint32 next_id;	/* The ID which would be assigned to the next
 				 * new acoustic model */
     
-    itree_t **multi_idx;	/* A quick index for mapping a multiphone to
-				 * an ID. */
+    acmod_tri_slot_t *tri_idx;	/* Open addressing index mapping a
+				 * packed (base, left, right, posn) key
+				 * to a triphone ID. */
+    uint32 tri_shift;		/* 32 - log2(# of slots in tri_idx) */
 
     char **attrib;		/* A NULL terminated list of C strings which
 				 * represent all possible attributes of the phones in
@@ -154,6 +164,11 @@ typedef struct acmod_set_s {
 				 * For instance, "base", "non_speech", "triphone" */
     
     uint32 *n_with;	/* The number of phones having each attribute. */
+
+    char ***attrib_pool;	/* Attribute lists shared by the phones,
+				 * when read from a binary model definition
+				 * (NULL otherwise, each phone owns its own). */
+    uint32 n_attrib_pool;
 } acmod_set_t;
 
 acmod_set_t *
@@ -58,6 +58,7 @@ extern "C" {
 #include <sphinxbase/prim_type.h>
 #include <s3/acmod_set.h>
 #include <s3/quest.h>
+#include <s3/model_def.h>
 
 #define NO_CLUST (0xffffffff)
 
@@ -150,6 +151,43 @@ read_final_tree(FILE *fp,
 		pset_t *pset,
 		uint32 n_pset);
 
+/*
+ * Binary trees hold the same nodes and questions as the text format
+ * (see dtree.c), so loading them involves no parsing.
+ */
+#define DTREE_BIN_MAGIC "s3dtreb\n"
+#define DTREE_BIN_VERSION 1
+
+/* Read a tree file in either format, telling them apart by the magic */
+dtree_t *
+read_final_tree_file(const char *fn,
+		     pset_t *pset,
+		     uint32 n_pset);
+
+/* Write a reindexed tree (node ids 0..n-1) in binary format */
+int32
+write_final_tree_bin(const char *fn,
+		     dtree_node_t *node,
+		     pset_t *pset);
+
+/* Read n_tree tree files using up to n_thread threads */
+int32
+read_final_trees(const char **fn,
+		 uint32 n_tree,
+		 pset_t *pset,
+		 uint32 n_pset,
+		 dtree_t **out_tree,
+		 uint32 n_thread);
+
+/* Number the leaves of the trees, indexed by phone (or just 0 if
+ * allphones) and emitting state, as tied states following the CI
+ * states of imdef, and build the tied model definition */
+model_def_t *
+tie_states(model_def_t *imdef,
+	   dtree_t ***tree,
+	   pset_t *pset,
+	   int allphones);
+
 void
 free_tree(dtree_t *tr);
 
@@ -267,6 +267,30 @@ gauden_accum_param_full(vector_t ****out,
 			uint32 n_density,
 			const uint32 *veclen);
 
+void
+gauden_accum_centered_var(vector_t ***out_var,
+			  vector_t ***in_var,
+			  vector_t ***out_mean,
+			  vector_t ***in_mean,
+			  float32 ***out_dnom,
+			  float32 ***in_dnom,
+			  uint32 n_mgau,
+			  uint32 n_feat,
+			  uint32 n_density,
+			  const uint32 *veclen);
+
+void
+gauden_accum_centered_fullvar(vector_t ****out_var,
+			      vector_t ****in_var,
+			      vector_t ***out_mean,
+			      vector_t ***in_mean,
+			      float32 ***out_dnom,
+			      float32 ***in_dnom,
+			      uint32 n_mgau,
+			      uint32 n_feat,
+			      uint32 n_density,
+			      const uint32 *veclen);
+
 void
 gauden_norm_wt_mean(vector_t ***in_mean,
 		    vector_t ***wt_mean,
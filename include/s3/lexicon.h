@@ -58,6 +58,7 @@ extern "C" {
 #include <sphinxbase/prim_type.h>
 #include <sphinxbase/hash_table.h>
 #include <sphinxbase/strfuncs.h>
+#include <sphinxbase/mmio.h>
 
 typedef uint32 word_id_t;
 #define WORD_NO_ID	(0xffffffff)
@@ -65,9 +66,9 @@ typedef uint32 word_id_t;
 typedef struct lex_entry_str {
     char *ortho;
     word_id_t word_id;
-    char **phone;
-    acmod_id_t *ci_acmod_id;
     uint32  phone_cnt;
+    const char **phone;		/* interned CI phone names of phone_set */
+    acmod_id_t *ci_acmod_id;
 
     /* Linked list of pronunciation variants of the same base word.
      * Entries with full orthos "reading", "reading(2)", "reading(3)"
@@ -76,15 +77,33 @@ typedef struct lex_entry_str {
      * Single-variant words have next_variant == NULL.
      */
     struct lex_entry_str *next_variant;
+    uint32 base_len;		/* length of the base word in ortho */
 } lex_entry_t;
 
+typedef struct lex_arena_s lex_arena_t;
+
 typedef struct lexicon_s {
     uint32 entry_cnt;
-    hash_table_t *ht;       /* full ortho ("reading(2)") -> lex_entry_t */
-    hash_table_t *base_ht;  /* base word ("reading")     -> head of variant chain */
+    lex_entry_t **entry;    /* by word id */
+    uint32 max_entry;
+    uint32 *slot;           /* full ortho ("reading(2)") -> word id + 1 */
+    uint32 *base_slot;      /* base word ("reading") -> head of variant chain */
+    uint32 n_slot;          /* power of 2, at least twice entry_cnt */
+    lex_arena_t *arena;     /* entries, orthos and phone lists */
+    mmio_file_t **cache;    /* mapped dictionary caches */
+    uint32 n_cache;
     acmod_set_t *phone_set;
 } lexicon_t;
 
+/*
+ * Binary dictionary caches are written to the directory given by the
+ * -dictcache argument, if the program has one, and are named after the
+ * dictionary and a hash of its contents and of the phone set, so that
+ * a stale cache is never used.
+ */
+#define LEXICON_CACHE_MAGIC "s3lexbn\n"
+#define LEXICON_CACHE_VERSION 1
+
 lexicon_t *lexicon_new(void);
 
 lexicon_t *
@@ -94,7 +113,7 @@ lexicon_read(lexicon_t *prior_lex,
 
 lex_entry_t *
 lexicon_lookup(lexicon_t *lexicon,
-	       char *word);
+	       const char *word);
 
 /* Return the head of the linked list of pronunciation variants for
  * `base_word` (i.e. the word with any "(N)" suffix stripped).
@@ -73,7 +73,7 @@ mk_phone_list(char **btw_mark,
 acmod_id_t *
 mk_word_phone_list(char **btw_mark,
 		   uint32 *n_phone,
-		   char *word,
+		   const char *word,
 		   lexicon_t *lex);
 
 acmod_id_t *
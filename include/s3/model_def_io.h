@@ -63,6 +63,11 @@ extern "C" {
 
 #define MODEL_DEF_VERSION "0.3"
 
+/* Binary model definitions start with this and are recognized by
+ * model_def_read() */
+#define MODEL_DEF_BIN_MAGIC "s3mdefb\n"
+#define MODEL_DEF_BIN_VERSION 1
+
 int32
 model_def_read(model_def_t **out_mdef,
 	       const char *file_name);
@@ -71,6 +76,10 @@ int32
 model_def_write(model_def_t *mdef,
 		const char *file_name);
 
+int32
+model_def_write_bin(model_def_t *mdef,
+		    const char *file_name);
+
 int32
 model_def_free(model_def_t *mdef);
 
@@ -58,6 +58,12 @@ extern "C" {
 #define GAUCNT_FILE_VERSION	"1.0"
 #define GAUDNOM_FILE_VERSION	"1.0"
 
+/* Value of the pass2var flag in gauden_counts files whose variance
+ * sums are centered about the file's own sample means (single-pass
+ * accumulation).  Merging such files needs the Chan et al. correction
+ * term, see gauden_accum_centered_var(). */
+#define GAUCNT_PASS2VAR_CENTERED	2
+
 int
 s3gau_read(const char *fn,
 	   vector_t ****out,
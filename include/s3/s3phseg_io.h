@@ -64,23 +64,33 @@ typedef struct s3phseg_s {
     struct s3phseg_s *next;	/* Next entry in alignment */
 } s3phseg_t;
 
+/* Binary lattices start with this and are recognized by
+ * s3lattice_read() */
+#define S3LATTICE_BIN_MAGIC "s3latbn\n"
+#define S3LATTICE_BIN_VERSION 1
+
 typedef struct s3lattice_s {
   uint32 n_arcs;                /* total number of arcs in lattice */
   uint32 n_true_arcs;           /* the number of arcs from the numerator lattice */
   float64 prob;                 /* total log likelihood of lattice=alpha(Q)=beta(1) */
   float64 postprob;             /* the log posterior probability of the true path */
   struct s3arc_s *arc;          /* word arcs */
+  uint32 *link;                 /* preceding then succeeding arc ids of
+                                   every arc, which the arcs point into */
+  char *word;                   /* word strings of a text lattice */
+  struct mmio_file_s *mf;       /* mapped file of a binary lattice, which
+                                   holds its links and words instead */
 } s3lattice_t;
 
 typedef struct s3arc_s {
-  char word[128];                   /* current word */
+  const char *word;                 /* current word */
   uint32 sf, ef;                    /* start and end frame for this word occurrence */
   uint32 n_prev_arcs, n_next_arcs;  /* number of preceding and succeeding arcs */
   float64 lm_score, ac_score;       /* language model score and acoustic score */
   float64 alpha, beta, gamma;       /* lattice level statistics accumulator */
   uint32 best_prev_arc, best_next_arc;        /* the prev and next arc id with the best ac score */
-  uint32 *prev_arcs;                /* previous acrs */
-  uint32 *next_arcs;                /* next arcs */
+  const uint32 *prev_arcs;          /* previous acrs */
+  const uint32 *next_arcs;          /* next arcs */
   uint32 good_arc;
 } s3arc_t;
 
@@ -94,9 +104,20 @@ int s3phseg_write(const char *fn,
 
 void s3phseg_free(s3phseg_t *phseg);
 
+/* Reads a text or binary lattice, telling them apart by
+ * S3LATTICE_BIN_MAGIC.  A binary lattice stays mapped until
+ * s3lattice_free(). */
 int s3lattice_read(const char *fn,
 		   s3lattice_t **lattice);
 
+int s3lattice_write(const char *fn,
+		    s3lattice_t *lattice);
+
+int s3lattice_write_bin(const char *fn,
+			s3lattice_t *lattice);
+
+void s3lattice_free(s3lattice_t *lattice);
+
 #ifdef __cplusplus
 }
 #endif
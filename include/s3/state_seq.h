@@ -67,6 +67,16 @@ state_seq_make(uint32 *n_state,
 	       model_inventory_t *inv,
 	       model_def_t *mdef);
 
+/* Like state_seq_make(), but the returned states do not share static
+ * storage with any other call and must be released with
+ * state_seq_free().  Callers on different threads must pass different
+ * inventories, since the local mixw/cb maps are stored in inv. */
+state_t *
+state_seq_make_alloc(uint32 *n_state,
+		     acmod_id_t *phone,
+		     uint32 n_phone,
+		     model_inventory_t *inv,
+		     model_def_t *mdef);
 
 void
 state_seq_print(state_t *state,
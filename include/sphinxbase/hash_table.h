@@ -96,6 +96,11 @@
  * 3, this is a reasonable practice because hash table is only used in
  * lookup in initialization or in lookups which is not critical for
  * speed.
+ *
+ * The buckets have since been replaced by open addressing with the
+ * full 64-bit hash of each key kept in its entry, as dictionaries
+ * and model definitions with hundreds of thousands of keys made
+ * table loading show up in profiles.
  */
 
 /**
@@ -129,6 +134,8 @@
 #include <sphinxbase/prim_type.h>
 #include <sphinxbase/glist.h>
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -140,12 +147,12 @@ extern "C" {
 /**
  * The hash table structures.
  * Each hash table is identified by a hash_table_t structure.  hash_table_t.table is
- * pre-allocated for a user-controlled max size, and is initially empty.  As new
- * entries are created (using hash_enter()), the empty entries get filled.  If multiple
- * keys hash to the same entry, new entries are allocated and linked together in a
- * linear list.
+ * an open-addressing table whose size is a power of two, and is initially empty.
+ * As new entries are created (using hash_enter()), the empty entries get filled,
+ * each at or after the slot its hash points to (linear probing).  The table is
+ * doubled when it becomes half full, so pointers to entries are only valid until
+ * the next insertion.
  */
-
 typedef struct hash_entry_s {
 	const char *key;		/** Key string, NULL if this is an empty slot.
 					    NOTE that the key must not be changed once the entry
@@ -153,13 +160,13 @@ typedef struct hash_entry_s {
 	size_t len;			/** Key-length; the key string does not have to be a C-style NULL
 					    terminated string; it can have arbitrary binary bytes */
 	void *val;			/** Value associated with above key */
-	struct hash_entry_s *next;	/** For collision resolution */
+	uint64_t hash;			/** Full hash of the key, compared before the key itself */
 } hash_entry_t;
 
 typedef struct hash_table_s {
-	hash_entry_t *table;	/**Primary hash table, excluding entries that collide */
-	int32 size;		/** Primary hash table size, (is a prime#); NOTE: This is the
-				    number of primary entries ALLOCATED, NOT the number of valid
+	hash_entry_t *table;	/**Open-addressing hash table */
+	int32 size;		/** Hash table size, (is a power of 2); NOTE: This is the
+				    number of entries ALLOCATED, NOT the number of valid
 				    entries in the table */
 	int32 inuse;		/** Number of valid entries in the table. */
 	int32 nocase;		/** Whether case insensitive for key comparisons */
@@ -0,0 +1,139 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2008 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file sbthread.h
+ * @brief Simple portable thread functions.
+ *
+ * Just enough to run a fixed pool of worker threads over shared,
+ * read-only model data: starting and joining threads, and mutexes
+ * to protect work queues and shared accumulators.
+ **/
+
+#ifndef __SBTHREAD_H__
+#define __SBTHREAD_H__
+
+#include <sphinxbase/sphinxbase_export.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+/* Fool Emacs. */
+}
+#endif
+
+/**
+ * Thread object.
+ */
+typedef struct sbthread_s sbthread_t;
+
+/**
+ * Mutex (critical section) object.
+ */
+typedef struct sbmtx_s sbmtx_t;
+
+/**
+ * Entry point for a thread.
+ */
+typedef int (*sbthread_main)(sbthread_t *th);
+
+/**
+ * Start a new thread.
+ *
+ * @return the new thread, or NULL on failure.
+ */
+SPHINXBASE_EXPORT
+sbthread_t *sbthread_start(sbthread_main func, void *arg);
+
+/**
+ * Wait for a thread to complete.
+ *
+ * @return the value returned by the thread's main function, or -1
+ * if the thread could not be joined.
+ */
+SPHINXBASE_EXPORT
+int sbthread_wait(sbthread_t *th);
+
+/**
+ * Free a thread object (waiting for it to finish if necessary).
+ */
+SPHINXBASE_EXPORT
+void sbthread_free(sbthread_t *th);
+
+/**
+ * Get argument pointer from thread.
+ */
+SPHINXBASE_EXPORT
+void *sbthread_arg(sbthread_t *th);
+
+/**
+ * Create a mutex.
+ */
+SPHINXBASE_EXPORT
+sbmtx_t *sbmtx_init(void);
+
+/**
+ * Try to acquire a mutex.
+ *
+ * @return 0 if the mutex was acquired, non-zero otherwise.
+ */
+SPHINXBASE_EXPORT
+int sbmtx_trylock(sbmtx_t *mtx);
+
+/**
+ * Acquire a mutex.
+ */
+SPHINXBASE_EXPORT
+int sbmtx_lock(sbmtx_t *mtx);
+
+/**
+ * Release a mutex.
+ */
+SPHINXBASE_EXPORT
+int sbmtx_unlock(sbmtx_t *mtx);
+
+/**
+ * Dispose of a mutex.
+ */
+SPHINXBASE_EXPORT
+void sbmtx_free(sbmtx_t *mtx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SBTHREAD_H__ */
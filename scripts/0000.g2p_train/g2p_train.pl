@@ -85,7 +85,9 @@ close INDICT or die $!;
 close OUTDICT or die $!;
 my $rv = RunTool('g2p_train', $logfile . ".training.log", 0,
 		 -ifile => "$dict.g2p.train",
-		 -prefix => $g2p_prefix);
+		 -prefix => $g2p_prefix,
+		 -nthreads => (defined($ST::CFG_G2P_NTHREADS)
+			       ? $ST::CFG_G2P_NTHREADS : 1));
 return $rv if $rv;
 
 Log ("Phase 3: Evaluating g2p model...\n");
@@ -129,6 +129,8 @@ my $return_value = RunTool
      -varnorm => $ST::CFG_VARNORM,
      -feat => $ST::CFG_FEATURE,
      -ceplen => $ST::CFG_VECTOR_LENGTH,
+     -nthreads => (defined($ST::CFG_FORCE_ALIGN_NTHREADS)
+		   ? $ST::CFG_FORCE_ALIGN_NTHREADS : 1),
      );
 
 if ($return_value) {
@@ -305,6 +305,8 @@ def main() -> int:
         cfg["CFG_VECTOR_LENGTH"],
         "-insert_sil",
         "1",
+        "-nthreads",
+        cfg.get("CFG_FORCE_ALIGN_NTHREADS") or "1",
     ]
 
     print("Doing multipron force alignment (sphinx3_align)...")
@@ -152,6 +152,11 @@ push(@feat_args, -multipron => 'yes')
     if (defined($ST::CFG_MULTIPRON_TRAINING)
         and $ST::CFG_MULTIPRON_TRAINING eq 'yes');
 
+# Sentence HMMs only depend on the transcripts and model architecture,
+# so later iterations reuse the ones built by the first.
+push(@feat_args, -uttstatecache =>
+     "$ST::CFG_BWACCUM_DIR/${ST::CFG_EXPTNAME}_${processname}_${part}.uttstates");
+
 my $return_value = RunTool
     ('bw', $logfile, $ctl_counter,
      -moddeffn => $moddeffn,
@@ -161,7 +161,8 @@ sub Initialize () {
 		   -fdictfn => $ST::CFG_FILLERDICT,
 		   -lsnfn => $transcriptfile,
 		   -ountiedmdef => $untiedmdef,
-		   -n_state_pm => $ST::CFG_STATESPERHMM);
+		   -n_state_pm => $ST::CFG_STATESPERHMM,
+		   -nthreads => ($ST::CFG_NPART > 1 ? $ST::CFG_NPART : 1));
   return $rv if $rv;
 
   $logfile = "$logdir/${ST::CFG_EXPTNAME}.copycitocd.log";
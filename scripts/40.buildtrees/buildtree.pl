@@ -75,6 +75,11 @@ my $unprunedtreedir = "$tree_base_dir/${ST::CFG_EXPTNAME}.unpruned";
 mkdir ($tree_base_dir,0777);
 mkdir ($unprunedtreedir,0777);
 
+# Build the trees for every phone and state in a single process
+if ($phone eq 'ALLTREES') {
+    exit BuildTree($phone);
+}
+
 my $state = 0;
 my $return_value = 0;
 while ( $state < $ST::CFG_STATESPERHMM) {
@@ -93,9 +98,11 @@ sub BuildTree
     my $phn = shift;
     my $stt = shift;
 
-    my $logfile = "$logdir/${ST::CFG_EXPTNAME}.buildtree.${phn}.${stt}.log";
+    my $logfile = defined($stt)
+	? "$logdir/${ST::CFG_EXPTNAME}.buildtree.${phn}.${stt}.log"
+	: "$logdir/${ST::CFG_EXPTNAME}.buildtree.log";
 
-    Log("${phn} ${stt} ", 'result');
+    Log(defined($stt) ? "${phn} ${stt} " : "all trees ", 'result');
 
     # RAH 7.21.2000 - These were other possible values for these
     # variables, I'm not sure the circumstance that would dictate
@@ -134,21 +141,29 @@ sub BuildTree
     }
 
     my @phnflag;
-    if ($ST::CFG_CROSS_PHONE_TREES eq 'yes') {
+    if (!defined($stt)) {
+	my $nthreads = $ST::CFG_NPART > 1 ? $ST::CFG_NPART : 1;
+	@phnflag = (-treedir => $unprunedtreedir,
+		    -phonelstfn => $ST::CFG_RAWPHONEFILE,
+		    -nthreads => $nthreads);
+    }
+    elsif ($ST::CFG_CROSS_PHONE_TREES eq 'yes') {
 	@phnflag = (-allphones => 'yes');
     }
     else {
 	@phnflag = (-phone => $phn);
     }
+    if (defined($stt)) {
+	push @phnflag, (-treefn => "$unprunedtreedir/$phn-$stt.dtree",
+			-state => $stt);
+    }
     return RunTool('bldtree', $logfile, 0,
-		   -treefn => "$unprunedtreedir/$phn-$stt.dtree",
 		   -moddeffn => "$mdef_file",
 		   -mixwfn => "$mixture_wt_file",
 		   -ts2cbfn => $ST::CFG_HMM_TYPE,
 		   -mwfloor => 1e-8,
 		   -psetfn => $ST::CFG_QUESTION_SET,
 		   @phnflag,
-		   -state => $stt,
 		   -stwt => join(",", @stwt),
 		   @gauflag,
 		   -ssplitmin => 1,
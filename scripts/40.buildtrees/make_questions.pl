@@ -79,7 +79,8 @@ my $rv = RunTool('make_quests', $logfile, 0,
 		 -niter => 1,
 		 -qstperstt => 20,
 		 -questfn => $questfn,
-		 -type => $ST::CFG_HMM_TYPE);
+		 -type => $ST::CFG_HMM_TYPE,
+		 -nthreads => ($ST::CFG_NPART > 1 ? $ST::CFG_NPART : 1));
 exit $rv if $rv;
 
 # Add phone-identity questions if we are doing cross-phone sharing (rather important!)
@@ -95,17 +95,15 @@ my @jobs;
 if ($ST::CFG_CROSS_PHONE_TREES eq 'yes') {
     Log("Processing all phones with each state\n", 'result');
     push @jobs, ['ALLPHONES' => LaunchScript("tree.all", ['buildtree.pl', 'ALLPHONES'])];
+} elsif ($ST::CFG_QUEUE_TYPE eq 'Queue' or $ST::CFG_QUEUE_TYPE eq 'Queue::POSIX') {
+    # On a single machine one bldtree builds every tree, reading the
+    # models only once and using $CFG_NPART threads
+    Log("Processing each phone with each state in one process\n", 'result');
+    push @jobs, ['ALLTREES' => LaunchScript("tree.all", ['buildtree.pl', 'ALLTREES'])];
 } else {
     Log ("Processing each phone with each state\n", 'result');
     open INPUT,"${ST::CFG_RAWPHONEFILE}";
     foreach $phone (<INPUT>) {
-	if ($ST::CFG_QUEUE_TYPE eq "Queue::POSIX") {
-	    # Use @jobs as a queue (better than nothing for Queue::POSIX)
-	    if (@jobs > $ST::CFG_NPART) {
-		my ($p, $j) = @{shift @jobs};
-		WaitForScript($j);
-	    }
-	}
 	$phone = Trim($phone);
 	if (($phone =~ m/^(\+).*(\+)$/) || ($phone =~ m/^SIL$/)) {
 	    Log ("Skipping $phone\n", 'result');
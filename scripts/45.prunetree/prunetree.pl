@@ -83,4 +83,5 @@ exit RunTool('prunetree', $logfile, 0,
 	     -moddeffn => $mdef_file,
 	     @phnarg,
 	     -psetfn => $ST::CFG_QUESTION_SET,
-	     -minocc => $occurance_threshold);
+	     -minocc => $occurance_threshold,
+	     -nthreads => ($ST::CFG_NPART > 1 ? $ST::CFG_NPART : 1));
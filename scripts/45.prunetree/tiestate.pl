@@ -78,5 +78,6 @@ exit RunTool('tiestate', $logfile, 0,
 	     -omoddeffn => $tied_mdef_file,
 	     -treedir => $prunedtreedir,
 	     @phnarg,
-	     -psetfn => $ST::CFG_QUESTION_SET);
+	     -psetfn => $ST::CFG_QUESTION_SET,
+	     -nthreads => ($ST::CFG_NPART > 1 ? $ST::CFG_NPART : 1));
 
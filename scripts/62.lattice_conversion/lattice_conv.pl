@@ -111,4 +111,18 @@ my $rv = RunTool("python",
 if ($rv) {
     LogError("Failed to run lattice_conv.py");
 }
+elsif (defined($ST::CFG_LATTICE_BINARY) and $ST::CFG_LATTICE_BINARY eq "yes") {
+    # bw reads either format, so a lattice which fails to convert
+    # is left as text
+    $rv = RunTool('lat_convert',
+		  "$logdir/${ST::CFG_EXPTNAME}.$part.latbin.log", $filecount,
+		  -ctlfn => $filelst,
+		  -ctloffset => $fileoffset,
+		  -ctlcount => $filecount,
+		  -latdir => $latdir,
+		  -latext => "numlat,denlat");
+    if ($rv) {
+	LogError("Failed to convert lattices to the binary format");
+    }
+}
 exit $rv;
@@ -86,6 +86,7 @@ $topn = $ST::CFG_CD_TOPN if (defined($ST::CFG_CD_TOPN) and ($ST::CFG_FULLVAR eq
 
 my $mmie_type   = defined($ST::CFG_MMIE_TYPE) ? $ST::CFG_MMIE_TYPE : "rand";
 my $lw          = defined($ST::CFG_LANGUAGEWEIGHT) ? $ST::CFG_LANGUAGEWEIGHT : "11.5";
+my $nthreads    = defined($ST::CFG_MMIE_NTHREADS) ? $ST::CFG_MMIE_NTHREADS : 1;
 
 my $numlatdir = defined($ST::CFG_NUMLAT_DIR)
     ? $ST::CFG_NUMLAT_DIR
@@ -180,7 +181,8 @@ my $return_value = RunTool
      -mmie_type => $mmie_type,
      -latext => $lat_ext,
      -latdir => $latdir,
-     -lw => $lw);
+     -lw => $lw,
+     -nthreads => $nthreads);
 
 if ($return_value) {
   LogError("Failed to run bw");
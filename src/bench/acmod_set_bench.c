@@ -0,0 +1,217 @@
+/* ====================================================================
+ * Copyright (c) 2024 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*********************************************************************
+ *
+ * File: acmod_set_bench.c
+ * 
+ * Description: 
+ * 	Time acmod_set_tri2id() against the per-base-phone itree index
+ *	it replaced, on the triphones of a model definition file and on
+ *	random (mostly absent) triphones, and check that both agree.
+ *
+ *	Usage: acmod_set_bench mdeffn [n_rep]
+ *
+ *********************************************************************/
+
+#include <s3/model_def_io.h>
+#include <s3/acmod_set.h>
+
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/err.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "itree.h"
+
+typedef struct {
+    acmod_id_t base;
+    acmod_id_t left;
+    acmod_id_t right;
+    word_posn_t posn;
+} tri_t;
+
+static void
+report(const char *what, ptmr_t *tm, int32 n_op)
+{
+    printf("%-24s %10d ops %8.3f sec %8.1f ns/op\n",
+	   what, n_op, tm->t_elapsed, 1e9 * tm->t_elapsed / n_op);
+}
+
+/* The triphone index as acmod_set kept it before: one itree per base
+ * phone, sized as acmod_set_add_tri() used to size them. */
+static itree_t **
+itree_index(acmod_set_t *acmod_set)
+{
+    itree_t **idx;
+    uint32 i, n_ci;
+    acmod_t *m;
+
+    n_ci = acmod_set->n_ci;
+    idx = ckd_calloc(n_ci, sizeof(itree_t *));
+    for (i = 0; i < n_ci; i++)
+	idx[i] = itree_new(n_ci * n_ci * N_WORD_POSN * 2);
+    for (i = 0; i < acmod_set->n_multi; i++) {
+	m = &acmod_set->multi[i];
+	itree_add_tri(idx[m->base], m->left_context, m->right_context,
+		      m->posn, n_ci + i);
+    }
+
+    return idx;
+}
+
+static void
+itree_index_free(itree_t **idx, uint32 n_ci)
+{
+    uint32 i;
+
+    for (i = 0; i < n_ci; i++) {
+	ckd_free(idx[i]->cell);
+	ckd_free(idx[i]);
+    }
+    ckd_free(idx);
+}
+
+static acmod_id_t
+itree_tri2id(itree_t **idx, tri_t *t)
+{
+    cell_index_t i;
+
+    i = itree_find_tri(idx[t->base], t->left, t->right, t->posn);
+
+    return i != NULL_INDEX ? i : NO_ACMOD;
+}
+
+static void
+bench(const char *what, acmod_set_t *acmod_set, itree_t **idx,
+      tri_t *tri, int32 n_tri, int32 n_rep)
+{
+    ptmr_t tm;
+    int32 r, i, n_diff;
+    acmod_id_t sum;
+    char buf[64];
+
+    /* Both must give the same answers */
+    for (i = 0, n_diff = 0; i < n_tri; i++) {
+	n_diff += (acmod_set_tri2id(acmod_set, tri[i].base, tri[i].left,
+				    tri[i].right, tri[i].posn)
+		   != itree_tri2id(idx, &tri[i]));
+    }
+    if (n_diff)
+	E_ERROR("%s: %d of %d lookups differ\n", what, n_diff, n_tri);
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (r = 0, sum = 0; r < n_rep; r++) {
+	for (i = 0; i < n_tri; i++)
+	    sum += itree_tri2id(idx, &tri[i]);
+    }
+    ptmr_stop(&tm);
+    sprintf(buf, "%s itree", what);
+    report(buf, &tm, n_rep * n_tri);
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (r = 0; r < n_rep; r++) {
+	for (i = 0; i < n_tri; i++)
+	    sum -= acmod_set_tri2id(acmod_set, tri[i].base, tri[i].left,
+				    tri[i].right, tri[i].posn);
+    }
+    ptmr_stop(&tm);
+    sprintf(buf, "%s table", what);
+    report(buf, &tm, n_rep * n_tri);
+
+    /* Keeps the loops from being optimized away */
+    if (sum != 0)
+	E_ERROR("%s: lookup sums differ\n", what);
+}
+
+int
+main(int argc, char *argv[])
+{
+    model_def_t *mdef;
+    acmod_set_t *acmod_set;
+    itree_t **idx;
+    tri_t *tri;
+    int32 n_tri, n_rep, i;
+    uint32 n_ci;
+    acmod_t *m;
+
+    if (argc < 2) {
+	fprintf(stderr, "Usage: %s mdeffn [n_rep]\n", argv[0]);
+	return 1;
+    }
+    n_rep = argc > 2 ? atoi(argv[2]) : 10;
+    if (n_rep < 1)
+	n_rep = 1;
+
+    if (model_def_read(&mdef, argv[1]) != S3_SUCCESS)
+	E_FATAL("Unable to read %s\n", argv[1]);
+    acmod_set = mdef->acmod_set;
+    n_ci = acmod_set->n_ci;
+    n_tri = acmod_set->n_multi;
+    if (n_tri == 0)
+	E_FATAL("No triphones in %s\n", argv[1]);
+    printf("%d base phones, %d triphones from %s\n", n_ci, n_tri, argv[1]);
+
+    idx = itree_index(acmod_set);
+
+    /* Every triphone of the model */
+    tri = ckd_calloc(n_tri, sizeof(tri_t));
+    for (i = 0; i < n_tri; i++) {
+	m = &acmod_set->multi[i];
+	tri[i].base = m->base;
+	tri[i].left = m->left_context;
+	tri[i].right = m->right_context;
+	tri[i].posn = m->posn;
+    }
+    bench("lookup (model)", acmod_set, idx, tri, n_tri, n_rep);
+
+    /* Random triphones, as a decision tree or a new dictionary asks for */
+    srand(1);
+    for (i = 0; i < n_tri; i++) {
+	tri[i].base = rand() % n_ci;
+	tri[i].left = rand() % n_ci;
+	tri[i].right = rand() % n_ci;
+	tri[i].posn = (word_posn_t) (rand() % N_WORD_POSN);
+    }
+    bench("lookup (random)", acmod_set, idx, tri, n_tri, n_rep);
+
+    itree_index_free(idx, n_ci);
+    ckd_free(tri);
+
+    return 0;
+}
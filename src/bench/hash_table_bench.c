@@ -0,0 +1,191 @@
+/* ====================================================================
+ * Copyright (c) 2024 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*********************************************************************
+ *
+ * File: hash_table_bench.c
+ * 
+ * Description: 
+ * 	Time hash_table_t insertion, lookup and deletion using the
+ *	words of a pronunciation dictionary as keys.
+ *
+ *	Usage: hash_table_bench dictfn [n_rep]
+ *
+ *********************************************************************/
+
+#include <sphinxbase/hash_table.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/pio.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/err.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char **
+read_keys(const char *fn, int32 *out_n_key)
+{
+    FILE *fp;
+    lineiter_t *li;
+    char **key = NULL;
+    int32 n_key = 0, max_key = 0;
+    size_t n;
+
+    if ((fp = fopen(fn, "r")) == NULL)
+	E_FATAL_SYSTEM("Unable to open %s for reading", fn);
+    for (li = lineiter_start_clean(fp); li; li = lineiter_next(li)) {
+	n = strcspn(li->buf, " \t");
+	if (n == 0)
+	    continue;
+	if (n_key == max_key) {
+	    max_key = max_key ? 2 * max_key : 1024;
+	    key = ckd_realloc(key, max_key * sizeof(char *));
+	}
+	key[n_key] = ckd_calloc(n + 1, 1);
+	memcpy(key[n_key++], li->buf, n);
+    }
+    fclose(fp);
+    *out_n_key = n_key;
+
+    return key;
+}
+
+static void
+report(const char *what, ptmr_t *tm, int32 n_op)
+{
+    printf("%-24s %10d ops %8.3f sec %8.1f ns/op\n",
+	   what, n_op, tm->t_elapsed, 1e9 * tm->t_elapsed / n_op);
+}
+
+static void
+bench(char **key, char **miss, int32 n_key, int32 n_rep, int32 casearg)
+{
+    hash_table_t *h;
+    ptmr_t tm;
+    int32 r, i, n_found;
+    void *val;
+
+    printf("%s keys:\n", casearg == HASH_CASE_NO ? "Case-insensitive" : "Case-sensitive");
+
+    /* Start small so that growing the table is part of the cost */
+    ptmr_init(&tm);
+    for (r = 0; r < n_rep; r++) {
+	h = hash_table_new(16, casearg);
+	ptmr_start(&tm);
+	for (i = 0; i < n_key; i++)
+	    hash_table_enter(h, key[i], (void *)(long)i);
+	ptmr_stop(&tm);
+	hash_table_free(h);
+    }
+    report("insert (growing)", &tm, n_rep * n_key);
+
+    ptmr_init(&tm);
+    h = hash_table_new(n_key, casearg);
+    ptmr_start(&tm);
+    for (i = 0; i < n_key; i++)
+	hash_table_enter(h, key[i], (void *)(long)i);
+    ptmr_stop(&tm);
+    report("insert (presized)", &tm, n_key);
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (r = 0, n_found = 0; r < n_rep; r++) {
+	for (i = 0; i < n_key; i++)
+	    n_found += (hash_table_lookup(h, key[i], &val) == 0);
+    }
+    ptmr_stop(&tm);
+    report("lookup (hit)", &tm, n_rep * n_key);
+    if (n_found != n_rep * hash_table_inuse(h))
+	printf("  (%d duplicate keys)\n", n_key - hash_table_inuse(h));
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (r = 0, n_found = 0; r < n_rep; r++) {
+	for (i = 0; i < n_key; i++)
+	    n_found += (hash_table_lookup(h, miss[i], &val) == 0);
+    }
+    ptmr_stop(&tm);
+    report("lookup (miss)", &tm, n_rep * n_key);
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (i = 0; i < n_key; i++)
+	hash_table_delete(h, key[i]);
+    ptmr_stop(&tm);
+    report("delete", &tm, n_key);
+    if (hash_table_inuse(h) != 0)
+	E_ERROR("%d entries left after deleting every key\n",
+		hash_table_inuse(h));
+
+    hash_table_free(h);
+}
+
+int
+main(int argc, char *argv[])
+{
+    char **key, **miss;
+    int32 n_key, n_rep, i;
+
+    if (argc < 2) {
+	fprintf(stderr, "Usage: %s dictfn [n_rep]\n", argv[0]);
+	return 1;
+    }
+    n_rep = argc > 2 ? atoi(argv[2]) : 5;
+    if (n_rep < 1)
+	n_rep = 1;
+
+    key = read_keys(argv[1], &n_key);
+    if (n_key == 0)
+	E_FATAL("No keys in %s\n", argv[1]);
+    printf("%d keys from %s\n", n_key, argv[1]);
+
+    /* Keys which are not in the table but look like those which are */
+    miss = ckd_calloc(n_key, sizeof(char *));
+    for (i = 0; i < n_key; i++)
+	miss[i] = string_join(key[i], "#", NULL);
+
+    bench(key, miss, n_key, n_rep, HASH_CASE_YES);
+    bench(key, miss, n_key, n_rep, HASH_CASE_NO);
+
+    for (i = 0; i < n_key; i++) {
+	ckd_free(key[i]);
+	ckd_free(miss[i]);
+    }
+    ckd_free(key);
+    ckd_free(miss);
+
+    return 0;
+}
@@ -45,7 +45,7 @@
  * 	$Author$
  *********************************************************************/
 
-#include <s3/itree.h>
+#include "itree.h"
 
 #include <sphinxbase/ckd_alloc.h>
 
@@ -0,0 +1,310 @@
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*********************************************************************
+ *
+ * File: subvq_bench.c
+ * 
+ * Description: 
+ * 	Time sphinx3_align's SubVQ codeword scoring and Gaussian
+ *	shortlists, with and without -svqpack, and check how closely
+ *	the packed results follow the reference ones.
+ *
+ *	Usage: subvq_bench [-synth] svqfn [n_frame [subvqbeam]]
+ *
+ *	With -synth, a synthetic model (1000 mixtures of 16 Gaussians,
+ *	3 x 13-dimensional subvectors, 256 codewords) is first written
+ *	to svqfn, which must not exist yet.  Frames are drawn around the
+ *	codewords of randomly chosen Gaussians.
+ *
+ *********************************************************************/
+
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/err.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "subvq.h"
+
+#define SYN_N_MGAU	1000
+#define SYN_N_COMP	16
+#define SYN_N_SV	3
+#define SYN_SVLEN	13
+#define SYN_VQSIZE	256
+
+static const arg_t defn[] = {
+    { "-vqeval", ARG_INT32, "3", "Number of subvectors to score" },
+    { "-svqpack", ARG_BOOLEAN, "no", "Use packed codebooks" },
+    { NULL, 0, NULL, NULL }
+};
+
+static float32
+frand(void)
+{
+    return (float32) rand() / RAND_MAX;
+}
+
+static void
+write_synthetic(const char *fn)
+{
+    FILE *fp;
+    int32 s, r, c, d;
+
+    if ((fp = fopen(fn, "w")) == NULL)
+	E_FATAL_SYSTEM("Unable to open %s for writing", fn);
+
+    fprintf(fp, "VQParam %d %d -> %d %d\n",
+	    SYN_N_MGAU, SYN_N_COMP, SYN_N_SV, SYN_VQSIZE);
+    for (s = 0; s < SYN_N_SV; s++) {
+	fprintf(fp, "Subvector %d length %d", s, SYN_SVLEN);
+	for (d = 0; d < SYN_SVLEN; d++)
+	    fprintf(fp, " %d", s * SYN_SVLEN + d);
+	fprintf(fp, "\n");
+    }
+    for (s = 0; s < SYN_N_SV; s++) {
+	fprintf(fp, "Codebook %d\n", s);
+	for (r = 0; r < SYN_VQSIZE; r++) {
+	    for (d = 0; d < SYN_SVLEN; d++)
+		fprintf(fp, " %.4f %.4f", 4 * frand() - 2, 0.5 + frand());
+	    fprintf(fp, "\n");
+	}
+	fprintf(fp, "Map %d\n", s);
+	for (r = 0; r < SYN_N_MGAU; r++) {
+	    for (c = 0; c < SYN_N_COMP; c++)
+		fprintf(fp, " %d", rand() % SYN_VQSIZE);
+	    fprintf(fp, "\n");
+	}
+    }
+    fprintf(fp, "End\n");
+    fclose(fp);
+}
+
+static float32 **
+make_frames(subvq_t *vq, int32 n_frame)
+{
+    float32 **feat;
+    int32 veclen, f, s, d, r;
+
+    veclen = 0;
+    for (s = 0; s < vq->n_sv; s++) {
+	for (d = 0; d < vq->gautbl[s].veclen; d++) {
+	    if (vq->featdim[s][d] >= veclen)
+		veclen = vq->featdim[s][d] + 1;
+	}
+    }
+
+    feat = (float32 **) ckd_calloc_2d(n_frame, veclen, sizeof(float32));
+    for (f = 0; f < n_frame; f++) {
+	for (s = 0; s < vq->n_sv; s++) {
+	    r = rand() % vq->vqsize;
+	    for (d = 0; d < vq->gautbl[s].veclen; d++)
+		feat[f][vq->featdim[s][d]] =
+		    vq->gautbl[s].mean[r][d] + frand() - 0.5f;
+	}
+    }
+
+    return feat;
+}
+
+/* Score every frame and shortlist every mixture; return the total
+ * shortlist length, and the shortlists in sl if it is not NULL. */
+static int64
+run(subvq_t *vq, float32 **feat, int32 n_frame, int32 *n_comp,
+    int32 beam, logmath_t *lmath, int32 ***sl, int32 **vqdist, ptmr_t *tm)
+{
+    int32 f, m, n;
+    int64 n_sl;
+
+    n_sl = 0;
+    ptmr_start(tm);
+    for (f = 0; f < n_frame; f++) {
+	subvq_gautbl_eval_logs3(vq, feat[f], lmath);
+	if (vqdist)
+	    memcpy(vqdist[f], vq->vqdist[0],
+		   vq->n_sv * vq->vqsize * sizeof(int32));
+	for (m = 0; m < vq->origsize.r; m++) {
+	    n = subvq_mgau_shortlist(vq, m, n_comp[m], beam);
+	    n_sl += n;
+	    if (sl)
+		memcpy(sl[f][m], vq->mgau_sl, (n + 1) * sizeof(int32));
+	}
+    }
+    ptmr_stop(tm);
+
+    return n_sl;
+}
+
+static void
+report(const char *what, ptmr_t *tm, int32 n_frame, int64 n_sl,
+       int32 n_mgau)
+{
+    printf("%-24s %8d frames %8.3f sec %8.1f us/frame %6.2f gau/mixture\n",
+	   what, n_frame, tm->t_elapsed, 1e6 * tm->t_elapsed / n_frame,
+	   (double) n_sl / ((double) n_frame * n_mgau));
+}
+
+int
+main(int argc, char *argv[])
+{
+    cmd_ln_t *config;
+    logmath_t *lmath;
+    subvq_t *vq;
+    FILE *fp;
+    float32 **feat;
+    int32 ***ref_sl, ***pk_sl;
+    int32 **ref_dist, **pk_dist;
+    int32 *n_comp;
+    int32 n_frame, beam, f, m, c, i, j, d, max_diff, n_same;
+    int64 n_ref, n_pk, n_hit;
+    float64 subvqbeam;
+    const char *svqfn;
+    int32 synth, a;
+    ptmr_t tm;
+
+    synth = (argc > 1 && strcmp(argv[1], "-synth") == 0);
+    a = 1 + synth;
+    if (argc <= a) {
+	fprintf(stderr, "Usage: %s [-synth] svqfn [n_frame [subvqbeam]]\n",
+		argv[0]);
+	return 1;
+    }
+    svqfn = argv[a];
+    n_frame = argc > a + 1 ? atoi(argv[a + 1]) : 200;
+    if (n_frame < 1)
+	n_frame = 1;
+    subvqbeam = argc > a + 2 ? atof(argv[a + 2]) : 3.0e-3;
+
+    if ((fp = fopen(svqfn, "r")) != NULL) {
+	fclose(fp);
+	if (synth) {
+	    E_ERROR("%s exists; not overwriting it with a synthetic model\n",
+		    svqfn);
+	    return 1;
+	}
+    }
+    else if (synth) {
+	E_INFO("Writing a synthetic SubVQ model to %s\n", svqfn);
+	write_synthetic(svqfn);
+    }
+    else {
+	E_ERROR_SYSTEM("Unable to open %s (use -synth to write a synthetic "
+		       "model to it)", svqfn);
+	return 1;
+    }
+
+    config = cmd_ln_init(NULL, defn, TRUE, NULL);
+    lmath = logmath_init(1.0003, 0, 0);
+    beam = logmath_log(lmath, subvqbeam);
+    if ((vq = subvq_init(svqfn, 0.0001, -1, NULL, config, lmath)) == NULL)
+	E_FATAL("Failed to read %s\n", svqfn);
+
+    n_comp = (int32 *) ckd_calloc(vq->origsize.r, sizeof(int32));
+    for (m = 0; m < vq->origsize.r; m++) {
+	for (c = 0; c < vq->origsize.c && vq->map[m][c][0] >= 0; c++);
+	n_comp[m] = c;
+    }
+    feat = make_frames(vq, n_frame);
+    ref_sl = (int32 ***) ckd_calloc_3d(n_frame, vq->origsize.r,
+				       vq->origsize.c + 1, sizeof(int32));
+    pk_sl = (int32 ***) ckd_calloc_3d(n_frame, vq->origsize.r,
+				      vq->origsize.c + 1, sizeof(int32));
+    ref_dist = (int32 **) ckd_calloc_2d(n_frame, vq->n_sv * vq->vqsize,
+					sizeof(int32));
+    pk_dist = (int32 **) ckd_calloc_2d(n_frame, vq->n_sv * vq->vqsize,
+				       sizeof(int32));
+
+    printf("%d mixtures x %d Gaussians, %d subvectors x %d codewords, "
+	   "subvqbeam %g\n", vq->origsize.r, vq->origsize.c, vq->n_sv,
+	   vq->vqsize, subvqbeam);
+
+    /* Time without copying the results out, then run again to keep them */
+    vq->packed = FALSE;
+    ptmr_init(&tm);
+    n_ref = run(vq, feat, n_frame, n_comp, beam, lmath, NULL, NULL, &tm);
+    report("reference", &tm, n_frame, n_ref, vq->origsize.r);
+    ptmr_init(&tm);
+    run(vq, feat, n_frame, n_comp, beam, lmath, ref_sl, ref_dist, &tm);
+
+    vq->packed = TRUE;
+    ptmr_init(&tm);
+    n_pk = run(vq, feat, n_frame, n_comp, beam, lmath, NULL, NULL, &tm);
+    report("packed", &tm, n_frame, n_pk, vq->origsize.r);
+    ptmr_init(&tm);
+    run(vq, feat, n_frame, n_comp, beam, lmath, pk_sl, pk_dist, &tm);
+
+    /* How far apart are the codeword scores and the shortlists? */
+    max_diff = 0;
+    for (f = 0; f < n_frame; f++) {
+	for (d = 0; d < vq->n_sv * vq->vqsize; d++) {
+	    i = abs(ref_dist[f][d] - pk_dist[f][d]);
+	    if (i > max_diff)
+		max_diff = i;
+	}
+    }
+    n_same = 0;
+    n_hit = 0;
+    for (f = 0; f < n_frame; f++) {
+	for (m = 0; m < vq->origsize.r; m++) {
+	    for (i = 0; ref_sl[f][m][i] >= 0
+		     && ref_sl[f][m][i] == pk_sl[f][m][i]; i++);
+	    n_same += (ref_sl[f][m][i] < 0 && pk_sl[f][m][i] < 0);
+	    for (i = 0; ref_sl[f][m][i] >= 0; i++) {
+		for (j = 0; pk_sl[f][m][j] >= 0
+			 && pk_sl[f][m][j] != ref_sl[f][m][i]; j++);
+		n_hit += (pk_sl[f][m][j] >= 0);
+	    }
+	}
+    }
+    printf("max codeword score difference: %d\n", max_diff);
+    printf("identical shortlists: %.2f%%, recall %.4f%%\n",
+	   100.0 * n_same / ((double) n_frame * vq->origsize.r),
+	   n_ref ? 100.0 * n_hit / n_ref : 100.0);
+
+    ckd_free_3d(ref_sl);
+    ckd_free_3d(pk_sl);
+    ckd_free_2d(ref_dist);
+    ckd_free_2d(pk_dist);
+    ckd_free_2d(feat);
+    ckd_free(n_comp);
+    subvq_free(vq);
+    logmath_free(lmath);
+    cmd_ln_free_r(config);
+
+    return 0;
+}
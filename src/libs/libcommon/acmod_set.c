@@ -55,6 +55,9 @@
  *	- All base acoustic models must be defined before any triphone.
  *	- No more than 256 CI acoustic models may be defined
  *	- Triphones are the only multiphones supported at present.
+ *	- Triphones are indexed by an open addressing hash table sized
+ *	  from the 'n_tri_hint', which must therefore be given before
+ *	  any triphone is added.
  * ------------------------------------------------------------------
  *
  *	A workable calling sequence to this interface is be:
@@ -279,6 +282,44 @@ acmod_set_add_ci(acmod_set_t *acmod_set,
     return id;
 }
 
+/* Triphone index key.  CI phone IDs are less than 256, so base,
+ * contexts and word position pack into a single word. */
+#define TRI_KEY(b, l, r, p) \
+    (((uint32)(b) << 24) | ((uint32)(l) << 16) | ((uint32)(r) << 8) | (uint32)(p))
+
+static void
+tri_idx_alloc(acmod_set_t *acmod_set)
+{
+    uint32 n_slot, log2_n;
+    uint32 i;
+
+    /* Keep the load factor at or below 1/2 */
+    for (log2_n = 4, n_slot = 16;
+	 n_slot < 2 * acmod_set->max_n_multi;
+	 log2_n++, n_slot <<= 1);
+
+    acmod_set->tri_idx = ckd_calloc(n_slot, sizeof(acmod_tri_slot_t));
+    for (i = 0; i < n_slot; i++)
+	acmod_set->tri_idx[i].id = NO_ACMOD;
+    acmod_set->tri_shift = 32 - log2_n;
+}
+
+/* Returns the slot holding key, or the empty slot where it belongs */
+static acmod_tri_slot_t *
+tri_idx_find(acmod_set_t *acmod_set, uint32 key)
+{
+    acmod_tri_slot_t *idx = acmod_set->tri_idx;
+    uint32 mask = (0xffffffff >> acmod_set->tri_shift);
+    uint32 i;
+
+    /* Fibonacci hashing, then linear probing */
+    for (i = (key * 2654435769U) >> acmod_set->tri_shift;
+	 idx[i].id != NO_ACMOD && idx[i].key != key;
+	 i = (i + 1) & mask);
+
+    return &idx[i];
+}
+
 /*********************************************************************
  *
  * Function: acmod_set_add_tri()
@@ -315,8 +356,8 @@ acmod_set_add_tri(acmod_set_t *acmod_set,
     acmod_id_t new;
     uint32 addr;
     uint32 n_ci;
-    uint32 i;
     acmod_t *multi;
+    acmod_tri_slot_t *slot;
 
     if (acmod_set->n_multi == acmod_set->max_n_multi) {
 	E_FATAL("Current acmod_set implementation requires the 'n_tri_hint' to "
@@ -328,35 +369,8 @@ acmod_set_add_tri(acmod_set_t *acmod_set,
 
     n_ci = acmod_set->n_ci;
 
-    if (acmod_set->multi_idx == NULL) {
-	/* allocate space for multiphone -> acoustic model id
-	 * index */
-
-	acmod_set->multi_idx = ckd_calloc(n_ci,
-					  sizeof(itree_t *));
-
-	  /* HACK! In theory, n_ci * n_ci * N_WORD_POSN should be
-	     enough to store all possible triphones.  However, in
-	     practice, we have seen situation where, the number of
-	     cells allocated in itree is bigger than n_ci * n_ci *
-	     N_WORD_POSN.  This simply mean there might be something
-	     wrong within the itree module.
-
-	     One could follow this thread of discussion to further the
-	     investigation at
-	     http://sourceforge.net/forum/forum.php?thread_id=1541914&forum_id=5471
-	     
-	     The resource is checked in and could be found in test
-	     bugcase1. This will solve the immediate the problem which
-	     the user was suffering.  We should revisit this issue
-	     later on.
-	   */
-
-	for (i = 0; i < n_ci; i++) {	  
-	  acmod_set->multi_idx[i] = itree_new(n_ci * n_ci * N_WORD_POSN * 2); 
-	  /*  acmod_set->multi_idx[i] = itree_new(n_ci * n_ci * N_WORD_POSN ); */
-	}
-    }
+    if (acmod_set->tri_idx == NULL)
+	tri_idx_alloc(acmod_set);
     
     assert(base < 256);
     assert(left_context < 256);
@@ -364,10 +378,14 @@ acmod_set_add_tri(acmod_set_t *acmod_set,
 
     new = acmod_set->next_id;
 
-    /* adds an index cell for this triphone. */
-    itree_add_tri(acmod_set->multi_idx[base],
-		  left_context, right_context, posn,
-		  new);
+    /* adds an index slot for this triphone.  Should a triphone be
+     * added twice, lookups find its first ID. */
+    slot = tri_idx_find(acmod_set,
+			TRI_KEY(base, left_context, right_context, posn));
+    if (slot->id == NO_ACMOD) {
+	slot->key = TRI_KEY(base, left_context, right_context, posn);
+	slot->id = new;
+    }
     
     /* multiphone list does not include CI acoustic models */
     addr = new - n_ci;
@@ -666,43 +684,34 @@ acmod_set_id2fullname(acmod_set_t *acmod_set,
 	return NULL;
 }
 
+static acmod_set_t *enum_set = NULL;
+static acmod_id_t enum_base = NO_ACMOD;
+static uint32 enum_addr = 0;
+
 acmod_id_t
 acmod_set_enum_init(acmod_set_t *acmod_set,
 		    acmod_id_t base)
 {
-    cell_index_t ret;
-
-    if (acmod_set->n_multi == 0) {
-	/* none defined */
-
-	return NO_ACMOD;
-    }
-
-    ret = itree_enum_init(acmod_set->multi_idx[base]);
+    enum_set = acmod_set;
+    enum_base = base;
+    enum_addr = 0;
 
-    if (ret != NULL_INDEX) {
-	return ret;
-    }
-    else {
-	return NO_ACMOD;
-    }
+    return acmod_set_enum();
 }
-
+
 acmod_id_t
 acmod_set_enum()
 {
-    cell_index_t ret;
-
-    ret = itree_enum();
+    acmod_t *multi = enum_set->multi;
 
-    if (ret != NULL_INDEX) {
-	return ret;
-    }
-    else {
-	return NO_ACMOD;
+    for (; enum_addr < enum_set->n_multi; enum_addr++) {
+	if (multi[enum_addr].base == enum_base)
+	    return enum_set->n_ci + enum_addr++;
     }
+
+    return NO_ACMOD;
 }
-
+
 acmod_id_t
 acmod_set_tri2id(acmod_set_t *acmod_set,
 		 acmod_id_t phone,
@@ -710,25 +719,21 @@ acmod_set_tri2id(acmod_set_t *acmod_set,
 		 acmod_id_t right_context,
 		 word_posn_t posn)
 {
-    itree_t *idx;
-    cell_index_t i;
-
     if (acmod_set->n_multi == 0) {
 	/* none defined */
 
 	return NO_ACMOD;
     }
 
-    idx = acmod_set->multi_idx[phone];
-
-    i = itree_find_tri(idx, left_context, right_context, posn);
-
-    if (i != NULL_INDEX)
-	return i;
-    else
+    /* IDs which do not fit the key (e.g. NO_ACMOD) match nothing */
+    if ((phone | left_context | right_context | (uint32)posn) > 0xff)
 	return NO_ACMOD;
+
+    return tri_idx_find(acmod_set,
+			TRI_KEY(phone, left_context,
+				right_context, posn))->id;
 }
-
+
 int32
 acmod_set_id2tri(acmod_set_t *acmod_set,
 		 acmod_id_t *phone,
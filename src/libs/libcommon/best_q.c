@@ -46,6 +46,8 @@
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/bitvec.h>
 
 #include <s3/best_q.h>
 #include <s3/metric.h>
@@ -55,6 +57,373 @@
 #include <stdio.h>
 #include <string.h>
 
+/*
+ * Sufficient statistics of the triphones at a node, one contiguous
+ * row per triphone.  Each row holds the mixture weight counts for
+ * every state and stream followed, for continuous models, by the
+ * weighted sums of x and x^2 (taken from the single Gaussian of each
+ * state).  Since all the statistics are additive, the statistics of
+ * the "no" side of a split are the node total minus those of the
+ * "yes" side, and only the smaller side needs to be summed.
+ */
+typedef struct bq_stats_s {
+    uint32 n_row;	/* # of triphones at the node */
+    uint32 row_len;	/* # of statistics per triphone */
+    uint32 mean_off;	/* Offset of sum(x) in a row */
+    uint32 var_off;	/* Offset of sum(x^2) in a row */
+    uint32 *vec_off;	/* Offset of each stream within sum(x) or sum(x^2) */
+    float32 *row;	/* n_row x row_len statistics */
+    float64 *total;	/* Node total for each statistic */
+} bq_stats_t;
+
+/* Scratch for evaluating one question; one per thread. */
+typedef struct bq_scratch_s {
+    bitvec_t *yes;	/* Which triphones answer the question with yes */
+    float64 *acc;	/* Statistics of the smaller side of the split */
+    float64 *yes_occ;	/* Occupancy of each state, yes side */
+    float64 *no_occ;	/* Occupancy of each state, no side */
+    float32 ***yes_dist;
+    float32 ***no_dist;
+    float32 ***yes_means;
+    float32 ***yes_vars;
+    float32 ***no_means;
+    float32 ***no_vars;
+} bq_scratch_t;
+
+/* Everything needed to evaluate a subset of the questions at a node. */
+typedef struct bq_job_s {
+    bq_stats_t *stats;
+    uint32 *veclen;
+    uint32 n_state;
+    uint32 n_stream;
+    uint32 n_density;
+    uint32 sumveclen;
+    uint32 continuous;
+    float32 varfloor;
+    float32 *stwt;
+    uint32 **dfeat;
+    uint32 n_dfeat;
+    quest_t *all_q;
+    uint32 n_all_q;
+    uint32 *id;
+    uint32 n_id;
+    float32 ***dist;
+    float64 node_wt_ent;
+
+    /* Questions first_q, first_q + q_step, ... are evaluated */
+    uint32 first_q;
+    uint32 q_step;
+
+    /* Best question found in this subset */
+    uint32 b_q;
+    float64 b_einc;
+    uint32 n_b_yes;
+    uint32 n_b_no;
+} bq_job_t;
+
+static void
+bq_stats_init(bq_stats_t *st,
+	      float32 ****mixw,
+	      float32 ****means,
+	      float32 ****vars,
+	      uint32 *veclen,
+	      uint32 n_state,
+	      uint32 n_stream,
+	      uint32 n_density,
+	      uint32 continuous,
+	      uint32 *id,
+	      uint32 n_id)
+{
+    uint32 ii, i, s, j, k, n_mixw, len;
+    float32 *row, *m_row, *v_row;
+    float32 wt;
+
+    n_mixw = n_state * n_stream * n_density;
+    st->vec_off = ckd_calloc(n_stream, sizeof(uint32));
+    for (j = 0, len = 0; j < n_stream; j++) {
+	st->vec_off[j] = len;
+	len += veclen[j];
+    }
+    st->n_row = n_id;
+    st->mean_off = n_mixw;
+    st->var_off = n_mixw + n_state * len;
+    st->row_len = n_mixw + (continuous == 1 ? 2 * n_state * len : 0);
+    st->row = ckd_calloc((size_t)n_id * st->row_len, sizeof(float32));
+    st->total = ckd_calloc(st->row_len, sizeof(float64));
+
+    for (ii = 0; ii < n_id; ii++) {
+	i = id[ii];
+	row = st->row + (size_t)ii * st->row_len;
+
+	/* Each state may point into a different part of the
+	 * caller's mixture weight array */
+	for (s = 0; s < n_state; s++) {
+	    for (j = 0; j < n_stream; j++) {
+		memcpy(row + (s * n_stream + j) * n_density, mixw[i][s][j],
+		       n_density * sizeof(float32));
+	    }
+	}
+	if (continuous == 1) {
+	    for (s = 0; s < n_state; s++) {
+		for (j = 0; j < n_stream; j++) {
+		    /* For continuous hmms we have only one gaussian per state */
+		    wt = mixw[i][s][j][0];
+		    m_row = row + st->mean_off + s * len + st->vec_off[j];
+		    v_row = row + st->var_off + s * len + st->vec_off[j];
+		    for (k = 0; k < veclen[j]; k++) {
+			m_row[k] = wt * means[i][s][j][k];
+			v_row[k] = wt * (vars[i][s][j][k]
+					 + means[i][s][j][k] * means[i][s][j][k]);
+		    }
+		}
+	    }
+	}
+	for (k = 0; k < st->row_len; k++)
+	    st->total[k] += row[k];
+    }
+}
+
+static void
+bq_stats_free(bq_stats_t *st)
+{
+    ckd_free(st->vec_off);
+    ckd_free(st->row);
+    ckd_free(st->total);
+}
+
+static void
+bq_scratch_init(bq_scratch_t *sc, bq_job_t *job)
+{
+    sc->yes = bitvec_alloc(job->n_id);
+    sc->acc = ckd_calloc(job->stats->row_len, sizeof(float64));
+    sc->yes_occ = ckd_calloc(job->n_state, sizeof(float64));
+    sc->no_occ = ckd_calloc(job->n_state, sizeof(float64));
+    sc->yes_dist = (float32 ***)ckd_calloc_3d(job->n_state, job->n_stream, job->n_density, sizeof(float32));
+    sc->no_dist = (float32 ***)ckd_calloc_3d(job->n_state, job->n_stream, job->n_density, sizeof(float32));
+    if (job->continuous == 1) {
+        /* Allocating for sumveclen is overallocation, but it eases coding */
+        sc->yes_means = (float32 ***)ckd_calloc_3d(job->n_state,job->n_stream,job->sumveclen,sizeof(float32));
+        sc->yes_vars = (float32 ***)ckd_calloc_3d(job->n_state,job->n_stream,job->sumveclen,sizeof(float32));
+        sc->no_means = (float32 ***)ckd_calloc_3d(job->n_state,job->n_stream,job->sumveclen,sizeof(float32));
+        sc->no_vars = (float32 ***)ckd_calloc_3d(job->n_state,job->n_stream,job->sumveclen,sizeof(float32));
+    }
+    else {
+        sc->yes_means = sc->yes_vars = sc->no_means = sc->no_vars = NULL;
+    }
+}
+
+static void
+bq_scratch_free(bq_scratch_t *sc)
+{
+    bitvec_free(sc->yes);
+    ckd_free(sc->acc);
+    ckd_free(sc->yes_occ);
+    ckd_free(sc->no_occ);
+    ckd_free_3d((void ***)sc->yes_dist);
+    ckd_free_3d((void ***)sc->no_dist);
+    if (sc->yes_means) {
+        ckd_free_3d((void ***)sc->yes_means);
+        ckd_free_3d((void ***)sc->yes_vars);
+        ckd_free_3d((void ***)sc->no_means);
+        ckd_free_3d((void ***)sc->no_vars);
+    }
+}
+
+/*
+ * Normalize one side of a split for state s, given its statistics
+ * (acc, or total - acc if total is non-NULL) and occupancy, into the
+ * dist/means/vars arrays used by the entropy functions.
+ */
+static void
+bq_side_norm(bq_job_t *job,
+	     const float64 *acc,
+	     const float64 *total,
+	     uint32 s,
+	     float64 dnom,
+	     float32 **dist,
+	     float32 **means,
+	     float32 **vars)
+{
+    bq_stats_t *st = job->stats;
+    uint32 j, k, off;
+    float64 norm, x;
+
+#define BQ_STAT(o) (total ? total[o] - acc[o] : acc[o])
+
+    off = s * job->n_stream * job->n_density;
+    norm = 1.0 / dnom;
+
+    for (j = 0; j < job->n_stream; j++) {
+	for (k = 0; k < job->n_density; k++) {
+	    dist[j][k] = BQ_STAT(off + j * job->n_density + k) * norm;
+	}
+    }
+    if (job->continuous == 1) {
+	for (j = 0; j < job->n_stream; j++) {
+	    off = s * job->sumveclen + st->vec_off[j];
+	    for (k = 0; k < job->veclen[j]; k++) {
+		x = BQ_STAT(st->mean_off + off + k) * norm;
+		means[j][k] = x;
+		vars[j][k] = BQ_STAT(st->var_off + off + k) * norm - x * x;
+		if (vars[j][k] < job->varfloor) vars[j][k] = job->varfloor;
+	    }
+	}
+    }
+#undef BQ_STAT
+}
+
+/*
+ * Compute the weighted entropy increase (or likelihood increase for
+ * continuous models) of splitting the node with question q.  Returns
+ * FALSE if the question does not split the node.
+ */
+static int
+eval_one_q(bq_job_t *job,
+	   bq_scratch_t *sc,
+	   uint32 q,
+	   float64 *out_einc,
+	   uint32 *out_n_yes,
+	   uint32 *out_n_no)
+{
+    bq_stats_t *st = job->stats;
+    uint32 n_state = job->n_state;
+    uint32 n_stream = job->n_stream;
+    uint32 n_density = job->n_density;
+    uint32 continuous = job->continuous;
+    float64 y_ent, n_ent;
+    float64 yes_dnom, no_dnom;
+    const float64 *yes_acc, *no_acc, *yes_total, *no_total;
+    const float32 *row;
+    uint32 n_yes, n_no;
+    uint32 ii, j, k, s;
+    int side;
+    float64 einc;
+
+    bitvec_clear_all(sc->yes, job->n_id);
+    for (ii = 0, n_yes = 0; ii < job->n_id; ii++) {
+	if (eval_quest(&job->all_q[q], job->dfeat[job->id[ii]], job->n_dfeat)) {
+	    bitvec_set(sc->yes, ii);
+	    ++n_yes;
+	}
+    }
+    n_no = job->n_id - n_yes;
+
+    if ((n_yes == 0) || (n_no == 0)) {
+	/* no split.  All satisfy or all don't satisfy */
+	return FALSE;
+    }
+
+    /* Sum the statistics of whichever side is smaller.  The state
+     * occupancies are summed directly on both sides, so that an
+     * empty side is exactly zero rather than a rounding residue. */
+    side = (n_yes <= n_no);
+    memset(sc->acc, 0, st->row_len * sizeof(float64));
+    memset(sc->yes_occ, 0, n_state * sizeof(float64));
+    memset(sc->no_occ, 0, n_state * sizeof(float64));
+    for (ii = 0; ii < job->n_id; ii++) {
+	int is_yes = (bitvec_is_set(sc->yes, ii) != 0);
+	float64 *occ = is_yes ? sc->yes_occ : sc->no_occ;
+
+	row = st->row + (size_t)ii * st->row_len;
+	for (s = 0; s < n_state; s++) {
+	    for (k = 0; k < n_density; k++)
+		occ[s] += row[s * n_stream * n_density + k];
+	}
+	if (is_yes != side)
+	    continue;
+	for (k = 0; k < st->row_len; k++)
+	    sc->acc[k] += row[k];
+    }
+    if (side) {
+	yes_acc = sc->acc; yes_total = NULL;
+	no_acc = sc->acc; no_total = st->total;
+    }
+    else {
+	yes_acc = sc->acc; yes_total = st->total;
+	no_acc = sc->acc; no_total = NULL;
+    }
+
+    for (s = 0, einc = 0; s < n_state; s++) {
+	yes_dnom = sc->yes_occ[s];
+	if (yes_dnom == 0)
+	    break;
+	no_dnom = sc->no_occ[s];
+	if (no_dnom == 0)
+	    break;
+
+	bq_side_norm(job, yes_acc, yes_total, s, yes_dnom, sc->yes_dist[s],
+		     continuous ? sc->yes_means[s] : NULL,
+		     continuous ? sc->yes_vars[s] : NULL);
+	bq_side_norm(job, no_acc, no_total, s, no_dnom, sc->no_dist[s],
+		     continuous ? sc->no_means[s] : NULL,
+		     continuous ? sc->no_vars[s] : NULL);
+
+	if (continuous == 1) {
+	    y_ent = 0;
+	    n_ent = 0;
+	    for (j = 0; j < n_stream; j++) {
+		y_ent +=  yes_dnom * ent_cont(sc->yes_means[s][j],sc->yes_vars[s][j],job->veclen[j]);
+		n_ent +=  no_dnom * ent_cont(sc->no_means[s][j],sc->no_vars[s][j],job->veclen[j]);
+	    }
+	    einc += (float64)job->stwt[s] * (y_ent + n_ent);
+	}
+	else {
+	    einc += (float64)job->stwt[s] * wt_ent_inc(sc->yes_dist[s], yes_dnom,
+						       sc->no_dist[s], no_dnom,
+						       job->dist[s], n_stream, n_density);
+	}
+    }
+
+    if (continuous == 1) {
+	einc -=  job->node_wt_ent;
+    }
+
+    if (s < n_state) {
+	/* Ended iteration over states prematurely; assume 'bad' question */
+	return FALSE;
+    }
+
+    *out_einc = einc;
+    *out_n_yes = n_yes;
+    *out_n_no = n_no;
+
+    return TRUE;
+}
+
+/*
+ * Evaluate the questions assigned to one job.  Questions are visited
+ * in increasing order and only a strictly better one replaces the
+ * current best, so ties go to the lowest question index.
+ */
+static int
+best_q_worker(bq_job_t *job)
+{
+    bq_scratch_t sc;
+    uint32 q, n_yes, n_no;
+    float64 einc;
+
+    bq_scratch_init(&sc, job);
+    for (q = job->first_q; q < job->n_all_q; q += job->q_step) {
+	if (!eval_one_q(job, &sc, q, &einc, &n_yes, &n_no))
+	    continue;
+	if (einc > job->b_einc) {
+	    job->b_einc = einc;
+	    job->b_q = q;
+	    job->n_b_yes = n_yes;
+	    job->n_b_no = n_no;
+	}
+    }
+    bq_scratch_free(&sc);
+
+    return 0;
+}
+
+static int
+best_q_thread(sbthread_t *th)
+{
+    return best_q_worker((bq_job_t *)sbthread_arg(th));
+}
+
 float64
 best_q(float32 ****mixw,
        float32 ****means,
@@ -76,27 +445,19 @@ best_q(float32 ****mixw,
        float64 node_wt_ent,  /* Weighted entropy of node */
        quest_t **out_best_q)
 {
-    float32 ***yes_dist;
-    float32 ***yes_means=0;
-    float32 ***yes_vars=0;
-    float32 varfloor=0;
-    float64 y_ent;
-    float64 yes_dnom, yes_norm;
-    uint32 *yes_id;
-    float32 ***no_dist;
-    float32 ***no_means=0;
-    float32 ***no_vars=0;
-    float64 n_ent;
-    float64 no_dnom, no_norm;
-    uint32 *no_id;
-    uint32 n_yes, n_b_yes = 0;
-    uint32 n_no, n_b_no = 0;
-    uint32 i, j, k, q, b_q=0, s;
+    bq_stats_t stats;
+    bq_job_t *job;
+    sbthread_t **thread;
+    uint32 n_thread, t;
+    uint32 b_q = 0;
+    uint32 n_b_yes = 0;
+    uint32 n_b_no = 0;
+    float64 b_einc = -1.0e+50;
     uint32 ii;
-    float64 einc, b_einc = -1.0e+50;
 
     const char*  type;
     uint32 continuous, sumveclen=0;
+    float32 varfloor=0;
 
     type = cmd_ln_str("-ts2cbfn");
     if (strcmp(type,".semi.")!=0 && strcmp(type,".cont.") != 0)
@@ -108,161 +469,75 @@ best_q(float32 ****mixw,
 
     if (continuous == 1) {
         varfloor = cmd_ln_float32("-varfloor");
-        /* Allocating for sumveclen is overallocation, but it eases coding */
         for (ii=0,sumveclen=0;ii<n_stream;ii++) sumveclen += veclen[ii];
-        yes_means = (float32 ***)ckd_calloc_3d(n_state,n_stream,sumveclen,sizeof(float32));
-        yes_vars = (float32 ***)ckd_calloc_3d(n_state,n_stream,sumveclen,sizeof(float32));
-        no_means = (float32 ***)ckd_calloc_3d(n_state,n_stream,sumveclen,sizeof(float32));
-        no_vars = (float32 ***)ckd_calloc_3d(n_state,n_stream,sumveclen,sizeof(float32));
     }
 
-    n_yes = n_no = 0;
-
-    yes_dist = (float32 ***)ckd_calloc_3d(n_state, n_stream, n_density, sizeof(float32));
-    no_dist = (float32 ***)ckd_calloc_3d(n_state, n_stream, n_density, sizeof(float32));
-
-    for (q = 0; q < n_all_q; q++) {
-	memset(&yes_dist[0][0][0], 0, sizeof(float32) * n_state * n_stream * n_density);
-	memset(&no_dist[0][0][0], 0, sizeof(float32) * n_state * n_stream * n_density);
+    n_thread = 1;
+    if (cmd_ln_exists("-nthreads") && cmd_ln_int32("-nthreads") > 1)
+        n_thread = cmd_ln_int32("-nthreads");
+    /* Not worth starting threads which would only get a question or two */
+    if (n_thread > n_all_q / 2)
+        n_thread = n_all_q / 2;
+    if (n_thread < 1)
+        n_thread = 1;
+
+    bq_stats_init(&stats, mixw, means, vars, veclen,
+                  n_state, n_stream, n_density, continuous, id, n_id);
+
+    job = ckd_calloc(n_thread, sizeof(*job));
+    for (t = 0; t < n_thread; t++) {
+        job[t].stats = &stats;
+        job[t].veclen = veclen;
+        job[t].n_state = n_state;
+        job[t].n_stream = n_stream;
+        job[t].n_density = n_density;
+        job[t].sumveclen = sumveclen;
+        job[t].continuous = continuous;
+        job[t].varfloor = varfloor;
+        job[t].stwt = stwt;
+        job[t].dfeat = dfeat;
+        job[t].n_dfeat = n_dfeat;
+        job[t].all_q = all_q;
+        job[t].n_all_q = n_all_q;
+        job[t].id = id;
+        job[t].n_id = n_id;
+        job[t].dist = dist;
+        job[t].node_wt_ent = node_wt_ent;
+        job[t].first_q = t;
+        job[t].q_step = n_thread;
+        job[t].b_einc = -1.0e+50;
+    }
 
-        if (continuous == 1) {
-	    memset(&yes_means[0][0][0], 0, sizeof(float32) * n_state * n_stream * sumveclen);
-	    memset(&yes_vars[0][0][0], 0, sizeof(float32) * n_state * n_stream * sumveclen);
-	    memset(&no_means[0][0][0], 0, sizeof(float32) * n_state * n_stream * sumveclen);
-	    memset(&no_vars[0][0][0], 0, sizeof(float32) * n_state * n_stream * sumveclen);
+    if (n_thread == 1) {
+        best_q_worker(&job[0]);
+    }
+    else {
+        thread = ckd_calloc(n_thread, sizeof(*thread));
+        for (t = 1; t < n_thread; t++) {
+            if ((thread[t] = sbthread_start(best_q_thread, &job[t])) == NULL)
+                E_FATAL("Failed to start question evaluation thread\n");
         }
+        best_q_worker(&job[0]);
+        for (t = 1; t < n_thread; t++)
+            sbthread_free(thread[t]);
+        ckd_free(thread);
+    }
 
-	n_yes = n_no = 0;
-
-	for (ii = 0; ii < n_id; ii++) {
-	    i = id[ii];
-	    if (eval_quest(&all_q[q], dfeat[i], n_dfeat)) {
-	        for (s = 0; s < n_state; s++) {
-		    for (j = 0; j < n_stream; j++) {
-			for (k = 0; k < n_density; k++) {
-			    yes_dist[s][j][k] += mixw[i][s][j][k];
-			}
-		    }
-		}
-                if (continuous == 1) {
-	            for (s = 0; s < n_state; s++) {
-		        for (j = 0; j < n_stream; j++) {
-			    for (k = 0; k < veclen[j]; k++) {
-                                yes_means[s][j][k] += mixw[i][s][j][0] * means[i][s][j][k];
-                                yes_vars[s][j][k] += mixw[i][s][j][0] * (vars[i][s][j][k] + means[i][s][j][k]*means[i][s][j][k]);
-			    }
-		        }
-		    }
-		}
-		++n_yes;
-	    }
-	    else {
-		for (s = 0; s < n_state; s++) {
-		    for (j = 0; j < n_stream; j++) {
-			for (k = 0; k < n_density; k++) {
-			    no_dist[s][j][k] += mixw[i][s][j][k];
-			}
-		    }
-		}
-                if (continuous == 1) {
-	            for (s = 0; s < n_state; s++) {
-		        for (j = 0; j < n_stream; j++) {
-			    for (k = 0; k < veclen[j]; k++) {
-                                no_means[s][j][k] += mixw[i][s][j][0] * means[i][s][j][k];
-                                no_vars[s][j][k] += mixw[i][s][j][0] * (vars[i][s][j][k] + means[i][s][j][k]*means[i][s][j][k]);
-			    }
-		        }
-		    }
-		}
-		++n_no;
-	    }
-	}
-	
-	if ((n_yes == 0) || (n_no == 0)) {
-	    /* no split.  All satisfy or all don't satisfy */
-	    continue;
-	}
-
-
-	for (s = 0, einc = 0; s < n_state; s++) {
-	    for (k = 0, yes_dnom = 0; k < n_density; k++) {
-		yes_dnom += yes_dist[s][0][k];
-	    }
-	
-	    if (yes_dnom == 0)
-	      break;
-
-	    yes_norm = 1.0 / yes_dnom;
-	
-	    for (j = 0; j < n_stream; j++) {
-		for (k = 0; k < n_density; k++) {
-		    yes_dist[s][j][k] *= yes_norm;
-		}
-	    }
-	
-	    for (k = 0, no_dnom = 0; k < n_density; k++) {
-		no_dnom += no_dist[s][0][k];
-	    }
-	
-	    if (no_dnom == 0)
-	      break;
-
-	    no_norm = 1.0 / no_dnom;
-	    
-	    for (j = 0; j < n_stream; j++) {
-		for (k = 0; k < n_density; k++) {
-		    no_dist[s][j][k] *= no_norm;
-		}
-	    }
-
-            if (continuous == 1) {
-                y_ent = 0;
-                n_ent = 0;
-	        for (j = 0; j < n_stream; j++) {
-                    if (yes_dnom != 0) {
-   		        for (k = 0; k < veclen[j]; k++) {
-                            yes_means[s][j][k] *= yes_norm;
-                            yes_vars[s][j][k] = yes_vars[s][j][k]*yes_norm - 
-                                          yes_means[s][j][k]*yes_means[s][j][k];
-                            if (yes_vars[s][j][k] < varfloor) yes_vars[s][j][k] = varfloor;
-                        }
-                    }
-                    if (no_dnom != 0) {
-   		        for (k = 0; k < veclen[j]; k++) {
-                            no_means[s][j][k] *= no_norm;
-                            no_vars[s][j][k] = no_vars[s][j][k]*no_norm - 
-                                            no_means[s][j][k]*no_means[s][j][k];
-                            if (no_vars[s][j][k] < varfloor) no_vars[s][j][k] = varfloor;
-                        }
-                    }
-                    y_ent +=  yes_dnom * ent_cont(yes_means[s][j],yes_vars[s][j],veclen[j]);
-                    n_ent +=  no_dnom * ent_cont(no_means[s][j],no_vars[s][j],veclen[j]);
-                }
-                einc += (float64)stwt[s] * (y_ent + n_ent);
-            }
-            else {
-	        einc += (float64)stwt[s] * wt_ent_inc(yes_dist[s], yes_dnom,
-	    				     no_dist[s], no_dnom,
-					     dist[s], n_stream, n_density);
-            }
-	}
-
-        if (continuous == 1) {
-            einc -=  node_wt_ent;
+    /* Combine the per-thread results, breaking ties by question
+     * index so the result does not depend on the number of threads */
+    for (t = 0; t < n_thread; t++) {
+        if (job[t].n_b_yes == 0 || job[t].n_b_no == 0)
+            continue;
+        if (job[t].b_einc > b_einc
+            || (job[t].b_einc == b_einc && job[t].b_q < b_q)) {
+            b_einc = job[t].b_einc;
+            b_q = job[t].b_q;
+            n_b_yes = job[t].n_b_yes;
+            n_b_no = job[t].n_b_no;
         }
-
-	if (s < n_state) {
-	  /* Ended iteration over states prematurely; assume 'bad' question */
-	  continue;
-	}
-	
-	if (einc > b_einc) {
-	    b_einc = einc;
-	    b_q = q;
-	    n_b_yes = n_yes;
-	    n_b_no = n_no;
-	}
     }
+    ckd_free(job);
+    bq_stats_free(&stats);
 
     if ((n_b_yes == 0) || (n_b_no == 0)) {
 	/* No best question */
@@ -271,51 +546,6 @@ best_q(float32 ****mixw,
 	return 0;
     }
 
-    yes_id = (uint32 *)ckd_calloc(n_b_yes, sizeof(uint32));
-    no_id  = (uint32 *)ckd_calloc(n_b_no, sizeof(uint32));
-
-    memset(&yes_dist[0][0][0], 0, sizeof(float32) * n_state * n_stream * n_density);
-    memset(&no_dist[0][0][0], 0, sizeof(float32) * n_state * n_stream * n_density);
-    n_yes = n_no = 0;
-
-    for (ii = 0; ii < n_id; ii++) {
-	i = id[ii];
-	if (eval_quest(&all_q[b_q], dfeat[i], n_dfeat)) {
-	    for (s = 0; s < n_state; s++) {
-		for (j = 0; j < n_stream; j++) {
-		    for (k = 0; k < n_density; k++) {
-			yes_dist[s][j][k] += mixw[i][s][j][k];
-		    }
-		}
-	    }
-	    yes_id[n_yes] = i;
-	    ++n_yes;
-	}
-	else {
-	    for (s = 0; s < n_state; s++) {
-		for (j = 0; j < n_stream; j++) {
-		    for (k = 0; k < n_density; k++) {
-			no_dist[s][j][k] += mixw[i][s][j][k];
-		    }
-		}
-	    }
-	    no_id[n_no] = i;
-	    ++n_no;
-	}
-    }
-    
-    ckd_free_3d((void ***)yes_dist);
-    ckd_free((void *)yes_id);
-    ckd_free_3d((void ***)no_dist);
-    ckd_free((void *)no_id);
-
-    if (continuous == 1) {
-        ckd_free_3d((void ***)yes_means);
-        ckd_free_3d((void ***)yes_vars);
-        ckd_free_3d((void ***)no_means);
-        ckd_free_3d((void ***)no_vars);
-    }
-
     *out_best_q = &all_q[b_q];
 
     return b_einc;
@@ -49,6 +49,8 @@
 #include <sphinxbase/pio.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/sbthread.h>
 
 #include <s3/dtree.h>
 #include <s3/best_q.h>
@@ -56,6 +58,7 @@
 #include <s3/div.h>
 #include <s3/s3.h>
 
+#include <sys/stat.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -357,6 +360,541 @@ read_final_tree(FILE *fp,
     return out;
 }
 
+/*
+ * Binary trees are native 32-bit words:
+ *
+ *	DTREE_BIN_MAGIC (8 bytes)
+ *	byte order, version, n_node, n_name, n_str_word, n_quest_word
+ *	strings: names of the phone sets asked about, each NUL
+ *	terminated, padded to n_str_word words
+ *	per node (by node id): yes child, no child, question offset
+ *	(NO_ID for leaves), occ, wt_ent (2 words), wt_ent_dec (2 words)
+ *	questions: sum_len, then per term prod_len and per simple
+ *	question ctxt, neg, name
+ *
+ * Phone sets are stored by name, as in the text format, so a tree
+ * stays valid if the question set is reordered.
+ */
+#define DTREE_BIN_HDR_WORDS	6
+#define DTREE_BIN_BYTE_ORDER	0x11223344
+#define DTREE_BIN_NODE_WORDS	8
+
+typedef struct dtree_bin_s {
+    uint32 *rec;
+    uint32 *qw;
+    uint32 n_qw, max_qw;
+    int32 *name_id;		/* name index of each phone set, or -1 */
+    uint32 n_name_id;
+    uint32 n_name;
+} dtree_bin_t;
+
+static void
+dtree_bin_qword(dtree_bin_t *b, uint32 w)
+{
+    if (b->n_qw == b->max_qw) {
+	b->max_qw = b->max_qw ? 2 * b->max_qw : 256;
+	b->qw = ckd_realloc(b->qw, b->max_qw * sizeof(uint32));
+    }
+    b->qw[b->n_qw++] = w;
+}
+
+static int
+dtree_bin_node(dtree_bin_t *b, dtree_node_t *node, uint32 n_node)
+{
+    uint32 *r;
+    comp_quest_t *q;
+    uint32 i, j, ps;
+
+    if (node->node_id >= n_node) {
+	E_ERROR("Node id %u out of range; tree must be reindexed\n",
+		node->node_id);
+	return S3_ERROR;
+    }
+    r = &b->rec[node->node_id * DTREE_BIN_NODE_WORDS];
+    memcpy(&r[3], &node->occ, sizeof(float32));
+    memcpy(&r[4], &node->wt_ent, sizeof(float64));
+    memcpy(&r[6], &node->wt_ent_dec, sizeof(float64));
+    if (IS_LEAF(node)) {
+	r[0] = r[1] = r[2] = NO_ID;
+	return S3_SUCCESS;
+    }
+
+    r[0] = node->y->node_id;
+    r[1] = node->n->node_id;
+    r[2] = b->n_qw;
+    q = (comp_quest_t *)node->q;
+    dtree_bin_qword(b, q->sum_len);
+    for (i = 0; i < q->sum_len; i++) {
+	dtree_bin_qword(b, q->prod_len[i]);
+	for (j = 0; j < q->prod_len[i]; j++) {
+	    ps = q->conj_q[i][j].pset;
+	    if (ps >= b->n_name_id) {
+		b->name_id = ckd_realloc(b->name_id, (ps + 1) * sizeof(int32));
+		for (; b->n_name_id <= ps; b->n_name_id++)
+		    b->name_id[b->n_name_id] = -1;
+	    }
+	    if (b->name_id[ps] < 0)
+		b->name_id[ps] = b->n_name++;
+	    dtree_bin_qword(b, (uint32)q->conj_q[i][j].ctxt);
+	    dtree_bin_qword(b, q->conj_q[i][j].neg);
+	    dtree_bin_qword(b, (uint32)b->name_id[ps]);
+	}
+    }
+
+    if (dtree_bin_node(b, node->y, n_node) != S3_SUCCESS)
+	return S3_ERROR;
+    return dtree_bin_node(b, node->n, n_node);
+}
+
+int32
+write_final_tree_bin(const char *fn,
+		     dtree_node_t *node,
+		     pset_t *pset)
+{
+    dtree_bin_t b;
+    uint32 hdr[DTREE_BIN_HDR_WORDS];
+    uint32 n_node, n_str, i;
+    size_t off;
+    char *str;
+    FILE *fp;
+    int32 rv = S3_ERROR;
+
+    memset(&b, 0, sizeof(b));
+    n_node = cnt_node(node);
+    if (node->node_id != 0) {
+	E_ERROR("Root node id is %u, not 0; tree must be reindexed\n",
+		node->node_id);
+	return S3_ERROR;
+    }
+    b.rec = ckd_calloc(n_node * DTREE_BIN_NODE_WORDS, sizeof(uint32));
+    if (dtree_bin_node(&b, node, n_node) != S3_SUCCESS)
+	goto done;
+
+    for (i = 0, off = 0; i < b.n_name_id; i++) {
+	if (b.name_id[i] >= 0)
+	    off += strlen(pset[i].name) + 1;
+    }
+    n_str = (off + 3) / 4;
+    str = ckd_calloc(n_str, 4);
+    /* Names go in the order they were first asked about */
+    {
+	uint32 k;
+
+	for (k = 0, off = 0; k < b.n_name; k++) {
+	    for (i = 0; b.name_id[i] != (int32)k; i++);
+	    strcpy(str + off, pset[i].name);
+	    off += strlen(pset[i].name) + 1;
+	}
+    }
+
+    hdr[0] = DTREE_BIN_BYTE_ORDER;
+    hdr[1] = DTREE_BIN_VERSION;
+    hdr[2] = n_node;
+    hdr[3] = b.n_name;
+    hdr[4] = n_str;
+    hdr[5] = b.n_qw;
+
+    fp = fopen(fn, "wb");
+    if (fp == NULL) {
+	E_ERROR_SYSTEM("Unable to open %s for writing", fn);
+	ckd_free(str);
+	goto done;
+    }
+    if (fwrite(DTREE_BIN_MAGIC, 1, 8, fp) != 8
+	|| fwrite(hdr, 4, DTREE_BIN_HDR_WORDS, fp) != DTREE_BIN_HDR_WORDS
+	|| fwrite(str, 4, n_str, fp) != n_str
+	|| fwrite(b.rec, 4, n_node * DTREE_BIN_NODE_WORDS, fp)
+	!= n_node * DTREE_BIN_NODE_WORDS
+	|| fwrite(b.qw, 4, b.n_qw, fp) != b.n_qw) {
+	E_ERROR_SYSTEM("Failed to write %s", fn);
+	fclose(fp);
+    }
+    else if (fclose(fp) != 0)
+	E_ERROR_SYSTEM("Failed to write %s", fn);
+    else
+	rv = S3_SUCCESS;
+    ckd_free(str);
+
+done:
+    ckd_free(b.rec);
+    ckd_free(b.qw);
+    ckd_free(b.name_id);
+
+    return rv;
+}
+
+static dtree_t *
+read_final_tree_bin(const char *fn,
+		    pset_t *pset,
+		    uint32 n_pset)
+{
+    mmio_file_t *mf;
+    struct stat st;
+    const uint32 *hdr, *rec, *qw, *qw_end, *w;
+    const char *str, *str_end, *nul;
+    uint32 n_node, n_name, n_str, n_qw, *pset_id;
+    size_t n_word;
+    dtree_t *out = NULL;
+    dtree_node_t *node;
+    comp_quest_t *q;
+    uint32 i, j, k, t;
+
+    if (stat(fn, &st) < 0) {
+	E_ERROR_SYSTEM("Unable to stat %s", fn);
+	return NULL;
+    }
+    if ((mf = mmio_file_read(fn)) == NULL) {
+	E_ERROR("Unable to map %s\n", fn);
+	return NULL;
+    }
+    hdr = (const uint32 *)((const char *)mmio_file_ptr(mf) + 8);
+    n_word = st.st_size < 8 ? 0 : (st.st_size - 8) / 4;
+    if (n_word < DTREE_BIN_HDR_WORDS) {
+	E_ERROR("%s is truncated\n", fn);
+	goto done;
+    }
+    if (hdr[0] != DTREE_BIN_BYTE_ORDER) {
+	E_ERROR("%s was written on a machine of different byte order\n", fn);
+	goto done;
+    }
+    if (hdr[1] != DTREE_BIN_VERSION) {
+	E_ERROR("%s has binary version %u, expected %u\n",
+		fn, hdr[1], DTREE_BIN_VERSION);
+	goto done;
+    }
+    n_node = hdr[2];
+    n_name = hdr[3];
+    n_str = hdr[4];
+    n_qw = hdr[5];
+    if (n_node == 0
+	|| n_name > 4 * (size_t)n_str
+	|| DTREE_BIN_HDR_WORDS + (size_t)n_str
+	+ DTREE_BIN_NODE_WORDS * (size_t)n_node + n_qw != n_word) {
+	E_ERROR("%s is corrupt or truncated\n", fn);
+	goto done;
+    }
+    str = (const char *)(hdr + DTREE_BIN_HDR_WORDS);
+    str_end = str + 4 * (size_t)n_str;
+    rec = hdr + DTREE_BIN_HDR_WORDS + n_str;
+    qw = rec + DTREE_BIN_NODE_WORDS * n_node;
+    qw_end = qw + n_qw;
+
+    /* Map the stored names onto this question set */
+    pset_id = ckd_calloc(n_name > 0 ? n_name : 1, sizeof(uint32));
+    for (i = 0; i < n_name; i++) {
+	if ((nul = memchr(str, '\0', str_end - str)) == NULL) {
+	    E_ERROR("%s is corrupt: question names overrun their table\n",
+		    fn);
+	    ckd_free(pset_id);
+	    goto done;
+	}
+	for (j = 0; j < n_pset && strcmp(pset[j].name, str) != 0; j++);
+	if (j == n_pset) {
+	    E_ERROR("Unknown question %s in %s\n", str, fn);
+	    ckd_free(pset_id);
+	    goto done;
+	}
+	pset_id[i] = j;
+	str = nul + 1;
+    }
+
+    out = ckd_calloc(1, sizeof(dtree_t));
+    out->n_node = n_node;
+    out->node = node = ckd_calloc(n_node, sizeof(dtree_node_t));
+    for (i = 0; i < n_node; i++, rec += DTREE_BIN_NODE_WORDS) {
+	node[i].node_id = i;
+	memcpy(&node[i].occ, &rec[3], sizeof(float32));
+	memcpy(&node[i].wt_ent, &rec[4], sizeof(float64));
+	memcpy(&node[i].wt_ent_dec, &rec[6], sizeof(float64));
+	if (rec[0] == NO_ID)
+	    continue;
+	/* The root (node 0) has no parent and every other node has one,
+	 * so walking down from the root can never loop */
+	if (rec[0] >= n_node || rec[1] >= n_node || rec[2] >= n_qw
+	    || rec[0] == 0 || rec[1] == 0 || rec[0] == rec[1]
+	    || node[rec[0]].p != NULL || node[rec[1]].p != NULL) {
+	    E_ERROR("%s is corrupt at node %u\n", fn, i);
+	    goto corrupt;
+	}
+	node[i].y = &node[rec[0]];
+	node[i].n = &node[rec[1]];
+	node[rec[0]].p = node[rec[1]].p = &node[i];
+
+	/* Each term needs at least its length word and each simple
+	 * question three words, so bound the lengths by what is left
+	 * before allocating anything for them */
+	w = qw + rec[2];
+	if (*w > (size_t)(qw_end - w - 1)) {
+	    E_ERROR("%s is corrupt at node %u\n", fn, i);
+	    goto corrupt;
+	}
+	node[i].q = q = ckd_calloc(1, sizeof(comp_quest_t));
+	q->sum_len = *w++;
+	q->conj_q = ckd_calloc(q->sum_len, sizeof(quest_t *));
+	q->prod_len = ckd_calloc(q->sum_len, sizeof(uint32));
+	for (j = 0; j < q->sum_len; j++) {
+	    if (w >= qw_end || *w > (size_t)(qw_end - w - 1) / 3) {
+		E_ERROR("%s is corrupt at node %u\n", fn, i);
+		goto corrupt;
+	    }
+	    q->prod_len[j] = *w++;
+	    q->conj_q[j] = ckd_calloc(q->prod_len[j], sizeof(quest_t));
+	    for (k = 0; k < q->prod_len[j]; k++, w += 3) {
+		if (w[2] >= n_name) {
+		    E_ERROR("%s is corrupt at node %u\n", fn, i);
+		    goto corrupt;
+		}
+		t = pset_id[w[2]];
+		q->conj_q[j][k].ctxt = (int32)w[0];
+		q->conj_q[j][k].neg = w[1];
+		q->conj_q[j][k].pset = t;
+		q->conj_q[j][k].member = pset[t].member;
+		q->conj_q[j][k].posn = pset[t].posn;
+	    }
+	}
+    }
+    ckd_free(pset_id);
+    goto done;
+
+corrupt:
+    ckd_free(pset_id);
+    /* free_tree() leaves the questions alone, as they are usually
+     * shared; these ones belong to this tree only */
+    for (i = 0; i < n_node; i++) {
+	if ((q = node[i].q) == NULL)
+	    continue;
+	for (j = 0; j < q->sum_len; j++)
+	    ckd_free(q->conj_q[j]);
+	ckd_free(q->conj_q);
+	ckd_free(q->prod_len);
+	ckd_free(q);
+    }
+    free_tree(out);
+    out = NULL;
+
+done:
+    mmio_file_unmap(mf);
+    return out;
+}
+
+dtree_t *
+read_final_tree_file(const char *fn,
+		     pset_t *pset,
+		     uint32 n_pset)
+{
+    dtree_t *tr;
+    char magic[8];
+    FILE *fp;
+
+    fp = fopen(fn, "rb");
+    if (fp == NULL) {
+	E_ERROR_SYSTEM("Unable to open %s for reading", fn);
+	return NULL;
+    }
+    if (fread(magic, 1, 8, fp) == 8
+	&& memcmp(magic, DTREE_BIN_MAGIC, 8) == 0) {
+	fclose(fp);
+	return read_final_tree_bin(fn, pset, n_pset);
+    }
+    rewind(fp);
+    tr = read_final_tree(fp, pset, n_pset);
+    fclose(fp);
+
+    return tr;
+}
+
+/* Trees are handed out one at a time to the reading threads */
+typedef struct tree_reader_s {
+    const char **fn;
+    uint32 n_tree;
+    pset_t *pset;
+    uint32 n_pset;
+    dtree_t **out_tree;
+    uint32 next;
+    sbmtx_t *mtx;
+} tree_reader_t;
+
+static int
+read_tree_job(tree_reader_t *rd)
+{
+    uint32 i;
+
+    for (;;) {
+	sbmtx_lock(rd->mtx);
+	i = rd->next++;
+	sbmtx_unlock(rd->mtx);
+	if (i >= rd->n_tree)
+	    break;
+	rd->out_tree[i] = read_final_tree_file(rd->fn[i], rd->pset, rd->n_pset);
+    }
+
+    return 0;
+}
+
+static int
+read_tree_worker(sbthread_t *th)
+{
+    return read_tree_job((tree_reader_t *)sbthread_arg(th));
+}
+
+int32
+read_final_trees(const char **fn,
+		 uint32 n_tree,
+		 pset_t *pset,
+		 uint32 n_pset,
+		 dtree_t **out_tree,
+		 uint32 n_thread)
+{
+    tree_reader_t rd;
+    sbthread_t **thread;
+    uint32 i, t;
+    int32 rv = S3_SUCCESS;
+
+    rd.fn = fn;
+    rd.n_tree = n_tree;
+    rd.pset = pset;
+    rd.n_pset = n_pset;
+    rd.out_tree = out_tree;
+    rd.next = 0;
+    rd.mtx = sbmtx_init();
+
+    if (n_thread > n_tree)
+	n_thread = n_tree;
+    if (n_thread < 1)
+	n_thread = 1;
+    thread = ckd_calloc(n_thread, sizeof(*thread));
+    for (t = 1; t < n_thread; t++)
+	thread[t] = sbthread_start(read_tree_worker, &rd);
+    read_tree_job(&rd);
+    for (t = 1; t < n_thread; t++)
+	sbthread_free(thread[t]);
+    ckd_free(thread);
+    sbmtx_free(rd.mtx);
+
+    for (i = 0; i < n_tree; i++) {
+	if (out_tree[i] == NULL) {
+	    E_ERROR("Error(s) while reading %s\n", fn[i]);
+	    rv = S3_ERROR;
+	}
+    }
+
+    return rv;
+}
+
+model_def_t *
+tie_states(model_def_t *imdef,
+	   dtree_t ***tree,
+	   pset_t *pset,
+	   int allphones)
+{
+    model_def_t *omdef;
+    model_def_entry_t *idefn, *odefn;
+    acmod_id_t b, l, r;
+    word_posn_t wp;
+    uint32 n_ci, n_acmod, n_state, n_seno, ts_id;
+    uint32 p, s, bb;
+
+    /* Number the leaves after the CI states */
+    n_ci = allphones ? 1 : acmod_set_n_ci(imdef->acmod_set);
+    ts_id = imdef->n_tied_ci_state;
+    for (p = 0, n_seno = 0; p < n_ci; p++) {
+	if (allphones || !acmod_set_has_attrib(imdef->acmod_set, p, "filler")) {
+	    const char *pname;
+
+	    if (allphones) {
+		n_state = imdef->defn[acmod_set_n_ci(imdef->acmod_set)].n_state;
+		pname = "ALLPHONES";
+	    }
+	    else {
+		n_state = imdef->defn[p].n_state;
+		pname = acmod_set_id2name(imdef->acmod_set, p);
+	    }
+	    for (s = 0; s < n_state-1; s++) {
+		E_INFO("%s-%u: offset %u\n",
+		       pname, s, ts_id);
+		label_leaves(&tree[p][s]->node[0], &ts_id);
+		n_seno += cnt_leaf(&tree[p][s]->node[0]);
+	    }
+	}
+    }
+    assert(n_seno == (ts_id - imdef->n_tied_ci_state));
+    E_INFO("n_seno= %u\n", ts_id);
+
+    omdef = (model_def_t *)ckd_calloc(1, sizeof(model_def_t));
+
+    omdef->acmod_set = imdef->acmod_set; /* same set of acoustic models */
+
+    omdef->n_total_state = imdef->n_total_state;
+
+    omdef->n_tied_ci_state = imdef->n_tied_ci_state;
+    omdef->n_tied_state = imdef->n_tied_ci_state + n_seno;
+
+    omdef->n_tied_tmat = imdef->n_tied_tmat;
+
+    omdef->defn = (model_def_entry_t *)ckd_calloc(imdef->n_defn,
+						  sizeof(model_def_entry_t));
+
+    /*
+     * Define the context-independent models
+     */
+    n_ci = acmod_set_n_ci(imdef->acmod_set);
+    for (p = 0; p < n_ci; p++) {
+	idefn = &imdef->defn[p];
+	odefn = &omdef->defn[p];
+	
+	odefn->p    = idefn->p;
+	odefn->tmat = idefn->tmat;
+
+	odefn->state = ckd_calloc(idefn->n_state, sizeof(uint32));
+	odefn->n_state = idefn->n_state;
+
+	for (s = 0; s < idefn->n_state; s++) {
+	    if (idefn->state[s] == NO_ID)
+		odefn->state[s] = NO_ID;
+	    else {
+		odefn->state[s] = idefn->state[s];
+	    }
+	}
+    }
+
+    /*
+     * Define the rest of the models
+     */
+    n_acmod = acmod_set_n_acmod(omdef->acmod_set);
+    for (; p < n_acmod; p++) {
+	b = acmod_set_base_phone(omdef->acmod_set, p);
+
+	assert(p != b);
+
+	idefn = &imdef->defn[p];
+	odefn = &omdef->defn[p];
+
+	odefn->p    = idefn->p;
+	odefn->tmat = idefn->tmat;
+
+	odefn->state = ckd_calloc(idefn->n_state, sizeof(uint32));
+	odefn->n_state = idefn->n_state;
+	for (s = 0; s < idefn->n_state; s++) {
+	    if (idefn->state[s] == NO_ID)
+		/* Non-emitting state */
+		odefn->state[s] = NO_ID;
+	    else {
+		/* emitting state: find the tied state */
+		acmod_set_id2tri(omdef->acmod_set,
+				 &b, &l, &r, &wp,
+				 p);
+
+		bb = allphones ? 0 : b;
+		odefn->state[s] = tied_state(&tree[bb][s]->node[0],
+					     b, l, r, wp,
+					     pset);
+	    }
+	}
+    }
+
+    return omdef;
+}
+
 
 void
 free_tree(dtree_t *tr)
@@ -45,84 +45,77 @@
 
 #include <s3/lexicon.h>
 #include <sphinxbase/ckd_alloc.h>
-#include <sphinxbase/hash_table.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/filename.h>
 #include <sphinxbase/pio.h>
+#include <sphinxbase/profile.h>
 
 #include <s3/s3.h>
 
+#include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
 
-static int
-add_word(char *ortho,
-	 uint32 wid,
-	 lexicon_t *l,
-	 lex_entry_t *e)
-{
-    e->ortho = ortho;
-    e->word_id = wid;
-    
-    return S3_SUCCESS;
-}
-
-static int
-add_phones(uint32 n_phone,
-	   lex_entry_t *e,
-	   acmod_set_t *acmod_set)
-{
-    uint32 i;
-    char *nxt_phone;
-
-    e->phone = ckd_calloc(n_phone, sizeof(char *));
-
-    e->ci_acmod_id = ckd_calloc(n_phone, sizeof(uint32));
-
-    e->phone_cnt = n_phone;
-
-    for (i = 0; (nxt_phone = strtok(NULL, " \t")); i++) {
-	e->phone[i] = nxt_phone;
-	e->ci_acmod_id[i] =
-	    acmod_set_name2id(acmod_set, nxt_phone);
-
-	if (e->ci_acmod_id[i] == NO_ACMOD) {
-	    E_ERROR("Unknown phone %s\n", nxt_phone);
-	    ckd_free(e->phone);
-	    e->phone = NULL;
-
-	    ckd_free(e->ci_acmod_id);
-	    e->ci_acmod_id = NULL;
+/*
+ * Entries, orthographies and phone lists live in large blocks which
+ * are only freed with the lexicon, rather than being allocated one
+ * at a time.  Phone names are not copied at all; they point at the
+ * names in the phone set.
+ */
+#define LEX_ARENA_BLOCK	(1 << 20)
 
-	    e->phone_cnt = 0;
+struct lex_arena_s {
+    struct lex_arena_s *next;
+    char *buf;
+    size_t size;
+    size_t used;
+};
 
-	    return S3_ERROR;
-	}
+static void *
+lex_arena_alloc(lexicon_t *lex, size_t n)
+{
+    lex_arena_t *a = lex->arena;
+    void *p;
+
+    n = (n + 7) & ~(size_t)7;
+    if (a == NULL || a->used + n > a->size) {
+	a = ckd_calloc(1, sizeof(*a));
+	a->size = n > LEX_ARENA_BLOCK ? n : LEX_ARENA_BLOCK;
+	a->buf = ckd_calloc(a->size, 1);
+	a->next = lex->arena;
+	lex->arena = a;
     }
-    
-    assert(i == n_phone);
+    p = a->buf + a->used;
+    a->used += n;
 
-    return S3_SUCCESS;
+    return p;
 }
-
-lexicon_t *lexicon_new()
-{
-    lexicon_t *new;
-    
-    new = ckd_calloc(1, sizeof(lexicon_t));
 
-    new->entry_cnt = 0;
+static uint64_t
+lex_hash(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i;
 
-    new->ht      = hash_table_new(64000, HASH_CASE_YES);
-    new->base_ht = hash_table_new(64000, HASH_CASE_YES);
+    for (i = 0; i < len; i++) {
+	h ^= (unsigned char)s[i];
+	h *= 0x100000001b3ULL;
+    }
 
-    return new;
+    return h;
 }
 
 /*
- * Compute the base word from a full ortho by stripping a trailing
- * "(N)" suffix where N is one or more digits. Returns a newly
- * malloc'd string; caller takes ownership.
+ * Length of the base word of a full ortho, i.e. without a trailing
+ * "(N)" suffix where N is one or more digits.
  *
  * Examples:
  *   "reading"     -> "reading"
@@ -130,8 +123,8 @@ lexicon_t *lexicon_new()
  *   "f(x)"        -> "f(x)"          (parens but no trailing digits)
  *   "wo(1rd)"     -> "wo(1rd)"       (not at end)
  */
-static char *
-lex_base_word(const char *ortho)
+static uint32
+lex_base_len(const char *ortho)
 {
     size_t n = strlen(ortho);
     /* Need at least "x(N)" => 4 chars */
@@ -142,85 +135,131 @@ lex_base_word(const char *ortho)
 	    ++digits;
 	    --i;
 	}
-	if (digits > 0 && ortho[i] == '(') {
-	    char *base = ckd_calloc(i + 1, sizeof(char));
-	    memcpy(base, ortho, i);
-	    base[i] = '\0';
-	    return base;
-	}
+	if (digits > 0 && ortho[i] == '(')
+	    return i;
     }
-    return ckd_salloc(ortho);
+    return n;
 }
 
-/* Add `entry` to the base-word index. If a chain already exists for
- * the base word, walk to its tail and append. Otherwise, register a
- * new chain head.
- *
- * The base_ht stores the chain head as its value; once registered, the
- * head never changes. New variants are appended to the tail. This
- * avoids the need for hash_table_replace (which would orphan the
- * strdup'd key string and break ownership invariants).
+/*
+ * Find the slot of word in an index, or the empty slot where it would
+ * go.  The full index is keyed on the whole ortho, the base index on
+ * its base word.
  */
-static void
-lex_index_by_base(lexicon_t *lex, lex_entry_t *entry)
+static uint32
+lex_find(lexicon_t *lex, uint32 *slot, const char *word, size_t len, int base)
 {
-    char *base = lex_base_word(entry->ortho);
-    lex_entry_t *head = NULL;
-
-    entry->next_variant = NULL;
+    uint32 mask = lex->n_slot - 1;
+    uint32 i;
+    lex_entry_t *e;
 
-    if (hash_table_lookup(lex->base_ht, base, (void **)&head) == 0) {
-	while (head->next_variant != NULL) {
-	    head = head->next_variant;
+    for (i = (uint32)lex_hash(word, len) & mask; slot[i]; i = (i + 1) & mask) {
+	e = lex->entry[slot[i] - 1];
+	if (base) {
+	    if (e->base_len == len && memcmp(e->ortho, word, len) == 0)
+		break;
 	}
-	head->next_variant = entry;
-	/* We didn't take ownership of `base`; it would have been
-	 * a duplicate of the existing key. Free it. */
-	ckd_free(base);
-    } else {
-	/* First variant for this base word. The hash table now owns
-	 * `base` as its key; do not free it here. lexicon_free()
-	 * releases it when iterating base_ht. */
-	hash_table_enter(lex->base_ht, base, (void *)entry);
+	else if (strncmp(e->ortho, word, len) == 0 && e->ortho[len] == '\0')
+	    break;
     }
+
+    return i;
 }
 
-lex_entry_t *lexicon_append_entry(lexicon_t *lex)
+static void
+lex_index(lexicon_t *lex, lex_entry_t *e)
 {
-    lex_entry_t *new;
+    uint32 i;
+    lex_entry_t *head;
+
+    /* The first of several entries with the same ortho is the one
+     * found by lexicon_lookup() */
+    i = lex_find(lex, lex->slot, e->ortho, strlen(e->ortho), FALSE);
+    if (lex->slot[i] == 0)
+	lex->slot[i] = e->word_id + 1;
+
+    /* Variants are appended to the chain of their base word, whose
+     * head never changes */
+    e->next_variant = NULL;
+    i = lex_find(lex, lex->base_slot, e->ortho, e->base_len, TRUE);
+    if (lex->base_slot[i] == 0) {
+	lex->base_slot[i] = e->word_id + 1;
+    }
+    else {
+	for (head = lex->entry[lex->base_slot[i] - 1];
+	     head->next_variant; head = head->next_variant);
+	head->next_variant = e;
+    }
+}
 
-    new = ckd_calloc(1, sizeof(lex_entry_t));
-    lex->entry_cnt++;
+static void
+lex_rehash(lexicon_t *lex, uint32 n_slot)
+{
+    uint32 i, j;
+    lex_entry_t *e;
+
+    ckd_free(lex->slot);
+    ckd_free(lex->base_slot);
+    lex->n_slot = n_slot;
+    lex->slot = ckd_calloc(n_slot, sizeof(uint32));
+    lex->base_slot = ckd_calloc(n_slot, sizeof(uint32));
+
+    /* Variant chains are already linked; only their heads (the
+     * first entry of each base word) go back in the base index */
+    for (i = 0; i < lex->entry_cnt; i++) {
+	e = lex->entry[i];
+	j = lex_find(lex, lex->slot, e->ortho, strlen(e->ortho), FALSE);
+	if (lex->slot[j] == 0)
+	    lex->slot[j] = i + 1;
+	j = lex_find(lex, lex->base_slot, e->ortho, e->base_len, TRUE);
+	if (lex->base_slot[j] == 0)
+	    lex->base_slot[j] = i + 1;
+    }
+}
 
-    return new;
+static void
+lex_add_entry(lexicon_t *lex, lex_entry_t *e)
+{
+    if (lex->entry_cnt == lex->max_entry) {
+	lex->max_entry = lex->max_entry ? 2 * lex->max_entry : 1024;
+	lex->entry = ckd_realloc(lex->entry,
+				 lex->max_entry * sizeof(lex_entry_t *));
+    }
+    if (2 * (lex->entry_cnt + 1) > lex->n_slot)
+	lex_rehash(lex, 2 * lex->n_slot);
+
+    e->word_id = lex->entry_cnt;
+    lex->entry[lex->entry_cnt++] = e;
+    lex_index(lex, e);
 }
 
-void lexicon_entry_free(lex_entry_t *entry)
+lexicon_t *lexicon_new()
 {
-    if (entry->ortho)
-        ckd_free(entry->ortho);
-    if (entry->ci_acmod_id)
-        ckd_free(entry->ci_acmod_id);
-    if (entry->phone)
-        ckd_free(entry->phone);
-    ckd_free(entry);
-    return;
+    lexicon_t *new;
+    
+    new = ckd_calloc(1, sizeof(lexicon_t));
+
+    new->entry_cnt = 0;
+
+    new->n_slot = 1024;
+    new->slot      = ckd_calloc(new->n_slot, sizeof(uint32));
+    new->base_slot = ckd_calloc(new->n_slot, sizeof(uint32));
+
+    return new;
 }
 
-lexicon_t *lexicon_read(lexicon_t *prior_lex,
-			const char *filename,
-			acmod_set_t *acmod_set)
+static uint32
+lexicon_read_text(lexicon_t *lex,
+		  const char *filename,
+		  acmod_set_t *acmod_set)
 {
     FILE *lex_fp;
     lineiter_t *line = NULL;
-    char *lex_line;
-    lexicon_t *lex;
-    lex_entry_t *next_entry = NULL;
-    uint32    wid, start_wid;
-    uint32    n_phone;
-    uint32    lineno = 0;
-    int       reuse_entry = FALSE;
-    char      *word;
+    lex_entry_t *e;
+    char **word = NULL;
+    int32 n_word, max_word = 0;
+    uint32 i, n_added = 0;
+    acmod_id_t id;
 
     lex_fp = fopen(filename, "r");
     if (lex_fp == NULL) {
@@ -228,93 +267,353 @@ lexicon_t *lexicon_read(lexicon_t *prior_lex,
 		       filename);
     }
 
-    if (prior_lex)
-	lex = prior_lex;
-    else
-	lex = lexicon_new();
-
-    if (lex->phone_set == NULL)
-	lex->phone_set = acmod_set;
-
-    start_wid = wid = lex->entry_cnt;
     for (line = lineiter_start_clean(lex_fp); line; line = lineiter_next(line)) {
 
 	if (line->buf[0] == 0) {
 	    E_WARN("Dictionary file '%s' has a blank line at line %d\n",
-		   filename, lineno);
+		   filename, lineiter_lineno(line));
 	    continue;
 	}
-	
-	next_entry = lexicon_append_entry(lex);
 
-	/* allocate space for string.  It will be parsed
-	 * by strtok() */
-	lex_line = strdup(line->buf);
-
-	/* get the word and make a hash table entry for
-	   this lexicon entry */
+	/* str2words() counts the # of space separated "words" on a line */
+	n_word = str2words(line->buf, NULL, 0);
+	if (n_word > max_word) {
+	    max_word = n_word;
+	    word = ckd_realloc(word, max_word * sizeof(char *));
+	}
+	str2words(line->buf, word, n_word);
 
-	word = strtok(lex_line, " \t");	
+#ifdef LEXICON_VERBOSE
+	E_INFO("%s %d phones\n", word[0], n_word - 1);
+#endif
 
-	if (add_word(word,
-		     wid,
-		     lex,
-		     next_entry) != S3_SUCCESS) {
-	    E_ERROR("%s duplicate entry?\n", word);
-	    lexicon_entry_free(next_entry);
+	e = lex_arena_alloc(lex, sizeof(lex_entry_t));
+	e->ortho = lex_arena_alloc(lex, strlen(word[0]) + 1);
+	strcpy(e->ortho, word[0]);
+	e->base_len = lex_base_len(e->ortho);
+	e->phone_cnt = n_word - 1;
+	e->phone = lex_arena_alloc(lex, e->phone_cnt * sizeof(char *));
+	e->ci_acmod_id = lex_arena_alloc(lex, e->phone_cnt * sizeof(acmod_id_t));
+
+	/* convert the phones to ids */
+	for (i = 0; i < e->phone_cnt; i++) {
+	    id = acmod_set_name2id(acmod_set, word[i + 1]);
+	    if (id == NO_ACMOD) {
+		E_ERROR("Unknown phone %s\n", word[i + 1]);
+		break;
+	    }
+	    e->ci_acmod_id[i] = id;
+	    e->phone[i] = acmod_set_id2name(acmod_set, id);
+	}
+	if (i < e->phone_cnt) {
+	    E_ERROR("pronunciation for %s has undefined phones; skipping.\n",
+		    e->ortho);
 	    continue;
 	}
 
-	/* str2words() counts the # of space separated "words" on a line */
-	n_phone = str2words(line->buf, NULL, 0) - 1;
+	lex_add_entry(lex, e);
+	++n_added;
+    }
 
-#ifdef LEXICON_VERBOSE
-	E_INFO("%s %d phones\n", line->buf, n_phone);
+    ckd_free(word);
+    lineiter_free(line);
+    fclose(lex_fp);
+
+    return n_added;
+}
+
+/*
+ * Binary dictionary caches hold the entries of one dictionary file,
+ * in native 32-bit words:
+ *
+ *	LEXICON_CACHE_MAGIC (8 bytes)
+ *	byte order, version, key (2 words), n_entry, n_phone, n_str_word
+ *	per entry: ortho offset, offset into the phone ids, phone count
+ *	phone ids: n_phone CI phone ids
+ *	strings: NUL terminated orthos, padded to n_str_word words
+ *
+ * The key is a hash of the dictionary and the phone set, so the phone
+ * ids are valid for any phone set which gives the same key.
+ */
+#define LEX_CACHE_HDR_WORDS	7
+#define LEX_CACHE_BYTE_ORDER	0x11223344
+#define LEX_CACHE_ENTRY_WORDS	3
+
+static int
+lexicon_cache_key(const char *filename,
+		  acmod_set_t *acmod_set,
+		  uint64_t *out_key)
+{
+    mmio_file_t *mf;
+    struct stat st;
+    uint64_t h;
+    uint32 i;
+
+    if (stat(filename, &st) < 0 || st.st_size == 0)
+	return S3_ERROR;
+    if ((mf = mmio_file_read(filename)) == NULL)
+	return S3_ERROR;
+    h = lex_hash(mmio_file_ptr(mf), st.st_size);
+    mmio_file_unmap(mf);
+
+    for (i = 0; i < acmod_set_n_ci(acmod_set); i++) {
+	const char *name = acmod_set_id2name(acmod_set, i);
+
+	h = (h ^ lex_hash(name, strlen(name) + 1)) * 0x100000001b3ULL;
+    }
+    *out_key = h;
+
+    return S3_SUCCESS;
+}
+
+static int
+lexicon_read_cache(lexicon_t *lex,
+		   const char *cachefn,
+		   uint64_t key,
+		   acmod_set_t *acmod_set,
+		   uint32 *out_n_added)
+{
+    mmio_file_t *mf;
+    struct stat st;
+    const uint32 *hdr, *rec, *pid;
+    const char *str;
+    const char **name;
+    lex_entry_t *e;
+    size_t n_word;
+    uint32 n_entry, n_phone, n_str, n_ci, i;
+
+    if (stat(cachefn, &st) < 0)
+	return S3_ERROR;
+    if ((mf = mmio_file_read(cachefn)) == NULL)
+	return S3_ERROR;
+
+    hdr = (const uint32 *)((const char *)mmio_file_ptr(mf) + 8);
+    n_word = (st.st_size - 8) / 4;
+    if (st.st_size < 8 + 4 * LEX_CACHE_HDR_WORDS
+	|| memcmp(mmio_file_ptr(mf), LEXICON_CACHE_MAGIC, 8) != 0
+	|| hdr[0] != LEX_CACHE_BYTE_ORDER
+	|| hdr[1] != LEXICON_CACHE_VERSION
+	|| hdr[2] != (uint32)key || hdr[3] != (uint32)(key >> 32))
+	goto bad;
+    n_entry = hdr[4];
+    n_phone = hdr[5];
+    n_str = hdr[6];
+    if (LEX_CACHE_HDR_WORDS + LEX_CACHE_ENTRY_WORDS * (size_t)n_entry
+	+ n_phone + n_str != n_word || n_str == 0)
+	goto bad;
+    rec = hdr + LEX_CACHE_HDR_WORDS;
+    pid = rec + LEX_CACHE_ENTRY_WORDS * n_entry;
+    str = (const char *)(pid + n_phone);
+    if (str[4 * n_str - 1] != '\0')
+	goto bad;
+
+    n_ci = acmod_set_n_ci(acmod_set);
+    name = lex_arena_alloc(lex, n_phone * sizeof(char *));
+    for (i = 0; i < n_phone; i++) {
+	if (pid[i] >= n_ci)
+	    goto bad;
+	name[i] = acmod_set_id2name(acmod_set, pid[i]);
+    }
+    for (i = 0; i < n_entry; i++, rec += LEX_CACHE_ENTRY_WORDS) {
+	if (rec[0] >= 4 * n_str || rec[1] > n_phone || rec[2] > n_phone - rec[1])
+	    goto bad;
+    }
+
+    /* Orthos and phone ids stay in the mapped file */
+    e = lex_arena_alloc(lex, n_entry * sizeof(lex_entry_t));
+    rec = hdr + LEX_CACHE_HDR_WORDS;
+    for (i = 0; i < n_entry; i++, e++, rec += LEX_CACHE_ENTRY_WORDS) {
+	e->ortho = (char *)str + rec[0];
+	e->base_len = lex_base_len(e->ortho);
+	e->phone = name + rec[1];
+	e->ci_acmod_id = (acmod_id_t *)pid + rec[1];
+	e->phone_cnt = rec[2];
+	lex_add_entry(lex, e);
+    }
+
+    lex->cache = ckd_realloc(lex->cache,
+			     (lex->n_cache + 1) * sizeof(mmio_file_t *));
+    lex->cache[lex->n_cache++] = mf;
+    *out_n_added = n_entry;
+
+    return S3_SUCCESS;
+
+bad:
+    E_WARN("Ignoring corrupt or truncated dictionary cache %s\n", cachefn);
+    mmio_file_unmap(mf);
+    return S3_ERROR;
+}
+
+static void
+lexicon_write_cache(lexicon_t *lex,
+		    const char *cachefn,
+		    uint64_t key,
+		    uint32 first)
+{
+    uint32 hdr[LEX_CACHE_HDR_WORDS];
+    uint32 rec[LEX_CACHE_ENTRY_WORDS];
+    uint32 n_phone, n_str, i;
+    size_t off;
+    lex_entry_t *e;
+    char *tmpfn, pid[24];
+    FILE *fp;
+    int err;
+
+    for (i = first, n_phone = 0, off = 0; i < lex->entry_cnt; i++) {
+	n_phone += lex->entry[i]->phone_cnt;
+	off += strlen(lex->entry[i]->ortho) + 1;
+    }
+    n_str = (off + 4) / 4;	/* at least one padding NUL */
+
+    hdr[0] = LEX_CACHE_BYTE_ORDER;
+    hdr[1] = LEXICON_CACHE_VERSION;
+    hdr[2] = (uint32)key;
+    hdr[3] = (uint32)(key >> 32);
+    hdr[4] = lex->entry_cnt - first;
+    hdr[5] = n_phone;
+    hdr[6] = n_str;
+
+    /* Write to a private name and rename, since several jobs may
+     * build the same cache at once */
+#ifndef _WIN32
+    sprintf(pid, ".tmp%d", (int)getpid());
+#else
+    strcpy(pid, ".tmp");
 #endif
+    tmpfn = string_join(cachefn, pid, NULL);
+    if ((fp = fopen(tmpfn, "wb")) == NULL) {
+	E_ERROR_SYSTEM("Unable to write dictionary cache %s", tmpfn);
+	ckd_free(tmpfn);
+	return;
+    }
 
-	/* read the phones, convert to ids and add them
-	   to the phone list for this entry */
-	if (add_phones(n_phone, next_entry, acmod_set) != S3_SUCCESS) {
-	    E_ERROR("pronunciation for %s has undefined phones; skipping.\n", word);
-	    lexicon_entry_free(next_entry);
-	    continue;
+    err = (fwrite(LEXICON_CACHE_MAGIC, 1, 8, fp) != 8);
+    err |= (fwrite(hdr, 4, LEX_CACHE_HDR_WORDS, fp) != LEX_CACHE_HDR_WORDS);
+    for (i = first, n_phone = 0, off = 0; i < lex->entry_cnt; i++) {
+	e = lex->entry[i];
+	rec[0] = off;
+	rec[1] = n_phone;
+	rec[2] = e->phone_cnt;
+	err |= (fwrite(rec, 4, LEX_CACHE_ENTRY_WORDS, fp) != LEX_CACHE_ENTRY_WORDS);
+	off += strlen(e->ortho) + 1;
+	n_phone += e->phone_cnt;
+    }
+    for (i = first; i < lex->entry_cnt; i++) {
+	e = lex->entry[i];
+	err |= (fwrite(e->ci_acmod_id, sizeof(acmod_id_t),
+		       e->phone_cnt, fp) != e->phone_cnt);
+    }
+    for (i = first; i < lex->entry_cnt; i++) {
+	e = lex->entry[i];
+	err |= (fwrite(e->ortho, 1, strlen(e->ortho) + 1, fp)
+		!= strlen(e->ortho) + 1);
+    }
+    for (; off < 4 * (size_t)n_str; off++)
+	err |= (fputc('\0', fp) == EOF);
+    err |= (fclose(fp) != 0);
+
+    if (err || rename(tmpfn, cachefn) != 0) {
+	E_ERROR_SYSTEM("Unable to write dictionary cache %s", cachefn);
+	remove(tmpfn);
+    }
+    else
+	E_INFO("Wrote dictionary cache %s\n", cachefn);
+    ckd_free(tmpfn);
+}
+
+static long
+lex_peak_rss_kb(void)
+{
+#ifndef _WIN32
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+#ifdef __APPLE__
+	return ru.ru_maxrss / 1024;
+#else
+	return ru.ru_maxrss;
+#endif
+#endif
+    return -1;
+}
+
+lexicon_t *lexicon_read(lexicon_t *prior_lex,
+			const char *filename,
+			acmod_set_t *acmod_set)
+{
+    lexicon_t *lex;
+    const char *cachedir = NULL;
+    char *cachefn = NULL;
+    uint64_t key;
+    uint32 first, n_added;
+    int cached = FALSE;
+    ptmr_t tm;
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+
+    if (prior_lex)
+	lex = prior_lex;
+    else
+	lex = lexicon_new();
+
+    if (lex->phone_set == NULL)
+	lex->phone_set = acmod_set;
+
+    if (cmd_ln_exists("-dictcache"))
+	cachedir = cmd_ln_str("-dictcache");
+    if (cachedir
+	&& lexicon_cache_key(filename, acmod_set, &key) == S3_SUCCESS) {
+	char keystr[24];
+
+	sprintf(keystr, ".%08x%08x", (uint32)(key >> 32), (uint32)key);
+	cachefn = string_join(cachedir, "/", path2basename(filename),
+			      keystr, ".lexbin", NULL);
+	cached = (lexicon_read_cache(lex, cachefn, key, acmod_set,
+				     &n_added) == S3_SUCCESS);
+    }
+
+    if (!cached) {
+	first = lex->entry_cnt;
+	n_added = lexicon_read_text(lex, filename, acmod_set);
+	if (cachefn) {
+	    build_directory(cachedir);
+	    lexicon_write_cache(lex, cachefn, key, first);
 	}
-	
-	hash_table_enter(lex->ht, next_entry->ortho, (void *)next_entry);
-	lex_index_by_base(lex, next_entry);
-	++wid;	/* only happens should everything be successful */
     }
+    ckd_free(cachefn);
 
-    E_INFO("%d entries added from %s\n",
-	   wid - start_wid, filename);
+    ptmr_stop(&tm);
+    E_INFO("%d entries added from %s%s in %.3f sec, peak RSS %ld kB\n",
+	   n_added, filename, cached ? " (cached)" : "",
+	   tm.t_elapsed, lex_peak_rss_kb());
 			  
-    lineiter_free(line);
-    fclose(lex_fp);
-    
     return lex;
 }
 
-lex_entry_t *lexicon_lookup(lexicon_t *lex, char *ortho)
+lex_entry_t *lexicon_lookup(lexicon_t *lex, const char *ortho)
 {
-    lex_entry_t *cur;
-    
-    if (hash_table_lookup(lex->ht, ortho, (void **)&cur) == 0) {
-	return cur;
-    }
+    uint32 i;
+
+    i = lex_find(lex, lex->slot, ortho, strlen(ortho), FALSE);
+    if (lex->slot[i])
+	return lex->entry[lex->slot[i] - 1];
+
     return NULL;
 }
 
 lex_entry_t *
 lexicon_lookup_variants(lexicon_t *lex, const char *base_word)
 {
-    lex_entry_t *head = NULL;
+    uint32 i;
 
-    if (lex == NULL || lex->base_ht == NULL || base_word == NULL) {
+    if (lex == NULL || lex->base_slot == NULL || base_word == NULL) {
 	return NULL;
     }
-    if (hash_table_lookup(lex->base_ht, base_word, (void **)&head) == 0) {
-	return head;
-    }
+    i = lex_find(lex, lex->base_slot, base_word, strlen(base_word), TRUE);
+    if (lex->base_slot[i])
+	return lex->entry[lex->base_slot[i] - 1];
+
     return NULL;
 }
 
@@ -332,26 +631,21 @@ lex_entry_next_variant(const lex_entry_t *e)
 
 void lexicon_free(lexicon_t *lexicon)
 {
-    hash_iter_t *itor;
+    lex_arena_t *a, *next;
+    uint32 i;
 
     if (lexicon == NULL) return;
 
-    /* Free the strdup'd base keys stored in base_ht. The values point
-     * to entries already owned by the main ht; do not free them here. */
-    if (lexicon->base_ht) {
-	for (itor = hash_table_iter(lexicon->base_ht);
-		 itor; itor = hash_table_iter_next(itor)) {
-	    ckd_free((void *)hash_entry_key(itor->ent));
-	}
-	hash_table_free(lexicon->base_ht);
-	lexicon->base_ht = NULL;
-    }
-
-    for (itor = hash_table_iter(lexicon->ht);
-             itor; itor = hash_table_iter_next(itor)) {
-        lex_entry_t *entry = hash_entry_val(itor->ent);
-        lexicon_entry_free(entry);
+    for (a = lexicon->arena; a; a = next) {
+	next = a->next;
+	ckd_free(a->buf);
+	ckd_free(a);
     }
-    hash_table_free(lexicon->ht);
+    for (i = 0; i < lexicon->n_cache; i++)
+	mmio_file_unmap(lexicon->cache[i]);
+    ckd_free(lexicon->cache);
+    ckd_free(lexicon->entry);
+    ckd_free(lexicon->slot);
+    ckd_free(lexicon->base_slot);
     ckd_free(lexicon);
 }
@@ -218,7 +218,7 @@ acmod_id_t *mk_phone_list(char **btw_mark,
 acmod_id_t *
 mk_word_phone_list(char **btw_mark,
 		   uint32 *n_phone,
-		   char *word,
+		   const char *word,
 		   lexicon_t *lex)
 {
   uint32 n_p;
@@ -432,27 +432,44 @@ state_seq_free(state_t *s,
     return S3_SUCCESS;
 }
 
-state_t *
-state_seq_make(uint32 *n_state,
-	       acmod_id_t *phone,
-	       uint32 n_phone,
-	       model_inventory_t *inv,
-	       model_def_t *mdef)
+/* Storage for the sentence HMM built by seq_make() */
+typedef struct state_seq_buf_s {
+    state_t *state;		/* The states of the sentence HMM graph */
+    uint32 *n_prior;		/* The in-degree of node i in the sent. HMM */
+    uint32 *n_next;		/* The out-degree of node i in the sent. HMM */
+    uint32 max_n_s;		/* max # of states seen so far */
+
+    uint32 *next_state;		/* Storage for all sent. HMM adjacency lists */
+    float32 *next_tprob;	/* Storage for all sent. HMM a_{ij} */
+    uint32 max_total_next;	/* max total # of next states seen so far */
+
+    uint32 *prior_state;	/* Storage for all sent. HMM adjacency lists */
+    float32 *prior_tprob;	/* Storage for all sent. HMM a_{ji} */
+    uint32 max_total_prior;	/* max total # of prior states seen so far */
+} state_seq_buf_t;
+
+static state_t *
+seq_make(state_seq_buf_t *buf,
+	 uint32 *n_state,
+	 acmod_id_t *phone,
+	 uint32 n_phone,
+	 model_inventory_t *inv,
+	 model_def_t *mdef)
 {
-    static state_t *state;	/* The states of the sentence HMM graph */
-    static uint32 *n_prior;	/* The in-degree of node i in the sent. HMM */
-    static uint32 *n_next;	/* The out-degree of node i in the sent. HMM */
-    static uint32 max_n_s = 0;	/* max # of states seen so far */
+    state_t *state = buf->state;
+    uint32 *n_prior = buf->n_prior;
+    uint32 *n_next = buf->n_next;
+    uint32 max_n_s = buf->max_n_s;
     uint32 n_s;			/* # of states for this sent. HMM */
 
-    static uint32 *next_state;		/* Storage for all sent. HMM adjacency lists */
-    static float32 *next_tprob;		/* Storage for all sent. HMM a_{ij} */
-    static uint32 max_total_next = 0;	/* max total # of next states seen so far */
+    uint32 *next_state = buf->next_state;
+    float32 *next_tprob = buf->next_tprob;
+    uint32 max_total_next = buf->max_total_next;
     uint32 total_next;			/* total next states for this sent. HMM */
 
-    static uint32 *prior_state;		/* Storage for all sent. HMM adjacency lists */
-    static float32 *prior_tprob;	/* Storage for all sent. HMM a_{ji} */
-    static uint32 max_total_prior = 0;	/* max total # of prior states seen so far */
+    uint32 *prior_state = buf->prior_state;
+    float32 *prior_tprob = buf->prior_tprob;
+    uint32 max_total_prior = buf->max_total_prior;
     uint32 total_prior;			/* total prior states for this sent. HMM */
 
     map_t *mixw_map;			/* Maps local (within sent. HMM) mixw id's to global ones */
@@ -657,8 +674,52 @@ state_seq_make(uint32 *n_state,
     remap_free(mixw_map);
     remap_free(cb_map);
 
+    buf->state = state;
+    buf->n_prior = n_prior;
+    buf->n_next = n_next;
+    buf->max_n_s = max_n_s;
+    buf->next_state = next_state;
+    buf->next_tprob = next_tprob;
+    buf->max_total_next = max_total_next;
+    buf->prior_state = prior_state;
+    buf->prior_tprob = prior_tprob;
+    buf->max_total_prior = max_total_prior;
+
     /* return # of states and the state list to caller */
     *n_state = n_s;
 
     return state;
 }
+
+state_t *
+state_seq_make(uint32 *n_state,
+	       acmod_id_t *phone,
+	       uint32 n_phone,
+	       model_inventory_t *inv,
+	       model_def_t *mdef)
+{
+    /* Reused from one call to the next, growing as needed */
+    static state_seq_buf_t buf;
+
+    return seq_make(&buf, n_state, phone, n_phone, inv, mdef);
+}
+
+state_t *
+state_seq_make_alloc(uint32 *n_state,
+		     acmod_id_t *phone,
+		     uint32 n_phone,
+		     model_inventory_t *inv,
+		     model_def_t *mdef)
+{
+    state_seq_buf_t buf;
+    state_t *state;
+
+    memset(&buf, 0, sizeof(buf));
+    state = seq_make(&buf, n_state, phone, n_phone, inv, mdef);
+
+    /* The adjacency lists now belong to the states */
+    ckd_free(buf.n_prior);
+    ckd_free(buf.n_next);
+
+    return state;
+}
@@ -1078,12 +1078,16 @@ corpus_next_utt()
 	free(cur_ctl_path);
     }
     cur_ctl_path = next_ctl_path;
+    /* cur_ctl_path owns it now; a call after the end of the corpus
+     * must not free it a second time */
+    next_ctl_path = NULL;
 
     if (cur_ctl_utt_id) {
 	free(cur_ctl_utt_id);
 	cur_ctl_utt_id = NULL;
     }
     cur_ctl_utt_id = next_ctl_utt_id;
+    next_ctl_utt_id = NULL;
     
     cur_ctl_sf = next_ctl_sf;
     cur_ctl_ef = next_ctl_ef;
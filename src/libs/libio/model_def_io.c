@@ -48,8 +48,11 @@
 #include <s3/acmod_set.h>
 #include <s3/model_def_io.h>
 #include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/hash_table.h>
 #include <s3/s3.h>
 
+#include <sys/stat.h>
 #include <assert.h>
 
 #include <string.h>
@@ -378,6 +381,369 @@ model_def_write(model_def_t *mdef,
     return S3_SUCCESS;
 }
 
+/*
+ * Binary model definitions hold the same information as the text
+ * format, plus the triphone index, as native 32-bit words:
+ *
+ *	MODEL_DEF_BIN_MAGIC (8 bytes)
+ *	byte order, version, n_base, n_tri, n_state_map, n_tied_state,
+ *	n_tied_ci_state, n_tied_tmat, max_n_state, min_n_state,
+ *	n_attrib, n_str_word, tri_shift, n_tri_slot
+ *	strings: base phone names, then attribute lists (comma
+ *	separated), each NUL terminated, padded to n_str_word words
+ *	per model: packed (base, left, right, posn), tmat, n_state,
+ *	attribute list
+ *	state map (n_state_map words)
+ *	triphone index (2 words per slot)
+ *
+ * Reading one is a few copies rather than a parse, and it needs no
+ * name lookups.
+ */
+#define MDEF_BIN_HDR_WORDS	14
+#define MDEF_BIN_BYTE_ORDER	0x11223344
+
+static uint32
+mdef_bin_pack(acmod_set_t *acmod_set, acmod_id_t p)
+{
+    acmod_id_t b, l, r;
+    word_posn_t wp;
+
+    if (p < acmod_set_n_ci(acmod_set))
+	return 0;
+    acmod_set_id2tri(acmod_set, &b, &l, &r, &wp, p);
+
+    return (b << 24) | (l << 16) | (r << 8) | (uint32)wp;
+}
+
+static char *
+mdef_bin_attrib_str(const char **attrib)
+{
+    char *str;
+    size_t len;
+    uint32 i;
+
+    if ((attrib == NULL) || (attrib[0] == NULL))
+	return ckd_salloc("n/a");
+
+    for (i = 0, len = 0; attrib[i]; i++)
+	len += strlen(attrib[i]) + 1;
+    str = ckd_calloc(len, 1);
+    for (i = 0; attrib[i]; i++) {
+	if (i > 0)
+	    strcat(str, ",");
+	strcat(str, attrib[i]);
+    }
+
+    return str;
+}
+
+int32
+model_def_write_bin(model_def_t *mdef,
+		    const char *fn)
+{
+    acmod_set_t *acmod_set = mdef->acmod_set;
+    uint32 hdr[MDEF_BIN_HDR_WORDS];
+    uint32 n_ci, n_acmod, n_attrib, n_slot;
+    uint32 *acmod_attrib;
+    char **attrib_str;
+    hash_table_t *attrib_ht;
+    size_t n_str, off;
+    char *str;
+    uint32 rec[4];
+    uint32 i;
+    void *val;
+    FILE *fp;
+    int32 rv = S3_SUCCESS;
+
+    n_ci = acmod_set_n_ci(acmod_set);
+    n_acmod = acmod_set_n_acmod(acmod_set);
+
+    /* Attribute lists are few; store each distinct one once */
+    attrib_ht = hash_table_new(64, HASH_CASE_YES);
+    attrib_str = ckd_calloc(n_acmod, sizeof(char *));
+    acmod_attrib = ckd_calloc(n_acmod, sizeof(uint32));
+    for (i = 0, n_attrib = 0; i < n_acmod; i++) {
+	str = mdef_bin_attrib_str(acmod_set_attrib(acmod_set, i));
+	if (hash_table_lookup(attrib_ht, str, &val) == 0) {
+	    acmod_attrib[i] = (uint32)(size_t)val;
+	    ckd_free(str);
+	}
+	else {
+	    attrib_str[n_attrib] = str;
+	    hash_table_enter(attrib_ht, str, (void *)(size_t)n_attrib);
+	    acmod_attrib[i] = n_attrib++;
+	}
+    }
+    hash_table_free(attrib_ht);
+
+    for (i = 0, n_str = 0; i < n_ci; i++)
+	n_str += strlen(acmod_set_id2name(acmod_set, i)) + 1;
+    for (i = 0; i < n_attrib; i++)
+	n_str += strlen(attrib_str[i]) + 1;
+    n_str = (n_str + 3) / 4;
+    str = ckd_calloc(n_str, 4);
+    for (i = 0, off = 0; i < n_ci; i++) {
+	strcpy(str + off, acmod_set_id2name(acmod_set, i));
+	off += strlen(str + off) + 1;
+    }
+    for (i = 0; i < n_attrib; i++) {
+	strcpy(str + off, attrib_str[i]);
+	off += strlen(str + off) + 1;
+    }
+
+    n_slot = acmod_set->tri_idx ? (0xffffffff >> acmod_set->tri_shift) + 1 : 0;
+
+    hdr[0] = MDEF_BIN_BYTE_ORDER;
+    hdr[1] = MODEL_DEF_BIN_VERSION;
+    hdr[2] = n_ci;
+    hdr[3] = acmod_set_n_multi(acmod_set);
+    hdr[4] = mdef->n_total_state;
+    hdr[5] = mdef->n_tied_state;
+    hdr[6] = mdef->n_tied_ci_state;
+    hdr[7] = mdef->n_tied_tmat;
+    hdr[8] = mdef->max_n_state;
+    hdr[9] = mdef->min_n_state;
+    hdr[10] = n_attrib;
+    hdr[11] = n_str;
+    hdr[12] = acmod_set->tri_shift;
+    hdr[13] = n_slot;
+
+    fp = fopen(fn, "wb");
+    if (fp == NULL) {
+	E_ERROR_SYSTEM("Unable to open %s for writing", fn);
+	rv = S3_ERROR;
+	goto done;
+    }
+    if (fwrite(MODEL_DEF_BIN_MAGIC, 1, 8, fp) != 8
+	|| fwrite(hdr, 4, MDEF_BIN_HDR_WORDS, fp) != MDEF_BIN_HDR_WORDS
+	|| fwrite(str, 4, n_str, fp) != n_str)
+	goto write_error;
+    for (i = 0; i < n_acmod; i++) {
+	rec[0] = mdef_bin_pack(acmod_set, i);
+	rec[1] = mdef->defn[i].tmat;
+	rec[2] = mdef->defn[i].n_state;
+	rec[3] = acmod_attrib[i];
+	if (fwrite(rec, 4, 4, fp) != 4)
+	    goto write_error;
+    }
+    if (mdef->n_total_state > 0
+	&& fwrite(mdef->defn[0].state, 4, mdef->n_total_state, fp)
+	!= mdef->n_total_state)
+	goto write_error;
+    if (n_slot > 0
+	&& fwrite(acmod_set->tri_idx, sizeof(acmod_tri_slot_t), n_slot, fp)
+	!= n_slot)
+	goto write_error;
+    if (fclose(fp) != 0) {
+	fp = NULL;
+	goto write_error;
+    }
+    goto done;
+
+write_error:
+    E_ERROR_SYSTEM("Failed to write %s", fn);
+    if (fp)
+	fclose(fp);
+    rv = S3_ERROR;
+
+done:
+    for (i = 0; i < n_attrib; i++)
+	ckd_free(attrib_str[i]);
+    ckd_free(attrib_str);
+    ckd_free(acmod_attrib);
+    ckd_free(str);
+
+    return rv;
+}
+
+static int32
+model_def_read_bin(model_def_t **out_model_def,
+		   const char *file_name)
+{
+    mmio_file_t *mf;
+    struct stat st;
+    const uint32 *hdr, *w, *rec, *all_state;
+    const acmod_tri_slot_t *slot;
+    const char *str, *str_end, *nul;
+    uint32 n_base, n_tri, n_total, n_total_map, n_attrib, n_str, n_slot;
+    uint32 n_empty;
+    size_t n_word;
+    model_def_t *omd;
+    acmod_set_t *acmod_set;
+    model_def_entry_t *mdef;
+    uint32 *state;
+    uint32 i, j;
+
+    if (stat(file_name, &st) < 0) {
+	E_ERROR_SYSTEM("Unable to stat %s", file_name);
+	return S3_ERROR;
+    }
+    if ((mf = mmio_file_read(file_name)) == NULL) {
+	E_ERROR("Unable to map %s\n", file_name);
+	return S3_ERROR;
+    }
+    hdr = (const uint32 *)((const char *)mmio_file_ptr(mf) + 8);
+    n_word = (st.st_size - 8) / 4;
+
+    if (n_word < MDEF_BIN_HDR_WORDS) {
+	E_ERROR("%s is truncated\n", file_name);
+	goto error;
+    }
+    if (hdr[0] != MDEF_BIN_BYTE_ORDER) {
+	E_ERROR("%s was written on a machine of different byte order; "
+		"convert it again from the text model definition\n",
+		file_name);
+	goto error;
+    }
+    if (hdr[1] != MODEL_DEF_BIN_VERSION) {
+	E_ERROR("%s has binary version %u, expected %u\n",
+		file_name, hdr[1], MODEL_DEF_BIN_VERSION);
+	goto error;
+    }
+    n_base = hdr[2];
+    n_tri = hdr[3];
+    n_total = n_base + n_tri;
+    n_total_map = hdr[4];
+    n_attrib = hdr[10];
+    n_str = hdr[11];
+    n_slot = hdr[13];
+    if (n_base > n_word || n_tri > n_word || n_attrib > n_word
+	|| (size_t)MDEF_BIN_HDR_WORDS + n_str + 4 * (size_t)n_total
+	+ n_total_map + 2 * (size_t)n_slot != n_word)
+	goto corrupt;
+    /* The index has a power of two slots, one per value of the top
+       32 - tri_shift bits of the hash */
+    if ((n_tri > 0 || n_slot > 0)
+	&& (hdr[12] == 0 || hdr[12] >= 32
+	    || n_slot != (0xffffffff >> hdr[12]) + 1))
+	goto corrupt;
+    w = hdr + MDEF_BIN_HDR_WORDS;
+    rec = w + n_str;
+    all_state = rec + 4 * n_total;
+    slot = (const acmod_tri_slot_t *)(all_state + n_total_map);
+
+    /* Everything below indexes with values from the file, so check
+     * them before building anything from it: the strings must end
+     * within the string table, the records must name existing
+     * phones and attribute lists and use up the state map, and the
+     * index must hold triphones and have room for lookups to stop. */
+    str = (const char *)w;
+    str_end = str + 4 * (size_t)n_str;
+    for (i = 0; i < n_base + n_attrib; i++) {
+	if ((nul = memchr(str, '\0', str_end - str)) == NULL)
+	    goto corrupt;
+	str = nul + 1;
+    }
+    for (i = 0, j = 0; i < n_total; i++, rec += 4) {
+	if (rec[3] >= n_attrib || rec[2] > MAX_N_STATE
+	    || rec[2] > n_total_map - j)
+	    goto corrupt;
+	j += rec[2];
+	if (i >= n_base
+	    && ((rec[0] >> 24) >= n_base
+		|| ((rec[0] >> 16) & 0xff) >= n_base
+		|| ((rec[0] >> 8) & 0xff) >= n_base
+		|| (rec[0] & 0xff) > WORD_POSN_UNDEFINED))
+	    goto corrupt;
+    }
+    if (j != n_total_map)
+	goto corrupt;
+    for (i = 0, n_empty = 0; i < n_slot; i++) {
+	if (slot[i].id == NO_ACMOD)
+	    n_empty++;
+	else if (slot[i].id < n_base || slot[i].id >= n_total)
+	    goto corrupt;
+    }
+    if (n_slot > 0 && n_empty == 0)
+	goto corrupt;
+    str = (const char *)w;
+    rec = w + n_str;
+
+    *out_model_def = omd = ckd_calloc(1, sizeof(model_def_t));
+    omd->acmod_set = acmod_set = acmod_set_new();
+
+    /* Attribute lists, shared by all the models which have them */
+    acmod_set->attrib_pool = ckd_calloc(n_attrib, sizeof(char **));
+    acmod_set->n_attrib_pool = n_attrib;
+    for (i = 0; i < n_base; i++)
+	str += strlen(str) + 1;
+    for (i = 0; i < n_attrib; i++) {
+	const char **attrib = mk_attrib_list((char *)str);
+	uint32 len;
+
+	for (len = 0; attrib[len]; len++);
+	acmod_set->attrib_pool[i] = ckd_calloc(len + 1, sizeof(char *));
+	for (j = 0; j < len; j++)
+	    acmod_set->attrib_pool[i][j] = ckd_salloc(attrib[j]);
+	str += strlen(str) + 1;
+    }
+
+    acmod_set_set_n_ci_hint(acmod_set, n_base);
+    str = (const char *)w;
+    for (i = 0; i < n_base; i++, rec += 4) {
+	acmod_set->ci[i].name = ckd_salloc(str);
+	acmod_set->ci[i].attrib = acmod_set->attrib_pool[rec[3]];
+	acmod_set->ci[i].id = i;
+	str += strlen(str) + 1;
+    }
+    acmod_set->n_ci = acmod_set->next_id = n_base;
+
+    acmod_set_set_n_tri_hint(acmod_set, n_tri);
+    for (i = 0; i < n_tri; i++, rec += 4) {
+	acmod_set->multi[i].base = rec[0] >> 24;
+	acmod_set->multi[i].left_context = (rec[0] >> 16) & 0xff;
+	acmod_set->multi[i].right_context = (rec[0] >> 8) & 0xff;
+	acmod_set->multi[i].posn = (word_posn_t)(rec[0] & 0xff);
+	acmod_set->multi[i].attrib = acmod_set->attrib_pool[rec[3]];
+    }
+    acmod_set->n_multi = n_tri;
+    acmod_set->next_id += n_tri;
+
+    if (n_slot > 0) {
+	acmod_set->tri_idx = ckd_calloc(n_slot, sizeof(acmod_tri_slot_t));
+	memcpy(acmod_set->tri_idx, slot, n_slot * sizeof(acmod_tri_slot_t));
+	acmod_set->tri_shift = hdr[12];
+    }
+
+    omd->defn = mdef = ckd_calloc(n_total, sizeof(model_def_entry_t));
+    omd->n_defn = n_total;
+    omd->n_total_state = n_total_map;
+    omd->n_tied_state = hdr[5];
+    omd->n_tied_ci_state = hdr[6];
+    omd->n_tied_tmat = hdr[7];
+    omd->max_n_state = hdr[8];
+    omd->min_n_state = hdr[9];
+
+    state = ckd_calloc(n_total_map, sizeof(uint32));
+    memcpy(state, all_state, n_total_map * sizeof(uint32));
+    rec = w + n_str;
+    for (i = 0, j = 0; i < n_total; i++, rec += 4) {
+	mdef[i].p = i;
+	mdef[i].tmat = rec[1];
+	mdef[i].n_state = rec[2];
+	mdef[i].state = &state[j];
+	j += rec[2];
+    }
+    mmio_file_unmap(mf);
+
+    E_INFO("Model definition info:\n");
+    E_INFO("%u total models defined (%u base, %u tri)\n", omd->n_defn, n_base, n_tri);
+    E_INFO("%u total states\n", omd->n_total_state);
+    E_INFO("%u total tied states\n", omd->n_tied_state);
+    E_INFO("%u total tied CI states\n", omd->n_tied_ci_state);
+    E_INFO("%u total tied transition matrices\n", omd->n_tied_tmat);
+    E_INFO("%u max state/model\n", omd->max_n_state);
+    E_INFO("%u min state/model\n", omd->min_n_state);
+
+    return S3_SUCCESS;
+
+corrupt:
+    E_ERROR("%s is corrupt or truncated\n", file_name);
+error:
+    mmio_file_unmap(mf);
+    return S3_ERROR;
+}
+
 int32
 model_def_read(model_def_t **out_model_def,
 	       const char *file_name)
@@ -406,6 +772,7 @@ model_def_read(model_def_t **out_model_def,
     uint32 max_ci_state;
     
     FILE *fp;
+    char magic[8];
 
     fp = fopen(file_name, "r");
     if (fp == NULL) {
@@ -414,6 +781,13 @@ model_def_read(model_def_t **out_model_def,
 
 	return S3_ERROR;
     }
+
+    if (fread(magic, 1, 8, fp) == 8
+	&& memcmp(magic, MODEL_DEF_BIN_MAGIC, 8) == 0) {
+	fclose(fp);
+	return model_def_read_bin(out_model_def, file_name);
+    }
+    rewind(fp);
     
     li = lineiter_start_clean(fp);
 
@@ -595,7 +969,7 @@ model_def_free(model_def_t *mdef)
     if (mdef->acmod_set->ci) {
       for (i = 0; i < mdef->acmod_set->n_ci; i++) {
 	ckd_free(mdef->acmod_set->ci[i].name);
-	if (mdef->acmod_set->ci[i].attrib) {
+	if (mdef->acmod_set->ci[i].attrib && !mdef->acmod_set->attrib_pool) {
 	  for (len = 0; mdef->acmod_set->ci[i].attrib[len]; len++)
     	     ckd_free(mdef->acmod_set->ci[i].attrib[len]);
 	  ckd_free(mdef->acmod_set->ci[i].attrib);
@@ -607,7 +981,7 @@ model_def_free(model_def_t *mdef)
 
     if (mdef->acmod_set->multi) {
       for (i = 0; i < mdef->acmod_set->n_multi; i ++) {
-	if (mdef->acmod_set->multi[i].attrib) {
+	if (mdef->acmod_set->multi[i].attrib && !mdef->acmod_set->attrib_pool) {
 	  for (len = 0; mdef->acmod_set->multi[i].attrib[len]; len++)
 	     ckd_free(mdef->acmod_set->multi[i].attrib[len]);
 	  ckd_free(mdef->acmod_set->multi[i].attrib);
@@ -617,14 +991,19 @@ model_def_free(model_def_t *mdef)
     }
     mdef->acmod_set->multi = NULL;
 
-    if (mdef->acmod_set->multi_idx) {
-      for (i = 0; i < mdef->acmod_set->n_ci; i++) {
-	ckd_free(mdef->acmod_set->multi_idx[i]->cell);
-	ckd_free(mdef->acmod_set->multi_idx[i]);
+    if (mdef->acmod_set->tri_idx)
+      ckd_free(mdef->acmod_set->tri_idx);
+    mdef->acmod_set->tri_idx = NULL;
+
+    if (mdef->acmod_set->attrib_pool) {
+      for (i = 0; i < mdef->acmod_set->n_attrib_pool; i++) {
+	for (len = 0; mdef->acmod_set->attrib_pool[i][len]; len++)
+	    ckd_free(mdef->acmod_set->attrib_pool[i][len]);
+	ckd_free(mdef->acmod_set->attrib_pool[i]);
       }
-      ckd_free(mdef->acmod_set->multi_idx);
+      ckd_free(mdef->acmod_set->attrib_pool);
     }
-    mdef->acmod_set->multi_idx = NULL;
+    mdef->acmod_set->attrib_pool = NULL;
 
     if (mdef->acmod_set->attrib) {
       for (len = 0; mdef->acmod_set->attrib[len]; len++)
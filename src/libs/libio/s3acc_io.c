@@ -279,20 +279,29 @@ rdacc_den(const char *dir,
         if (err)
             return S3_ERROR;
 
-        /* accumulate values */
-        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
-
-        gauden_accum_param(wt_mean, in_wt_mean,
-                           n_mgau, n_stream, n_density, *inout_veclen);
-        gauden_free_param(in_wt_mean);
-
+        /* accumulate values (centered variances are merged using
+         * the means and counts, so do them first) */
         if (wt_var) {
             assert(in_wt_var);
 
-            gauden_accum_param(wt_var, in_wt_var,
-                               n_mgau, n_stream, n_density, *inout_veclen);
+            if (pass2var == GAUCNT_PASS2VAR_CENTERED)
+                gauden_accum_centered_var(wt_var, in_wt_var,
+                                          wt_mean, in_wt_mean,
+                                          dnom, in_dnom,
+                                          n_mgau, n_stream, n_density,
+                                          *inout_veclen);
+            else
+                gauden_accum_param(wt_var, in_wt_var,
+                                   n_mgau, n_stream, n_density,
+                                   *inout_veclen);
             gauden_free_param(in_wt_var);
         }
+
+        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
+
+        gauden_accum_param(wt_mean, in_wt_mean,
+                           n_mgau, n_stream, n_density, *inout_veclen);
+        gauden_free_param(in_wt_mean);
     }
 
     return S3_SUCCESS;
@@ -402,21 +411,29 @@ rdacc_den_full(const char *dir,
         if (err)
             return S3_ERROR;
 
-        /* accumulate values */
-        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
-
-        gauden_accum_param(wt_mean, in_wt_mean,
-                           n_mgau, n_stream, n_density, *inout_veclen);
-        gauden_free_param(in_wt_mean);
-
+        /* accumulate values (centered variances are merged using
+         * the means and counts, so do them first) */
         if (wt_var) {
             assert(in_wt_var);
 
-            gauden_accum_param_full(wt_var, in_wt_var,
-                                    n_mgau, n_stream, n_density,
-                                    *inout_veclen);
+            if (pass2var == GAUCNT_PASS2VAR_CENTERED)
+                gauden_accum_centered_fullvar(wt_var, in_wt_var,
+                                              wt_mean, in_wt_mean,
+                                              dnom, in_dnom,
+                                              n_mgau, n_stream, n_density,
+                                              *inout_veclen);
+            else
+                gauden_accum_param_full(wt_var, in_wt_var,
+                                        n_mgau, n_stream, n_density,
+                                        *inout_veclen);
             gauden_free_param_full(in_wt_var);
         }
+
+        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
+
+        gauden_accum_param(wt_mean, in_wt_mean,
+                           n_mgau, n_stream, n_density, *inout_veclen);
+        gauden_free_param(in_wt_mean);
     }
 
     return S3_SUCCESS;
@@ -520,20 +537,29 @@ rdacc_mmie_den(const char *dir,
         if (err)
             return S3_ERROR;
 
-        /* accumulate values */
-        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
-
-        gauden_accum_param(wt_mean, in_wt_mean,
-                           n_mgau, n_stream, n_density, *inout_veclen);
-        gauden_free_param(in_wt_mean);
-
+        /* accumulate values (centered variances are merged using
+         * the means and counts, so do them first) */
         if (wt_var) {
             assert(in_wt_var);
 
-            gauden_accum_param(wt_var, in_wt_var,
-                               n_mgau, n_stream, n_density, *inout_veclen);
+            if (pass2var == GAUCNT_PASS2VAR_CENTERED)
+                gauden_accum_centered_var(wt_var, in_wt_var,
+                                          wt_mean, in_wt_mean,
+                                          dnom, in_dnom,
+                                          n_mgau, n_stream, n_density,
+                                          *inout_veclen);
+            else
+                gauden_accum_param(wt_var, in_wt_var,
+                                   n_mgau, n_stream, n_density,
+                                   *inout_veclen);
             gauden_free_param(in_wt_var);
         }
+
+        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
+
+        gauden_accum_param(wt_mean, in_wt_mean,
+                           n_mgau, n_stream, n_density, *inout_veclen);
+        gauden_free_param(in_wt_mean);
     }
 
     return S3_SUCCESS;
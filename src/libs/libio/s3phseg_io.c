@@ -46,7 +46,10 @@
 
 #include <s3/s3phseg_io.h>
 #include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/hash_table.h>
 #include <s3/s3.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -169,110 +172,450 @@ s3phseg_free(s3phseg_t *phseg)
 	}
 }
 
-int
-s3lattice_read(const char *fn,
-	       s3lattice_t **lattice)
+/*
+ * Binary lattices hold the same information as the text format, as
+ * native 32-bit words:
+ *
+ *	S3LATTICE_BIN_MAGIC (8 bytes)
+ *	byte order, version, n_arcs, n_true_arcs, n_word, n_str_word, n_link
+ *	words: the distinct arc words, each NUL terminated, padded to
+ *	n_str_word words
+ *	per arc: word index, sf, ef, lm_score (float64), n_prev_arcs,
+ *	n_next_arcs, offset of its links
+ *	links: preceding then succeeding arc ids of every arc, 1-based
+ *	with 0 for the start or end of the lattice
+ *
+ * The words and links are used in place from the mapped file, so
+ * reading one allocates only the arc array.
+ */
+#define LAT_BIN_HDR_WORDS	7
+#define LAT_BIN_ARC_WORDS	8
+#define LAT_BIN_BYTE_ORDER	0x11223344
+
+static int
+s3lattice_read_text(const char *fn,
+		    FILE *fp,
+		    s3lattice_t *out_lattice)
 {
-  FILE *fp;
-  uint32 id;
-  char line[1024], temp[16];
-  s3lattice_t *out_lattice;
-  uint32 i, j, n;
-  
-  if ((fp = fopen(fn, "r")) == NULL) {
-    E_ERROR("Failed to open lattice file %s\n", fn);
-    return S3_ERROR;
-  }
-  
-  out_lattice = ckd_calloc(1, sizeof(*out_lattice));
-  
+  char line[1024], temp[16], word[1024];
+  s3arc_t *arc;
+  uint32 *word_off, *link_off;
+  size_t n_char, max_char, n_link, max_link, len;
+  uint32 id, i, j, n;
+  int rv = S3_ERROR;
+
   /* process file head */
   /* read the number of total arcs */
-  fgets(line, sizeof(line), fp);
-  if (strstr(line, "Total arcs") == NULL) {
+  if (fgets(line, sizeof(line), fp) == NULL
+      || strstr(line, "Total arcs") == NULL) {
     E_ERROR("Lattice Format Error, missing Total arcs\n");
-    goto error_out;
+    return S3_ERROR;
   }
-  fgets(line, sizeof(line), fp);
-  n = sscanf(line, "%d", &out_lattice->n_arcs);
-  if (n!=1) {
+  if (fgets(line, sizeof(line), fp) == NULL
+      || sscanf(line, "%u", &out_lattice->n_arcs) != 1) {
     E_ERROR("Lattice Format Error, missing Total arcs\n");
-    goto error_out;
+    return S3_ERROR;
   }
   if (out_lattice->n_arcs == 0) {
     E_ERROR("No arc exits in the lattice\n");
-    goto error_out;
+    return S3_ERROR;
   }
 
   /* read the number of true arcs */
-  fgets(line, sizeof(line), fp);
-  if (strstr(line, "True arcs") == NULL) {
+  if (fgets(line, sizeof(line), fp) == NULL
+      || strstr(line, "True arcs") == NULL) {
     E_ERROR("Lattice Format Error, missing True arcs\n");
-    goto error_out;
+    return S3_ERROR;
   }
-  fgets(line, sizeof(line), fp);
-  n = sscanf(line, "%d", &out_lattice->n_true_arcs);
-  if (n!=1) {
+  if (fgets(line, sizeof(line), fp) == NULL
+      || sscanf(line, "%u", &out_lattice->n_true_arcs) != 1) {
     E_ERROR("Lattice Format Error, missing True arcs\n");
-    goto error_out;
+    return S3_ERROR;
   }
   if (out_lattice->n_true_arcs == 0) {
     E_ERROR("No arc from the numerator lattice\n");
-    goto error_out;
+    return S3_ERROR;
   }
   if (out_lattice->n_true_arcs > out_lattice->n_arcs) {
     E_ERROR("The number of arcs from numerator lattice is larger than the number of total arcs\n");
-    goto error_out;
+    return S3_ERROR;
   }
 
   /* read parameter lists */
-  fgets(line, sizeof(line), fp);
-  if (strstr(line, "arc_id") == NULL) {
+  if (fgets(line, sizeof(line), fp) == NULL
+      || strstr(line, "arc_id") == NULL) {
     E_ERROR("Lattice Format Error\n");
-    goto error_out;
+    return S3_ERROR;
   }
-  
-  /* allocate memory for arcs */
-  out_lattice->arc = ckd_calloc(out_lattice->n_arcs, sizeof(*out_lattice->arc));
-  
+
+  /* allocate memory for arcs.  Words and links go into two growing
+   * buffers, and the arcs point into them once they stop moving. */
+  n = out_lattice->n_arcs;
+  out_lattice->arc = ckd_calloc(n, sizeof(*out_lattice->arc));
+  word_off = ckd_calloc(n, sizeof(*word_off));
+  link_off = ckd_calloc(n, sizeof(*link_off));
+  max_char = 16 * (size_t)n;
+  out_lattice->word = ckd_calloc(max_char, 1);
+  max_link = 8 * (size_t)n;
+  out_lattice->link = ckd_calloc(max_link, sizeof(uint32));
+  n_char = n_link = 0;
+
   i = 0;
   /* Get each arc */
-  while (fscanf(fp, "%d", &id) != EOF) {/* arc id */
-    fscanf(fp, "%s", out_lattice->arc[i].word);/* word */
-    fscanf(fp, "%d", &out_lattice->arc[i].sf);/* start frame */
-    fscanf(fp, "%d", &out_lattice->arc[i].ef);/* end frame */
-    fscanf(fp, "%lf", &out_lattice->arc[i].lm_score);/* LM score */
-    fscanf(fp, "%d", &out_lattice->arc[i].n_prev_arcs);/* num of previous arcs */
-    fscanf(fp, "%d", &out_lattice->arc[i].n_next_arcs);/* num of succeeding arcs */
-    
-    /* read preceding arc ids */
-    fscanf(fp, "%s", temp);/* move over '<' */
-    if (out_lattice->arc[i].n_prev_arcs == 0) {
+  while (fscanf(fp, "%u", &id) == 1) {/* arc id */
+    if (i == n) {
+      E_ERROR("%s has more than %u arcs\n", fn, n);
+      goto done;
+    }
+    arc = &out_lattice->arc[i];
+    if (fscanf(fp, "%1023s %u %u %lf %u %u",
+	       word,			/* word */
+	       &arc->sf,		/* start frame */
+	       &arc->ef,		/* end frame */
+	       &arc->lm_score,		/* LM score */
+	       &arc->n_prev_arcs,	/* num of previous arcs */
+	       &arc->n_next_arcs	/* num of succeeding arcs */
+	  ) != 6) {
+      E_ERROR("Lattice Format Error at arc %u\n", id);
+      goto done;
+    }
+    if (arc->n_prev_arcs == 0) {
       E_ERROR("No preceding arc exits\n");
-      goto error_out;
+      goto done;
     }
-    out_lattice->arc[i].prev_arcs = ckd_calloc(out_lattice->arc[i].n_prev_arcs, sizeof(int));
-    for (j=0; j<out_lattice->arc[i].n_prev_arcs; j++)
-      fscanf(fp, "%d", &out_lattice->arc[i].prev_arcs[j]);
-    
-    /* read succeeding arc ids */
-    fscanf(fp, "%s", temp);/* move over '<' */
-    if (out_lattice->arc[i].n_next_arcs == 0) {
+    if (arc->n_next_arcs == 0) {
       E_ERROR("No succeeding arc exits\n");
-      goto error_out;
+      goto done;
+    }
+
+    len = strlen(word) + 1;
+    if (n_char + len > max_char) {
+      max_char = 2 * max_char + len;
+      out_lattice->word = ckd_realloc(out_lattice->word, max_char);
+    }
+    word_off[i] = n_char;
+    memcpy(out_lattice->word + n_char, word, len);
+    n_char += len;
+
+    len = (size_t)arc->n_prev_arcs + arc->n_next_arcs;
+    if (n_link + len > max_link) {
+      max_link = 2 * max_link + len;
+      out_lattice->link = ckd_realloc(out_lattice->link,
+				      max_link * sizeof(uint32));
+    }
+    link_off[i] = n_link;
+
+    /* read preceding arc ids after a '<', then succeeding arc ids
+     * after a '>' */
+    for (j = 0; j < len; j++) {
+      if ((j == 0 || j == arc->n_prev_arcs)
+	  && fscanf(fp, "%15s", temp) != 1)
+	break;
+      if (fscanf(fp, "%u", &out_lattice->link[n_link + j]) != 1)
+	break;
+    }
+    if (j < len) {
+      E_ERROR("Lattice Format Error at arc %u\n", id);
+      goto done;
     }
-    out_lattice->arc[i].next_arcs = ckd_calloc(out_lattice->arc[i].n_next_arcs, sizeof(int));
-    for (j=0; j<out_lattice->arc[i].n_next_arcs; j++)
-      fscanf(fp, "%d", &out_lattice->arc[i].next_arcs[j]);
-    
+    n_link += len;
+
     i++;
   }
-  fclose(fp);
+
+  for (j = 0; j < n; j++) {
+    arc = &out_lattice->arc[j];
+    if (j < i) {
+      arc->word = out_lattice->word + word_off[j];
+      arc->prev_arcs = out_lattice->link + link_off[j];
+    }
+    else {
+      /* Arcs past the end of the file stay empty */
+      arc->word = "";
+      arc->prev_arcs = out_lattice->link + n_link;
+    }
+    arc->next_arcs = arc->prev_arcs + arc->n_prev_arcs;
+  }
+  rv = S3_SUCCESS;
+
+ done:
+  ckd_free(word_off);
+  ckd_free(link_off);
+
+  return rv;
+}
+
+static int
+s3lattice_read_bin(const char *fn,
+		   s3lattice_t *out_lattice)
+{
+  struct stat st;
+  const uint32 *hdr, *rec, *link;
+  const char *str, **word;
+  uint32 n_word, n_str, n_link, i, n;
+  size_t n_file_word, off;
+  s3arc_t *arc;
+
+  if (stat(fn, &st) < 0) {
+    E_ERROR_SYSTEM("Unable to stat %s", fn);
+    return S3_ERROR;
+  }
+  if ((out_lattice->mf = mmio_file_read(fn)) == NULL) {
+    E_ERROR("Unable to map %s\n", fn);
+    return S3_ERROR;
+  }
+  hdr = (const uint32 *)((const char *)mmio_file_ptr(out_lattice->mf) + 8);
+  n_file_word = (st.st_size - 8) / 4;
+  if (n_file_word < LAT_BIN_HDR_WORDS) {
+    E_ERROR("%s is truncated\n", fn);
+    return S3_ERROR;
+  }
+  if (hdr[0] != LAT_BIN_BYTE_ORDER) {
+    E_ERROR("%s was written on a machine of different byte order\n", fn);
+    return S3_ERROR;
+  }
+  if (hdr[1] != S3LATTICE_BIN_VERSION) {
+    E_ERROR("%s has binary version %u, expected %u\n",
+	    fn, hdr[1], S3LATTICE_BIN_VERSION);
+    return S3_ERROR;
+  }
+  n = out_lattice->n_arcs = hdr[2];
+  out_lattice->n_true_arcs = hdr[3];
+  n_word = hdr[4];
+  n_str = hdr[5];
+  n_link = hdr[6];
+  if (n == 0 || out_lattice->n_true_arcs == 0
+      || out_lattice->n_true_arcs > n
+      || LAT_BIN_HDR_WORDS + (size_t)n_str
+      + LAT_BIN_ARC_WORDS * (size_t)n + n_link != n_file_word) {
+    E_ERROR("%s is corrupt or truncated\n", fn);
+    return S3_ERROR;
+  }
+  str = (const char *)(hdr + LAT_BIN_HDR_WORDS);
+  rec = hdr + LAT_BIN_HDR_WORDS + n_str;
+  link = rec + LAT_BIN_ARC_WORDS * n;
+
+  word = ckd_calloc(n_word > 0 ? n_word : 1, sizeof(*word));
+  for (i = 0, off = 0; i < n_word; i++) {
+    if (off >= 4 * (size_t)n_str
+	|| memchr(str + off, '\0', 4 * (size_t)n_str - off) == NULL) {
+      E_ERROR("%s is corrupt in its word list\n", fn);
+      ckd_free(word);
+      return S3_ERROR;
+    }
+    word[i] = str + off;
+    off += strlen(str + off) + 1;
+  }
+
+  out_lattice->arc = ckd_calloc(n, sizeof(*out_lattice->arc));
+  for (i = 0; i < n; i++, rec += LAT_BIN_ARC_WORDS) {
+    arc = &out_lattice->arc[i];
+    if (rec[0] >= n_word
+	|| (size_t)rec[7] + rec[5] + rec[6] > n_link) {
+      E_ERROR("%s is corrupt at arc %u\n", fn, i + 1);
+      ckd_free(word);
+      return S3_ERROR;
+    }
+    arc->word = word[rec[0]];
+    arc->sf = rec[1];
+    arc->ef = rec[2];
+    memcpy(&arc->lm_score, &rec[3], sizeof(float64));
+    arc->n_prev_arcs = rec[5];
+    arc->n_next_arcs = rec[6];
+    arc->prev_arcs = link + rec[7];
+    arc->next_arcs = arc->prev_arcs + arc->n_prev_arcs;
+  }
+  ckd_free(word);
+
+  /* Arc ids are 1-based, with 0 for the start or end of the lattice,
+   * and index the arc array, so check them once here */
+  for (i = 0; i < n_link; i++) {
+    if (link[i] > n) {
+      E_ERROR("%s links to arc %u of %u\n", fn, link[i], n);
+      return S3_ERROR;
+    }
+  }
+
+  return S3_SUCCESS;
+}
+
+int
+s3lattice_read(const char *fn,
+	       s3lattice_t **lattice)
+{
+  FILE *fp;
+  char magic[8];
+  s3lattice_t *out_lattice;
+  int rv;
+  
+  if ((fp = fopen(fn, "rb")) == NULL) {
+    E_ERROR("Failed to open lattice file %s\n", fn);
+    return S3_ERROR;
+  }
+  
+  out_lattice = ckd_calloc(1, sizeof(*out_lattice));
+  
+  if (fread(magic, 1, 8, fp) == 8
+      && memcmp(magic, S3LATTICE_BIN_MAGIC, 8) == 0) {
+    fclose(fp);
+    rv = s3lattice_read_bin(fn, out_lattice);
+  }
+  else {
+    rewind(fp);
+    rv = s3lattice_read_text(fn, fp, out_lattice);
+    fclose(fp);
+  }
+  if (rv != S3_SUCCESS) {
+    s3lattice_free(out_lattice);
+    return S3_ERROR;
+  }
   
   *lattice = out_lattice;
   
   return S3_SUCCESS;
- error_out:
+}
+
+int
+s3lattice_write(const char *fn,
+		s3lattice_t *lattice)
+{
+  FILE *fp;
+  s3arc_t *arc;
+  uint32 i, j;
+
+  if ((fp = fopen(fn, "w")) == NULL) {
+    E_ERROR_SYSTEM("Failed to open lattice file %s for writing", fn);
+    return S3_ERROR;
+  }
+  fprintf(fp, "Total arcs:\n%u\n", lattice->n_arcs);
+  fprintf(fp, "True arcs:\n%u\n", lattice->n_true_arcs);
+  fprintf(fp, "arc_id, arc_name, start frame, end frame, lmscore, number of preceding acrs, number of succeeding arcs, preceding arc_ids, succeeding arc_ids\n");
+  for (i = 0; i < lattice->n_arcs; i++) {
+    arc = &lattice->arc[i];
+    /* Empty arcs were past the end of a text lattice */
+    if (arc->n_prev_arcs == 0)
+      break;
+    fprintf(fp, "%u %s %u %u %.17g %u %u <",
+	    i + 1, arc->word, arc->sf, arc->ef, arc->lm_score,
+	    arc->n_prev_arcs, arc->n_next_arcs);
+    for (j = 0; j < arc->n_prev_arcs; j++)
+      fprintf(fp, " %u", arc->prev_arcs[j]);
+    fprintf(fp, " >");
+    for (j = 0; j < arc->n_next_arcs; j++)
+      fprintf(fp, " %u", arc->next_arcs[j]);
+    fprintf(fp, "\n");
+  }
+  if (fclose(fp) != 0) {
+    E_ERROR_SYSTEM("Failed to write %s", fn);
+    return S3_ERROR;
+  }
+
+  return S3_SUCCESS;
+}
+
+int
+s3lattice_write_bin(const char *fn,
+		    s3lattice_t *lattice)
+{
+  uint32 hdr[LAT_BIN_HDR_WORDS];
+  uint32 rec[LAT_BIN_ARC_WORDS];
+  uint32 *word_id, n_word, n_str, n_link, i;
+  hash_table_t *ht;
+  s3arc_t *arc;
+  size_t off;
+  char *str;
+  int32 id;
+  FILE *fp;
+  int rv = S3_ERROR;
+
+  /* Intern the words, in order of first use */
+  ht = hash_table_new(lattice->n_arcs, HASH_CASE_YES);
+  word_id = ckd_calloc(lattice->n_arcs, sizeof(*word_id));
+  for (i = 0, n_word = 0, off = 0, n_link = 0; i < lattice->n_arcs; i++) {
+    arc = &lattice->arc[i];
+    if (hash_table_lookup_int32(ht, arc->word, &id) == 0)
+      word_id[i] = id;
+    else {
+      word_id[i] = n_word;
+      (void)hash_table_enter_int32(ht, arc->word, n_word);
+      n_word++;
+      off += strlen(arc->word) + 1;
+    }
+    n_link += arc->n_prev_arcs + arc->n_next_arcs;
+  }
+  n_str = (off + 3) / 4;
+  str = ckd_calloc(n_str > 0 ? n_str : 1, 4);
+  for (i = 0, off = 0, id = 0; i < lattice->n_arcs; i++) {
+    if (word_id[i] == (uint32)id) {
+      strcpy(str + off, lattice->arc[i].word);
+      off += strlen(lattice->arc[i].word) + 1;
+      id++;
+    }
+  }
+
+  hdr[0] = LAT_BIN_BYTE_ORDER;
+  hdr[1] = S3LATTICE_BIN_VERSION;
+  hdr[2] = lattice->n_arcs;
+  hdr[3] = lattice->n_true_arcs;
+  hdr[4] = n_word;
+  hdr[5] = n_str;
+  hdr[6] = n_link;
+
+  if ((fp = fopen(fn, "wb")) == NULL) {
+    E_ERROR_SYSTEM("Failed to open lattice file %s for writing", fn);
+    goto done;
+  }
+  if (fwrite(S3LATTICE_BIN_MAGIC, 1, 8, fp) != 8
+      || fwrite(hdr, 4, LAT_BIN_HDR_WORDS, fp) != LAT_BIN_HDR_WORDS
+      || fwrite(str, 4, n_str, fp) != n_str)
+    goto write_error;
+  for (i = 0, off = 0; i < lattice->n_arcs; i++) {
+    arc = &lattice->arc[i];
+    rec[0] = word_id[i];
+    rec[1] = arc->sf;
+    rec[2] = arc->ef;
+    memcpy(&rec[3], &arc->lm_score, sizeof(float64));
+    rec[5] = arc->n_prev_arcs;
+    rec[6] = arc->n_next_arcs;
+    rec[7] = off;
+    off += arc->n_prev_arcs + arc->n_next_arcs;
+    if (fwrite(rec, 4, LAT_BIN_ARC_WORDS, fp) != LAT_BIN_ARC_WORDS)
+      goto write_error;
+  }
+  for (i = 0; i < lattice->n_arcs; i++) {
+    arc = &lattice->arc[i];
+    if (fwrite(arc->prev_arcs, 4, arc->n_prev_arcs, fp) != arc->n_prev_arcs
+	|| fwrite(arc->next_arcs, 4, arc->n_next_arcs, fp)
+	!= arc->n_next_arcs)
+      goto write_error;
+  }
+  if (fclose(fp) != 0)
+    E_ERROR_SYSTEM("Failed to write %s", fn);
+  else
+    rv = S3_SUCCESS;
+  goto done;
+
+ write_error:
+  E_ERROR_SYSTEM("Failed to write %s", fn);
   fclose(fp);
-  return S3_ERROR;
+
+ done:
+  hash_table_free(ht);
+  ckd_free(word_id);
+  ckd_free(str);
+
+  return rv;
+}
+
+void
+s3lattice_free(s3lattice_t *lattice)
+{
+  if (lattice == NULL)
+    return;
+  ckd_free(lattice->arc);
+  ckd_free(lattice->link);
+  ckd_free(lattice->word);
+  if (lattice->mf)
+    mmio_file_unmap(lattice->mf);
+  ckd_free(lattice);
 }
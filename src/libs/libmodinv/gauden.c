@@ -1542,6 +1542,96 @@ gauden_accum_param_full(vector_t ****out,
 	}
     }
 }
+
+/*
+ * Merge variance sums which are centered about their own sample
+ * means (M2 = sum (x - mean)^2) using the pairwise update of Chan,
+ * Golub and LeVeque:
+ *
+ *	M2 = M2_a + M2_b + (mean_b - mean_a)^2 * n_a * n_b / (n_a + n_b)
+ *
+ * The means are the unnormalized sums and the counts are the dnoms,
+ * so this must be called before those are accumulated.
+ */
+void
+gauden_accum_centered_var(vector_t ***out_var,
+			  vector_t ***in_var,
+			  vector_t ***out_mean,
+			  vector_t ***in_mean,
+			  float32 ***out_dnom,
+			  float32 ***in_dnom,
+			  uint32 n_mgau,
+			  uint32 n_feat,
+			  uint32 n_density,
+			  const uint32 *veclen)
+{
+    uint32 i, j, k, l;
+    float64 n_a, n_b, w, d;
+
+    for (i = 0; i < n_mgau; i++) {
+	for (j = 0; j < n_feat; j++) {
+	    for (k = 0; k < n_density; k++) {
+		n_a = out_dnom[i][j][k];
+		n_b = in_dnom[i][j][k];
+		w = (n_a > 0 && n_b > 0) ? n_a * n_b / (n_a + n_b) : 0;
+		for (l = 0; l < veclen[j]; l++) {
+		    out_var[i][j][k][l] += in_var[i][j][k][l];
+		    if (w > 0) {
+			d = in_mean[i][j][k][l] / n_b
+			    - out_mean[i][j][k][l] / n_a;
+			out_var[i][j][k][l] += d * d * w;
+		    }
+		}
+	    }
+	}
+    }
+}
+
+void
+gauden_accum_centered_fullvar(vector_t ****out_var,
+			      vector_t ****in_var,
+			      vector_t ***out_mean,
+			      vector_t ***in_mean,
+			      float32 ***out_dnom,
+			      float32 ***in_dnom,
+			      uint32 n_mgau,
+			      uint32 n_feat,
+			      uint32 n_density,
+			      const uint32 *veclen)
+{
+    uint32 i, j, k, l, ll;
+    float64 n_a, n_b, w;
+    float64 *d;
+
+    for (j = 0, l = 0; j < n_feat; j++)
+	if (veclen[j] > l)
+	    l = veclen[j];
+    d = ckd_calloc(l, sizeof(float64));
+
+    for (i = 0; i < n_mgau; i++) {
+	for (j = 0; j < n_feat; j++) {
+	    for (k = 0; k < n_density; k++) {
+		n_a = out_dnom[i][j][k];
+		n_b = in_dnom[i][j][k];
+		w = (n_a > 0 && n_b > 0) ? n_a * n_b / (n_a + n_b) : 0;
+		for (l = 0; l < veclen[j]; l++) {
+		    if (w > 0)
+			d[l] = in_mean[i][j][k][l] / n_b
+			    - out_mean[i][j][k][l] / n_a;
+		    else
+			d[l] = 0;
+		}
+		for (l = 0; l < veclen[j]; l++) {
+		    for (ll = 0; ll < veclen[j]; ll++) {
+			out_var[i][j][k][l][ll] += in_var[i][j][k][l][ll]
+			    + d[l] * d[ll] * w;
+		    }
+		}
+	    }
+	}
+    }
+    ckd_free(d);
+}
 
 void
 gauden_norm_wt_mean(vector_t ***in_mean,
@@ -99,134 +99,55 @@
 #include "sphinxbase/case.h"
 
 
-#if 0
-static void
-prime_sieve(int32 max)
-{
-    char *notprime;
-    int32 p, pp;
-
-    notprime = (char *) ckd_calloc(max + 1, 1);
-    p = 2;
-    for (;;) {
-        printf("%d\n", p);
-        for (pp = p + p; pp <= max; pp += p)
-            notprime[pp] = 1;
-        for (++p; (p <= max) && notprime[p]; p++);
-        if (p > max)
-            break;
-    }
-}
-#endif
-
-
 /*
- * HACK!!  Initial hash table size is restricted by this set of primes.  (Of course,
- * collision resolution by chaining will accommodate more entries indefinitely, but
- * efficiency will drop.)
+ * Smallest table allocated, and the largest fraction of a table in
+ * use before it is doubled.  Linear probing stays short below half
+ * full.
  */
-const int32 prime[] = {
-    101, 211, 307, 401, 503, 601, 701, 809, 907,
-    1009, 1201, 1601, 2003, 2411, 3001, 4001, 5003, 6007, 7001, 8009,
-    9001,
-    10007, 12007, 16001, 20011, 24001, 30011, 40009, 50021, 60013,
-    70001, 80021, 90001,
-    100003, 120011, 160001, 200003, 240007, 300007, 400009, 500009,
-    600011, 700001, 800011, 900001,
-    -1
-};
-
-
-/**
- * This function returns a very large prime. 
- */
-static int32
-prime_size(int32 size)
-{
-    int32 i;
-
-    for (i = 0; (prime[i] > 0) && (prime[i] < size); i++);
-    if (prime[i] <= 0) {
-        E_WARN("Very large hash table requested (%d entries)\n", size);
-        --i;
-    }
-    return (prime[i]);
-}
-
-
-hash_table_t *
-hash_table_new(int32 size, int32 casearg)
-{
-    hash_table_t *h;
-
-    h = (hash_table_t *) ckd_calloc(1, sizeof(hash_table_t));
-    h->size = prime_size(size + (size >> 1));
-    h->nocase = (casearg == HASH_CASE_NO);
-    h->table = (hash_entry_t *) ckd_calloc(h->size, sizeof(hash_entry_t));
-    /* The above calloc clears h->table[*].key and .next to NULL, i.e. an empty table */
-
-    return h;
-}
+#define HASH_MIN_SIZE	16
+#define HASH_FULL(h, n)	(2 * (n) > (h)->size)
 
 
 /*
- * Compute hash value for given key string.
- * Somewhat tuned for English text word strings.
+ * Compute the 64-bit hash of a key, eight bytes at a time.  Each word
+ * is mixed in with a multiply and shift, and the result goes through
+ * the MurmurHash3 finalizer so that its low bits, which select the
+ * slot, depend on every byte.  For case-insensitive tables, 7-bit
+ * ASCII letters are folded to upper case as in key comparisons.
  */
-static uint32
-key2hash(hash_table_t * h, const char *key)
+static uint64_t
+key2hash(hash_table_t * h, const char *key, size_t len)
 {
-
-    register const char *cp;
-
-    /* This is a hack because the best way to solve it is to make sure 
-       all character representation is unsigned character in the first place.        
-       (or better unicode.) */
-    register unsigned char c;
-    register int32 s;
-    register uint32 hash;
-
-    hash = 0;
-    s = 0;
-
-    if (h->nocase) {
-        for (cp = key; *cp; cp++) {
-            c = *cp;
-            c = UPPER_CASE(c);
-            hash += c << s;
-            s += 5;
-            if (s >= 25)
-                s -= 24;
+    uint64_t hash, w;
+    size_t i, n;
+
+    hash = 0x9e3779b97f4a7c15ULL ^ ((uint64_t)len * 0xff51afd7ed558ccdULL);
+    while (len > 0) {
+        n = len < 8 ? len : 8;
+        w = 0;
+        if (h->nocase) {
+            for (i = 0; i < n; i++) {
+                unsigned char c = key[i];
+                w |= (uint64_t)UPPER_CASE(c) << (8 * i);
+            }
         }
-    }
-    else {
-        for (cp = key; *cp; cp++) {
-            hash += (*cp) << s;
-            s += 5;
-            if (s >= 25)
-                s -= 24;
+        else {
+            for (i = 0; i < n; i++)
+                w |= (uint64_t)(unsigned char)key[i] << (8 * i);
         }
+        hash = (hash ^ w) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+        key += n;
+        len -= n;
     }
 
-    return (hash % h->size);
-}
-
-
-static char *
-makekey(uint8 * data, size_t len, char *key)
-{
-    size_t i, j;
-
-    if (!key)
-        key = (char *) ckd_calloc(len * 2 + 1, sizeof(char));
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
 
-    for (i = 0, j = 0; i < len; i++, j += 2) {
-        key[j] = 'A' + (data[i] & 0x000f);
-        key[j + 1] = 'J' + ((data[i] >> 4) & 0x000f);
-    }
-    key[j] = '\0';
-
-    return key;
+    return hash;
 }
 
 
@@ -251,71 +172,79 @@ keycmp_nocase(hash_entry_t * entry, const char *key)
 }
 
 
-static int32
-keycmp_case(hash_entry_t * entry, const char *key)
-{
-    char c1, c2;
-    int32 i;
-    const char *str;
-
-    str = entry->key;
-    for (i = 0; i < entry->len; i++) {
-        c1 = *(str++);
-        c2 = *(key++);
-        if (c1 != c2)
-            return (c1 - c2);
-    }
-
-    return 0;
-}
-
-
 /*
- * Lookup entry with hash-value hash in table h for given key
- * Return value: hash_entry_t for key
+ * Find the slot holding key, or the empty slot where it would be
+ * entered.
  */
 static hash_entry_t *
-lookup(hash_table_t * h, uint32 hash, const char *key, size_t len)
+lookup(hash_table_t * h, uint64_t hash, const char *key, size_t len)
 {
     hash_entry_t *entry;
+    uint32 mask, i;
+
+    mask = h->size - 1;
+    for (i = (uint32)hash & mask;; i = (i + 1) & mask) {
+        entry = &(h->table[i]);
+        if (entry->key == NULL)
+            return entry;
+        if (entry->hash != hash || entry->len != len)
+            continue;
+        if (h->nocase) {
+            if (keycmp_nocase(entry, key) == 0)
+                return entry;
+        }
+        else if (memcmp(entry->key, key, len) == 0)
+            return entry;
+    }
+}
 
-    entry = &(h->table[hash]);
-    if (entry->key == NULL)
-        return NULL;
 
-    if (h->nocase) {
-        while (entry && ((entry->len != len)
-                         || (keycmp_nocase(entry, key) != 0)))
-            entry = entry->next;
-    }
-    else {
-        while (entry && ((entry->len != len)
-                         || (keycmp_case(entry, key) != 0)))
-            entry = entry->next;
+static void
+resize(hash_table_t * h, int32 size)
+{
+    hash_entry_t *old, *e;
+    int32 old_size, i;
+    uint32 mask, j;
+
+    old = h->table;
+    old_size = h->size;
+    h->size = size;
+    h->table = (hash_entry_t *) ckd_calloc(size, sizeof(hash_entry_t));
+
+    mask = size - 1;
+    for (i = 0; i < old_size; i++) {
+        if (old[i].key == NULL)
+            continue;
+        for (j = (uint32)old[i].hash & mask; h->table[j].key;
+             j = (j + 1) & mask);
+        e = &(h->table[j]);
+        *e = old[i];
     }
+    ckd_free(old);
+}
 
-    return entry;
+
+hash_table_t *
+hash_table_new(int32 size, int32 casearg)
+{
+    hash_table_t *h;
+
+    h = (hash_table_t *) ckd_calloc(1, sizeof(hash_table_t));
+    h->size = HASH_MIN_SIZE;
+    while (HASH_FULL(h, size) && h->size < (1 << 30))
+        h->size <<= 1;
+    h->nocase = (casearg == HASH_CASE_NO);
+    h->table = (hash_entry_t *) ckd_calloc(h->size, sizeof(hash_entry_t));
+    /* The above calloc clears h->table[*].key to NULL, i.e. an empty table */
+
+    return h;
 }
 
 
 int32
 hash_table_lookup(hash_table_t * h, const char *key, void ** val)
 {
-    hash_entry_t *entry;
-    uint32 hash;
-    size_t len;
-
-    hash = key2hash(h, key);
-    len = strlen(key);
-
-    entry = lookup(h, hash, key, len);
-    if (entry) {
-        if (val)
-            *val = entry->val;
-        return 0;
-    }
-    else
-        return -1;
+    return hash_table_lookup_bkey(h, key, strlen(key), val);
 }
 
 int32
@@ -337,15 +266,9 @@ int32
 hash_table_lookup_bkey(hash_table_t * h, const char *key, size_t len, void ** val)
 {
     hash_entry_t *entry;
-    uint32 hash;
-    char *str;
-
-    str = makekey((uint8 *) key, len, NULL);
-    hash = key2hash(h, str);
-    ckd_free(str);
 
-    entry = lookup(h, hash, key, len);
-    if (entry) {
+    entry = lookup(h, key2hash(h, key, len), key, len);
+    if (entry->key) {
         if (val)
             *val = entry->val;
         return 0;
@@ -370,11 +293,14 @@ hash_table_lookup_bkey_int32(hash_table_t * h, const char *key, size_t len, int3
 
 
 static void *
-enter(hash_table_t * h, uint32 hash, const char *key, size_t len, void *val, int32 replace)
+enter(hash_table_t * h, const char *key, size_t len, void *val, int32 replace)
 {
-    hash_entry_t *cur, *new;
+    hash_entry_t *cur;
+    uint64_t hash;
 
-    if ((cur = lookup(h, hash, key, len)) != NULL) {
+    hash = key2hash(h, key, len);
+    cur = lookup(h, hash, key, len);
+    if (cur->key != NULL) {
         void *oldval;
         /* Key already exists. */
         oldval = cur->val;
@@ -388,91 +314,48 @@ enter(hash_table_t * h, uint32 hash, const char *key, size_t len, void *val, int
         return oldval;
     }
 
-    cur = &(h->table[hash]);
-    if (cur->key == NULL) {
-        /* Empty slot at hashed location; add this entry */
-        cur->key = key;
-        cur->len = len;
-        cur->val = val;
-
-        /* Added by ARCHAN at 20050515. This allows deletion could work. */
-        cur->next = NULL;
-
-    }
-    else {
-        /* Key collision; create new entry and link to hashed location */
-        new = (hash_entry_t *) ckd_calloc(1, sizeof(hash_entry_t));
-        new->key = key;
-        new->len = len;
-        new->val = val;
-        new->next = cur->next;
-        cur->next = new;
+    if (HASH_FULL(h, h->inuse + 1)) {
+        resize(h, h->size * 2);
+        cur = lookup(h, hash, key, len);
     }
+    cur->key = key;
+    cur->len = len;
+    cur->val = val;
+    cur->hash = hash;
     ++h->inuse;
 
     return val;
 }
 
-/* 20050523 Added by ARCHAN  to delete a key from a hash table */
+/*
+ * Delete a key from a hash table.  Entries after it in the same run
+ * of full slots are shifted back over the hole if that brings them
+ * no further from their own slot, so that lookups never need to skip
+ * deleted entries.
+ */
 static void *
-delete(hash_table_t * h, uint32 hash, const char *key, size_t len)
+delete(hash_table_t * h, const char *key, size_t len)
 {
-    hash_entry_t *entry, *prev;
+    hash_entry_t *entry;
+    uint32 mask, i, j, k;
     void *val;
 
-    prev = NULL;
-    entry = &(h->table[hash]);
+    entry = lookup(h, key2hash(h, key, len), key, len);
     if (entry->key == NULL)
         return NULL;
-
-    if (h->nocase) {
-        while (entry && ((entry->len != len)
-                         || (keycmp_nocase(entry, key) != 0))) {
-            prev = entry;
-            entry = entry->next;
-        }
-    }
-    else {
-        while (entry && ((entry->len != len)
-                         || (keycmp_case(entry, key) != 0))) {
-            prev = entry;
-            entry = entry->next;
-        }
-    }
-
-    if (entry == NULL)
-        return NULL;
-
-    /* At this point, entry will be the one required to be deleted, prev
-       will contain the previous entry
-     */
     val = entry->val;
 
-    if (prev == NULL) {
-        /* That is to say the entry in the hash table (not the chain) matched the key. */
-        /* We will then copy the things from the next entry to the hash table */
-        prev = entry;
-        if (entry->next) {      /* There is a next entry, great, copy it. */
-            entry = entry->next;
-            prev->key = entry->key;
-            prev->len = entry->len;
-            prev->val = entry->val;
-            prev->next = entry->next;
-            ckd_free(entry);
-        }
-        else {                  /* There is not a next entry, just set the key to null */
-            prev->key = NULL;
-            prev->len = 0;
-            prev->next = NULL;
-        }
-
-    }
-    else {                      /* This case is simple */
-        prev->next = entry->next;
-        ckd_free(entry);
+    mask = h->size - 1;
+    i = entry - h->table;
+    for (j = (i + 1) & mask; h->table[j].key; j = (j + 1) & mask) {
+        k = (uint32)h->table[j].hash & mask;
+        /* Leave the entry if its own slot k lies cyclically in (i, j] */
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        h->table[i] = h->table[j];
+        i = j;
     }
-
-    /* Do wiring and free the entry */
+    memset(&h->table[i], 0, sizeof(h->table[i]));
 
     --h->inuse;
 
@@ -482,17 +365,7 @@ delete(hash_table_t * h, uint32 hash, const char *key, size_t len)
 void
 hash_table_empty(hash_table_t *h)
 {
-    hash_entry_t *e, *e2;
-    int32 i;
-
-    for (i = 0; i < h->size; i++) {
-        /* Free collision lists. */
-        for (e = h->table[i].next; e; e = e2) {
-            e2 = e->next;
-            ckd_free((void *) e);
-        }
-        memset(&h->table[i], 0, sizeof(h->table[i]));
-    }
+    memset(h->table, 0, h->size * sizeof(hash_entry_t));
     h->inuse = 0;
 }
 
@@ -500,74 +373,37 @@ hash_table_empty(hash_table_t *h)
 void *
 hash_table_enter(hash_table_t * h, const char *key, void *val)
 {
-    uint32 hash;
-    size_t len;
-
-    hash = key2hash(h, key);
-    len = strlen(key);
-    return (enter(h, hash, key, len, val, 0));
+    return (enter(h, key, strlen(key), val, 0));
 }
 
 void *
 hash_table_replace(hash_table_t * h, const char *key, void *val)
 {
-    uint32 hash;
-    size_t len;
-
-    hash = key2hash(h, key);
-    len = strlen(key);
-    return (enter(h, hash, key, len, val, 1));
+    return (enter(h, key, strlen(key), val, 1));
 }
 
 void *
 hash_table_delete(hash_table_t * h, const char *key)
 {
-    uint32 hash;
-    size_t len;
-
-    hash = key2hash(h, key);
-    len = strlen(key);
-
-    return (delete(h, hash, key, len));
+    return (delete(h, key, strlen(key)));
 }
 
 void *
 hash_table_enter_bkey(hash_table_t * h, const char *key, size_t len, void *val)
 {
-    uint32 hash;
-    char *str;
-
-    str = makekey((uint8 *) key, len, NULL);
-    hash = key2hash(h, str);
-    ckd_free(str);
-
-    return (enter(h, hash, key, len, val, 0));
+    return (enter(h, key, len, val, 0));
 }
 
 void *
 hash_table_replace_bkey(hash_table_t * h, const char *key, size_t len, void *val)
 {
-    uint32 hash;
-    char *str;
-
-    str = makekey((uint8 *) key, len, NULL);
-    hash = key2hash(h, str);
-    ckd_free(str);
-
-    return (enter(h, hash, key, len, val, 1));
+    return (enter(h, key, len, val, 1));
 }
 
 void *
 hash_table_delete_bkey(hash_table_t * h, const char *key, size_t len)
 {
-    uint32 hash;
-    char *str;
-
-    str = makekey((uint8 *) key, len, NULL);
-    hash = key2hash(h, str);
-    ckd_free(str);
-
-    return (delete(h, hash, key, len));
+    return (delete(h, key, len));
 }
 
 void
@@ -577,34 +413,20 @@ hash_table_display(hash_table_t * h, int32 showdisplay)
     int i, j;
     j = 0;
 
-    printf("Hash with chaining representation of the hash table\n");
+    printf("Open addressing representation of the hash table\n");
 
     for (i = 0; i < h->size; i++) {
         e = &(h->table[i]);
         if (e->key != NULL) {
-            printf("|key:");
+            printf("|slot:%d|key:", i);
             if (showdisplay)
                 printf("%s", e->key);
             else
                 printf("%p", e->key);
 
-            printf("|len:%zd|val=%ld|->", e->len, (long)e->val);
-            if (e->next == NULL) {
-                printf("NULL\n");
-            }
+            printf("|len:%zd|val=%ld|home=%d\n", e->len, (long)e->val,
+                   (int)(e->hash & (h->size - 1)));
             j++;
-
-            for (e = e->next; e; e = e->next) {
-                printf("|key:");
-                if (showdisplay)
-                    printf("%s", e->key);
-
-                printf("|len:%zd|val=%ld|->", e->len, (long)e->val);
-                if (e->next == NULL) {
-                    printf("NULL\n");
-                }
-                j++;
-            }
         }
     }
 
@@ -628,11 +450,6 @@ hash_table_tolist(hash_table_t * h, int32 * count)
         if (e->key != NULL) {
             g = glist_add_ptr(g, (void *) e);
             j++;
-
-            for (e = e->next; e; e = e->next) {
-                g = glist_add_ptr(g, (void *) e);
-                j++;
-            }
         }
     }
 
@@ -655,26 +472,20 @@ hash_table_iter(hash_table_t *h)
 hash_iter_t *
 hash_table_iter_next(hash_iter_t *itor)
 {
-	/* If there is an entry, walk down its list. */
-	if (itor->ent)
-		itor->ent = itor->ent->next;
-	/* If we got to the end of the chain, or we had no entry, scan
-	 * forward in the table to find the next non-empty bucket. */
-	if (itor->ent == NULL) {
-		while (itor->idx < itor->ht->size
-		       && itor->ht->table[itor->idx].key == NULL) 
-			++itor->idx;
-		/* If we did not find one then delete the iterator and
-		 * return NULL. */
-		if (itor->idx == itor->ht->size) {
-			hash_table_iter_free(itor);
-			return NULL;
-		}
-		/* Otherwise use this next entry. */
-		itor->ent = itor->ht->table + itor->idx;
-		/* Increase idx for the next time around. */
+	/* Scan forward in the table to find the next full slot. */
+	while (itor->idx < itor->ht->size
+	       && itor->ht->table[itor->idx].key == NULL) 
 		++itor->idx;
+	/* If we did not find one then delete the iterator and
+	 * return NULL. */
+	if (itor->idx == itor->ht->size) {
+		hash_table_iter_free(itor);
+		return NULL;
 	}
+	/* Otherwise use this next entry. */
+	itor->ent = itor->ht->table + itor->idx;
+	/* Increase idx for the next time around. */
+	++itor->idx;
 	return itor;
 }
 
@@ -687,20 +498,9 @@ hash_table_iter_free(hash_iter_t *itor)
 void
 hash_table_free(hash_table_t * h)
 {
-    hash_entry_t *e, *e2;
-    int32 i;
-
     if (h == NULL)
         return;
 
-    /* Free additional entries created for key collision cases */
-    for (i = 0; i < h->size; i++) {
-        for (e = h->table[i].next; e; e = e2) {
-            e2 = e->next;
-            ckd_free((void *) e);
-        }
-    }
-
     ckd_free((void *) h->table);
     ckd_free((void *) h);
 }
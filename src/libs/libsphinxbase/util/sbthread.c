@@ -0,0 +1,266 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2008 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file sbthread.c
+ * @brief Simple portable thread functions
+ **/
+
+#include <string.h>
+
+#include "sphinxbase/sbthread.h"
+#include "sphinxbase/ckd_alloc.h"
+#include "sphinxbase/err.h"
+
+#if defined(_WIN32)
+/*
+ * Platform-specific parts: Windows.
+ */
+#include <windows.h>
+
+struct sbthread_s {
+    sbthread_main func;
+    void *arg;
+    int rv;
+    HANDLE th;
+    DWORD tid;
+};
+
+struct sbmtx_s {
+    CRITICAL_SECTION mtx;
+};
+
+static DWORD WINAPI
+sbthread_internal_main(LPVOID arg)
+{
+    sbthread_t *th = (sbthread_t *)arg;
+
+    th->rv = (*th->func)(th);
+    return 0;
+}
+
+sbthread_t *
+sbthread_start(sbthread_main func, void *arg)
+{
+    sbthread_t *th;
+
+    th = ckd_calloc(1, sizeof(*th));
+    th->func = func;
+    th->arg = arg;
+    th->th = CreateThread(NULL, 0, sbthread_internal_main, th, 0, &th->tid);
+    if (th->th == NULL) {
+        E_ERROR("Failed to create thread\n");
+        ckd_free(th);
+        return NULL;
+    }
+    return th;
+}
+
+int
+sbthread_wait(sbthread_t *th)
+{
+    DWORD status;
+
+    /* It has already been joined. */
+    if (th->th == NULL)
+        return -1;
+
+    status = WaitForSingleObject(th->th, INFINITE);
+    if (status == WAIT_FAILED) {
+        E_ERROR("Failed to join thread: WAIT_FAILED\n");
+        return -1;
+    }
+    CloseHandle(th->th);
+    th->th = NULL;
+    return th->rv;
+}
+
+sbmtx_t *
+sbmtx_init(void)
+{
+    sbmtx_t *mtx;
+
+    mtx = ckd_calloc(1, sizeof(*mtx));
+    InitializeCriticalSection(&mtx->mtx);
+    return mtx;
+}
+
+int
+sbmtx_trylock(sbmtx_t *mtx)
+{
+    return TryEnterCriticalSection(&mtx->mtx) ? 0 : -1;
+}
+
+int
+sbmtx_lock(sbmtx_t *mtx)
+{
+    EnterCriticalSection(&mtx->mtx);
+    return 0;
+}
+
+int
+sbmtx_unlock(sbmtx_t *mtx)
+{
+    LeaveCriticalSection(&mtx->mtx);
+    return 0;
+}
+
+void
+sbmtx_free(sbmtx_t *mtx)
+{
+    DeleteCriticalSection(&mtx->mtx);
+    ckd_free(mtx);
+}
+
+#else /* !_WIN32 */
+/*
+ * Platform-specific parts: POSIX threads.
+ */
+#include <pthread.h>
+
+struct sbthread_s {
+    sbthread_main func;
+    void *arg;
+    int rv;
+    int joined;
+    pthread_t th;
+};
+
+struct sbmtx_s {
+    pthread_mutex_t mtx;
+};
+
+static void *
+sbthread_internal_main(void *arg)
+{
+    sbthread_t *th = (sbthread_t *)arg;
+
+    th->rv = (*th->func)(th);
+    return NULL;
+}
+
+sbthread_t *
+sbthread_start(sbthread_main func, void *arg)
+{
+    sbthread_t *th;
+    int rv;
+
+    th = ckd_calloc(1, sizeof(*th));
+    th->func = func;
+    th->arg = arg;
+    if ((rv = pthread_create(&th->th, NULL, &sbthread_internal_main, th)) != 0) {
+        E_ERROR("Failed to create thread: %d\n", rv);
+        ckd_free(th);
+        return NULL;
+    }
+    return th;
+}
+
+int
+sbthread_wait(sbthread_t *th)
+{
+    int rv;
+
+    /* It has already been joined. */
+    if (th->joined)
+        return -1;
+
+    if ((rv = pthread_join(th->th, NULL)) != 0) {
+        E_ERROR("Failed to join thread: %d\n", rv);
+        return -1;
+    }
+    th->joined = 1;
+    return th->rv;
+}
+
+sbmtx_t *
+sbmtx_init(void)
+{
+    sbmtx_t *mtx;
+
+    mtx = ckd_calloc(1, sizeof(*mtx));
+    if (pthread_mutex_init(&mtx->mtx, NULL) != 0) {
+        ckd_free(mtx);
+        return NULL;
+    }
+    return mtx;
+}
+
+int
+sbmtx_trylock(sbmtx_t *mtx)
+{
+    return pthread_mutex_trylock(&mtx->mtx);
+}
+
+int
+sbmtx_lock(sbmtx_t *mtx)
+{
+    return pthread_mutex_lock(&mtx->mtx);
+}
+
+int
+sbmtx_unlock(sbmtx_t *mtx)
+{
+    return pthread_mutex_unlock(&mtx->mtx);
+}
+
+void
+sbmtx_free(sbmtx_t *mtx)
+{
+    pthread_mutex_destroy(&mtx->mtx);
+    ckd_free(mtx);
+}
+
+#endif /* !_WIN32 */
+
+/*
+ * Platform-independent parts.
+ */
+
+void *
+sbthread_arg(sbthread_t *th)
+{
+    return th->arg;
+}
+
+void
+sbthread_free(sbthread_t *th)
+{
+    if (th == NULL)
+        return;
+    sbthread_wait(th);
+    ckd_free(th);
+}
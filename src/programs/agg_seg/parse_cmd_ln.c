@@ -152,6 +152,11 @@ ctl -cepdir cepdir -cepext mfc -ceplen 13 -stride 10 ";
 	  NULL,
 	  "Dictionary containing pronunciations for the fillers."},
 
+	{ "-dictcache",
+	  ARG_STRING,
+	  NULL,
+	  "Directory for binary caches of the dictionaries, which are built on first use"},
+
 	{ "-segdir",
 	  ARG_STRING,
 	  NULL,
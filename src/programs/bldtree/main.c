@@ -65,6 +65,8 @@
 
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/err.h>
+#include <sphinxbase/pio.h>
+#include <sphinxbase/sbthread.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -72,6 +74,49 @@
 #include <assert.h>
 
 #define N_DFEAT	4
+
+/* Models and questions shared by every tree built in one run */
+typedef struct bt_model_s {
+    model_def_t *mdef;
+    uint32 mixw_s;		/* Mixing weight id of in_mixw[0] */
+    float32 ***in_mixw;
+    uint32 n_stream;
+    uint32 n_density;
+    uint32 continuous;
+    int32 var_is_full;
+    vector_t ***fullmean;
+    vector_t ***fullvar;
+    vector_t ****fullvar_full;
+    uint32 *veclen;
+    uint32 sumveclen;
+    pset_t *pset;
+    uint32 n_pset;
+    quest_t *all_q;
+    uint32 n_all_q;
+} bt_model_t;
+
+/* One tree to build: a state of the n-phones p_s through p_e */
+typedef struct bt_task_s {
+    uint32 p_s;
+    uint32 p_e;
+    uint32 state;
+    uint32 order;		/* Position in the order requested */
+    char *treefn;
+} bt_task_t;
+
+/* Inputs to mk_tree_comp() for one task */
+typedef struct bt_tree_s {
+    float32 ****mixw_occ;	/* Rows of the shared mixing weights */
+    float32 ****mixw;
+    float32 ****cnt;		/* Occupancy counts (continuous only) */
+    float32 ****mean;
+    float32 ****var;
+    float32 *stwt;
+    uint32 **dfeat;
+    uint32 n_model;
+    uint32 n_state;
+    uint32 n_density;
+} bt_tree_t;
 
 static void
 mk_stwt(float32 *ostwt, float32 *stwt, uint32 t_s, uint32 n_stwt)
@@ -149,156 +194,314 @@ find_triphones(model_def_t *mdef, const char *phn, uint32 *p_s, uint32 *p_e)
 }
 
 static int
-init(model_def_t **out_mdef,
-     const char *phn,
-     uint32 state,
-     uint32 *out_mixw_s,
-     float32 *****out_mixw,
-     float32 *****out_mixw_occ,
-     float32 *****out_mean,
-     float32 *****out_var,
-     uint32   **out_veclen,
-     uint32 *out_n_model,
-     uint32 *out_n_state,
-     uint32 *out_n_stream,
-     uint32 *out_n_density,
-     float32 **out_stwt,
-     uint32 ***out_dfeat,
-     pset_t **out_pset,
-     uint32 *out_n_pset,
-     quest_t **out_all_q,
-     uint32 *out_n_all_q)
+check_triphones(model_def_t *mdef, const char *phn, uint32 p_s, uint32 p_e)
 {
-    const char *moddeffn;
-    const char *mixwfn;
-    const char *psetfn;
-    model_def_t *mdef;
-    uint32 p, p_s = NO_ID, p_e = NO_ID, s, m;
-    int allphones;
-    uint32 mixw_s, mixw_e;
-    uint32 **dfeat;
-    pset_t *pset;
-    uint32 n_pset;
-    acmod_id_t b, l, r;
-    word_posn_t pn;
-    float32 ****mixw;
-    float32 ****mixw_occ;
-    float32 ***in_mixw;
-    uint32 n_state, n_model, n_in_mixw, n_stream, n_density;
-    uint32 i, j, k;
-    float32 *stwt;
-    float32 *istwt;
-    const char **stwt_str;
-    quest_t *all_q;
-    uint32 n_l_q, n_r_q;
-    uint32 n_all_q;
-    uint32 n_phone_q, n_wdbndry;
-    float64 norm;
-    float64 dnom;
-    float32 mwfloor;
-    float64 wt_ent;
-    float64 s_wt_ent=0;
-    const char*   type;
-    uint32  continuous;
-    uint32  *l_veclen, *t_veclen;
-    uint32  l_nstates, t_nstates;
-    uint32  t_nfeat, t_ndensity;
-    vector_t  ***fullmean;
-    vector_t  ***fullvar = NULL;
-    vector_t  ****fullvar_full = NULL;
-    float32   ****mean;
-    float32   ****var;
-    float32   varfloor;
-    uint32    mm, kk,ll,n,nn,sumveclen;
-    
-    char      *cntflag;
-    float32   cntthreshold,stcnt;
-
-    
-
-    moddeffn = cmd_ln_str("-moddeffn");
-    if (moddeffn == NULL)
-	E_FATAL("Specify -moddeffn\n");
-
-    E_INFO("Reading: %s\n", moddeffn);
-    if (model_def_read(&mdef, moddeffn) != S3_SUCCESS)
-	return S3_ERROR;
-
-    *out_mdef = mdef;
-
-    allphones = cmd_ln_int32("-allphones");
-    if (allphones) {
-      p_s = acmod_set_n_ci(mdef->acmod_set);
-      p_e = acmod_set_n_acmod(mdef->acmod_set)-1;
-    }
-    else if (phn) {
-	if (find_triphones(mdef, phn, &p_s, &p_e) == -1)
-	  return S3_ERROR;
-    }
-    else {
-      E_FATAL("No -phone, -start_phone, or -end_phone specified!\n");
-    }
-
-    E_INFO("Building trees for [%s]", acmod_set_id2name(mdef->acmod_set, p_s));
-    E_INFOCONT(" through [%s]\n", acmod_set_id2name(mdef->acmod_set, p_e));
+    uint32 p, i, j, n_state;
 
     for (p = p_s, i = mdef->defn[p_s].state[0]-1; p <= p_e; p++) {
 	for (j = 0; j < mdef->defn[p].n_state; j++) {
 	    if (mdef->defn[p].state[j] != TYING_NON_EMITTING) {
 		if (mdef->defn[p].state[j] != i+1) {
 		    E_ERROR("States in triphones for %s are not consecutive\n", phn);
-		    
+
 		    return S3_ERROR;
 		}
-		
+
 		i = mdef->defn[p].state[j];
 	    }
 	}
     }
 
-    cntflag = (char *)ckd_calloc(p_e-p_s+1,sizeof(char));
-    cntthreshold = cmd_ln_float32("-cntthresh");
+    n_state = mdef->defn[p_s].n_state - 1;
+    for (p = p_s+1; p <= p_e; p++) {
+	if ((mdef->defn[p].n_state - 1) != n_state) {
+	    E_FATAL("Models do not have uniform topology\n");
+	}
+    }
+
+    return S3_SUCCESS;
+}
+
+/*
+ * Read everything which does not depend on the phone and state the
+ * tree is built for: the mixture weights of the triphones p_s through
+ * p_e, the means and variances (if continuous), and the simple
+ * questions.  All of it is read-only once loaded, so it is shared by
+ * every tree built in this run.
+ */
+static int
+load_models(bt_model_t *bm, uint32 p_s, uint32 p_e)
+{
+    model_def_t *mdef = bm->mdef;
+    const char *mixwfn;
+    const char *psetfn;
+    const char *type;
+    uint32 mixw_e, n_in_mixw;
+    pset_t *pset;
+    uint32 n_pset;
+    quest_t *all_q;
+    uint32 n_all_q;
+    uint32 n_l_q, n_r_q;
+    uint32 n_phone_q, n_wdbndry;
+    uint32 *t_veclen;
+    uint32 l_nstates, t_nstates;
+    uint32 t_nfeat, t_ndensity;
+    int allphones;
+    uint32 i, l;
 
     /* Find first and last mixing weight used for p_s through p_e */
-    mixw_s = mdef->defn[p_s].state[0];
+    bm->mixw_s = mdef->defn[p_s].state[0];
     mixw_e = mdef->defn[p_e].state[mdef->defn[p_e].n_state-2];
 
-    *out_mixw_s = mixw_s;
-
     E_INFO("Covering states |[%u %u]| == %u\n",
-	   mixw_s, mixw_e, mixw_e - mixw_s + 1);
+	   bm->mixw_s, mixw_e, mixw_e - bm->mixw_s + 1);
 
     mixwfn = cmd_ln_str("-mixwfn");
     if (mixwfn == NULL)
 	E_FATAL("Specify -mixwfn\n");
 
     E_INFO("Reading: %s\n", mixwfn);
-    if (s3mixw_intv_read(mixwfn, mixw_s, mixw_e,
-			 &in_mixw,
+    if (s3mixw_intv_read(mixwfn, bm->mixw_s, mixw_e,
+			 &bm->in_mixw,
 			 &n_in_mixw,
-			 &n_stream,
-			 &n_density) != S3_SUCCESS)
+			 &bm->n_stream,
+			 &bm->n_density) != S3_SUCCESS)
 	return S3_ERROR;
 
-    *out_n_stream = n_stream;
-    *out_n_density = n_density;
-    n_state = mdef->defn[p_s].n_state - 1;
-    *out_n_state = n_state;
+    type = cmd_ln_str("-ts2cbfn");
+    if (strcmp(type,".semi.")!=0 && strcmp(type,".cont.") != 0)
+        E_FATAL("Type %s unsupported; trees can only be built on types .semi. or .cont.\n",type);
+    if (strcmp(type,".cont.") == 0)
+        bm->continuous = 1;
+    else
+        bm->continuous = 0;
 
-    for (i = p_s+1; i <= p_e; i++) {
-	if ((mdef->defn[i].n_state - 1) != n_state) {
-	    E_FATAL("Models do not have uniform topology\n");
+    if (bm->continuous == 1) {
+	bm->var_is_full = cmd_ln_int32("-fullvar");
+        /* Read Means and Variances; perform consistency checks */
+        if (s3gau_read(cmd_ln_str("-meanfn"),
+                       &bm->fullmean,
+                       &l_nstates,
+                       &t_nfeat,
+                       &t_ndensity,
+                       &bm->veclen) != S3_SUCCESS)
+            E_FATAL("Error reading mean file %s\n",cmd_ln_str("-meanfn"));
+        if (t_nfeat != bm->n_stream && t_ndensity != bm->n_density)
+            E_FATAL("Mismatch between Mean and Mixture weight files\n");
+
+	if (bm->var_is_full) {
+	    if (s3gau_read_full(cmd_ln_str("-varfn"),
+				&bm->fullvar_full,
+				&t_nstates,
+				&t_nfeat,
+				&t_ndensity,
+				&t_veclen) != S3_SUCCESS)
+		E_FATAL("Error reading var file %s\n",cmd_ln_str("-varfn"));
+	}
+        else {
+	    if (s3gau_read(cmd_ln_str("-varfn"),
+			   &bm->fullvar,
+			   &t_nstates,
+			   &t_nfeat,
+			   &t_ndensity,
+			   &t_veclen) != S3_SUCCESS)
+		E_FATAL("Error reading var file %s\n",cmd_ln_str("-varfn"));
 	}
+        if (t_nfeat != bm->n_stream && t_ndensity != bm->n_density)
+            E_FATAL("Mismatch between Variance and Mixture weight files\n");
+        for (i=0;i<bm->n_stream;i++)
+            if (t_veclen[i] != bm->veclen[i])
+                E_FATAL("Feature length %d in var file != %d in mean file for feature %d\n",t_veclen[i],bm->veclen[i],i);
+        if (l_nstates != t_nstates)
+            E_FATAL("Total no. of states %d in var file != %d in mean file\n",t_nstates,l_nstates);
+
+        if (t_ndensity > 1)
+            E_WARN("The state distributions given have %d gaussians per state;\n..*..shrinking them down to 1 gau per state..\n",t_ndensity);
+
+        for (i=0,bm->sumveclen=0; i < bm->n_stream; i++)
+	    bm->sumveclen += t_veclen[i];
     }
 
-    for (i=p_s,j=0,mm=0; i<=p_e ;i++,j++) { 
+    allphones = cmd_ln_int32("-allphones");
+    psetfn = cmd_ln_str("-psetfn");
+
+    E_INFO("Reading: %s\n", psetfn);
+    bm->pset = pset = read_pset_file(psetfn, mdef->acmod_set, &n_pset);
+    bm->n_pset = n_pset;
+
+    /* Determine the # of phone sets and word boundary
+     * questions there are */
+
+    n_l_q = n_r_q = 0;
+    for (i = 0, n_phone_q = 0, n_wdbndry = 0; i < n_pset; i++) {
+	if (pset[i].member){
+            if (strstr(pset[i].name,"_L") != NULL) {
+                n_phone_q++;
+                n_l_q++;
+            }
+            else if (strstr(pset[i].name,"_R") != NULL) {
+                n_phone_q++;
+                n_r_q++;
+            }
+            else if (allphones)
+	      n_phone_q += 3;
+	    else
+	      n_phone_q += 2;
+        }
+	else
+	    n_wdbndry++;
+    }
+
+    /* Compute the total number of simple questions */
+    if (allphones) /* Ask questions about the phone itself */
+	n_all_q = 2 * n_phone_q + 2 * n_wdbndry;
+    else
+	n_all_q = 2 * n_phone_q + 2 * n_wdbndry;
+    bm->n_all_q = n_all_q;
+
+    /* Allocate an array to hold all the simple questions */
+    all_q = ckd_calloc(n_all_q, sizeof(quest_t));
+    bm->all_q = all_q;
+
+    E_INFO("%u total simple questions (%u phone; %u word bndry)\n",
+	   n_all_q, 2 * n_phone_q, 2 * n_wdbndry);
+    E_INFO("%u Left Only questions, and %u Right Only questions\n",
+           2*n_l_q, 2*n_r_q);
+
+    /* Generate all the L simple questions to be asked when generating
+     * simple trees */
+    for (i = 0, l = 0; i < n_pset; i++) {
+	if (pset[i].member) {
+	    /* Generate the phonetic questions */
+
+            if (strstr(pset[i].name,"_L") != NULL ||
+                (strstr(pset[i].name,"_L") == NULL &&
+                 strstr(pset[i].name,"_R") == NULL)){
+	        all_q[l].pset = i;
+	        all_q[l].member = pset[i].member;
+	        all_q[l].neg  = FALSE;
+	        all_q[l].ctxt = -1;    /* one phone to the left of base phone */
+	        l++;
+            }
+            if (strstr(pset[i].name,"_R") != NULL ||
+                (strstr(pset[i].name,"_L") == NULL &&
+                 strstr(pset[i].name,"_R") == NULL)){
+	        all_q[l].pset = i;
+	        all_q[l].member = pset[i].member;
+	        all_q[l].neg  = FALSE;
+	        all_q[l].ctxt = 1;    /* one phone to the right of base phone */
+	        l++;
+            }
+	    if (allphones
+		&& strstr(pset[i].name,"_R") == NULL
+		&& strstr(pset[i].name,"_L") == NULL) {
+		all_q[l].pset = i;
+		all_q[l].member = pset[i].member;
+		all_q[l].neg = FALSE;
+		all_q[l].ctxt = 0; /* the base phone itself */
+		l++;
+	    }
+
+	    /* The negations of the above questions */
+            if (strstr(pset[i].name,"_L") != NULL ||
+                (strstr(pset[i].name,"_L") == NULL &&
+                 strstr(pset[i].name,"_R") == NULL)){
+	        all_q[l].pset = i;
+	        all_q[l].member = pset[i].member;
+	        all_q[l].neg  = TRUE;
+	        all_q[l].ctxt = -1;
+	        l++;
+            }
+            if (strstr(pset[i].name,"_R") != NULL ||
+                (strstr(pset[i].name,"_L") == NULL &&
+                 strstr(pset[i].name,"_R") == NULL)){
+	        all_q[l].pset = i;
+	        all_q[l].member = pset[i].member;
+	        all_q[l].neg  = TRUE;
+	        all_q[l].ctxt = 1;
+	        l++;
+            }
+	    if (allphones
+		&& strstr(pset[i].name,"_R") == NULL
+		&& strstr(pset[i].name,"_L") == NULL) {
+		all_q[l].pset = i;
+		all_q[l].member = pset[i].member;
+		all_q[l].neg = TRUE;
+		all_q[l].ctxt = 0;
+		l++;
+	    }
+	}
+	else if (pset[i].posn) {
+	    /* Word position question */
+	    all_q[l].pset = i;
+	    all_q[l].posn = pset[i].posn;
+	    all_q[l].neg = FALSE;
+	    l++;
+
+	    /* Negation of the above question */
+	    all_q[l].pset = i;
+	    all_q[l].posn = pset[i].posn;
+	    all_q[l].neg = TRUE;
+	    l++;
+	}
+	else
+	  E_ERROR("Invalid phoneme set %s\n", pset[i].name);
+
+    }
+
+    return S3_SUCCESS;
+}
+
+/*
+ * Build the per-tree inputs to mk_tree_comp() for the triphones of
+ * one task out of the shared models.  Nothing in bm is modified, so
+ * several trees may be set up at once.
+ */
+static int
+init_tree(bt_model_t *bm, bt_task_t *task, bt_tree_t *tr)
+{
+    model_def_t *mdef = bm->mdef;
+    uint32 p_s = task->p_s, p_e = task->p_e;
+    uint32 n_stream = bm->n_stream;
+    uint32 n_density = bm->n_density;
+    uint32 n_state, n_model;
+    uint32 **dfeat;
+    acmod_id_t b, l, r;
+    word_posn_t pn;
+    float32 ****mixw;
+    float32 ****mixw_occ;
+    uint32 i, j, k, s, m, mm, kk, ll, n, nn;
+    float32 *stwt;
+    float32 *istwt;
+    const char **stwt_str;
+    float64 norm;
+    float64 dnom;
+    float32 mwfloor;
+    float64 wt_ent;
+    float64 s_wt_ent=0;
+    float32 ****mean;
+    float32 ****var;
+    float32 varfloor;
+    char      *cntflag;
+    float32   cntthreshold,stcnt;
+
+    E_INFO("Building trees for [%s]", acmod_set_id2name(mdef->acmod_set, p_s));
+    E_INFOCONT(" through [%s]\n", acmod_set_id2name(mdef->acmod_set, p_e));
+
+    n_state = mdef->defn[p_s].n_state - 1;
+    tr->n_state = n_state;
+
+    cntflag = (char *)ckd_calloc(p_e-p_s+1,sizeof(char));
+    cntthreshold = cmd_ln_float32("-cntthresh");
+
+    for (i=p_s,j=0,mm=0; i<=p_e ;i++,j++) {
         cntflag[j] = 1;
         for (k=0; k < n_state; k++) {
-            s = mdef->defn[i].state[k] - mixw_s;
+            s = mdef->defn[i].state[k] - bm->mixw_s;
             for (kk=0; kk<n_stream; kk++) {
                 stcnt = 0;
                 for (ll=0; ll<n_density; ll++) {
-                    stcnt += in_mixw[s][kk][ll];
+                    stcnt += bm->in_mixw[s][kk][ll];
                 }
                 if (stcnt < cntthreshold) cntflag[j] = 0;
             }
@@ -307,15 +510,15 @@ init(model_def_t **out_mdef,
     }
 
     n_model = mm;
-    *out_n_model = n_model;
+    tr->n_model = n_model;
     E_INFO("%d of %d models have observation count greater than %f\n",n_model,p_e-p_s+1,cntthreshold);
-        
 
-    /* Allocate the state weight array for weighting the 
+
+    /* Allocate the state weight array for weighting the
      * similarity of neighboring states */
     istwt = ckd_calloc(n_state, sizeof(float32));
     stwt = ckd_calloc(n_state, sizeof(float32));
-    *out_stwt = stwt;
+    tr->stwt = stwt;
     stwt_str = cmd_ln_str_list("-stwt");
     if (stwt_str == NULL) {
 	E_FATAL("Specify state weights using -stwt\n");
@@ -332,13 +535,13 @@ init(model_def_t **out_mdef,
     }
 
     /* Normalize the weights so they sum to 1.0 */
-    for (i = 0, norm = 0; i < n_state; i++) 
+    for (i = 0, norm = 0; i < n_state; i++)
 	norm += istwt[i];
     norm = 1.0 / norm;
     for (i = 0; i < n_state; i++)
 	istwt[i] *= norm;
 
-    mk_stwt(stwt, istwt, state, n_state);
+    mk_stwt(stwt, istwt, task->state, n_state);
     ckd_free((void *)istwt);
 
     /*
@@ -352,14 +555,14 @@ init(model_def_t **out_mdef,
     mixw_occ = (float32 ****)ckd_calloc_2d(n_model, n_state, sizeof(float32 **));
     mixw     = (float32 ****)ckd_calloc_4d(n_model, n_state, n_stream, n_density,
 					   sizeof(float32));
-    *out_mixw_occ = mixw_occ;
-    *out_mixw = mixw;
+    tr->mixw_occ = mixw_occ;
+    tr->mixw = mixw;
 
     for (i = p_s, j = 0, mm = 0; i <= p_e; i++, mm++) {
         if (cntflag[mm]==1) {
 	    for (k = 0; k < n_state; k++) {
-	        s = mdef->defn[i].state[k] - mixw_s;
-	        mixw_occ[j][k] = in_mixw[s];
+	        s = mdef->defn[i].state[k] - bm->mixw_s;
+	        mixw_occ[j][k] = bm->in_mixw[s];
 	    }
             j++;
 	}
@@ -368,23 +571,15 @@ init(model_def_t **out_mdef,
     assert(j == n_model);
     mwfloor = cmd_ln_float32("-mwfloor");
 
-    type = cmd_ln_str("-ts2cbfn");
-    if (strcmp(type,".semi.")!=0 && strcmp(type,".cont.") != 0)
-        E_FATAL("Type %s unsupported; trees can only be built on types .semi. or .cont.\n",type);
-    if (strcmp(type,".cont.") == 0) 
-        continuous = 1;
-    else 
-        continuous = 0;
-
 #if 0 /* This is rather arbitrary (in actual fact we should treat all models as continuous) */
    /* Additional check for meaningless input */
-    if (continuous == 0 && n_density < 256) {
+    if (bm->continuous == 0 && n_density < 256) {
         E_FATAL("Attempt to build trees on semi-continuous HMMs with %d < 256 gaussians!\n****A minimum of 256 gaussians are expected!\n",n_density);
     }
 #endif
 
     for (s = 0, wt_ent = 0; s < n_state; s++) {
-	if (continuous==0) s_wt_ent = 0;
+	if (bm->continuous==0) s_wt_ent = 0;
 	for (i = 0; i < n_model; i++) {
 	    for (j = 0; j < n_stream; j++) {
 		/* The denominators for each stream should be nearly
@@ -400,69 +595,36 @@ init(model_def_t **out_mdef,
 			    mixw[i][s][j][k] = mwfloor;
 			}
 		    }
-		    if (continuous == 0)
+		    if (bm->continuous == 0)
                         s_wt_ent += dnom * ent_d(mixw[i][s][j], n_density);
 		}
 	    }
 	}
-	if (continuous == 0) wt_ent += stwt[s] * s_wt_ent;
+	if (bm->continuous == 0) wt_ent += stwt[s] * s_wt_ent;
     }
 
-    if (continuous == 0) E_INFO("%u-class entropy: %e\n", n_model, wt_ent);
-
-    if (continuous == 1) {
-	int32 var_is_full = cmd_ln_int32("-fullvar");
-        /* Read Means and Variances; perform consistency checks */
-        if (s3gau_read(cmd_ln_str("-meanfn"),
-                       &fullmean,
-                       &l_nstates,
-                       &t_nfeat,
-                       &t_ndensity,
-                       &l_veclen) != S3_SUCCESS)
-            E_FATAL("Error reading mean file %s\n",cmd_ln_str("-meanfn"));
-        *out_veclen = l_veclen;
-        if (t_nfeat != n_stream && t_ndensity != n_density)
-            E_FATAL("Mismatch between Mean and Mixture weight files\n");
-
-	if (var_is_full) {
-	    if (s3gau_read_full(cmd_ln_str("-varfn"),
-				&fullvar_full,
-				&t_nstates,
-				&t_nfeat,
-				&t_ndensity,
-				&t_veclen) != S3_SUCCESS)
-		E_FATAL("Error reading var file %s\n",cmd_ln_str("-varfn"));
-	}
-        else {
-	    if (s3gau_read(cmd_ln_str("-varfn"),
-			   &fullvar,
-			   &t_nstates,
-			   &t_nfeat,
-			   &t_ndensity,
-			   &t_veclen) != S3_SUCCESS)
-		E_FATAL("Error reading var file %s\n",cmd_ln_str("-varfn"));
-	}
-        if (t_nfeat != n_stream && t_ndensity != n_density)
-            E_FATAL("Mismatch between Variance and Mixture weight files\n");
-        for (i=0;i<n_stream;i++)
-            if (t_veclen[i] != l_veclen[i])
-                E_FATAL("Feature length %d in var file != %d in mean file for feature %d\n",t_veclen[i],l_veclen[i],i);
-        if (l_nstates != t_nstates)
-            E_FATAL("Total no. of states %d in var file != %d in mean file\n",t_nstates,l_nstates);
+    if (bm->continuous == 0) E_INFO("%u-class entropy: %e\n", n_model, wt_ent);
 
-        if (t_ndensity > 1)
-            E_WARN("The state distributions given have %d gaussians per state;\n..*..shrinking them down to 1 gau per state..\n",t_ndensity);
+    tr->n_density = n_density;
+    tr->cnt = NULL;
+    if (bm->continuous == 1) {
+	uint32 *l_veclen = bm->veclen;
+	uint32 sumveclen = bm->sumveclen;
+	float32 ****cnt;
 
         /* Allocate for out_mean and out_var. If input are multi_gaussian
            distributions convert to single gaussians. Copy appropriate
            states to out_mean and out_var */
-        for (i=0,sumveclen=0; i < n_stream; i++) sumveclen += t_veclen[i];
         mean = (float32 ****)ckd_calloc_4d(n_model,n_state,n_stream,sumveclen,sizeof(float32));
 	/* Use only the diagonals regardless of whether -varfn is full. */
         var = (float32 ****)ckd_calloc_4d(n_model,n_state,n_stream,sumveclen,sizeof(float32));
+	/* From here on we need only have global counts for the mixws.
+	   These go in a private array rather than over the shared
+	   mixture weights, which other trees may still be reading. */
+        cnt = (float32 ****)ckd_calloc_4d(n_model,n_state,n_stream,1,sizeof(float32));
         varfloor = cmd_ln_float32("-varfloor");
- 
-        for (i = p_s, j = 0, m = mixw_s, mm = 0; i <= p_e; i++, mm++) {
+
+        for (i = p_s, j = 0, m = mdef->defn[p_s].state[0], mm = 0; i <= p_e; i++, mm++) {
             if (cntflag[mm]==1) {
                 for (k = 0; k < n_state; k++, m++) {
                     for (ll = 0; ll < n_stream; ll++) {
@@ -475,15 +637,15 @@ init(model_def_t **out_mdef,
                             float32 mw = mixw_occ[j][k][ll][n];
                             dnom += mw;
                             for (nn = 0; nn < l_veclen[ll]; nn++) {
-                                featmean[nn] += mw * fullmean[m][ll][n][nn];
-				if (var_is_full)
-				    featvar[nn] += 
-					mw *(fullmean[m][ll][n][nn]*fullmean[m][ll][n][nn] +
-					     fullvar_full[m][ll][n][nn][nn]);
+                                featmean[nn] += mw * bm->fullmean[m][ll][n][nn];
+				if (bm->var_is_full)
+				    featvar[nn] +=
+					mw *(bm->fullmean[m][ll][n][nn]*bm->fullmean[m][ll][n][nn] +
+					     bm->fullvar_full[m][ll][n][nn][nn]);
 				else
-				    featvar[nn] += 
-					mw *(fullmean[m][ll][n][nn]*fullmean[m][ll][n][nn] +
-					     fullvar[m][ll][n][nn]);
+				    featvar[nn] +=
+					mw *(bm->fullmean[m][ll][n][nn]*bm->fullmean[m][ll][n][nn] +
+					     bm->fullvar[m][ll][n][nn]);
                             }
                         }
                         if (dnom != 0) {
@@ -499,9 +661,7 @@ init(model_def_t **out_mdef,
                                     E_FATAL("dnom = 0, but featmean[nn] != 0, =  %f for ll = %d\n",featmean[nn],ll);
                             }
                         }
-                      /* Now on we need only have global counts for the mixws,
-                         so we store them all in mixw_occ[][][0] */
-                        mixw_occ[j][k][ll][0] = dnom;
+                        cnt[j][k][ll][0] = dnom;
                     }
                 }
                 j++;
@@ -511,15 +671,14 @@ init(model_def_t **out_mdef,
         assert(j == n_model);
 
         /* Now n_density = 1 */
-        n_density = 1;
-        *out_n_density = n_density;
-        *out_mean = mean;
-        *out_var = var;
-        ckd_free_4d((void ****)fullmean);
-	if (fullvar)
-	    ckd_free_4d((void ****)fullvar);
-	if (fullvar_full)
-	    gauden_free_param_full(fullvar_full);
+        tr->n_density = 1;
+        tr->cnt = cnt;
+        tr->mean = mean;
+        tr->var = var;
+    }
+    else {
+        tr->mean = NULL;
+        tr->var = NULL;
     }
 
 
@@ -528,11 +687,11 @@ init(model_def_t **out_mdef,
      * associated with each phone
      */
     dfeat = (uint32 **)ckd_calloc_2d(n_model, N_DFEAT, sizeof(uint32));
-    *out_dfeat = dfeat;
+    tr->dfeat = dfeat;
 
-    for (p = p_s, j = 0, mm = 0; p <= p_e; p++, mm++) {
+    for (i = p_s, j = 0, mm = 0; i <= p_e; i++, mm++) {
         if (cntflag[mm] == 1) {
-	    acmod_set_id2tri(mdef->acmod_set, &b, &l, &r, &pn, p);
+	    acmod_set_id2tri(mdef->acmod_set, &b, &l, &r, &pn, i);
 
 	    dfeat[j][0] = (uint32)l;
 	    dfeat[j][1] = (uint32)b;
@@ -544,224 +703,321 @@ init(model_def_t **out_mdef,
     assert(j == n_model);
     ckd_free(cntflag);
 
-    psetfn = cmd_ln_str("-psetfn");
-
-    E_INFO("Reading: %s\n", psetfn);
-    *out_pset = pset = read_pset_file(psetfn, mdef->acmod_set, &n_pset);
-    *out_n_pset = n_pset;
-
-    /* Determine the # of phone sets and word boundary
-     * questions there are */
-
-    n_l_q = n_r_q = 0;
-    for (i = 0, n_phone_q = 0, n_wdbndry = 0; i < n_pset; i++) {
-	if (pset[i].member){
-            if (strstr(pset[i].name,"_L") != NULL) {
-                n_phone_q++;
-                n_l_q++;
-            }
-            else if (strstr(pset[i].name,"_R") != NULL) {
-                n_phone_q++;
-                n_r_q++;
-            }
-            else if (allphones)
-	      n_phone_q += 3;
-	    else
-	      n_phone_q += 2;
-        }
-	else
-	    n_wdbndry++;
-    }
-
-    /* Compute the total number of simple questions */
-    if (allphones) /* Ask questions about the phone itself */
-	n_all_q = 2 * n_phone_q + 2 * n_wdbndry;
-    else
-	n_all_q = 2 * n_phone_q + 2 * n_wdbndry;
-    *out_n_all_q = n_all_q;
-
-    /* Allocate an array to hold all the simple questions */
-    all_q = ckd_calloc(n_all_q, sizeof(quest_t));
-    *out_all_q = all_q;
-
-    E_INFO("%u total simple questions (%u phone; %u word bndry)\n",
-	   n_all_q, 2 * n_phone_q, 2 * n_wdbndry);
-    E_INFO("%u Left Only questions, and %u Right Only questions\n",
-           2*n_l_q, 2*n_r_q);
-
-    /* Generate all the L simple questions to be asked when generating
-     * simple trees */
-    for (i = 0, l = 0; i < n_pset; i++) {
-	if (pset[i].member) {
-	    /* Generate the phonetic questions */
-
-            if (strstr(pset[i].name,"_L") != NULL ||
-                (strstr(pset[i].name,"_L") == NULL && 
-                 strstr(pset[i].name,"_R") == NULL)){
-	        all_q[l].pset = i;
-	        all_q[l].member = pset[i].member;
-	        all_q[l].neg  = FALSE;
-	        all_q[l].ctxt = -1;    /* one phone to the left of base phone */
-	        l++;
-            }
-            if (strstr(pset[i].name,"_R") != NULL ||
-                (strstr(pset[i].name,"_L") == NULL && 
-                 strstr(pset[i].name,"_R") == NULL)){
-	        all_q[l].pset = i;
-	        all_q[l].member = pset[i].member;
-	        all_q[l].neg  = FALSE;
-	        all_q[l].ctxt = 1;    /* one phone to the right of base phone */
-	        l++;
-            }
-	    if (allphones
-		&& strstr(pset[i].name,"_R") == NULL
-		&& strstr(pset[i].name,"_L") == NULL) {
-		all_q[l].pset = i;
-		all_q[l].member = pset[i].member;
-		all_q[l].neg = FALSE;
-		all_q[l].ctxt = 0; /* the base phone itself */
-		l++;
-	    }
-
-	    /* The negations of the above questions */
-            if (strstr(pset[i].name,"_L") != NULL ||
-                (strstr(pset[i].name,"_L") == NULL && 
-                 strstr(pset[i].name,"_R") == NULL)){
-	        all_q[l].pset = i;
-	        all_q[l].member = pset[i].member;
-	        all_q[l].neg  = TRUE;
-	        all_q[l].ctxt = -1;
-	        l++;
-            }
-            if (strstr(pset[i].name,"_R") != NULL ||
-                (strstr(pset[i].name,"_L") == NULL && 
-                 strstr(pset[i].name,"_R") == NULL)){
-	        all_q[l].pset = i;
-	        all_q[l].member = pset[i].member;
-	        all_q[l].neg  = TRUE;
-	        all_q[l].ctxt = 1;
-	        l++;
-            }
-	    if (allphones
-		&& strstr(pset[i].name,"_R") == NULL
-		&& strstr(pset[i].name,"_L") == NULL) {
-		all_q[l].pset = i;
-		all_q[l].member = pset[i].member;
-		all_q[l].neg = TRUE;
-		all_q[l].ctxt = 0;
-		l++;
-	    }
-	}
-	else if (pset[i].posn) {
-	    /* Word position question */
-	    all_q[l].pset = i;
-	    all_q[l].posn = pset[i].posn;
-	    all_q[l].neg = FALSE;
-	    l++;
-
-	    /* Negation of the above question */
-	    all_q[l].pset = i;
-	    all_q[l].posn = pset[i].posn;
-	    all_q[l].neg = TRUE;
-	    l++;
-	}
-	else
-	  E_ERROR("Invalid phoneme set %s\n", pset[i].name);
-
-    }
-
     return S3_SUCCESS;
 }
-
 
+static void
+free_tree_inputs(bt_tree_t *tr)
+{
+    ckd_free_2d((void **)tr->mixw_occ);
+    ckd_free_4d((void ****)tr->mixw);
+    if (tr->cnt)
+	ckd_free_4d((void ****)tr->cnt);
+    if (tr->mean)
+	ckd_free_4d((void ****)tr->mean);
+    if (tr->var)
+	ckd_free_4d((void ****)tr->var);
+    ckd_free_2d((void **)tr->dfeat);
+    ckd_free(tr->stwt);
+}
 
-int main(int argc, char *argv[])
+static int
+build_tree(bt_model_t *bm, bt_task_t *task)
 {
-    float32 ****mixw_occ = NULL;
-    float32 ****mixw = NULL;
-    float32 ****means = NULL;
-    float32 ****vars = NULL;
-    uint32  *veclen = NULL;
-    uint32 mixw_s;
-    uint32 n_model = 0;
-    uint32 n_state = 0;
-    uint32 n_stream = 0;
-    uint32 n_density = 0;
-    model_def_t *mdef = NULL;
-    const char *phn;
-    pset_t *pset = NULL;
-    uint32 n_pset;
-    uint32 **dfeat = NULL;
-    quest_t *all_q = NULL;
-    uint32 n_all_q = 0;
-    uint32 m;
+    bt_tree_t tr;
     uint32 *id;
-    float32 *stwt = NULL;
-    uint32 state;
-    dtree_t *tr;
+    uint32 m;
+    dtree_t *dt;
     FILE *fp;
-    float32 mwfloor;
-
-    parse_cmd_ln(argc, argv);
-
-    phn = cmd_ln_str("-phone");
-
-    state = cmd_ln_int32("-state");
-
-    if (init(&mdef,
-	     phn,
-	     state,
-	     &mixw_s,
-	     &mixw,
-	     &mixw_occ,
-             &means,
-             &vars,
-             &veclen,
-	     &n_model,
-	     &n_state,
-	     &n_stream,
-	     &n_density,
-	     &stwt,
-	     &dfeat,
-	     &pset,
-	     &n_pset,
-	     &all_q,
-	     &n_all_q) != S3_SUCCESS) {
-	E_FATAL("Initialization failed\n");
-    }
 
-    mwfloor = cmd_ln_float32("-mwfloor");
+    if (init_tree(bm, task, &tr) != S3_SUCCESS)
+	return S3_ERROR;
 
-    id = (uint32 *)ckd_calloc(n_model, sizeof(uint32));
+    id = (uint32 *)ckd_calloc(tr.n_model, sizeof(uint32));
 
     /* Initially, all states in the same class */
-    for (m = 0; m < n_model; m++) {
+    for (m = 0; m < tr.n_model; m++) {
 	id[m] = m;
     }
 
     /* Build the composite tree.  Recursively generates
     * the composite decision tree.  See dtree.c in libcommon */
-    tr = mk_tree_comp(mixw_occ, means, vars, veclen, n_model, n_state, 
-                      n_stream, n_density, stwt,
-		      id, n_model,
-		      all_q, n_all_q, pset, acmod_set_n_ci(mdef->acmod_set),
-		      dfeat, N_DFEAT,
+    dt = mk_tree_comp(tr.cnt ? tr.cnt : tr.mixw_occ, tr.mean, tr.var,
+		      bm->veclen, tr.n_model, tr.n_state,
+                      bm->n_stream, tr.n_density, tr.stwt,
+		      id, tr.n_model,
+		      bm->all_q, bm->n_all_q, bm->pset,
+		      acmod_set_n_ci(bm->mdef->acmod_set),
+		      tr.dfeat, N_DFEAT,
 		      cmd_ln_int32("-ssplitmin"),
 		      cmd_ln_int32("-ssplitmax"),
 		      cmd_ln_float32("-ssplitthr"),
 		      cmd_ln_int32("-csplitmin"),
 		      cmd_ln_int32("-csplitmax"),
 		      cmd_ln_float32("-csplitthr"),
-		      mwfloor);
+		      cmd_ln_float32("-mwfloor"));
 
     /* Save it to a file */
-    fp = fopen(cmd_ln_str("-treefn"), "w");
+    fp = fopen(task->treefn, "w");
     if (fp == NULL) {
 	E_FATAL_SYSTEM("Unable to open %s for writing",
-		       cmd_ln_str("-treefn"));
+		       task->treefn);
     }
-    print_final_tree(fp, &tr->node[0], pset);
+    print_final_tree(fp, &dt->node[0], bm->pset);
     fclose(fp);
+    E_INFO("Wrote %s\n", task->treefn);
+
+    ckd_free(id);
+    free_tree(dt);
+    free_tree_inputs(&tr);
+
+    return S3_SUCCESS;
+}
+
+/* Shared queue of trees still to be built */
+typedef struct bt_queue_s {
+    bt_model_t *bm;
+    bt_task_t *task;
+    uint32 n_task;
+    uint32 next;
+    sbmtx_t *mtx;
+    int err;
+} bt_queue_t;
+
+static int
+run_queue(bt_queue_t *q)
+{
+    bt_task_t *task;
+
+    for (;;) {
+	sbmtx_lock(q->mtx);
+	task = (q->next < q->n_task) ? &q->task[q->next++] : NULL;
+	sbmtx_unlock(q->mtx);
+	if (task == NULL)
+	    break;
+
+	if (build_tree(q->bm, task) != S3_SUCCESS) {
+	    E_ERROR("Failed to build %s\n", task->treefn);
+	    sbmtx_lock(q->mtx);
+	    q->err = 1;
+	    sbmtx_unlock(q->mtx);
+	}
+    }
 
     return 0;
 }
+
+static int
+build_worker(sbthread_t *th)
+{
+    return run_queue((bt_queue_t *)sbthread_arg(th));
+}
+
+static int
+cmp_task(const void *a, const void *b)
+{
+    const bt_task_t *ta = a, *tb = b;
+    uint32 na = ta->p_e - ta->p_s, nb = tb->p_e - tb->p_s;
+
+    /* Most triphones first, otherwise keep the order requested */
+    if (na != nb)
+	return (na > nb) ? -1 : 1;
+    return (ta->order < tb->order) ? -1 : (ta->order > tb->order);
+}
+
+/*
+ * Add one task per state of the n-phones of phn to the task list.
+ * Returns the number of tasks added.
+ */
+static uint32
+add_phone_tasks(model_def_t *mdef, const char *phn, const char *treedir,
+		bt_task_t **inout_task, uint32 *inout_n_task, uint32 *inout_n_alloc)
+{
+    uint32 p_s, p_e, n_state, s;
+    bt_task_t *task;
+
+    if (cmd_ln_int32("-allphones")) {
+	p_s = acmod_set_n_ci(mdef->acmod_set);
+	p_e = acmod_set_n_acmod(mdef->acmod_set)-1;
+    }
+    else if (find_triphones(mdef, phn, &p_s, &p_e) == -1)
+	return 0;
+
+    if (check_triphones(mdef, phn, p_s, p_e) != S3_SUCCESS)
+	E_FATAL("Initialization failed\n");
+
+    n_state = mdef->defn[p_s].n_state - 1;
+    for (s = 0; s < n_state; s++) {
+	if (*inout_n_task == *inout_n_alloc) {
+	    *inout_n_alloc = *inout_n_alloc ? 2 * *inout_n_alloc : 64;
+	    *inout_task = ckd_realloc(*inout_task,
+				      *inout_n_alloc * sizeof(**inout_task));
+	}
+	task = &(*inout_task)[*inout_n_task];
+	task->p_s = p_s;
+	task->p_e = p_e;
+	task->state = s;
+	task->order = *inout_n_task;
+	task->treefn = ckd_calloc(strlen(treedir) + strlen(phn) + 32, 1);
+	sprintf(task->treefn, "%s/%s-%u.dtree", treedir, phn, s);
+	++*inout_n_task;
+    }
+
+    return n_state;
+}
+
+/*
+ * Collect the trees requested by -treedir mode: every state of
+ * ALLPHONES, of -phone, or of each base phone listed in -phonelstfn
+ * (all context-independent phones by default).  As in 40.buildtrees,
+ * filler phones and SIL are skipped.
+ */
+static bt_task_t *
+mk_tree_tasks(model_def_t *mdef, const char *treedir, uint32 *out_n_task)
+{
+    bt_task_t *task = NULL;
+    uint32 n_task = 0, n_alloc = 0;
+    const char *phn = cmd_ln_str("-phone");
+    const char *phonelstfn = cmd_ln_str("-phonelstfn");
+    uint32 p;
+
+    if (cmd_ln_int32("-allphones"))
+	add_phone_tasks(mdef, "ALLPHONES", treedir, &task, &n_task, &n_alloc);
+    else if (phn)
+	add_phone_tasks(mdef, phn, treedir, &task, &n_task, &n_alloc);
+    else if (phonelstfn) {
+	lineiter_t *li;
+	FILE *fp;
+
+	if ((fp = fopen(phonelstfn, "r")) == NULL)
+	    E_FATAL_SYSTEM("Failed to open phone list %s", phonelstfn);
+	for (li = lineiter_start_clean(fp); li; li = lineiter_next(li)) {
+	    size_t len = strlen(li->buf);
+
+	    if ((li->buf[0] == '+' && len > 1 && li->buf[len-1] == '+')
+		|| strcmp(li->buf, "SIL") == 0) {
+		E_INFO("Skipping %s\n", li->buf);
+		continue;
+	    }
+	    if (add_phone_tasks(mdef, li->buf, treedir,
+				&task, &n_task, &n_alloc) == 0)
+		E_WARN("No trees built for %s\n", li->buf);
+	}
+	fclose(fp);
+    }
+    else {
+	for (p = 0; p < acmod_set_n_ci(mdef->acmod_set); p++) {
+	    const char *name = acmod_set_id2name(mdef->acmod_set, p);
+	    size_t len = strlen(name);
+
+	    if ((name[0] == '+' && len > 1 && name[len-1] == '+')
+		|| strcmp(name, "SIL") == 0)
+		continue;
+	    add_phone_tasks(mdef, name, treedir, &task, &n_task, &n_alloc);
+	}
+    }
+
+    *out_n_task = n_task;
+    return task;
+}
+
+int main(int argc, char *argv[])
+{
+    bt_model_t bm;
+    bt_task_t *task;
+    bt_queue_t q;
+    sbthread_t **thread;
+    uint32 n_task, n_thread, t, p_s, p_e;
+    const char *moddeffn;
+    const char *treedir;
+
+    parse_cmd_ln(argc, argv);
+
+    memset(&bm, 0, sizeof(bm));
+    moddeffn = cmd_ln_str("-moddeffn");
+    if (moddeffn == NULL)
+	E_FATAL("Specify -moddeffn\n");
+
+    E_INFO("Reading: %s\n", moddeffn);
+    if (model_def_read(&bm.mdef, moddeffn) != S3_SUCCESS)
+	E_FATAL("Initialization failed\n");
+
+    treedir = cmd_ln_str("-treedir");
+    if (treedir) {
+	if (build_directory(treedir) < 0)
+	    E_FATAL_SYSTEM("Failed to create %s", treedir);
+	task = mk_tree_tasks(bm.mdef, treedir, &n_task);
+	if (n_task == 0)
+	    E_FATAL("No trees to build\n");
+    }
+    else {
+	const char *phn = cmd_ln_str("-phone");
+
+	if (cmd_ln_str("-treefn") == NULL)
+	    E_FATAL("Specify -treefn or -treedir\n");
+	if (!cmd_ln_int32("-allphones") && phn == NULL)
+	    E_FATAL("No -phone, -start_phone, or -end_phone specified!\n");
+
+	n_task = 1;
+	task = ckd_calloc(1, sizeof(*task));
+	if (cmd_ln_int32("-allphones")) {
+	    task->p_s = acmod_set_n_ci(bm.mdef->acmod_set);
+	    task->p_e = acmod_set_n_acmod(bm.mdef->acmod_set)-1;
+	}
+	else if (find_triphones(bm.mdef, phn, &task->p_s, &task->p_e) == -1)
+	    E_FATAL("Initialization failed\n");
+	if (check_triphones(bm.mdef, phn ? phn : "ALLPHONES",
+			    task->p_s, task->p_e) != S3_SUCCESS)
+	    E_FATAL("Initialization failed\n");
+	task->state = cmd_ln_int32("-state");
+	task->treefn = ckd_salloc(cmd_ln_str("-treefn"));
+    }
+
+    /* Read the models once for the union of all the triphones */
+    for (t = 0, p_s = task[0].p_s, p_e = task[0].p_e; t < n_task; t++) {
+	if (task[t].p_s < p_s)
+	    p_s = task[t].p_s;
+	if (task[t].p_e > p_e)
+	    p_e = task[t].p_e;
+    }
+    if (load_models(&bm, p_s, p_e) != S3_SUCCESS)
+	E_FATAL("Initialization failed\n");
+
+    /* Tree building time grows with the number of triphones, so
+     * start the biggest trees first to keep the tail of the run
+     * short. */
+    qsort(task, n_task, sizeof(*task), cmp_task);
+
+    n_thread = cmd_ln_int32("-nthreads");
+    if (n_thread > n_task)
+	n_thread = n_task;
+    if (n_thread < 1)
+	n_thread = 1;
+    if (n_thread > 1) {
+	/* Threads are spent on whole trees, so questions at each
+	 * node are evaluated serially (see best_q()). */
+	cmd_ln_set_int32("-nthreads", 1);
+	E_INFO("Building %u trees with %u threads\n", n_task, n_thread);
+    }
+
+    memset(&q, 0, sizeof(q));
+    q.bm = &bm;
+    q.task = task;
+    q.n_task = n_task;
+    q.mtx = sbmtx_init();
+
+    thread = ckd_calloc(n_thread, sizeof(*thread));
+    for (t = 1; t < n_thread; t++)
+	thread[t] = sbthread_start(build_worker, &q);
+    run_queue(&q);
+    for (t = 1; t < n_thread; t++)
+	sbthread_free(thread[t]);
+    ckd_free(thread);
+    sbmtx_free(q.mtx);
+
+    for (t = 0; t < n_task; t++)
+	ckd_free(task[t].treefn);
+    ckd_free(task);
+
+    return q.err;
+}
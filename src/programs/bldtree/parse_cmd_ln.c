@@ -88,6 +88,11 @@ var -psetfn questions -stwt 1.0 0.05 0.01 -state 0 -ssplitmin 1 \n\
 	  NULL,
 	  "Name of output tree file to produce" },
 
+	{ "-treedir",
+	  ARG_STRING,
+	  NULL,
+	  "Build the trees for every state of every requested phone, writing <phone>-<state>.dtree files in this directory" },
+
 	{ "-moddeffn",
 	  ARG_STRING,
 	  NULL,
@@ -143,6 +148,11 @@ var -psetfn questions -stwt 1.0 0.05 0.01 -state 0 -ssplitmin 1 \n\
 	  "no",
 	  "Build trees over all n-phones"},
 
+	{ "-phonelstfn",
+	  ARG_STRING,
+	  NULL,
+	  "With -treedir, build trees for the base phones listed in this file (default: all phones)"},
+
 	{ "-state",
 	  ARG_INT32,
 	  NULL,
@@ -188,6 +198,11 @@ var -psetfn questions -stwt 1.0 0.05 0.01 -state 0 -ssplitmin 1 \n\
 	  "100",
 	  "Minimum # of compound tree splits to do" },
 
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads.  With -treedir, trees are built concurrently; otherwise candidate questions at each node are evaluated concurrently" },
+
 	{NULL, 0, NULL, NULL}
     };
 
@@ -73,6 +73,7 @@
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/profile.h>
 #include <sphinxbase/feat.h>
+#include <sphinxbase/sbthread.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -173,7 +174,8 @@ main_initialize(int argc,
 		model_inventory_t **out_inv,
 		lexicon_t **out_lex,
 		model_def_t **out_mdef,
-		feat_t **out_feat)
+		feat_t **out_feat,
+		utt_states_cache_t **out_cache)
 {
     model_inventory_t *inv;	/* the model inventory */
     lexicon_t *lex;		/* the lexicon to be returned to the caller */
@@ -444,6 +446,13 @@ main_initialize(int argc,
 
     *out_lex = lex;
 
+    *out_cache = NULL;
+    if (cmd_ln_str("-uttstatecache") && !cmd_ln_int32("-mmie")) {
+	*out_cache = utt_states_cache_open(cmd_ln_str("-uttstatecache"),
+					   inv, mdef, mdeffn,
+					   cmd_ln_str("-dictfn"), fdictfn,
+					   cmd_ln_int32("-multipron"));
+    }
 
     /*
      * Configure corpus module (controls sequencing/access of per utterance data)
@@ -590,7 +599,8 @@ main_reestimate(model_inventory_t *inv,
 		lexicon_t *lex,
 		model_def_t *mdef,
 		feat_t *feat,
-		int32 viterbi)
+		int32 viterbi,
+		utt_states_cache_t *cache)
 {
     vector_t *mfcc;	/* utterance cepstra */	
     int32 n_frame;	/* # of cepstrum frames  */
@@ -798,7 +808,10 @@ main_reestimate(model_inventory_t *inv,
         if (timers)
 	    ptmr_start(&timers->upd_timer);
 	/* create a sentence HMM */
-	if (multipron_on) {
+	if (cache) {
+	    state_seq = next_utt_states_cached(&n_state, cache,
+					       lex, inv, mdef, trans);
+	} else if (multipron_on) {
 	    state_seq = next_utt_states_graph(&n_state, lex, inv, mdef, trans);
 	} else {
 	    state_seq = next_utt_states(&n_state, lex, inv, mdef, trans);
@@ -864,8 +877,9 @@ main_reestimate(model_inventory_t *inv,
 	    ptmr_stop(&timers->upd_timer);
 
 	/* Free only in the multipron case so we don't double-free the
-	 * linear path's static buffer. */
-	if (multipron_on && state_seq != NULL) {
+	 * linear path's static buffer.  Cached sequences belong to the
+	 * cache. */
+	if (multipron_on && !cache && state_seq != NULL) {
 	    state_seq_free(state_seq, n_state);
 	    state_seq = NULL;
 	}
@@ -1106,7 +1120,8 @@ mmi_rand_train(model_inventory_t *inv,
 	       float64 a_beam,
 	       uint32 mean_reest,
 	       uint32 var_reest,
-	       feat_t *fcb)
+	       feat_t *fcb,
+	       const char *uttid)
 {
   uint32 k, n;
   uint32 n_rand;/* random number */
@@ -1121,8 +1136,6 @@ mmi_rand_train(model_inventory_t *inv,
   float64 log_lik;/* log-likelihood of an arc */
   
   /* viterbi run on each arc */
-  printf(" %5u", lat->n_arcs);
-  
   for(n=0; n<lat->n_arcs; n++) {
 
     /* total observations of this arc */
@@ -1178,16 +1191,19 @@ mmi_rand_train(model_inventory_t *inv,
       state_seq = next_utt_states_mmie(&n_state, lex, inv, mdef, cword, lphone, rphone);
 
       /* viterbi compuation to get the acoustic score for a word hypothesis */
-      if (mmi_viterbi_run(&log_lik,
-			  arc_f, n_word_obs,
-			  state_seq, n_state,
-			  inv,
-			  a_beam) == S3_SUCCESS) {
+      if (state_seq != NULL
+	  && mmi_viterbi_run(&log_lik,
+			     arc_f, n_word_obs,
+			     state_seq, n_state,
+			     inv,
+			     a_beam, uttid) == S3_SUCCESS) {
 	lat->arc[n].good_arc = 1;
 	lat->arc[n].ac_score = log_lik;
 	lat->arc[n].best_prev_arc = rand_prev_id;
 	lat->arc[n].best_next_arc = rand_next_id;
       }
+      if (state_seq)
+	state_seq_free(state_seq, n_state);
 
       n_max_run--;
       ckd_free(lphone);
@@ -1237,16 +1253,20 @@ mmi_rand_train(model_inventory_t *inv,
       state_seq = next_utt_states_mmie(&n_state, lex, inv, mdef, cword, lphone, rphone);
       
       /* viterbi update model parameters */
-      if (mmi_viterbi_update(arc_f, n_word_obs,
-			     state_seq, n_state,
-			     inv,
-			     a_beam,
-			     mean_reest,
-			     var_reest,
-			     lat->arc[n].gamma,
-			     fcb) != S3_SUCCESS) {
+      if (state_seq == NULL
+	  || mmi_viterbi_update(arc_f, n_word_obs,
+				state_seq, n_state,
+				inv,
+				a_beam,
+				mean_reest,
+				var_reest,
+				lat->arc[n].gamma,
+				fcb,
+				uttid) != S3_SUCCESS) {
 	E_ERROR("arc_%d is ignored (viterbi update failed)\n", n+1);
       }
+      if (state_seq)
+	state_seq_free(state_seq, n_state);
       ckd_free(arc_f);
       ckd_free(lphone);
       ckd_free(rphone);
@@ -1266,7 +1286,8 @@ mmi_best_train(model_inventory_t *inv,
 	       float64 a_beam,
 	       uint32 mean_reest,
 	       uint32 var_reest,
-	       feat_t *fcb)
+	       feat_t *fcb,
+	       const char *uttid)
 {
   uint32 i, j, k, n;
   char pword[128], cword[128], nword[128];      /* previous, current and next word hypothesis */
@@ -1280,8 +1301,6 @@ mmi_best_train(model_inventory_t *inv,
   float64 log_lik;/* log-likelihood of an arc */
   
   /* viterbi run on each arc */
-  printf(" %5u", lat->n_arcs);
-  
   for(n=0; n<lat->n_arcs; n++) {
     
     /* total observations of this arc */
@@ -1339,11 +1358,12 @@ mmi_best_train(model_inventory_t *inv,
 	    state_seq = next_utt_states_mmie(&n_state, lex, inv, mdef, cword, lphone, rphone);
 	        
 	    /* viterbi compuation to get the acoustic score for a word hypothesis */
-	    if (mmi_viterbi_run(&log_lik,
-				arc_f, n_word_obs,
-				state_seq, n_state,
-				inv,
-				a_beam) == S3_SUCCESS) {
+	    if (state_seq != NULL
+		&& mmi_viterbi_run(&log_lik,
+				   arc_f, n_word_obs,
+				   state_seq, n_state,
+				   inv,
+				   a_beam, uttid) == S3_SUCCESS) {
 	      if (lat->arc[n].good_arc == 0) {
 		lat->arc[n].good_arc = 1;
 		lat->arc[n].ac_score = log_lik;
@@ -1356,6 +1376,8 @@ mmi_best_train(model_inventory_t *inv,
 		lat->arc[n].best_next_arc = lat->arc[n].next_arcs[j];
 	      }
 	    }
+	    if (state_seq)
+	      state_seq_free(state_seq, n_state);
 	    /* save the current right context */
 	    prev_rphone = *rphone;
 	  }
@@ -1410,16 +1432,20 @@ mmi_best_train(model_inventory_t *inv,
       state_seq = next_utt_states_mmie(&n_state, lex, inv, mdef, cword, lphone, rphone);
       
       /* viterbi update model parameters */
-      if (mmi_viterbi_update(arc_f, n_word_obs,
-			     state_seq, n_state,
-			     inv,
-			     a_beam,
-			     mean_reest,
-			     var_reest,
-			     lat->arc[n].gamma,
-			     fcb) != S3_SUCCESS) {
+      if (state_seq == NULL
+	  || mmi_viterbi_update(arc_f, n_word_obs,
+				state_seq, n_state,
+				inv,
+				a_beam,
+				mean_reest,
+				var_reest,
+				lat->arc[n].gamma,
+				fcb,
+				uttid) != S3_SUCCESS) {
 	E_ERROR("arc_%d is ignored (viterbi update failed)\n", n+1);
       }
+      if (state_seq)
+	state_seq_free(state_seq, n_state);
       ckd_free(arc_f);
       ckd_free(lphone);
       ckd_free(rphone);
@@ -1439,7 +1465,8 @@ mmi_ci_train(model_inventory_t *inv,
 	     float64 a_beam,
 	     uint32 mean_reest,
 	     uint32 var_reest,
-	     feat_t *fcb)
+	     feat_t *fcb,
+	     const char *uttid)
 {
   uint32 k, n;
   vector_t **arc_f = NULL;/* feature vector for a word arc */
@@ -1449,8 +1476,6 @@ mmi_ci_train(model_inventory_t *inv,
   float64 log_lik;/* log-likelihood of an arc */
   
   /* viterbi run on each arc */
-  printf(" %5u", lat->n_arcs);
-
   for(n=0; n<lat->n_arcs; n++) {
     
     /* total observations of this arc */
@@ -1463,17 +1488,21 @@ mmi_ci_train(model_inventory_t *inv,
       arc_f[k] = f[k+lat->arc[n].sf-1];
     
     /* make state list */
-    state_seq = next_utt_states(&n_state, lex, inv, mdef, lat->arc[n].word);
+    state_seq = next_utt_states_mmie(&n_state, lex, inv, mdef,
+				     lat->arc[n].word, NULL, NULL);
     
     /* viterbi compuation to get the acoustic score for a word hypothesis */
-    if (mmi_viterbi_run(&log_lik,
-			arc_f, n_word_obs,
-			state_seq, n_state,
-			inv,
-			a_beam) == S3_SUCCESS) {
+    if (state_seq != NULL
+	&& mmi_viterbi_run(&log_lik,
+			   arc_f, n_word_obs,
+			   state_seq, n_state,
+			   inv,
+			   a_beam, uttid) == S3_SUCCESS) {
       lat->arc[n].good_arc = 1;
       lat->arc[n].ac_score = log_lik;
     }
+    if (state_seq)
+      state_seq_free(state_seq, n_state);
     
     ckd_free(arc_f);
     
@@ -1498,19 +1527,24 @@ mmi_ci_train(model_inventory_t *inv,
 	arc_f[k] = f[k+lat->arc[n].sf-1];
       
       /* make state list */
-      state_seq = next_utt_states(&n_state, lex, inv, mdef, lat->arc[n].word);
+      state_seq = next_utt_states_mmie(&n_state, lex, inv, mdef,
+				       lat->arc[n].word, NULL, NULL);
       
       /* viterbi update model parameters */
-      if (mmi_viterbi_update(arc_f, n_word_obs,
-			     state_seq, n_state,
-			     inv,
-			     a_beam,
-			     mean_reest,
-			     var_reest,
-			     lat->arc[n].gamma,
-			     fcb) != S3_SUCCESS) {
+      if (state_seq == NULL
+	  || mmi_viterbi_update(arc_f, n_word_obs,
+				state_seq, n_state,
+				inv,
+				a_beam,
+				mean_reest,
+				var_reest,
+				lat->arc[n].gamma,
+				fcb,
+				uttid) != S3_SUCCESS) {
 	E_ERROR("arc_%d is ignored (viterbi update failed)\n", n+1);
       }
+      if (state_seq)
+	state_seq_free(state_seq, n_state);
       
       ckd_free(arc_f);
     }
@@ -1519,6 +1553,254 @@ mmi_ci_train(model_inventory_t *inv,
   return S3_SUCCESS;
 }
 
+/* State shared by the MMIE training threads.  Utterances, their
+ * features and lattices are read one at a time under the lock;
+ * training on the lattice is done outside it. */
+typedef struct mmi_ctx_s {
+  lexicon_t *lex;
+  model_def_t *mdef;
+  feat_t *feat;
+  const char *lat_dir;
+  const char *lat_ext;
+  uint32 n_mmi_type;
+  float64 a_beam;
+  uint32 mean_reest;
+  uint32 var_reest;
+  uint32 in_veclen;
+  uint32 maxuttlen;
+  sbmtx_t *mtx;
+  uint32 seq_no;                /* sequence # of the next utterance */
+  int done;                     /* corpus_next_utt() has returned FALSE */
+  uint32 n_utt;
+  uint32 n_utt_fail;            /* number of sentences failed */
+  uint32 n_frame_skipped;
+  float64 total_log_postprob;   /* total posterior probability of the correct hypotheses */
+} mmi_ctx_t;
+
+/* Each thread keeps its own tallies; they are added up in thread
+ * order once all threads are done, so the sums do not depend on the
+ * order in which the threads finish. */
+typedef struct mmi_job_s {
+  mmi_ctx_t *ctx;
+  model_inventory_t *inv;       /* local maps and accumulators of this thread */
+  uint32 n_utt_fail;
+  float64 total_log_postprob;
+} mmi_job_t;
+
+/* One utterance handed to a training thread */
+typedef struct mmi_utt_s {
+  uint32 seq_no;
+  char *uttid;
+  uint32 n_frame;               /* # of cepstrum frames */
+  uint32 n_frame_del;           /* # of frames added or removed by feature computation */
+  vector_t **f;                 /* independent feature streams derived from cepstra */
+  s3lattice_t *lat;             /* input lattice, or NULL if it could not be read */
+} mmi_utt_t;
+
+/* Fetch the next utterance; returns FALSE at the end of the corpus */
+static int
+mmi_next_utt(mmi_ctx_t *ctx, mmi_utt_t *utt)
+{
+  vector_t *mfcc;
+  int32 n_frame;
+  uint32 svd_n_frame;
+  char *trans;
+  int more;
+
+  sbmtx_lock(ctx->mtx);
+  more = FALSE;
+  while (!ctx->done) {
+    /* The corpus must not be asked again once it has run out */
+    if (!(more = corpus_next_utt())) {
+      ctx->done = TRUE;
+      break;
+    }
+    if (corpus_get_generic_featurevec(&mfcc, &n_frame, ctx->in_veclen) < 0) {
+      E_FATAL("Can't read input features\n");
+    }
+
+    if (n_frame < 9) {
+      E_WARN("utt %s too short\n", corpus_utt());
+      if (mfcc) {
+	ckd_free(mfcc[0]);
+	ckd_free(mfcc);
+      }
+      continue;
+    }
+
+    if ((ctx->maxuttlen > 0) && (n_frame > ctx->maxuttlen)) {
+      E_INFO("utt # frames > -maxuttlen; skipping\n");
+      ctx->n_frame_skipped += n_frame;
+      if (mfcc) {
+	ckd_free(mfcc[0]);
+	ckd_free(mfcc);
+      }
+      continue;
+    }
+
+    svd_n_frame = n_frame;
+
+    utt->f = feat_array_alloc(ctx->feat, n_frame + feat_window_size(ctx->feat));
+    feat_s2mfc2feat_live(ctx->feat, mfcc, &n_frame, TRUE, TRUE, utt->f);
+    utt->n_frame = svd_n_frame;
+    utt->n_frame_del = n_frame - svd_n_frame;
+
+    /* Get the transcript */
+    corpus_get_sent(&trans);
+    free(trans);
+
+    utt->lat = NULL;
+    if (corpus_load_lattice(&utt->lat, ctx->lat_dir, ctx->lat_ext) != S3_SUCCESS) {
+      E_WARN("Can't read input lattice\n");
+      utt->lat = NULL;
+    }
+
+    utt->uttid = ckd_salloc(corpus_utt());
+    utt->seq_no = ctx->seq_no++;
+    ctx->n_utt++;
+
+    free(mfcc[0]);
+    ckd_free(mfcc);
+    break;
+  }
+  sbmtx_unlock(ctx->mtx);
+
+  return more;
+}
+
+static int
+mmi_job(mmi_job_t *job)
+{
+  mmi_ctx_t *ctx = job->ctx;
+  mmi_utt_t utt;
+  s3lattice_t *lat;
+  int32 ret;
+
+  while (mmi_next_utt(ctx, &utt)) {
+    lat = utt.lat;
+    if (lat == NULL) {
+      printf("utt> %5u %25s %4u %4u\n",
+	     utt.seq_no, utt.uttid, utt.n_frame, utt.n_frame_del);
+    }
+    else {
+      /* accumulate density counts on lattice */
+      switch (ctx->n_mmi_type) {
+	/* take random left and right context for viterbi run */
+      case 1:
+	ret = mmi_rand_train(job->inv, ctx->mdef, ctx->lex, utt.f, lat,
+			     ctx->a_beam, ctx->mean_reest,
+			     ctx->var_reest, ctx->feat, utt.uttid);
+	break;
+	/* take the best left and right context for viterbi run */
+      case 2:
+	ret = mmi_best_train(job->inv, ctx->mdef, ctx->lex, utt.f, lat,
+			     ctx->a_beam, ctx->mean_reest,
+			     ctx->var_reest, ctx->feat, utt.uttid);
+	break;
+	/* use context-independent hmms for word boundary models */
+      case 3:
+	ret = mmi_ci_train(job->inv, ctx->mdef, ctx->lex, utt.f, lat,
+			   ctx->a_beam, ctx->mean_reest,
+			   ctx->var_reest, ctx->feat, utt.uttid);
+	break;
+	/* mmi_type error */
+      default:
+	E_FATAL("Invalid -mmie_type, try rand, best or ci \n");
+	break;
+      }
+
+      if (ret == S3_SUCCESS)
+	printf("utt> %5u %25s %4u %4u %5u   %e\n",
+	       utt.seq_no, utt.uttid, utt.n_frame, utt.n_frame_del,
+	       lat->n_arcs, lat->postprob);
+      else
+	printf("utt> %5u %25s %4u %4u %5u\n",
+	       utt.seq_no, utt.uttid, utt.n_frame, utt.n_frame_del,
+	       lat->n_arcs);
+
+      if (ret == S3_SUCCESS)
+	job->total_log_postprob += lat->postprob;
+      else
+	job->n_utt_fail++;
+
+      s3lattice_free(lat);
+    }
+
+    feat_array_free(utt.f);
+    ckd_free(utt.uttid);
+  }
+
+  return 0;
+}
+
+static int
+mmi_worker(sbthread_t *th)
+{
+  return mmi_job((mmi_job_t *)sbthread_arg(th));
+}
+
+/* An inventory for one extra MMIE thread.  It shares the model
+ * parameters with inv, but has its own local mixw/cb maps and its own
+ * local and corpus accumulators. */
+static model_inventory_t *
+mmi_inv_clone(model_inventory_t *inv)
+{
+  model_inventory_t *c;
+  gauden_t *g;
+
+  c = ckd_calloc(1, sizeof(*c));
+  *c = *inv;
+  c->mixw_acc = NULL;
+  c->l_mixw_acc = NULL;
+  c->mixw_inverse = NULL;
+  c->n_mixw_inverse = 0;
+  c->cb_inverse = NULL;
+  c->n_cb_inverse = 0;
+  c->tmat_acc = NULL;
+  c->l_tmat_acc = NULL;
+
+  g = ckd_calloc(1, sizeof(*g));
+  *g = *inv->gauden;
+  g->macc = g->vacc = NULL;
+  g->fullvacc = NULL;
+  g->dnom = NULL;
+  g->l_macc = g->l_vacc = NULL;
+  g->l_fullvacc = NULL;
+  g->l_dnom = NULL;
+  gauden_alloc_acc(g);
+  c->gauden = g;
+
+  return c;
+}
+
+/* Add the accumulators of a thread's inventory to inv, then free it */
+static void
+mmi_inv_merge(model_inventory_t *inv, model_inventory_t *c)
+{
+  gauden_t *g = inv->gauden;
+  gauden_t *cg = c->gauden;
+  uint32 *ident;
+  uint32 i;
+
+  ident = ckd_calloc(g->n_mgau, sizeof(uint32));
+  for (i = 0; i < g->n_mgau; i++)
+    ident[i] = i;
+  accum_global_gauden(g->macc, cg->macc, g, ident, g->n_mgau);
+  accum_global_gauden(g->vacc, cg->vacc, g, ident, g->n_mgau);
+  if (g->dnom)
+    accum_global_gauden_dnom(g->dnom, cg->dnom, g, ident, g->n_mgau);
+  ckd_free(ident);
+
+  gauden_free_l_acc(cg);
+  gauden_free_acc(cg);
+  ckd_free(cg);
+  if (c->l_mixw_acc)
+    ckd_free_3d((void ***)c->l_mixw_acc);
+  ckd_free(c->mixw_inverse);
+  ckd_free(c->cb_inverse);
+  ckd_free(c);
+}
+
 /* main mmie training program */
 void
 main_mmi_reestimate(model_inventory_t *inv,
@@ -1526,37 +1808,16 @@ main_mmi_reestimate(model_inventory_t *inv,
 		    model_def_t *mdef,
 		    feat_t *feat)
 {
-  vector_t *mfcc;/* utterance cepstra */
-  int32 n_frame;/* # of cepstrum frames  */
-  uint32 svd_n_frame;        /* # of cepstrum frames  */
-  vector_t **f;/* independent feature streams derived from cepstra */
-  float32 ***lda = NULL;
-  uint32 total_frames;        /* # of frames over the corpus */
-  float64 a_beam;/* alpha pruning beam */
-  float64 b_beam;/* beta pruning beam */
-  float32 spthresh;        /* state posterior probability threshold */
-  uint32 seq_no;/* sequence # of utterance in corpus */
-  uint32 mean_reest;        /* if TRUE, reestimate means */
-  uint32 var_reest;        /* if TRUE, reestimate variances */
-
-  const char *lat_dir;        /* lattice directory */
-  const char *lat_ext;/* denominator or numerator lattice */
-  const char *mmi_type;/* different methods to get left and right context for Viterbi run on lattice */
-  uint32 n_mmi_type = 0;/* convert the mmi_type string to a int */
-  s3lattice_t *lat = NULL;/* input lattice */
-  float64 total_log_postprob = 0;/* total posterior probability of the correct hypotheses */
-  uint32 n_utt_fail = 0;        /* number of sentences failed */
-  uint32 i;
+  mmi_ctx_t ctx;
+  mmi_job_t *job;
+  sbthread_t **thread;
+  int32 n_thread;
+  int32 i;
 
-  char *trans;
-  uint32 in_veclen;
-  uint32 n_utt;
+  const char *mmi_type;/* different methods to get left and right context for Viterbi run on lattice */
 
   uint32 no_retries=0;
 
-  uint32 maxuttlen;
-  uint32 n_frame_skipped = 0;
-
   /* get rid of unnecessary arguments */
   if (cmd_ln_int32("-2passvar")) {
     E_FATAL("for MMIE training, set -2passvar to no\n");
@@ -1582,43 +1843,50 @@ main_mmi_reestimate(model_inventory_t *inv,
   if (cmd_ln_str("-pdumpdir")) {
     E_FATAL("current MMIE training don't support pdumpdir, set -pdumpdir to no\n");
   }
+  if (cmd_ln_str("-outphsegdir")) {
+    E_FATAL("current MMI implementation don't support -outphsegdir\n");
+  }
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.lex = lex;
+  ctx.mdef = mdef;
+  ctx.feat = feat;
 
   /* get lattice related parameters */
-  lat_dir = cmd_ln_str("-latdir");
-  lat_ext = cmd_ln_str("-latext");
-  if (strcmp(lat_ext, "denlat") != 0 && strcmp(lat_ext, "numlat") != 0) {
+  ctx.lat_dir = cmd_ln_str("-latdir");
+  ctx.lat_ext = cmd_ln_str("-latext");
+  if (strcmp(ctx.lat_ext, "denlat") != 0 && strcmp(ctx.lat_ext, "numlat") != 0) {
     E_FATAL("-latext should be either denlat or numlat\n");
   }
   else {
-    printf("MMIE training for %s \n", lat_ext);
+    printf("MMIE training for %s \n", ctx.lat_ext);
   }
   mmi_type = cmd_ln_str("-mmie_type");
   if (strcmp(mmi_type, "rand") == 0) {
-    n_mmi_type = 1;
+    ctx.n_mmi_type = 1;
     printf("MMIE training: take random left and right context for Viterbi run \n");
   }
   else if (strcmp(mmi_type, "best") == 0) {
-    n_mmi_type = 2;
+    ctx.n_mmi_type = 2;
     printf("MMIE training: take the best left and right context for Viterbi run \n");
   }
   else if (strcmp(mmi_type, "ci") == 0) {
     printf("MMIE training: use context-independent hmms for boundary word models \n");
-    n_mmi_type = 3;
+    ctx.n_mmi_type = 3;
   }
   else {
     E_FATAL("-mmie_type should be rand, best or ci\n");
   }
   lm_scale = cmd_ln_float32("-lw");
 
-  mean_reest = cmd_ln_int32("-meanreest");
-  var_reest = cmd_ln_int32("-varreest");
-  in_veclen = cmd_ln_int32("-ceplen");
-  
+  ctx.mean_reest = cmd_ln_int32("-meanreest");
+  ctx.var_reest = cmd_ln_int32("-varreest");
+  ctx.in_veclen = cmd_ln_int32("-ceplen");
+
   /* Read in an LDA matrix for accumulation. */
   if (cmd_ln_str("-lda")) {
-	feat_read_lda(feat, cmd_ln_str("-lda"), 
+	feat_read_lda(feat, cmd_ln_str("-lda"),
 			    cmd_ln_int32("-ldadim"));
-	lda = feat->lda;
   }
 
   if (cmd_ln_str("-accumdir") == NULL) {
@@ -1626,22 +1894,18 @@ main_mmi_reestimate(model_inventory_t *inv,
     return;
   }
 
-  if (!mean_reest && !var_reest) {
+  if (!ctx.mean_reest && !ctx.var_reest) {
     E_FATAL("No reestimation specified! Nothing done. Set -meanreest or -varreest \n");
     return;
   }
 
-  total_frames = 0;
-
-  a_beam = cmd_ln_float64("-abeam");
-  b_beam = cmd_ln_float64("-bbeam");
-  spthresh = cmd_ln_float32("-spthresh");
-  maxuttlen = cmd_ln_int32("-maxuttlen");
+  ctx.a_beam = cmd_ln_float64("-abeam");
+  ctx.maxuttlen = cmd_ln_int32("-maxuttlen");
 
   /* Begin by skipping over some (possibly zero) # of utterances.
    * Continue to process utterances until there are no more (either EOF
    * or end of run). */
-  seq_no = corpus_get_begin();
+  ctx.seq_no = corpus_get_begin();
 
   printf("column defns\n");
   printf("\t<seq>\n");
@@ -1652,140 +1916,49 @@ main_mmi_reestimate(model_inventory_t *inv,
   printf("\t<n_word>\n");
   printf("\t<lattice_log_postprob>\n");
 
-  /* accumulate density for each training sentence */
-  n_utt = 0;
-  while (corpus_next_utt()) {
-    printf("utt> %5u %25s",  seq_no, corpus_utt());
-    
-    if (corpus_get_generic_featurevec(&mfcc, &n_frame, in_veclen) < 0) {
-	E_FATAL("Can't read input features\n");
-    }
-    
-    printf(" %4u", n_frame);
-      
-    if (n_frame < 9) {
-      E_WARN("utt %s too short\n", corpus_utt());
-      if (mfcc) {
-	ckd_free(mfcc[0]);
-	ckd_free(mfcc);
-      }
-      continue;
-    }
-      
-    if ((maxuttlen > 0) && (n_frame > maxuttlen)) {
-      E_INFO("utt # frames > -maxuttlen; skipping\n");
-      n_frame_skipped += n_frame;
-      if (mfcc) {
-	ckd_free(mfcc[0]);
-	ckd_free(mfcc);
-      }
-      continue;
-    }
-      
-  
-    svd_n_frame = n_frame;
-      
-    f = feat_array_alloc(feat, n_frame + feat_window_size(feat));
-    feat_s2mfc2feat_live(feat, mfcc, &n_frame, TRUE, TRUE, f);
-      
-    printf(" %4u", n_frame - svd_n_frame);
-      
-    /* Get the transcript */
-    corpus_get_sent(&trans);
-
-    /* accumulate density counts on lattice */
-    if (corpus_load_lattice(&lat, lat_dir, lat_ext) == S3_SUCCESS) {
-      
-      /* different type of mmie training */
-      switch (n_mmi_type) {
-	/* take random left and right context for viterbi run */
-      case 1:
-	{
-	  if (mmi_rand_train(inv, mdef, lex, f, lat,
-			     a_beam, mean_reest,
-			     var_reest, feat) == S3_SUCCESS) {
-	    total_log_postprob += lat->postprob;
-	    printf("   %e", lat->postprob);
-	  }
-	  else {
-	    n_utt_fail++;
-	  }
-	  break;
-	}
-	/* take the best left and right context for viterbi run */
-      case 2:
-	{
-	  if (mmi_best_train(inv, mdef, lex, f, lat,
-			      a_beam, mean_reest,
-			     var_reest, feat) == S3_SUCCESS) {
-	    total_log_postprob += lat->postprob;
-	    printf("   %e", lat->postprob);
-	  }
-	  else {
-	    n_utt_fail++;
-	  }
-	  break;
-	}
-	/* use context-independent hmms for word boundary models */
-      case 3:
-	{
-	  if (mmi_ci_train(inv, mdef, lex, f, lat,
-			   a_beam, mean_reest,
-			   var_reest, feat) == S3_SUCCESS) {
-	    total_log_postprob += lat->postprob;
-	    printf("   %e", lat->postprob);
-	  }
-	  else {
-	    n_utt_fail++;
-	  }
-	  break;
-	}
-	/* mmi_type error */
-      default:
-	{
-	  E_FATAL("Invalid -mmie_type, try rand, best or ci \n");
-	  break;
-	}
-      }
-      
-      /* free memory for lattice */
-      for(i=0; i<lat->n_arcs; i++) {
-	ckd_free(lat->arc[i].prev_arcs);
-	ckd_free(lat->arc[i].next_arcs);
-      }
-      ckd_free(lat->arc);
-      ckd_free(lat);
-    }
-    else {
-      E_WARN("Can't read input lattice");
-    }
-    
-    free(mfcc[0]);
-    ckd_free(mfcc);
-    feat_array_free(f);
-    free(trans);
-      
-    seq_no++;
-    n_utt++;
-
-    printf("\n");
+  /* accumulate density for each training sentence.  Thread 0 uses
+     inv itself; the others get their own accumulators, which are
+     added to inv's in thread order once all threads are done. */
+  n_thread = cmd_ln_int32("-nthreads");
+  if (n_thread < 1)
+    n_thread = 1;
+  ctx.mtx = sbmtx_init();
+  job = ckd_calloc(n_thread, sizeof(*job));
+  thread = ckd_calloc(n_thread, sizeof(*thread));
+  for (i = 0; i < n_thread; i++) {
+    job[i].ctx = &ctx;
+    job[i].inv = (i == 0) ? inv : mmi_inv_clone(inv);
   }
-    
+  for (i = 1; i < n_thread; i++)
+    thread[i] = sbthread_start(mmi_worker, &job[i]);
+  mmi_job(&job[0]);
+  for (i = 1; i < n_thread; i++)
+    sbthread_free(thread[i]);
+  for (i = 0; i < n_thread; i++) {
+    if (i > 0)
+      mmi_inv_merge(inv, job[i].inv);
+    ctx.total_log_postprob += job[i].total_log_postprob;
+    ctx.n_utt_fail += job[i].n_utt_fail;
+  }
+  ckd_free(thread);
+  ckd_free(job);
+  sbmtx_free(ctx.mtx);
+
   printf ("overall> stats %u (-%u) %e %e",
-	  n_utt-n_utt_fail,
-	  n_utt_fail,
-	  (n_utt-n_utt_fail>0 ? total_log_postprob/(n_utt-n_utt_fail) : 0.0),
-	  total_log_postprob);  
+	  ctx.n_utt-ctx.n_utt_fail,
+	  ctx.n_utt_fail,
+	  (ctx.n_utt-ctx.n_utt_fail>0 ? ctx.total_log_postprob/(ctx.n_utt-ctx.n_utt_fail) : 0.0),
+	  ctx.total_log_postprob);
   printf("\n");
-    
+
   no_retries=0;
   /* dump the accumulators to a file system */
   while (cmd_ln_str("-accumdir") != NULL &&
 	 accum_mmie_dump(cmd_ln_str("-accumdir"),
-			 lat_ext,
+			 ctx.lat_ext,
 			 inv,
-			 mean_reest,
-			 var_reest) != S3_SUCCESS) {
+			 ctx.mean_reest,
+			 ctx.var_reest) != S3_SUCCESS) {
     static int notified = FALSE;
     time_t t;
     char time_str[64];
@@ -1824,9 +1997,10 @@ int main(int argc, char *argv[])
     lexicon_t *lex = NULL;
     model_def_t *mdef = NULL;
     feat_t *feat = NULL;
+    utt_states_cache_t *cache = NULL;
     
     if (main_initialize(argc, argv,
-			&inv, &lex, &mdef, &feat) != S3_SUCCESS) {
+			&inv, &lex, &mdef, &feat, &cache) != S3_SUCCESS) {
 	E_FATAL("initialization failed\n");
     }
 
@@ -1834,8 +2008,12 @@ int main(int argc, char *argv[])
       main_mmi_reestimate(inv, lex, mdef, feat);
     }
     else {
-      main_reestimate(inv, lex, mdef, feat, cmd_ln_int32("-viterbi"));
+      main_reestimate(inv, lex, mdef, feat, cmd_ln_int32("-viterbi"),
+		      cache);
     }
+
+    if (cache)
+	utt_states_cache_close(cache);
     
     if (feat)
 	feat_free(feat);
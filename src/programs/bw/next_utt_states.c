@@ -49,6 +49,10 @@
 #include <s3/model_inventory.h>
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/err.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/hash_table.h>
+#include <sphinxbase/glist.h>
+#include <sphinxbase/strfuncs.h>
 #include <s3/mk_phone_list.h>
 #include <s3/cvt2triphone.h>
 
@@ -58,6 +62,11 @@
 
 #include "next_utt_states.h"
 
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
 state_t *next_utt_states(uint32 *n_state,
 			 lexicon_t *lex,
 			 model_inventory_t *inv,
@@ -161,7 +170,7 @@ state_t *next_utt_states_mmie(uint32 *n_state,
 			      lexicon_t *lex,
 			      model_inventory_t *inv,
 			      model_def_t *mdef,
-			      char *curr_word,
+			      const char *curr_word,
 			      acmod_id_t *l_phone,
 			      acmod_id_t *r_phone
 			      )
@@ -182,12 +191,545 @@ state_t *next_utt_states_mmie(uint32 *n_state,
   
   acmod_set = inv->acmod_set;
   
-  cvt2triphone_mmie(acmod_set, phone, l_phone, r_phone, btw_mark, n_phone);
+  if (l_phone && r_phone)
+    cvt2triphone_mmie(acmod_set, phone, l_phone, r_phone, btw_mark, n_phone);
+  else
+    cvt2triphone(acmod_set, phone, btw_mark, n_phone);
   
-  state_seq = state_seq_make(n_state, phone, n_phone, inv, mdef);
+  state_seq = state_seq_make_alloc(n_state, phone, n_phone, inv, mdef);
   
   ckd_free(phone);
   ckd_free(btw_mark);
   
   return state_seq;
 }
+
+/*
+ * Sentence HMM cache.
+ *
+ * The state sequence of an utterance depends only on its transcript,
+ * the model definition, the dictionaries and which transitions the
+ * transition matrices allow, none of which change between iterations.
+ * The cache file holds the compiled sequence of every transcript seen,
+ * stored as 32-bit words:
+ *
+ *   header   magic, version, key (2 words), n_entry, index (2 words), 0
+ *   entries  n_trans_word, transcript (NUL padded to a word boundary),
+ *            n_state, n_next, n_prior, n_mixw_inverse, n_cb_inverse,
+ *            UTT_STATE_N_WORD words per state,
+ *            next states, next tprobs, prior states, prior tprobs,
+ *            mixw_inverse, cb_inverse
+ *   index    offset of each entry (2 words)
+ *
+ * Transition probabilities are refreshed from the current transition
+ * matrices when an entry is loaded, except across phones where they do
+ * not come from a matrix.
+ */
+#define UTT_STATES_MAGIC	0x51455354
+#define UTT_STATES_VERSION	1
+#define UTT_STATES_HDR_WORDS	8
+#define UTT_STATE_N_WORD	13
+
+struct utt_states_cache_s {
+    char *fn;
+    int multipron;
+    uint64_t key;
+
+    mmio_file_t *mf;		/* Cache from a previous run, if valid */
+    const uint32 *old;
+    uint32 n_old;
+    hash_table_t *old_ht;	/* Transcript -> entry in old */
+
+    FILE *out;			/* Replacement cache, opened on first miss */
+    char *tmpfn;
+    uint64_t out_off;		/* Words written to out */
+    uint64_t *out_entry;
+    uint32 n_out, max_out;
+    hash_table_t *out_ht;	/* Transcripts already in out */
+    glist_t out_trans;
+
+    uint32 *blob;		/* Serialization buffer */
+    size_t max_blob;
+
+    state_t *state;		/* Storage for the returned sequence */
+    uint32 max_n_s;
+    uint32 *arc_state;
+    float32 *arc_tprob;
+    uint32 max_arc;
+
+    uint32 n_hit, n_miss;
+};
+
+static uint64_t
+fnv_hash(uint64_t h, const void *buf, size_t len)
+{
+    const unsigned char *c = buf;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+	h ^= c[i];
+	h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t
+fnv_hash_file(uint64_t h, const char *fn)
+{
+    unsigned char buf[BUFSIZ];
+    size_t len;
+    FILE *fp;
+
+    if (fn == NULL)
+	return h;
+    if ((fp = fopen(fn, "rb")) == NULL) {
+	E_ERROR_SYSTEM("Failed to open %s", fn);
+	return h;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+	h = fnv_hash(h, buf, len);
+    fclose(fp);
+    return h;
+}
+
+static uint64_t
+read_u64(const uint32 *w)
+{
+    return (uint64_t)w[0] | ((uint64_t)w[1] << 32);
+}
+
+static void
+write_u64(uint32 *w, uint64_t v)
+{
+    w[0] = (uint32)v;
+    w[1] = (uint32)(v >> 32);
+}
+
+static void
+cache_open_old(utt_states_cache_t *cache)
+{
+    const uint32 *hdr;
+    uint64_t idx;
+    uint32 i;
+    struct stat st;
+
+    if (stat(cache->fn, &st) < 0)
+	return;
+    if (st.st_size < UTT_STATES_HDR_WORDS * 4
+	|| (cache->mf = mmio_file_read(cache->fn)) == NULL)
+	return;
+    hdr = cache->old = mmio_file_ptr(cache->mf);
+    if (hdr[0] != UTT_STATES_MAGIC || hdr[1] != UTT_STATES_VERSION
+	|| read_u64(hdr + 2) != cache->key) {
+	E_INFO("Sentence HMM cache %s is out of date; rebuilding it\n",
+	       cache->fn);
+	goto invalid;
+    }
+    cache->n_old = hdr[4];
+    idx = read_u64(hdr + 5);
+    if ((idx + 2 * (uint64_t)cache->n_old) * 4 > (uint64_t)st.st_size) {
+	E_WARN("Sentence HMM cache %s is truncated; rebuilding it\n",
+	       cache->fn);
+	goto invalid;
+    }
+    cache->old_ht = hash_table_new(cache->n_old + 1, HASH_CASE_YES);
+    for (i = 0; i < cache->n_old; i++) {
+	const uint32 *ent = cache->old + read_u64(cache->old + idx + 2 * i);
+	hash_table_enter(cache->old_ht, (const char *)(ent + 1), (void *)ent);
+    }
+    E_INFO("Read %u sentence HMMs from %s\n", cache->n_old, cache->fn);
+    return;
+
+invalid:
+    mmio_file_unmap(cache->mf);
+    cache->mf = NULL;
+    cache->old = NULL;
+    cache->n_old = 0;
+}
+
+utt_states_cache_t *
+utt_states_cache_open(const char *fn,
+		      model_inventory_t *inv,
+		      model_def_t *mdef,
+		      const char *mdeffn,
+		      const char *dictfn,
+		      const char *fdictfn,
+		      int multipron)
+{
+    utt_states_cache_t *cache;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    uint32 i, j, k;
+    unsigned char nz;
+
+    cache = ckd_calloc(1, sizeof(*cache));
+    cache->fn = ckd_salloc(fn);
+    cache->multipron = multipron;
+
+    h = fnv_hash_file(h, mdeffn);
+    h = fnv_hash(h, mdef->cb, mdef->n_tied_state * sizeof(*mdef->cb));
+    h = fnv_hash_file(h, dictfn);
+    h = fnv_hash_file(h, fdictfn);
+    h = fnv_hash(h, &multipron, sizeof(multipron));
+    /* Only the transitions which exist shape the sentence HMM */
+    for (i = 0; i < inv->n_tmat; i++) {
+	for (j = 0; j < inv->n_state_pm - 1; j++) {
+	    for (k = 0; k < inv->n_state_pm; k++) {
+		nz = (inv->tmat[i][j][k] > 0.0);
+		h = fnv_hash(h, &nz, 1);
+	    }
+	}
+    }
+    cache->key = h;
+
+    cache_open_old(cache);
+
+    return cache;
+}
+
+static uint32 *
+cache_blob_reserve(utt_states_cache_t *cache, size_t n_word)
+{
+    if (n_word > cache->max_blob) {
+	cache->max_blob = n_word + n_word / 2;
+	cache->blob = ckd_realloc(cache->blob, cache->max_blob * sizeof(uint32));
+    }
+    return cache->blob;
+}
+
+/* Serialize a sentence HMM and the local ID maps in inv */
+static size_t
+cache_serialize(utt_states_cache_t *cache, const char *trans,
+		state_t *state, uint32 n_s, model_inventory_t *inv)
+{
+    uint32 n_trans_word = strlen(trans) / 4 + 1;
+    uint32 total_next = 0, total_prior = 0;
+    uint32 *w, *ns, *nt, *ps, *pt;
+    uint32 i, u;
+    size_t n_word;
+
+    for (i = 0; i < n_s; i++) {
+	total_next += state[i].n_next;
+	total_prior += state[i].n_prior;
+    }
+    n_word = 1 + n_trans_word + 5 + UTT_STATE_N_WORD * n_s
+	+ 2 * total_next + 2 * total_prior
+	+ inv->n_mixw_inverse + inv->n_cb_inverse;
+    w = cache_blob_reserve(cache, n_word);
+    memset(w, 0, n_word * sizeof(uint32));
+
+    *w++ = n_trans_word;
+    strcpy((char *)w, trans);
+    w += n_trans_word;
+    *w++ = n_s;
+    *w++ = total_next;
+    *w++ = total_prior;
+    *w++ = inv->n_mixw_inverse;
+    *w++ = inv->n_cb_inverse;
+    for (i = 0; i < n_s; i++) {
+	*w++ = state[i].mixw;
+	*w++ = state[i].cb;
+	*w++ = state[i].ci_cb;
+	*w++ = state[i].ci_mixw;
+	*w++ = state[i].n_prior;
+	*w++ = state[i].n_next;
+	*w++ = state[i].tmat;
+	*w++ = state[i].m_state;
+	*w++ = state[i].l_mixw;
+	*w++ = state[i].l_cb;
+	*w++ = state[i].l_ci_mixw;
+	*w++ = state[i].l_ci_cb;
+	*w++ = state[i].phn;
+    }
+    ns = w;
+    nt = ns + total_next;
+    ps = nt + total_next;
+    pt = ps + total_prior;
+    for (i = 0; i < n_s; i++) {
+	for (u = 0; u < state[i].n_next; u++) {
+	    *ns++ = state[i].next_state[u];
+	    memcpy(nt++, &state[i].next_tprob[u], sizeof(float32));
+	}
+	for (u = 0; u < state[i].n_prior; u++) {
+	    *ps++ = state[i].prior_state[u];
+	    memcpy(pt++, &state[i].prior_tprob[u], sizeof(float32));
+	}
+    }
+    w = pt;
+    memcpy(w, inv->mixw_inverse, inv->n_mixw_inverse * sizeof(uint32));
+    w += inv->n_mixw_inverse;
+    memcpy(w, inv->cb_inverse, inv->n_cb_inverse * sizeof(uint32));
+    w += inv->n_cb_inverse;
+    assert((size_t)(w - cache->blob) == n_word);
+
+    return n_word;
+}
+
+static void
+cache_write_entry(utt_states_cache_t *cache, const uint32 *blob, size_t n_word)
+{
+    if (cache->n_out == cache->max_out) {
+	cache->max_out = cache->max_out ? 2 * cache->max_out : 1024;
+	cache->out_entry = ckd_realloc(cache->out_entry,
+				       cache->max_out * sizeof(*cache->out_entry));
+    }
+    cache->out_entry[cache->n_out++] = cache->out_off;
+    if (fwrite(blob, sizeof(uint32), n_word, cache->out) != n_word)
+	E_FATAL_SYSTEM("Failed to write %s", cache->tmpfn);
+    cache->out_off += n_word;
+}
+
+/*
+ * Rebuild a sentence HMM from a cache entry, refresh its transition
+ * probabilities and set the local ID maps in inv, as the sentence HMM
+ * builders do.
+ */
+static state_t *
+cache_load(utt_states_cache_t *cache, const uint32 *w,
+	   uint32 *n_state, model_inventory_t *inv)
+{
+    uint32 n_s, total_next, total_prior, n_mixw_inv, n_cb_inv;
+    const uint32 *ns, *nt, *ps, *pt;
+    float32 ***all_tmat = inv->tmat;
+    state_t *state;
+    uint32 i, u, n, p;
+
+    w += 1 + w[0];
+    n_s = *w++;
+    total_next = *w++;
+    total_prior = *w++;
+    n_mixw_inv = *w++;
+    n_cb_inv = *w++;
+
+    if (n_s > cache->max_n_s) {
+	ckd_free(cache->state);
+	cache->state = ckd_calloc(n_s, sizeof(state_t));
+	cache->max_n_s = n_s;
+    }
+    else
+	memset(cache->state, 0, n_s * sizeof(state_t));
+    if (total_next + total_prior > cache->max_arc) {
+	cache->max_arc = total_next + total_prior;
+	ckd_free(cache->arc_state);
+	ckd_free(cache->arc_tprob);
+	cache->arc_state = ckd_calloc(cache->max_arc, sizeof(uint32));
+	cache->arc_tprob = ckd_calloc(cache->max_arc, sizeof(float32));
+    }
+    state = cache->state;
+
+    for (i = 0; i < n_s; i++, w += UTT_STATE_N_WORD) {
+	state[i].mixw = w[0];
+	state[i].cb = w[1];
+	state[i].ci_cb = w[2];
+	state[i].ci_mixw = w[3];
+	state[i].n_prior = w[4];
+	state[i].n_next = w[5];
+	state[i].tmat = w[6];
+	state[i].m_state = w[7];
+	state[i].l_mixw = w[8];
+	state[i].l_cb = w[9];
+	state[i].l_ci_mixw = w[10];
+	state[i].l_ci_cb = w[11];
+	state[i].phn = w[12];
+    }
+    ns = w;
+    nt = ns + total_next;
+    ps = nt + total_next;
+    pt = ps + total_prior;
+
+    memcpy(cache->arc_state, ns, total_next * sizeof(uint32));
+    memcpy(cache->arc_tprob, nt, total_next * sizeof(float32));
+    memcpy(cache->arc_state + total_next, ps, total_prior * sizeof(uint32));
+    memcpy(cache->arc_tprob + total_next, pt, total_prior * sizeof(float32));
+
+    /* Arcs out of emitting states stay within a model, so their
+     * probabilities come from its current transition matrix. */
+    for (i = 0, n = 0, p = total_next; i < n_s; i++) {
+	state[i].next_state = state[i].n_next ? cache->arc_state + n : NULL;
+	state[i].next_tprob = state[i].n_next ? cache->arc_tprob + n : NULL;
+	if (state[i].mixw != TYING_NO_ID) {
+	    for (u = 0; u < state[i].n_next; u++) {
+		state_t *d = &state[state[i].next_state[u]];
+		state[i].next_tprob[u] =
+		    all_tmat[state[i].tmat][state[i].m_state][d->m_state];
+	    }
+	}
+	n += state[i].n_next;
+	state[i].prior_state = state[i].n_prior ? cache->arc_state + p : NULL;
+	state[i].prior_tprob = state[i].n_prior ? cache->arc_tprob + p : NULL;
+	p += state[i].n_prior;
+    }
+    for (i = 0; i < n_s; i++) {
+	for (u = 0; u < state[i].n_prior; u++) {
+	    state_t *s = &state[state[i].prior_state[u]];
+	    if (s->mixw != TYING_NO_ID)
+		state[i].prior_tprob[u] =
+		    all_tmat[s->tmat][s->m_state][state[i].m_state];
+	}
+    }
+    w = pt + total_prior;
+
+    if (inv->l_mixw_acc) {
+	ckd_free_3d((void ***)inv->l_mixw_acc);
+	inv->l_mixw_acc = NULL;
+    }
+    if (inv->mixw_inverse)
+	ckd_free((void *)inv->mixw_inverse);
+    inv->mixw_inverse = ckd_calloc(n_mixw_inv, sizeof(uint32));
+    memcpy(inv->mixw_inverse, w, n_mixw_inv * sizeof(uint32));
+    inv->n_mixw_inverse = n_mixw_inv;
+    w += n_mixw_inv;
+
+    if (inv->cb_inverse)
+	ckd_free((void *)inv->cb_inverse);
+    inv->cb_inverse = ckd_calloc(n_cb_inv, sizeof(uint32));
+    memcpy(inv->cb_inverse, w, n_cb_inv * sizeof(uint32));
+    inv->n_cb_inverse = n_cb_inv;
+
+    *n_state = n_s;
+    return state;
+}
+
+state_t *
+next_utt_states_cached(uint32 *n_state,
+		       utt_states_cache_t *cache,
+		       lexicon_t *lex,
+		       model_inventory_t *inv,
+		       model_def_t *mdef,
+		       char *trans)
+{
+    state_t *state_seq;
+    void *val;
+    size_t n_word;
+
+    if (cache->old_ht && hash_table_lookup(cache->old_ht, trans, &val) == 0) {
+	++cache->n_hit;
+	return cache_load(cache, (const uint32 *)val, n_state, inv);
+    }
+
+    ++cache->n_miss;
+    if (cache->multipron)
+	state_seq = next_utt_states_graph(n_state, lex, inv, mdef, trans);
+    else
+	state_seq = next_utt_states(n_state, lex, inv, mdef, trans);
+    if (state_seq == NULL)
+	return NULL;
+
+    n_word = cache_serialize(cache, trans, state_seq, *n_state, inv);
+    if (cache->multipron)
+	state_seq_free(state_seq, *n_state);
+
+    if (cache->out == NULL) {
+	uint32 hdr[UTT_STATES_HDR_WORDS];
+
+	cache->tmpfn = string_join(cache->fn, ".tmp", NULL);
+	if ((cache->out = fopen(cache->tmpfn, "wb")) == NULL)
+	    E_FATAL_SYSTEM("Failed to open %s for writing", cache->tmpfn);
+	memset(hdr, 0, sizeof(hdr));
+	if (fwrite(hdr, sizeof(uint32), UTT_STATES_HDR_WORDS, cache->out)
+	    != UTT_STATES_HDR_WORDS)
+	    E_FATAL_SYSTEM("Failed to write %s", cache->tmpfn);
+	cache->out_off = UTT_STATES_HDR_WORDS;
+	cache->out_ht = hash_table_new(1024, HASH_CASE_YES);
+    }
+    if (hash_table_lookup(cache->out_ht, trans, &val) < 0) {
+	char *key = ckd_salloc(trans);
+
+	cache->out_trans = glist_add_ptr(cache->out_trans, key);
+	hash_table_enter(cache->out_ht, key, key);
+	cache_write_entry(cache, cache->blob, n_word);
+    }
+
+    /* Hand back our own copy so that callers treat hits and misses
+     * alike. */
+    return cache_load(cache, cache->blob, n_state, inv);
+}
+
+int
+utt_states_cache_close(utt_states_cache_t *cache)
+{
+    int rv = S3_SUCCESS;
+    gnode_t *gn;
+
+    E_INFO("Sentence HMM cache: %u hits, %u misses\n",
+	   cache->n_hit, cache->n_miss);
+
+    if (cache->out) {
+	uint32 hdr[UTT_STATES_HDR_WORDS];
+	uint32 off[2];
+	uint64_t idx;
+	uint32 i, n_new;
+
+	/* Carry over old entries which are still valid */
+	if (cache->old) {
+	    uint64_t oidx = read_u64(cache->old + 5);
+	    for (i = 0; i < cache->n_old; i++) {
+		const uint32 *ent = cache->old
+		    + read_u64(cache->old + oidx + 2 * i);
+		void *val;
+		size_t n_word;
+
+		if (hash_table_lookup(cache->out_ht,
+				      (const char *)(ent + 1), &val) == 0)
+		    continue;
+		/* Size the entry from its header words */
+		{
+		    const uint32 *w = ent + 1 + ent[0];
+		    n_word = 1 + ent[0] + 5 + UTT_STATE_N_WORD * w[0]
+			+ 2 * w[1] + 2 * w[2] + w[3] + w[4];
+		}
+		cache_write_entry(cache, ent, n_word);
+	    }
+	}
+	n_new = cache->n_out;
+
+	idx = cache->out_off;
+	for (i = 0; i < n_new; i++) {
+	    write_u64(off, cache->out_entry[i]);
+	    if (fwrite(off, sizeof(uint32), 2, cache->out) != 2)
+		E_FATAL_SYSTEM("Failed to write %s", cache->tmpfn);
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	hdr[0] = UTT_STATES_MAGIC;
+	hdr[1] = UTT_STATES_VERSION;
+	write_u64(hdr + 2, cache->key);
+	hdr[4] = n_new;
+	write_u64(hdr + 5, idx);
+	if (fseek(cache->out, 0, SEEK_SET) < 0
+	    || fwrite(hdr, sizeof(uint32), UTT_STATES_HDR_WORDS, cache->out)
+	    != UTT_STATES_HDR_WORDS)
+	    E_FATAL_SYSTEM("Failed to write %s", cache->tmpfn);
+	if (fclose(cache->out) != 0)
+	    E_FATAL_SYSTEM("Failed to write %s", cache->tmpfn);
+
+	if (cache->mf)
+	    mmio_file_unmap(cache->mf);
+	cache->mf = NULL;
+	if (rename(cache->tmpfn, cache->fn) < 0) {
+	    E_ERROR_SYSTEM("Failed to rename %s to %s",
+			   cache->tmpfn, cache->fn);
+	    rv = S3_ERROR;
+	}
+	else
+	    E_INFO("Wrote %u sentence HMMs to %s\n", n_new, cache->fn);
+	ckd_free(cache->tmpfn);
+	hash_table_free(cache->out_ht);
+	for (gn = cache->out_trans; gn; gn = gnode_next(gn))
+	    ckd_free(gnode_ptr(gn));
+	glist_free(cache->out_trans);
+	ckd_free(cache->out_entry);
+    }
+
+    if (cache->mf)
+	mmio_file_unmap(cache->mf);
+    if (cache->old_ht)
+	hash_table_free(cache->old_ht);
+    ckd_free(cache->blob);
+    ckd_free(cache->state);
+    ckd_free(cache->arc_state);
+    ckd_free(cache->arc_tprob);
+    ckd_free(cache->fn);
+    ckd_free(cache);
+
+    return rv;
+}
@@ -69,13 +69,44 @@ state_t *next_utt_states_graph(uint32 *n_state,
 			       model_def_t *mdef,
 			       char *transcript);
 
+/* HMM for a single lattice word with the given boundary phones as
+ * its outer contexts, or with SIL contexts if they are NULL.  The
+ * result is allocated per call and must be freed with state_seq_free(),
+ * so MMIE threads may call this with their own inventories. */
 state_t *next_utt_states_mmie(uint32 *n_state,
 			      lexicon_t *lex,
 			      model_inventory_t *inv,
 			      model_def_t *mdef,
-			      char *curr_word,
+			      const char *curr_word,
 			      acmod_id_t *l_phone,
 			      acmod_id_t *r_phone);
 
+/* Persistent cache of sentence HMMs keyed by transcript, so that
+ * later iterations of training skip building them.  Entries are only
+ * reused while the model definition, dictionaries, pronunciation mode
+ * and transition topology are unchanged. */
+typedef struct utt_states_cache_s utt_states_cache_t;
+
+utt_states_cache_t *utt_states_cache_open(const char *fn,
+					  model_inventory_t *inv,
+					  model_def_t *mdef,
+					  const char *mdeffn,
+					  const char *dictfn,
+					  const char *fdictfn,
+					  int multipron);
+
+/* Cached variant of next_utt_states/next_utt_states_graph.  The
+ * returned state_t* belongs to the cache and stays valid until the
+ * next call; do not free it. */
+state_t *next_utt_states_cached(uint32 *n_state,
+				utt_states_cache_t *cache,
+				lexicon_t *lex,
+				model_inventory_t *inv,
+				model_def_t *mdef,
+				char *transcript);
+
+/* Writes back any new entries. */
+int utt_states_cache_close(utt_states_cache_t *cache);
+
 #endif /* NEXT_UTT_STATES_H */ 
 
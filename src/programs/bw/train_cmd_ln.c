@@ -367,6 +367,11 @@ If yo want to do parallel training for N machines. Run N trainers with \n\
 	  NULL,
 	  "The filler word dictionary (e.g. SIL, SILb, ++COUGH++)" },
 
+	{ "-dictcache",
+	  ARG_STRING,
+	  NULL,
+	  "Directory for binary caches of the dictionaries, which are built on first use"},
+
 	{ "-ctlfn",
 	  ARG_STRING,
 	  NULL,
@@ -550,6 +555,13 @@ If yo want to do parallel training for N machines. Run N trainers with \n\
 	  "11.5",
 	  "Language model weight" },
 
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads for MMIE training.  Each thread takes whole "
+	  "utterances and keeps its own accumulators, which are summed "
+	  "before the counts are written" },
+
 	{ "-multipron",
 	  ARG_BOOLEAN,
 	  "no",
@@ -558,6 +570,14 @@ If yo want to do parallel training for N machines. Run N trainers with \n\
 	  "across variants. Default no for SphinxTrain parity. "
 	  "Set $CFG_MULTIPRON_TRAINING = 'yes' in sphinx_train.cfg "
 	  "to enable this for every bw stage." },
+
+	{ "-uttstatecache",
+	  ARG_STRING,
+	  NULL,
+	  "File in which to keep the sentence HMMs built for each transcript "
+	  "so that later iterations can reuse them. Rebuilt automatically "
+	  "when the model definition, dictionaries or transition topology "
+	  "change." },
 	/* end */
 	
 	cepstral_to_feature_command_line_macro(),
@@ -294,10 +294,10 @@ viterbi_update(float64 *log_forw_prob,
     uint32 max_n_next = 0;
     uint32 n_cb;
 
-    static float64 *p_op = NULL;
-    static float64 *p_ci_op = NULL;
-    static float64 **d_term = NULL;
-    static float64 **d_term_ci = NULL;
+    float64 *p_op;
+    float64 *p_ci_op;
+    float64 **d_term;
+    float64 **d_term_ci;
 
     /* caller must ensure that there is some non-zero amount
        of work to be done here */
@@ -310,15 +310,11 @@ viterbi_update(float64 *log_forw_prob,
     n_top = gauden_n_top(g);
     n_cb = gauden_n_mgau(g);
 
-    if (p_op == NULL) {
-	p_op    = ckd_calloc(n_feat, sizeof(float64));
-	p_ci_op = ckd_calloc(n_feat, sizeof(float64));
-    }
-
-    if (d_term == NULL) {
-	d_term    = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
-	d_term_ci = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
-    }
+    /* Allocated per call, since MMIE threads run this concurrently */
+    p_op    = ckd_calloc(n_feat, sizeof(float64));
+    p_ci_op = ckd_calloc(n_feat, sizeof(float64));
+    d_term    = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
+    d_term_ci = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
 
     scale = (float64 *)ckd_calloc(n_obs, sizeof(float64));
     dscale = (float64 **)ckd_calloc(n_obs, sizeof(float64 *));
@@ -705,7 +701,8 @@ mmi_viterbi_run(float64 *log_forw_prob,
 		state_t *state_seq,
 		uint32 n_state,
 		model_inventory_t *inv,
-		float64 a_beam)
+		float64 a_beam,
+		const char *uttid)
 {
     float64 *scale = NULL;
     float64 **dscale = NULL;
@@ -794,7 +791,7 @@ mmi_viterbi_run(float64 *log_forw_prob,
     ckd_free((void **)bp);
 
     if (ret != S3_SUCCESS && !final_state_error)
-	E_ERROR("viterbi run error in sentence %s\n", corpus_utt_brief_name());
+	E_ERROR("viterbi run error in sentence %s\n", uttid);
 
     return ret;
 }
@@ -809,7 +806,8 @@ mmi_viterbi_update(vector_t **feature,
 		   int32 mean_reest,
 		   int32 var_reest,
 		   float64 arc_gamma,
-		   feat_t *fcb)
+		   feat_t *fcb,
+		   const char *uttid)
 {
     float64 *scale = NULL;
     float64 **dscale = NULL;
@@ -836,10 +834,10 @@ mmi_viterbi_update(vector_t **feature,
     int ret;
     uint32 n_cb;
 
-    static float64 *p_op = NULL;
-    static float64 *p_ci_op = NULL;
-    static float64 **d_term = NULL;
-    static float64 **d_term_ci = NULL;
+    float64 *p_op;
+    float64 *p_ci_op;
+    float64 **d_term;
+    float64 **d_term_ci;
 
     /* caller must ensure that there is some non-zero amount
        of work to be done here */
@@ -852,15 +850,11 @@ mmi_viterbi_update(vector_t **feature,
     n_top = gauden_n_top(g);
     n_cb = gauden_n_mgau(g);
 
-    if (p_op == NULL) {
-	p_op    = ckd_calloc(n_feat, sizeof(float64));
-	p_ci_op = ckd_calloc(n_feat, sizeof(float64));
-    }
-
-    if (d_term == NULL) {
-	d_term    = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
-	d_term_ci = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
-    }
+    /* Allocated per call, since MMIE threads run this concurrently */
+    p_op    = ckd_calloc(n_feat, sizeof(float64));
+    p_ci_op = ckd_calloc(n_feat, sizeof(float64));
+    d_term    = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
+    d_term_ci = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
 
     scale = (float64 *)ckd_calloc(n_obs, sizeof(float64));
     dscale = (float64 **)ckd_calloc(n_obs, sizeof(float64 *));
@@ -1102,8 +1096,13 @@ mmi_viterbi_update(vector_t **feature,
     if (now_den_idx)
 	ckd_free_3d((void ***)now_den_idx);
 
+    ckd_free(p_op);
+    ckd_free(p_ci_op);
+    ckd_free_2d((void **)d_term);
+    ckd_free_2d((void **)d_term_ci);
+
     if (ret != S3_SUCCESS)
-	E_ERROR("viterbi update error in sentence %s\n", corpus_utt_brief_name());
+	E_ERROR("viterbi update error in sentence %s\n", uttid);
 
     return ret;
 }
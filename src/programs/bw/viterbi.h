@@ -104,7 +104,8 @@ mmi_viterbi_run(float64 *log_forw_prob,
 		state_t *state,
 		uint32 n_state,
 		model_inventory_t *inv,
-		float64 a_beam);
+		float64 a_beam,
+		const char *uttid);
 
 int32
 mmi_viterbi_update(vector_t **feature,
@@ -116,7 +117,8 @@ mmi_viterbi_update(vector_t **feature,
 		   int32 mean_reest,
 		   int32 var_reest,
 		   float64 arc_gamma,
-		   feat_t *fcb);
+		   feat_t *fcb,
+		   const char *uttid);
 
 #endif /* VITERBI_H */ 
 
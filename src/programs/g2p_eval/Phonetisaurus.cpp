@@ -139,57 +139,62 @@ Phonetisaurus::makeEpsMapper()
 
 StdVectorFst
 Phonetisaurus::entryToFSA(vector <string> entry)
+{
+    StdVectorFst efst;
+    entryToFSA(entry, &efst);
+    return efst;
+}
+
+void
+Phonetisaurus::entryToFSA(const vector <string> &entry, StdVectorFst *efst)
 {
     /*
        Transform an input spelling/pronunciation into an equivalent
        FSA, adding extra arcs as needed to accomodate clusters.
      */
 
-    StdVectorFst efst;
-    efst.AddState();
-    efst.SetStart(0);
+    efst->DeleteStates();
+    efst->ReserveStates(entry.size() + 3);
+    efst->AddState();
+    efst->SetStart(0);
 
-    efst.AddState();
-    efst.AddArc(0, StdArc(isyms->Find(sb), isyms->Find(sb), 0, 1));
+    efst->AddState();
+    efst->AddArc(0, StdArc(isyms->Find(sb), isyms->Find(sb), 0, 1));
     size_t i = 0;
 
     //Build the basic FSA
     for (i = 0; i < entry.size(); i++) {
-        efst.AddState();
-        string ch = entry[i];
-        efst.AddArc(i + 1,
-                    StdArc(isyms->Find(ch), isyms->Find(ch), 0, i + 2));
-        if (i == 0)
-            continue;
-
+        efst->AddState();
+        const string &ch = entry[i];
+        efst->AddArc(i + 1,
+                     StdArc(isyms->Find(ch), isyms->Find(ch), 0, i + 2));
     }
 
     //Add any cluster arcs
-    map<vector<string>,int>::iterator it_i;
+    map<vector<string>,int>::const_iterator it_i;
     for (it_i = clusters.begin(); it_i != clusters.end(); it_i++) {
-        vector<string>::iterator it_j;
-        vector<string>::iterator start = entry.begin();
-        vector<string> cluster = (*it_i).first;
+        vector<string>::const_iterator it_j = entry.begin();
+        vector<string>::const_iterator start = entry.begin();
+        const vector<string> &cluster = (*it_i).first;
         while (it_j != entry.end()) {
             it_j =
                 search(start, entry.end(), cluster.begin(), cluster.end());
             if (it_j != entry.end()) {
-                efst.AddArc(it_j - entry.begin() + 1, StdArc((*it_i).second,    //input symbol
-                            (*it_i).second,    //output symbol
-                            0, //weight
-                            it_j - entry.begin() + cluster.size() + 1  //destination state
-                                                            ));
+                efst->AddArc(it_j - entry.begin() + 1, StdArc((*it_i).second,   //input symbol
+                             (*it_i).second,   //output symbol
+                             0, //weight
+                             it_j - entry.begin() + cluster.size() + 1 //destination state
+                                                              ));
                 start = it_j + cluster.size();
             }
         }
     }
 
-    efst.AddState();
-    efst.AddArc(i + 1, StdArc(isyms->Find(se), isyms->Find(se), 0, i + 2));
-    efst.SetFinal(i + 2, 0);
-    efst.SetInputSymbols(isyms);
-    efst.SetOutputSymbols(isyms);
-    return efst;
+    efst->AddState();
+    efst->AddArc(i + 1, StdArc(isyms->Find(se), isyms->Find(se), 0, i + 2));
+    efst->SetFinal(i + 2, 0);
+    efst->SetInputSymbols(isyms);
+    efst->SetOutputSymbols(isyms);
 }
 
 vector<PathData> Phonetisaurus::phoneticize(vector <string> entry,
@@ -199,36 +204,36 @@ vector<PathData> Phonetisaurus::phoneticize(vector <string> entry,
        Generate pronunciation/spelling hypotheses for an
        input entry.
      */
-    StdVectorFst
-    result;
-    StdVectorFst
-    epsMapped;
-    StdVectorFst
-    shortest;
-    StdVectorFst
-    efst = entryToFSA(entry);
-    StdVectorFst
-    smbr;
-    Compose(efst, *g2pmodel, &result);
-
-    Project(&result, PROJECT_OUTPUT);
+    G2PWorkspace
+    ws;
+    return phoneticize(entry, nbest, beam, &ws);
+}
+
+vector<PathData> Phonetisaurus::phoneticize(const vector <string> &entry,
+        int nbest, int beam,
+        G2PWorkspace *ws)
+{
+    entryToFSA(entry, &ws->efst);
+    Compose(ws->efst, *g2pmodel, &ws->result);
+
+    Project(&ws->result, PROJECT_OUTPUT);
     if (nbest > 1) {
         //This is a cheesy hack.
-        ShortestPath(result, &shortest, beam);
+        ShortestPath(ws->result, &ws->shortest, beam);
     }
     else {
-        ShortestPath(result, &shortest, 1);
+        ShortestPath(ws->result, &ws->shortest, 1);
     }
-    RmEpsilon(&shortest);
+    RmEpsilon(&ws->shortest);
     FstPathFinder
     pathfinder(skipSeqs);
-    pathfinder.findAllStrings(shortest);
+    pathfinder.findAllStrings(ws->shortest);
 
     return pathfinder.paths;
 }
 
 void
-printPath(PathData * path, string onepath, int k, ofstream * hypfile,
+printPath(PathData * path, string onepath, int k, ostream * hypfile,
           string correct, string word, bool output_cost)
 {
     if (word != "") {
@@ -257,7 +262,7 @@ printPath(PathData * path, string onepath, int k, ofstream * hypfile,
 
 bool
 Phonetisaurus::printPaths(vector<PathData> paths, int nbest,
-                          ofstream * hypfile, string correct, string word,
+                          ostream * hypfile, string correct, string word,
                           bool output_cost)
 {
     /*
@@ -36,6 +36,14 @@
 using namespace fst;
 typedef PhiMatcher<SortedMatcher<Fst<StdArc> > > PM;
 
+//Scratch FSTs for phoneticize().  Each thread keeps one and reuses it
+// for every word it handles.
+struct G2PWorkspace {
+    StdVectorFst efst;
+    StdVectorFst result;
+    StdVectorFst shortest;
+};
+
 class Phonetisaurus {
     /*
        Load a G2P/P2G model and generate pronunciation/spelling
@@ -61,14 +69,19 @@ public:
     Phonetisaurus(const char *_g2pmodel_file);
 
     StdVectorFst entryToFSA(vector<string> entry);
+    void entryToFSA(const vector<string> &entry, StdVectorFst *efst);
 
     StdVectorFst makeEpsMapper();
 
     vector<PathData>  phoneticize(vector<string> entry, int nbest,
                                     int beam = 500);
+    //Same, with the caller's workspace.  The model is only read, so
+    // several threads can share one Phonetisaurus this way.
+    vector<PathData>  phoneticize(const vector<string> &entry, int nbest,
+                                    int beam, G2PWorkspace *ws);
 
     bool printPaths(vector<PathData> paths, int nbest,
-                    ofstream * hypfile, string correct = "", string word =
+                    ostream * hypfile, string correct = "", string word =
                         "", bool output_cost = true);
 
 private:
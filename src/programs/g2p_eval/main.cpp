@@ -6,7 +6,7 @@ using namespace std;
 
 const char helpstr[] =
     "Usage: g2p_eval -model MODEL -input INPUT [-output OUTPUT] [-isfile] [-output_cost] \n\
-		               [-nbest NBEST] [-beam BEAM] [-sep SEP] [-words] \n\
+		               [-nbest NBEST] [-beam BEAM] [-sep SEP] [-words] [-nthreads N] \n\
 		\n\
 		-model MODEL,   The input WFST G2P model. \n\
 		-input INPUT,   A word or test file. \n\
@@ -16,7 +16,8 @@ const char helpstr[] =
 		-nbest NBEST,   Output the N-best pronunciations. Defaults to 1. \n\
 		-beam BEAM,     N-best search beam. Defaults to 500. \n\
 		-sep SEP,       Separator token for input words. Defaults to ''. \n\
-		-words,         Output words with hypotheses. Defaults to false.";
+		-words,         Output words with hypotheses. Defaults to false. \n\
+		-nthreads N,    Threads for a test file. Defaults to 1.";
 
 int
 main(int argc, char *argv[])
@@ -44,6 +45,9 @@ main(int argc, char *argv[])
         {   "-words", ARG_BOOLEAN, "no",
             "Output words with hypotheses. Defaults to false."
         },
+        {   "-nthreads", ARG_INT32, "1",
+            "Number of threads to phoneticize a test file with. Defaults to 1."
+        },
         {NULL, 0, NULL, NULL}
     };
 
@@ -62,11 +66,12 @@ main(int argc, char *argv[])
     int beam = cmd_ln_int32("-beam");
     string sep = cmd_ln_str("-sep");
     bool words = cmd_ln_boolean("-words");
+    int nthreads = cmd_ln_int32("-nthreads");
 
     if (isfile) {
         //If its a file, go for it
         phoneticizeTestSet(model.c_str(), output.c_str(), input, nbest,
-                           sep, beam, words, output_cost);
+                           sep, beam, words, output_cost, nthreads);
     }
     else {
         //Otherwise we just have a word
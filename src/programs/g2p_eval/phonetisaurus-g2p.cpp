@@ -29,6 +29,9 @@
  */
 
 #include <iostream>
+#include <sstream>
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/err.h>
 #include "Phonetisaurus.hpp"
 #include "util.hpp"
 
@@ -71,10 +74,86 @@ phoneticizeWord(const char *g2pmodel_file, const char *output,
     return;
 }
 
+//Parameters and output of one phoneticizeTestSet() batch
+struct G2PBatch {
+    Phonetisaurus *phonetisaurus;
+    const char *output;
+    int nbest;
+    string sep;
+    int beam;
+    int output_words;
+    bool output_cost;
+    vector<string> words;
+    vector<string> prons;
+    //The hypothesis lines of words[i], written out in input order
+    vector<string> hyps;
+};
+
+//One batch thread: every step'th word from first, with its own workspace
+struct G2PBatchJob {
+    G2PBatch *batch;
+    G2PWorkspace *ws;
+    size_t first;
+    size_t step;
+};
+
+static void
+phoneticizeEntry(G2PBatch *batch, G2PWorkspace *ws, size_t w)
+{
+    Phonetisaurus *phonetisaurus = batch->phonetisaurus;
+    string word = batch->words[w];
+    string pron = batch->prons[w];
+    ostringstream hypfile;
+
+    vector <string> entry = tokenize_entry(&word, &batch->sep,
+                                           phonetisaurus->isyms);
+    vector<PathData> paths =
+        phonetisaurus->phoneticize(entry, batch->nbest, batch->beam, ws);
+    int nbest_new = batch->nbest;
+    if (batch->output_words == 0) {
+        while (phonetisaurus->
+                printPaths(paths, nbest_new, &hypfile, batch->output,
+                           pron) == true
+                && nbest_new <= paths.size()) {
+            nbest_new++;
+            paths =
+                phonetisaurus->phoneticize(entry, nbest_new, batch->beam, ws);
+        }
+    }
+    else {
+        while (phonetisaurus->
+                printPaths(paths, nbest_new, &hypfile, pron, word,
+                           batch->output_cost) == true
+                && nbest_new <= paths.size()) {
+            nbest_new++;
+            paths =
+                phonetisaurus->phoneticize(entry, nbest_new, batch->beam, ws);
+        }
+    }
+    batch->hyps[w] = hypfile.str();
+}
+
+static void
+phoneticizeRange(G2PBatchJob *job)
+{
+    for (size_t w = job->first; w < job->batch->words.size(); w += job->step)
+        phoneticizeEntry(job->batch, job->ws, w);
+}
+
+static int
+phoneticizeWorker(sbthread_t *th)
+{
+    phoneticizeRange((G2PBatchJob *) sbthread_arg(th));
+    return 0;
+}
+
+//Words read and phoneticized per thread in one batch
+static const size_t batch_words = 1024;
+
 void
 phoneticizeTestSet(const char *g2pmodel_file, const char *output,
-                   string testset_file, int nbest, string sep, int beam =
-                       500, int output_words = 0, bool output_cost = true)
+                   string testset_file, int nbest, string sep, int beam,
+                   int output_words, bool output_cost, int nthreads)
 {
 
     Phonetisaurus phonetisaurus(g2pmodel_file);
@@ -86,51 +165,71 @@ phoneticizeTestSet(const char *g2pmodel_file, const char *output,
     if (test_fp.is_open()) {
         ofstream hypfile;
         hypfile.open(output);
-        while (test_fp.good()) {
-            getline(test_fp, line);
-            if (line.compare("") == 0)
-                continue;
-
-            char *tmpstring = (char *) line.c_str();
-            char *p = strtok(tmpstring, "\t");
-            string word;
-            string pron;
-
-            int i = 0;
-            while (p) {
-                if (i == 0)
-                    word = p;
-                else
-                    pron = p;
-                i++;
-                p = strtok(NULL, "\t");
-            }
 
-            vector <string> entry = tokenize_entry(&word, &sep,
-                                                   phonetisaurus.isyms);
-            vector<PathData> paths =
-                phonetisaurus.phoneticize(entry, nbest, beam);
-            int nbest_new = nbest;
-            if (output_words == 0) {
-                while (phonetisaurus.
-                        printPaths(paths, nbest_new, &hypfile, output,
-                                   pron) == true
-                        && nbest_new <= paths.size()) {
-                    nbest_new++;
-                    paths =
-                        phonetisaurus.phoneticize(entry, nbest_new, beam);
-                }
-            }
-            else {
-                while (phonetisaurus.
-                        printPaths(paths, nbest_new, &hypfile, pron, word,
-                                   output_cost) == true
-                        && nbest_new <= paths.size()) {
-                    nbest_new++;
-                    paths =
-                        phonetisaurus.phoneticize(entry, nbest_new, beam);
+        //The threads share the model read-only.  Work out all its
+        // property bits now so that Compose() does not have to.
+        size_t n = nthreads > 1 ? nthreads : 1;
+        if (n > 1)
+            phonetisaurus.g2pmodel->Properties(kFstProperties, true);
+
+        G2PBatch batch;
+        batch.phonetisaurus = &phonetisaurus;
+        batch.output = output;
+        batch.nbest = nbest;
+        batch.sep = sep;
+        batch.beam = beam;
+        batch.output_words = output_words;
+        batch.output_cost = output_cost;
+        vector<G2PWorkspace> ws(n);
+        vector<G2PBatchJob> jobs(n);
+        vector<sbthread_t *> threads(n);
+        for (size_t k = 0; k < n; k++) {
+            jobs[k].batch = &batch;
+            jobs[k].ws = &ws[k];
+            jobs[k].first = k;
+            jobs[k].step = n;
+        }
+
+        while (test_fp.good()) {
+            //Read the next batch of words
+            batch.words.clear();
+            batch.prons.clear();
+            while (batch.words.size() < n * batch_words && test_fp.good()) {
+                getline(test_fp, line);
+                if (line.compare("") == 0)
+                    continue;
+
+                char *tmpstring = (char *) line.c_str();
+                char *p = strtok(tmpstring, "\t");
+                string word;
+                string pron;
+
+                int i = 0;
+                while (p) {
+                    if (i == 0)
+                        word = p;
+                    else
+                        pron = p;
+                    i++;
+                    p = strtok(NULL, "\t");
                 }
+                batch.words.push_back(word);
+                batch.prons.push_back(pron);
             }
+            batch.hyps.assign(batch.words.size(), string());
+
+            //Each thread takes every n'th word, so the output can be
+            // written in input order once they are all done
+            for (size_t k = 1; k < n; k++)
+                if ((threads[k] = sbthread_start(phoneticizeWorker,
+                                                 &jobs[k])) == NULL)
+                    E_FATAL("Failed to start g2p thread %d\n", (int) k);
+            phoneticizeRange(&jobs[0]);
+            for (size_t k = 1; k < n; k++)
+                sbthread_free(threads[k]);
+
+            for (size_t w = 0; w < batch.hyps.size(); w++)
+                hypfile << batch.hyps[w];
         }
         test_fp.close();
         hypfile.flush();
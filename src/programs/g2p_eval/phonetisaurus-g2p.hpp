@@ -8,4 +8,4 @@ void phoneticizeWord(const char *g2pmodel_file, const char *output,
 void phoneticizeTestSet(const char *g2pmodel_file, const char *output,
                         string testset_file, int nbest, string sep,
                         int beam = 500, int output_words =
-                            0, bool output_cost = true);
+                            0, bool output_cost = true, int nthreads = 1);
@@ -32,6 +32,8 @@
 #include <fst/fstlib.h>
 #include <iostream>
 #include <set>
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/err.h>
 #include "M2MFstAligner.hpp"
 
 //Begin Utility functions (these really need to go somewhere else
@@ -102,6 +104,11 @@ M2MFstAligner::get_max_length(string joint_label)
 M2MFstAligner::M2MFstAligner()
 {
     //Default constructor
+    nthreads = 1;
+    fsa_store = FSA_MEMORY;
+    arena_words = 0;
+    arena_fh = NULL;
+    arena_map = NULL;
 }
 
 M2MFstAligner::M2MFstAligner(bool _seq1_del, bool _seq2_del, int _seq1_max,
@@ -119,6 +126,11 @@ M2MFstAligner::M2MFstAligner(bool _seq1_del, bool _seq2_del, int _seq1_max,
     seq2_sep = _seq2_sep;
     s1s2_sep = _s1s2_sep;
     penalize = _penalize;
+    nthreads = 1;
+    fsa_store = FSA_MEMORY;
+    arena_words = 0;
+    arena_fh = NULL;
+    arena_map = NULL;
     eps = _eps;
     skip = _skip;
     skipSeqs.insert(eps);
@@ -147,15 +159,6 @@ M2MFstAligner::M2MFstAligner(bool _seq1_del, bool _seq2_del, int _seq1_max,
 M2MFstAligner::M2MFstAligner(string _model_file)
 {
     VectorFst<LogArc> *model = VectorFst<LogArc>::Read(_model_file);
-    for (StateIterator<VectorFst<LogArc> > siter(*model);
-            !siter.Done(); siter.Next()) {
-        LogArc::StateId q = siter.Value();
-        for (ArcIterator<VectorFst<LogArc> > aiter(*model, q);
-                !aiter.Done(); aiter.Next()) {
-            const LogArc & arc = aiter.Value();
-            alignment_model.insert(pair<LogArc::Label,LogWeight> (arc.ilabel, arc.weight));
-        }
-    }
     isyms = (SymbolTable *) model->InputSymbols();
     int i = 0;
     eps = isyms->Find(i);       //Can't write '0' here for some reason...
@@ -169,7 +172,137 @@ M2MFstAligner::M2MFstAligner(string _model_file)
     seq2_del = params[1].compare("true") ? false : true;
     seq1_max = atoi(params[2].c_str());
     seq2_max = atoi(params[3].c_str());
+    //The separators have to be known before add_label() splits the
+    // joint labels with get_max_length()
+    for (StateIterator<VectorFst<LogArc> > siter(*model);
+            !siter.Done(); siter.Next()) {
+        LogArc::StateId q = siter.Value();
+        for (ArcIterator<VectorFst<LogArc> > aiter(*model, q);
+                !aiter.Done(); aiter.Next()) {
+            const LogArc & arc = aiter.Value();
+            add_label(arc.ilabel, isyms->Find(arc.ilabel));
+            alignment_model[arc.ilabel] = arc.weight;
+        }
+    }
+    nthreads = 1;
+    fsa_store = FSA_MEMORY;
+    arena_words = 0;
+    arena_fh = NULL;
+    arena_map = NULL;
+}
+
+M2MFstAligner::~M2MFstAligner()
+{
+    if (arena_fh)
+        fclose(arena_fh);
+    if (arena_map)
+        mmio_file_unmap(arena_map);
+    //The mapped arena is scratch space for this run only
+    if (fsa_store == FSA_MMAP)
+        remove(fsa_file.c_str());
+}
+
+void
+M2MFstAligner::set_fsa_store(int store, string file)
+{
+    assert(num_fsas() == 0);
+    fsa_store = store;
+    if (fsa_store == FSA_MMAP) {
+        fsa_file = file;
+        if ((arena_fh = fopen(fsa_file.c_str(), "wb")) == NULL)
+            E_FATAL_SYSTEM("Failed to open FSA arena %s", fsa_file.c_str());
+    }
+}
+
+//Append the topology of fst to the arena.  The weights are not stored,
+// get_fsa() takes them from the current model.
+void
+M2MFstAligner::add_to_arena(const VectorFst<LogArc> &fst)
+{
+    vector<int32_t> rec;
+    int32_t nstates = fst.NumStates();
+    int32_t narcs = 0;
+
+    rec.resize(3 + nstates);
+    rec[0] = nstates;
+    rec[1] = -1;
+    for (int32_t q = 0; q < nstates; q++) {
+        rec[2 + q] = narcs;
+        narcs += fst.NumArcs(q);
+        if (fst.Final(q) != LogWeight::Zero())
+            rec[1] = q;
+    }
+    rec[2 + nstates] = narcs;
+    rec.reserve(rec.size() + 2 * narcs);
+    for (int32_t q = 0; q < nstates; q++) {
+        for (ArcIterator<VectorFst<LogArc> > aiter(fst, q);
+                !aiter.Done(); aiter.Next()) {
+            rec.push_back(aiter.Value().ilabel);
+            rec.push_back(aiter.Value().nextstate);
+        }
+    }
+
+    arena_index.push_back(arena_words);
+    arena_words += rec.size();
+    if (fsa_store == FSA_MMAP) {
+        if (fwrite(&rec[0], sizeof(int32_t), rec.size(), arena_fh)
+                != rec.size())
+            E_FATAL_SYSTEM("Failed to write FSA arena %s", fsa_file.c_str());
+    }
+    else
+        arena.insert(arena.end(), rec.begin(), rec.end());
+}
+
+//Finish writing the arena file and map it.  Not thread safe, so the
+// callers do this before any threads start.
+void
+M2MFstAligner::seal_arena()
+{
+    if (arena_fh == NULL)
+        return;
+    if (fclose(arena_fh) != 0)
+        E_FATAL_SYSTEM("Failed to write FSA arena %s", fsa_file.c_str());
+    arena_fh = NULL;
+    if (arena_words == 0)
+        return;
+    if ((arena_map = mmio_file_read(fsa_file.c_str())) == NULL)
+        E_FATAL("Failed to map FSA arena %s\n", fsa_file.c_str());
+}
 
+void
+M2MFstAligner::get_fsa(size_t i, VectorFst<LogArc> *fst)
+{
+    if (fsa_store == FSA_MEMORY) {
+        *fst = fsas[i];
+        return;
+    }
+    seal_arena();
+
+    const int32_t *rec;
+    if (fsa_store == FSA_MMAP)
+        rec = (const int32_t *) mmio_file_ptr(arena_map) + arena_index[i];
+    else
+        rec = &arena[0] + arena_index[i];
+    int32_t nstates = rec[0];
+    const int32_t *offsets = rec + 2;
+    const int32_t *arcs = offsets + nstates + 1;
+
+    fst->DeleteStates();
+    fst->ReserveStates(nstates);
+    for (int32_t q = 0; q < nstates; q++)
+        fst->AddState();
+    for (int32_t q = 0; q < nstates; q++) {
+        fst->ReserveArcs(q, offsets[q + 1] - offsets[q]);
+        for (int32_t a = offsets[q]; a < offsets[q + 1]; a++) {
+            LogArc::Label label = arcs[2 * a];
+            fst->AddArc(q, LogArc(label, label, alignment_model[label],
+                                  arcs[2 * a + 1]));
+        }
+    }
+    if (nstates > 0)
+        fst->SetStart(0);
+    if (rec[1] >= 0)
+        fst->SetFinal(rec[1], LogWeight::One());
 }
 
 void
@@ -179,49 +312,222 @@ M2MFstAligner::write_model(string _model_file)
     model.AddState();
     model.SetStart(0);
     model.SetFinal(0, LogWeight::One());
-    map<LogArc::Label,LogWeight>::iterator it;
-    for (it = alignment_model.begin(); it != alignment_model.end(); it++)
-        model.AddArc(0, LogArc((*it).first, (*it).first, (*it).second, 0));
+    for (size_t i = 0; i < alignment_model.size(); i++)
+        if (label_maxl[i] != -2)
+            model.AddArc(0, LogArc(i, i, alignment_model[i], 0));
     model.SetInputSymbols(isyms);
     model.Write(_model_file);
     return;
 }
 
-void
-M2MFstAligner::expectation()
+//One expectation thread: a share of the entries and its own tally
+struct EStepJob {
+    M2MFstAligner *aligner;
+    size_t first;
+    size_t step;
+};
+
+static int
+expectation_worker(sbthread_t *th)
 {
-    for (int i = 0; i < fsas.size(); i++) {
-        //Comput Forward and Backward probabilities
-        ShortestDistance(fsas.at(i), &alpha);
-        ShortestDistance(fsas.at(i), &beta, true);
+    EStepJob *job = (EStepJob *) sbthread_arg(th);
+    job->aligner->expectation_range(job->first, job->step);
+    return 0;
+}
 
-        //Compute the normalized Gamma probabilities and
-        // update our running tally
-        for (StateIterator<VectorFst<LogArc> > siter(fsas.at(i));
-                !siter.Done(); siter.Next()) {
-            LogArc::StateId q = siter.Value();
-            for (ArcIterator<VectorFst<LogArc> > aiter(fsas.at(i), q);
-                    !aiter.Done(); aiter.Next()) {
-                const LogArc & arc = aiter.Value();
-                const LogWeight & gamma =
-                    Divide(Times
-                           (Times(alpha[q], arc.weight),
-                            beta[arc.nextstate]), beta[0]);
-                //Check for any BadValue results, otherwise add to the tally.
-                //We call this 'prev_alignment_model' which may seem misleading, but
-                // this conventions leads to 'alignment_model' being the final version.
-                if (gamma.Value() == gamma.Value()) {
-                    prev_alignment_model[arc.ilabel] =
-                        Plus(prev_alignment_model[arc.ilabel], gamma);
-                    total = Plus(total, gamma);
+//Entries per expectation block.  This, not the number of threads,
+// decides how the additions are grouped.
+#define E_BLOCK 1024
+
+void
+M2MFstAligner::expectation_range(size_t first, size_t step)
+{
+    vector<LogWeight> alpha, beta;
+    VectorFst<LogArc> packed;
+    vector<LogWeight> tally(prev_alignment_model.size(), LogWeight::Zero());
+    vector<char> used(prev_alignment_model.size(), 0);
+    vector<LogArc::Label> labels;
+    size_t n_fsas = num_fsas();
+
+    for (size_t b = first; b * E_BLOCK < n_fsas; b += step) {
+        LogWeight tally_total = LogWeight::Zero();
+        for (size_t i = b * E_BLOCK; i < n_fsas && i < (b + 1) * E_BLOCK; i++) {
+            const VectorFst<LogArc> *fsa = &packed;
+            if (fsa_store == FSA_MEMORY)
+                fsa = &fsas.at(i);
+            else
+                get_fsa(i, &packed);
+
+            //Comput Forward and Backward probabilities
+            ShortestDistance(*fsa, &alpha);
+            ShortestDistance(*fsa, &beta, true);
+
+            //Compute the normalized Gamma probabilities and
+            // update our running tally
+            for (StateIterator<VectorFst<LogArc> > siter(*fsa);
+                    !siter.Done(); siter.Next()) {
+                LogArc::StateId q = siter.Value();
+                for (ArcIterator<VectorFst<LogArc> > aiter(*fsa, q);
+                        !aiter.Done(); aiter.Next()) {
+                    const LogArc & arc = aiter.Value();
+                    const LogWeight & gamma =
+                        Divide(Times
+                               (Times(alpha[q], arc.weight),
+                                beta[arc.nextstate]), beta[0]);
+                    //Check for any BadValue results, otherwise add to the tally.
+                    if (gamma.Value() == gamma.Value()) {
+                        if (!used[arc.ilabel]) {
+                            used[arc.ilabel] = 1;
+                            labels.push_back(arc.ilabel);
+                        }
+                        tally[arc.ilabel] = Plus(tally[arc.ilabel], gamma);
+                        tally_total = Plus(tally_total, gamma);
+                    }
                 }
             }
+            alpha.clear();
+            beta.clear();
+        }
+
+        //Keep only the labels this block used, and start the next one afresh
+        block_model[b].reserve(labels.size());
+        for (size_t k = 0; k < labels.size(); k++) {
+            block_model[b].push_back(make_pair(labels[k], tally[labels[k]]));
+            tally[labels[k]] = LogWeight::Zero();
+            used[labels[k]] = 0;
         }
-        alpha.clear();
-        beta.clear();
+        labels.clear();
+        block_total[b] = tally_total;
+    }
+}
+
+void
+M2MFstAligner::expectation()
+{
+    //The entries are independent, so they are tallied in blocks of
+    // E_BLOCK, and each thread takes every nthreads'th block.
+    // maximization() adds the block tallies up in block order, so the
+    // result is the same whatever the number of threads.
+    //We call the result 'prev_alignment_model' which may seem misleading, but
+    // this conventions leads to 'alignment_model' being the final version.
+    size_t n = nthreads > 1 ? nthreads : 1;
+    size_t n_blocks = (num_fsas() + E_BLOCK - 1) / E_BLOCK;
+    if (n > n_blocks)
+        n = n_blocks > 0 ? n_blocks : 1;
+    seal_arena();
+    block_model.assign(n_blocks, vector<pair<LogArc::Label, LogWeight> >());
+    block_total.assign(n_blocks, LogWeight::Zero());
+
+    if (n == 1) {
+        expectation_range(0, 1);
+        return;
+    }
+
+    vector<EStepJob> jobs(n);
+    vector<sbthread_t *> threads(n);
+    for (size_t k = 0; k < n; k++) {
+        jobs[k].aligner = this;
+        jobs[k].first = k;
+        jobs[k].step = n;
+    }
+    for (size_t k = 1; k < n; k++)
+        if ((threads[k] = sbthread_start(expectation_worker, &jobs[k])) == NULL)
+            E_FATAL("Failed to start expectation thread %d\n", (int) k);
+    expectation_range(0, n);
+    for (size_t k = 1; k < n; k++)
+        sbthread_free(threads[k]);
+}
+
+//Append the k tokens of seq starting at i, joined by sep
+static void
+append_span(string &sym, const vector<string> &seq, int i, int k,
+            const string &sep)
+{
+    for (int t = i; t < i + k; t++) {
+        if (t != i)
+            sym += sep;
+        sym += seq[t];
     }
 }
 
+void
+M2MFstAligner::add_label(LogArc::Label label, const string &sym)
+{
+    if (label >= (LogArc::Label) label_maxl.size()) {
+        alignment_model.resize(label + 1, LogWeight::Zero());
+        prev_alignment_model.resize(label + 1, LogWeight::Zero());
+        label_maxl.resize(label + 1, -2);
+    }
+    label_maxl[label] = get_max_length(sym);
+}
+
+void
+M2MFstAligner::intern_spans(const vector<string> &seq, int max_len,
+                            unordered_map<string,int> &tokens,
+                            unordered_map<uint64_t,int> &spans,
+                            vector<int> &ids)
+{
+    vector<int> tok(seq.size());
+    for (size_t i = 0; i < seq.size(); i++) {
+        unordered_map<string,int>::iterator it = tokens.find(seq[i]);
+        if (it == tokens.end())
+            it = tokens.insert(make_pair(seq[i], (int) tokens.size())).first;
+        tok[i] = it->second;
+    }
+
+    ids.assign(seq.size() * max_len, 0);
+    for (size_t i = 0; i < seq.size(); i++) {
+        int prefix = 0;
+        for (int k = 1; k <= max_len && i + k <= seq.size(); k++) {
+            uint64_t key = ((uint64_t) prefix << 32) | (uint32_t) tok[i + k - 1];
+            unordered_map<uint64_t,int>::iterator it = spans.find(key);
+            if (it == spans.end())
+                it = spans.insert(make_pair(key, (int) spans.size() + 1)).first;
+            prefix = it->second;
+            ids[i * max_len + k - 1] = prefix;
+        }
+    }
+}
+
+LogArc::Label
+M2MFstAligner::joint_label(int span1, int span2,
+                           const vector<string> &seq1, int i, int k,
+                           const vector<string> &seq2, int j, int l,
+                           bool init)
+{
+    uint64_t key = ((uint64_t) span1 << 32) | (uint32_t) span2;
+    unordered_map<uint64_t,LogArc::Label>::iterator it =
+        joint_labels.find(key);
+    if (it != joint_labels.end())
+        return it->second;
+
+    //First time we see this pair, so build its symbol once
+    string sym;
+    if (span1 == 0)
+        sym = skip;
+    else
+        append_span(sym, seq1, i, k, seq1_sep);
+    sym += s1s2_sep;
+    if (span2 == 0)
+        sym += skip;
+    else
+        append_span(sym, seq2, j, l, seq2_sep);
+
+    LogArc::Label is;
+    if (init) {
+        is = isyms->AddSymbol(sym);
+        add_label(is, sym);
+    }
+    else {
+        //Unknown subsequences are not cached; see write_alignment()
+        is = isyms->Find(sym);
+        if (is == kNoSymbol)
+            return is;
+    }
+    joint_labels.insert(make_pair(key, is));
+    return is;
+}
+
 void
 M2MFstAligner::Sequences2FST(VectorFst<LogArc> *fst,
                              vector<string> *seq1,
@@ -244,6 +550,10 @@ M2MFstAligner::Sequences2FST(VectorFst<LogArc> *fst,
      */
     int istate = 0;
     int ostate = 0;
+    vector<int> span1, span2;
+    intern_spans(*seq1, seq1_max, seq1_tokens, seq1_spans, span1);
+    intern_spans(*seq2, seq2_max, seq2_tokens, seq2_spans, span2);
+    fst->ReserveStates((seq1->size() + 1) * (seq2->size() + 1));
     for (int i = 0; i <= seq1->size(); i++) {
         for (int j = 0; j <= seq2->size(); j++) {
             fst->AddState();
@@ -253,28 +563,15 @@ M2MFstAligner::Sequences2FST(VectorFst<LogArc> *fst,
             if (seq1_del == true)
                 for (int l = 1; l <= seq2_max; l++) {
                     if (j + l <= seq2->size()) {
-                        vector<string> subseq2(seq2->begin() + j,
-                                                  seq2->begin() + j + l);
-                        string sym = skip + s1s2_sep +
-                            vec2str(subseq2, seq2_sep);
-                        int is =
-                            isyms->AddSymbol(sym);
+                        int is = joint_label(0, span2[j * seq2_max + l - 1],
+                                             *seq1, i, 0, *seq2, j, l, true);
                         ostate = i * (seq2->size() + 1) + (j + l);
                         //LogArc arc( is, is, LogWeight::One().Value()*(l+1)*2, ostate );
                         LogArc arc(is, is, 99, ostate);
                         //LogArc arc( is, is, LogWeight::Zero(), ostate );
                         fst->AddArc(istate, arc);
-                        if (prev_alignment_model.find(arc.ilabel) ==
-                                prev_alignment_model.end())
-                            prev_alignment_model.insert(pair <
-                                                        LogArc::Label,
-                                                        LogWeight >
-                                                        (arc.ilabel,
-                                                         arc.weight));
-                        else
-                            prev_alignment_model[arc.ilabel] =
-                                Plus(prev_alignment_model[arc.ilabel],
-                                     arc.weight);
+                        prev_alignment_model[is] =
+                            Plus(prev_alignment_model[is], arc.weight);
                         total = Plus(total, arc.weight);
                     }
                 }
@@ -283,28 +580,15 @@ M2MFstAligner::Sequences2FST(VectorFst<LogArc> *fst,
             if (seq2_del == true)
                 for (int k = 1; k <= seq1_max; k++) {
                     if (i + k <= seq1->size()) {
-                        vector<string> subseq1(seq1->begin() + i,
-                                                  seq1->begin() + i + k);
-                        string sym = vec2str(subseq1, seq1_sep) +
-                            s1s2_sep + skip;
-                        int is =
-                            isyms->AddSymbol(sym);
+                        int is = joint_label(span1[i * seq1_max + k - 1], 0,
+                                             *seq1, i, k, *seq2, j, 0, true);
                         ostate = (i + k) * (seq2->size() + 1) + j;
                         //LogArc arc( is, is, LogWeight::One().Value()*(k+1)*2, ostate );
                         LogArc arc(is, is, 99, ostate);
                         //LogArc arc( is, is, LogWeight::Zero(), ostate );
                         fst->AddArc(istate, arc);
-                        if (prev_alignment_model.find(arc.ilabel) ==
-                                prev_alignment_model.end())
-                            prev_alignment_model.insert(pair <
-                                                        LogArc::Label,
-                                                        LogWeight >
-                                                        (arc.ilabel,
-                                                         arc.weight));
-                        else
-                            prev_alignment_model[arc.ilabel] =
-                                Plus(prev_alignment_model[arc.ilabel],
-                                     arc.weight);
+                        prev_alignment_model[is] =
+                            Plus(prev_alignment_model[is], arc.weight);
                         total = Plus(total, arc.weight);
                     }
                 }
@@ -312,17 +596,12 @@ M2MFstAligner::Sequences2FST(VectorFst<LogArc> *fst,
             //All the other arcs
             for (int k = 1; k <= seq1_max; k++) {
                 for (int l = 1; l <= seq2_max; l++) {
+                    if (l > 1 && k > 1)
+                        continue;
                     if (i + k <= seq1->size() && j + l <= seq2->size()) {
-                        vector<string> subseq1(seq1->begin() + i,
-                                               seq1->begin() + i + k);
-                        string s1 = vec2str(subseq1, seq1_sep);
-                        vector<string> subseq2(seq2->begin() + j,
-                                               seq2->begin() + j + l);
-                        string s2 = vec2str(subseq2, seq2_sep);
-                        if (l > 1 && k > 1)
-                            continue;
-                        string sym = s1 + s1s2_sep + s2;
-                        int is = isyms->AddSymbol(sym);
+                        int is = joint_label(span1[i * seq1_max + k - 1],
+                                             span2[j * seq2_max + l - 1],
+                                             *seq1, i, k, *seq2, j, l, true);
                         ostate = (i + k) * (seq2->size() + 1) + (j + l);
                         LogArc arc(is, is,
                                    LogWeight::One().Value() * (k + l),
@@ -332,17 +611,8 @@ M2MFstAligner::Sequences2FST(VectorFst<LogArc> *fst,
                         //During the initialization phase, just count non-eps transitions
                         //We currently initialize to uniform probability so there is also
                         // no need to tally anything here.
-                        if (prev_alignment_model.find(arc.ilabel) ==
-                                prev_alignment_model.end())
-                            prev_alignment_model.insert(pair <
-                                                        LogArc::Label,
-                                                        LogWeight >
-                                                        (arc.ilabel,
-                                                         arc.weight));
-                        else
-                            prev_alignment_model[arc.ilabel] =
-                                Plus(prev_alignment_model[arc.ilabel],
-                                     arc.weight);
+                        prev_alignment_model[is] =
+                            Plus(prev_alignment_model[is], arc.weight);
                         total = Plus(total, arc.weight);
                     }
                 }
@@ -381,6 +651,10 @@ M2MFstAligner::Sequences2FSTNoInit(VectorFst<LogArc> *fst,
      */
     int istate = 0;
     int ostate = 0;
+    vector<int> span1, span2;
+    intern_spans(*seq1, seq1_max, seq1_tokens, seq1_spans, span1);
+    intern_spans(*seq2, seq2_max, seq2_tokens, seq2_spans, span2);
+    fst->ReserveStates((seq1->size() + 1) * (seq2->size() + 1));
     for (int i = 0; i <= seq1->size(); i++) {
         for (int j = 0; j <= seq2->size(); j++) {
             fst->AddState();
@@ -390,11 +664,8 @@ M2MFstAligner::Sequences2FSTNoInit(VectorFst<LogArc> *fst,
             if (seq1_del == true)
                 for (int l = 1; l <= seq2_max; l++) {
                     if (j + l <= seq2->size()) {
-                        vector<string> subseq2(seq2->begin() + j,
-                                                  seq2->begin() + j + l);
-                        int is =
-                            isyms->Find(skip + s1s2_sep +
-                                        vec2str(subseq2, seq2_sep));
+                        int is = joint_label(0, span2[j * seq2_max + l - 1],
+                                             *seq1, i, 0, *seq2, j, l, false);
                         ostate = i * (seq2->size() + 1) + (j + l);
                         //LogArc arc( is, is, LogWeight::One().Value()*(l+1)*2, ostate );
                         LogArc arc(is, is, 99, ostate);
@@ -406,11 +677,8 @@ M2MFstAligner::Sequences2FSTNoInit(VectorFst<LogArc> *fst,
             if (seq2_del == true)
                 for (int k = 1; k <= seq1_max; k++) {
                     if (i + k <= seq1->size()) {
-                        vector<string> subseq1(seq1->begin() + i,
-                                                  seq1->begin() + i + k);
-                        int is =
-                            isyms->Find(vec2str(subseq1, seq1_sep) +
-                                        s1s2_sep + skip);
+                        int is = joint_label(span1[i * seq1_max + k - 1], 0,
+                                             *seq1, i, k, *seq2, j, 0, false);
                         ostate = (i + k) * (seq2->size() + 1) + j;
                         //LogArc arc( is, is, LogWeight::One().Value()*(k+1)*2, ostate );
                         LogArc arc(is, is, 99, ostate);
@@ -421,16 +689,12 @@ M2MFstAligner::Sequences2FSTNoInit(VectorFst<LogArc> *fst,
             //All the other arcs
             for (int k = 1; k <= seq1_max; k++) {
                 for (int l = 1; l <= seq2_max; l++) {
+                    if (l > 1 && k > 1)
+                        continue;
                     if (i + k <= seq1->size() && j + l <= seq2->size()) {
-                        vector<string> subseq1(seq1->begin() + i,
-                                                  seq1->begin() + i + k);
-                        string s1 = vec2str(subseq1, seq1_sep);
-                        vector<string> subseq2(seq2->begin() + j,
-                                                  seq2->begin() + j + l);
-                        string s2 = vec2str(subseq2, seq2_sep);
-                        if (l > 1 && k > 1)
-                            continue;
-                        int is = isyms->Find(s1 + s1s2_sep + s2);
+                        int is = joint_label(span1[i * seq1_max + k - 1],
+                                             span2[j * seq2_max + l - 1],
+                                             *seq1, i, k, *seq2, j, l, false);
                         ostate = (i + k) * (seq2->size() + 1) + (j + l);
                         LogArc arc(is, is,
                                    LogWeight::One().Value() * (k + l),
@@ -460,7 +724,10 @@ M2MFstAligner::entry2alignfst(vector<string> seq1,
 {
     VectorFst<LogArc> fst;
     Sequences2FST(&fst, &seq1, &seq2);
-    fsas.push_back(fst);
+    if (fsa_store == FSA_MEMORY)
+        fsas.push_back(fst);
+    else
+        add_to_arena(fst);
     return;
 }
 
@@ -482,17 +749,31 @@ M2MFstAligner::maximization(bool lastiter)
 {
     //Maximization. Simple count normalization.  Probably get an improvement
     // by using a more sophisticated regularization approach.
-    map<LogArc::Label,LogWeight>::iterator it;
+    size_t n_labels = prev_alignment_model.size();
+
+    //Fold in the tallies of the expectation blocks, in order
+    for (size_t b = 0; b < block_model.size(); b++) {
+        for (size_t k = 0; k < block_model[b].size(); k++) {
+            LogArc::Label l = block_model[b][k].first;
+            prev_alignment_model[l] =
+                Plus(prev_alignment_model[l], block_model[b][k].second);
+        }
+        total = Plus(total, block_total[b]);
+    }
+    block_model.clear();
+    block_total.clear();
+
     float change = abs(total.Value() - prevTotal.Value());
     //cout << "Total: " << total << " Change: " << abs(total.Value()-prevTotal.Value()) << endl;
     prevTotal = total;
 
     //Normalize and iterate to the next model.  We apply it dynamically
     // during the expectation step.
-    for (it = prev_alignment_model.begin();
-            it != prev_alignment_model.end(); it++) {
-        alignment_model[(*it).first] = Divide((*it).second, total);
-        (*it).second = LogWeight::Zero();
+    for (size_t l = 0; l < n_labels; l++) {
+        if (label_maxl[l] == -2)
+            continue;
+        alignment_model[l] = Divide(prev_alignment_model[l], total);
+        prev_alignment_model[l] = LogWeight::Zero();
     }
 
     for (int i = 0; i < fsas.size(); i++) {
@@ -515,6 +796,8 @@ int
 M2MFstAligner::num_fsas()
 {
     //A getter function because I'm retarded.
+    if (fsa_store != FSA_MEMORY)
+        return arena_index.size();
     return fsas.size();
 }
 
@@ -557,8 +840,15 @@ vector<PathData> M2MFstAligner::write_alignment(const VectorFst<LogArc> &ifst,
             // occurred in the original model.
             StdArc
             arc = aiter.Value();
+            //Labels that are not in the model (never seen in training)
+            // get LogWeight::Zero(), which is reset to 999 below.
+            bool
+            known = arc.ilabel >= 0
+                && arc.ilabel < (StdArc::Label) label_maxl.size()
+                && label_maxl[arc.ilabel] != -2;
             int
-            maxl = get_max_length(isyms->Find(arc.ilabel));
+            maxl = known ? label_maxl[arc.ilabel]
+                : get_max_length(isyms->Find(arc.ilabel));
             if (maxl == -1) {
                 arc.weight = 999;
             }
@@ -570,7 +860,9 @@ vector<PathData> M2MFstAligner::write_alignment(const VectorFst<LogArc> &ifst,
                 // alignment corpus results in a more flexible joint n-gram model
                 // with regard to previously unseen data.
                 //if( penalize==true ){
-                arc.weight = alignment_model[arc.ilabel].Value() * maxl;
+                arc.weight = known
+                    ? alignment_model[arc.ilabel].Value() * maxl
+                    : LogWeight::Zero().Value();
                 //}else{
                 //For larger corpora this is probably unnecessary.
                 //arc.weight = alignment_model[arc.ilabel].Value();
@@ -612,8 +904,8 @@ void
 M2MFstAligner::write_all_alignments(int nbest)
 {
     //Convenience function for the python bindings
-    for (int i = 0; i < fsas.size(); i++)
-        write_alignment(fsas[i], nbest);
+    for (int i = 0; i < num_fsas(); i++)
+        write_alignment_wrapper(i, nbest);
 
     return;
 }
@@ -622,7 +914,11 @@ vector<PathData> M2MFstAligner::write_alignment_wrapper(int i,
         int nbest)
 {
     //Wrapper for the python bindings.
-    return write_alignment(fsas[i], nbest);
+    if (fsa_store == FSA_MEMORY)
+        return write_alignment(fsas[i], nbest);
+    VectorFst<LogArc> fsa;
+    get_fsa(i, &fsa);
+    return write_alignment(fsa, nbest);
 }
 
 void
@@ -647,9 +943,15 @@ M2MFstAligner::write_lattice(string lattice)
     ufst.AddState();
     ufst.SetStart(0);
     int total_states = 0;
-    for (int i = 0; i < fsas.size(); i++) {
-        TopSort(&fsas[i]);
-        for (StateIterator<VectorFst<LogArc> > siter(fsas[i]);
+    VectorFst<LogArc> packed;
+    for (int i = 0; i < num_fsas(); i++) {
+        VectorFst<LogArc> *fsa = &packed;
+        if (fsa_store == FSA_MEMORY)
+            fsa = &fsas[i];
+        else
+            get_fsa(i, &packed);
+        TopSort(fsa);
+        for (StateIterator<VectorFst<LogArc> > siter(*fsa);
                 !siter.Done(); siter.Next()) {
             LogArc::StateId q = siter.Value();
             LogArc::StateId r;
@@ -658,17 +960,17 @@ M2MFstAligner::write_lattice(string lattice)
             else
                 r = ufst.AddState();
 
-            for (ArcIterator <VectorFst<LogArc> > aiter(fsas[i], q);
+            for (ArcIterator <VectorFst<LogArc> > aiter(*fsa, q);
                     !aiter.Done(); aiter.Next()) {
                 const LogArc & arc = aiter.Value();
                 ufst.AddArc(r,
                             LogArc(arc.ilabel, arc.ilabel, arc.weight,
                                    arc.nextstate + total_states));
             }
-            if (fsas[i].Final(q) != LogWeight::Zero())
+            if (fsa->Final(q) != LogWeight::Zero())
                 ufst.SetFinal(r, LogWeight::One());
         }
-        total_states += fsas[i].NumStates() - 1;
+        total_states += fsa->NumStates() - 1;
     }
     //Normalize weights
     Push(&ufst, REWEIGHT_TO_INITIAL);
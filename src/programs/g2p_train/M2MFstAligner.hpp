@@ -32,6 +32,10 @@
 */
 #include <fst/fstlib.h>
 #include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <stdio.h>
+#include <sphinxbase/mmio.h>
 #include "FstPathFinder.hpp"
 using namespace std;
 
@@ -64,22 +68,56 @@ public:
     string eps;
     string skip;
     bool penalize;
+    int nthreads;
     vector<LogWeight> alpha, beta;
     //This will be used during decoding to clean the paths
     set<string> skipSeqs;
     //OpenFst stuff
     //These will be overwritten after each FST construction
     vector<VectorFst<LogArc> > fsas;
+    //Where the training FSAs live.  FSA_MEMORY keeps them in fsas.
+    // FSA_ARENA packs their topology into one array and get_fsa()
+    // rebuilds an FSA with the current model weights when it is needed.
+    // FSA_MMAP writes the same records to fsa_file and maps it.
+    enum { FSA_MEMORY, FSA_ARENA, FSA_MMAP };
+    int fsa_store;
+    string fsa_file;
+    //Arena records, one per entry at arena_index[i] (in words):
+    // nstates, final state, nstates+1 arc offsets, (label, nextstate)
+    // for each arc.
+    vector<int32_t> arena;
+    vector<uint64_t> arena_index;
+    uint64_t arena_words;
+    FILE *arena_fh;
+    mmio_file_t *arena_map;
 
     //This will be maintained for the life of object
     //These symbol tables will be maintained entire life of
     // the object.  This will ensure that any resulting 'corpus'
     // shares the same symbol tables.
     SymbolTable *isyms;
-    map<LogArc::Label,LogWeight> alignment_model;
-    map<LogArc::Label,LogWeight> prev_alignment_model;
+    //The models are indexed directly by arc label, which are the dense
+    // isyms ids.  label_maxl holds get_max_length() of each joint label,
+    // or -2 for ids that are not in the model (the reserved symbols).
+    vector<LogWeight> alignment_model;
+    vector<LogWeight> prev_alignment_model;
+    vector<int> label_maxl;
     LogWeight total;
     LogWeight prevTotal;
+    //Expectation tallies, one per block of entries, as (label, weight)
+    // pairs for the labels the block used.  The blocks do not depend on
+    // the number of threads and maximization() folds them into
+    // prev_alignment_model and total in order, so neither do the sums.
+    vector<vector<pair<LogArc::Label, LogWeight> > > block_model;
+    vector<LogWeight> block_total;
+    //Interned subsequences.  Tokens of each side get dense ids, and a
+    // span id is looked up from its prefix span and its last token, so
+    // (i,k) subsequences are found without building strings.  Span 0
+    // is the skip; joint_labels maps a (seq1 span, seq2 span) pair
+    // to its arc label.
+    unordered_map<string,int> seq1_tokens, seq2_tokens;
+    unordered_map<uint64_t,int> seq1_spans, seq2_spans;
+    unordered_map<uint64_t,LogArc::Label> joint_labels;
 
     //Constructors
     M2MFstAligner();
@@ -88,6 +126,16 @@ public:
                   string _s1s2_sep, string _eps, string _skip,
                   bool _penalize);
     M2MFstAligner(string _model_file);
+    ~M2MFstAligner();
+
+    //Choose the FSA storage; call before adding any entries
+    void set_fsa_store(int store, string file = "");
+    //Build entry i's FSA into fst, whatever the storage.  Arena FSAs
+    // carry the current alignment_model weights, so maximization() has
+    // to run once after the entries are added, as align() does.
+    void get_fsa(size_t i, VectorFst<LogArc> *fst);
+    void add_to_arena(const VectorFst<LogArc> &fst);
+    void seal_arena();
 
     //Write an aligner model to disk.  Critical info is stored in the
     // the symbol table so that it can be restored when the model is loaded.
@@ -110,6 +158,9 @@ public:
     vector<PathData> write_alignment_wrapper(int i, int nbest);
     //The expectation routine
     void expectation();
+    //Expectation over blocks first, first+step, ..., each into its own
+    // block_model and block_total entry
+    void expectation_range(size_t first, size_t step);
     //The maximization routine.  Returns the change since the last iteration
     float maximization(bool lastiter);
     //Print out the EM-optimized alignment for the training data
@@ -121,6 +172,19 @@ public:
     void write_all_alignments(int nbest);
     //max routine
     int get_max_length(string joint_label);
+    //Make room for a new joint label in the model
+    void add_label(LogArc::Label label, const string &sym);
+    //Span ids of every subsequence of seq of up to max_len tokens,
+    // as ids[i*max_len+k-1]
+    void intern_spans(const vector<string> &seq, int max_len,
+                      unordered_map<string,int> &tokens,
+                      unordered_map<uint64_t,int> &spans,
+                      vector<int> &ids);
+    //Arc label of a pair of spans; NoInit only looks it up in isyms
+    LogArc::Label joint_label(int span1, int span2,
+                              const vector<string> &seq1, int i, int k,
+                              const vector<string> &seq2, int j, int l,
+                              bool init);
     int num_fsas();
 
 };
@@ -428,7 +428,7 @@ train_model(string eps, string s1s2_sep, string skip, int order,
 void
 align(string input_file, string prefix, bool seq1_del, bool seq2_del,
       int seq1_max, int seq2_max, string seq_sep, string s1s2_sep,
-      string eps, string skip, int iter)
+      string eps, string skip, int iter, int nthreads, string fsa_store)
 {
 
     ifstream dict(input_file.c_str(), ifstream::in);
@@ -437,6 +437,13 @@ align(string input_file, string prefix, bool seq1_del, bool seq2_del,
     cout << "Loading..." << endl;
     M2MFstAligner fstaligner(seq1_del, seq2_del, seq1_max, seq2_max,
                              seq_sep, seq_sep, s1s2_sep, eps, skip, true);
+    fstaligner.nthreads = nthreads;
+    if (fsa_store == "arena")
+        fstaligner.set_fsa_store(M2MFstAligner::FSA_ARENA);
+    else if (fsa_store == "mmap")
+        fstaligner.set_fsa_store(M2MFstAligner::FSA_MMAP, prefix + ".fsa");
+    else if (fsa_store != "memory")
+        E_FATAL("Bad FSA storage: %s\n", fsa_store.c_str());
 
     string sep1 = "";
     string sep2 = " ";
@@ -472,9 +479,9 @@ align(string input_file, string prefix, bool seq1_del, bool seq2_del,
     cout << "Iteration " << i << ": " << change << endl;
 
     cout << "Generating best alignments..." << endl;
-    for (int i = 0; i < fstaligner.fsas.size(); i++) {
+    for (int i = 0; i < fstaligner.num_fsas(); i++) {
         vector<PathData> paths =
-            fstaligner.write_alignment(fstaligner.fsas[i], 1);
+            fstaligner.write_alignment_wrapper(i, 1);
         for (int k = 0; k < paths.size(); k++) {
             for (int j = 0; j < paths[k].path.size(); j++) {
                 ofile << paths[k].path[j];
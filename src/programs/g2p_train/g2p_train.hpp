@@ -44,7 +44,8 @@ void split(string input_file, string prefix, int ratio);
 
 void align(string input_file, string prefix, bool seq1_del, bool seq2_del,
            int seq1_max, int seq2_max, string seq_sep, string s1s2_sep,
-           string eps, string skip, int iter);
+           string eps, string skip, int iter, int nthreads,
+           string fsa_store);
 
 void train_model(string eps, string s1s2_sep, string skip, int order,
                  string smooth, string prefix, string seq_sep,
@@ -71,6 +71,12 @@ main(int argc, char *argv[])
         {   "-iter", ARG_INT32, "10",
             "Maximum number of iterations for EM"
         },
+        {   "-nthreads", ARG_INT32, "1",
+            "Number of threads for the EM expectation step"
+        },
+        {   "-fsa_store", ARG_STRING, "memory",
+            "Where the alignment FSAs are kept during EM. Available options are: 'memory' (fastest), 'arena' (compact, rebuilt on each use), 'mmap' (arena in PREFIX.fsa, mapped from disk)"
+        },
         {"-order", ARG_INT32, "6", "N-gram order"},
         {   "-prune", ARG_STRING, "no",
             "Pruning method. Available options are: 'no', 'count_prune', 'relative_entropy', 'seymore'"
@@ -115,6 +121,8 @@ main(int argc, char *argv[])
     string eps = "<eps>";
     string skip = "_";
     int iter = cmd_ln_int32("-iter");
+    int nthreads = cmd_ln_int32("-nthreads");
+    string fsa_store = cmd_ln_str("-fsa_store");
     int ratio = cmd_ln_int32("-ratio");
     int order = cmd_ln_int32("-order");
     string smooth = cmd_ln_str("-smooth");
@@ -146,7 +154,7 @@ main(int argc, char *argv[])
         cout << "Using dictionary: " << input_file << endl;
         align(input_file, prefix, seq1_del, seq2_del, seq1_max,
               seq2_max, seq_sep, s1s2_sep,
-              eps, skip, iter);
+              eps, skip, iter, nthreads, fsa_store);
     }
 
     train_model(eps, s1s2_sep, skip, order, smooth, prefix, seq_sep, prune,
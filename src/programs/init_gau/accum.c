@@ -205,3 +205,134 @@ accum_state_fullvar(vector_t ****var,
     return 0;
 }
 
+
+/*
+ * Single-pass accumulation: keeps a running mean and the sum of
+ * squared deviations from it (Welford's update), so that the
+ * variance can be estimated without a second pass over the corpus
+ * and without the cancellation of the sum(x^2) - n*mean^2 form.
+ */
+static void
+welford_update(vector_t mean,
+	       vector_t var,
+	       float32 *dnom,
+	       vector_t x,
+	       uint32 veclen)
+{
+    uint32 c;
+    float64 n, d;
+
+    n = (*dnom += 1.0);
+    for (c = 0; c < veclen; c++) {
+	d = x[c] - mean[c];
+	mean[c] += d / n;
+	var[c] += d * (x[c] - mean[c]);
+    }
+}
+
+int
+accum_state_meanvar(vector_t ***mean,
+		    vector_t ***var,
+		    float32 ***dnom,
+		    vector_t **feat,
+		    uint32 n_feat,
+		    const uint32 *veclen,
+		    uint32 *sseq,
+		    uint32 *ci_sseq,
+		    uint32 n_frame)
+{
+    uint32 t;		/* time (in frames) */
+    uint32 s;		/* a tied state */
+    uint32 ci_s;	/* a CI tied state */
+    uint32 f;		/* a feature stream idx */
+
+    for (t = 0; t < n_frame; t++) {
+	if (sseq && ci_sseq) {
+	    s = sseq[t];
+	    ci_s = ci_sseq[t];
+	}
+	else {
+	    s = 0;
+	    ci_s = 0;
+	}
+
+	for (f = 0; f < n_feat; f++) {
+	    welford_update(mean[s][f][0], var[s][f][0], &dnom[s][f][0],
+			   feat[t][f], veclen[f]);
+	    if (s != ci_s) {
+		welford_update(mean[ci_s][f][0], var[ci_s][f][0],
+			       &dnom[ci_s][f][0], feat[t][f], veclen[f]);
+	    }
+	}
+    }
+    return 0;
+}
+
+static void
+welford_update_full(vector_t mean,
+		    vector_t *var,
+		    float32 *dnom,
+		    vector_t x,
+		    float64 *d,
+		    uint32 veclen)
+{
+    uint32 c, cc;
+    float64 n;
+
+    n = (*dnom += 1.0);
+    for (c = 0; c < veclen; c++) {
+	d[c] = x[c] - mean[c];
+	mean[c] += d[c] / n;
+    }
+    for (c = 0; c < veclen; c++) {
+	for (cc = 0; cc < veclen; cc++) {
+	    var[c][cc] += d[c] * (x[cc] - mean[cc]);
+	}
+    }
+}
+
+int
+accum_state_meanfullvar(vector_t ***mean,
+			vector_t ****var,
+			float32 ***dnom,
+			vector_t **feat,
+			uint32 n_feat,
+			const uint32 *veclen,
+			uint32 *sseq,
+			uint32 *ci_sseq,
+			uint32 n_frame)
+{
+    uint32 t;		/* time (in frames) */
+    uint32 s;		/* a tied state */
+    uint32 ci_s;	/* a CI tied state */
+    uint32 f;		/* a feature stream idx */
+    uint32 maxlen;
+    float64 *d;
+
+    for (f = 0, maxlen = 0; f < n_feat; f++)
+	if (veclen[f] > maxlen)
+	    maxlen = veclen[f];
+    d = ckd_calloc(maxlen, sizeof(float64));
+
+    for (t = 0; t < n_frame; t++) {
+	if (sseq && ci_sseq) {
+	    s = sseq[t];
+	    ci_s = ci_sseq[t];
+	}
+	else {
+	    s = 0;
+	    ci_s = 0;
+	}
+
+	for (f = 0; f < n_feat; f++) {
+	    welford_update_full(mean[s][f][0], var[s][f][0], &dnom[s][f][0],
+				feat[t][f], d, veclen[f]);
+	    if (s != ci_s) {
+		welford_update_full(mean[ci_s][f][0], var[ci_s][f][0],
+				    &dnom[ci_s][f][0], feat[t][f], d, veclen[f]);
+	    }
+	}
+    }
+    ckd_free(d);
+    return 0;
+}
@@ -72,5 +72,27 @@ accum_state_fullvar(vector_t ****var_acc,
 		    uint32 *ci_sseq,
 		    uint32 n_frame);
 
+int
+accum_state_meanvar(vector_t ***mean,
+		    vector_t ***var_acc,
+		    float32  ***dnom,
+		    vector_t **f,
+		    uint32 n_feat,
+		    const uint32 *veclen,
+		    uint32 *sseq,
+		    uint32 *ci_sseq,
+		    uint32 n_frame);
+
+int
+accum_state_meanfullvar(vector_t ***mean,
+			vector_t ****var_acc,
+			float32  ***dnom,
+			vector_t **f,
+			uint32 n_feat,
+			const uint32 *veclen,
+			uint32 *sseq,
+			uint32 *ci_sseq,
+			uint32 n_frame);
+
 #endif /* ACCUM_H */ 
 
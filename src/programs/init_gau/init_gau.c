@@ -104,6 +104,7 @@ init_gau(lexicon_t *lex,
     const uint32 *veclen;
 
     uint32 n_ts;
+    uint32 i, j, l;
 
     uint32 *r_veclen;
     uint32 r_n_ts;
@@ -116,6 +117,7 @@ init_gau(lexicon_t *lex,
 
     uint32 ceplen = cmd_ln_int32("-ceplen");
     int32 var_is_full = cmd_ln_int32("-fullvar");
+    int32 onepass = cmd_ln_boolean("-onepass");
 
     if (mdef) {
 	acmod_set = mdef->acmod_set;
@@ -131,17 +133,34 @@ init_gau(lexicon_t *lex,
     veclen = (uint32 *)feat_stream_lengths(feat);
     
     if (meanfn == NULL) {
-	E_INFO("Computing %ux%ux1 mean estimates\n", n_ts, feat_dimension1(feat));
+	E_INFO("Computing %ux%ux1 mean%s estimates\n", n_ts, feat_dimension1(feat),
+	       onepass ? " and variance" : "");
     
 	mean_acc = gauden_alloc_param(n_ts,
 				      feat_dimension1(feat),
 				      1,
 				      veclen);
 	var_acc = NULL;
+	if (onepass) {
+	    if (var_is_full)
+		fullvar_acc = gauden_alloc_param_full(n_ts,
+						      feat_dimension1(feat),
+						      1,
+						      veclen);
+	    else
+		var_acc = gauden_alloc_param(n_ts,
+					     feat_dimension1(feat),
+					     1,
+					     veclen);
+	}
     }
     else {
 	assert(meanfn != NULL);
 
+	if (onepass) {
+	    E_FATAL("-onepass computes its own means, -meanfn cannot be used with it\n");
+	}
+
 	E_INFO("Computing %ux%ux1 variance estimates\n", n_ts, feat_dimension1(feat));
 
 
@@ -279,7 +298,14 @@ init_gau(lexicon_t *lex,
 	    E_FATAL("# frames compute != # frames of state seg\n");
 	}
 
-	if (mean_acc) {
+	if (mean_acc && var_acc) {
+	    /* running means and centered variance sums in one pass */
+	    accum_state_meanvar(mean_acc, var_acc, dnom, f, feat_dimension1(feat), veclen, sseq, ci_sseq, n_frame);
+	}
+	else if (mean_acc && fullvar_acc) {
+	    accum_state_meanfullvar(mean_acc, fullvar_acc, dnom, f, feat_dimension1(feat), veclen, sseq, ci_sseq, n_frame);
+	}
+	else if (mean_acc) {
 	    /* accumulate mean sums since no estimate given */
 	    accum_state_mean(mean_acc, dnom, f, feat_dimension1(feat), veclen, sseq, ci_sseq, n_frame);
 	}
@@ -295,15 +321,29 @@ init_gau(lexicon_t *lex,
     
     fn = ckd_calloc(strlen(cmd_ln_str("-accumdir")) + strlen("/gauden_counts") + 1, 1);
     sprintf(fn, "%s/gauden_counts", cmd_ln_str("-accumdir"));
+
+    if (onepass) {
+	/* norm expects unnormalized mean sums, so that parts can be
+	   added together */
+	for (i = 0; i < n_ts; i++) {
+	    for (j = 0; j < feat_dimension1(feat); j++) {
+		for (l = 0; l < veclen[j]; l++) {
+		    mean_acc[i][j][0][l] *= dnom[i][j][0];
+		}
+	    }
+	}
+    }
     
     if (var_is_full) {
-	if (s3gaucnt_write_full(fn, mean_acc, fullvar_acc, TRUE /* 2-pass variance */, dnom,
-				n_ts, feat_dimension1(feat), 1, veclen) != 0) {
+	if (s3gaucnt_write_full(fn, mean_acc, fullvar_acc,
+				onepass ? GAUCNT_PASS2VAR_CENTERED : TRUE /* 2-pass variance */,
+				dnom, n_ts, feat_dimension1(feat), 1, veclen) != 0) {
 	}
     }
     else {
-	if (s3gaucnt_write(fn, mean_acc, var_acc, TRUE /* 2-pass variance */, dnom,
-			   n_ts, feat_dimension1(feat), 1, veclen) != 0) {
+	if (s3gaucnt_write(fn, mean_acc, var_acc,
+			   onepass ? GAUCNT_PASS2VAR_CENTERED : TRUE /* 2-pass variance */,
+			   dnom, n_ts, feat_dimension1(feat), 1, veclen) != 0) {
 	}
     }
 
@@ -114,6 +114,10 @@ init_gau -accumdir accumdir -ctlfn controlfn -part 1 -npart 1 -cepdir cepdir -fe
 	  ARG_BOOLEAN,
 	  "no",
 	  "Accumulate for full covariance matrices"},
+	{ "-onepass",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Accumulate means and variances together in a single pass over the corpus (the counts cannot be normalized with norm -tiedvar)"},
 	{ "-ctlfn",
 	  ARG_STRING,
 	  NULL,
@@ -146,6 +150,10 @@ init_gau -accumdir accumdir -ctlfn controlfn -part 1 -npart 1 -cepdir cepdir -fe
 	  ARG_STRING,
 	  NULL,
 	  "Dictionary for the filler words"},
+	{ "-dictcache",
+	  ARG_STRING,
+	  NULL,
+	  "Directory for binary caches of the dictionaries, which are built on first use"},
 	{ "-segdir",
 	  ARG_STRING,
 	  NULL,
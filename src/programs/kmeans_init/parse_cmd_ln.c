@@ -123,6 +123,11 @@ kmeans_init -gthobj single -stride 1 -ntrial 1 -minratio 0.001 \n\
 	  ARG_STRING,
 	  NULL,
 	  "Filler word dictionary file name"},
+
+	{ "-dictcache",
+	  ARG_STRING,
+	  NULL,
+	  "Directory for binary caches of the dictionaries, which are built on first use"},
 	  
 	{ "-cbcntfn",
 	  ARG_STRING,
@@ -0,0 +1,189 @@
+/* ====================================================================
+ * Copyright (c) 1995-2000 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*********************************************************************
+ *
+ * File: main.c
+ * 
+ * Description: 
+ * 	Convert MMIE training lattices between the text and binary
+ *	formats
+ *
+ *********************************************************************/
+
+#include "parse_cmd_ln.h"
+
+#include <s3/s3phseg_io.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/pio.h>
+#include <sphinxbase/err.h>
+#include <s3/s3.h>
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static int32
+convert(const char *infn, const char *outfn, int32 text)
+{
+    s3lattice_t *lat;
+    char *tmpfn, pid[24];
+    int32 rv;
+
+    if (s3lattice_read(infn, &lat) != S3_SUCCESS)
+	return S3_ERROR;
+
+    /* The output may be the input, which stays mapped until freed,
+     * so write to a private name and rename */
+#ifndef _WIN32
+    sprintf(pid, ".tmp%d", (int)getpid());
+#else
+    strcpy(pid, ".tmp");
+#endif
+    tmpfn = string_join(outfn, pid, NULL);
+    if (text)
+	rv = s3lattice_write(tmpfn, lat);
+    else
+	rv = s3lattice_write_bin(tmpfn, lat);
+    s3lattice_free(lat);
+
+#ifdef _WIN32
+    if (rv == S3_SUCCESS)
+	remove(outfn);
+#endif
+    if (rv != S3_SUCCESS || rename(tmpfn, outfn) != 0) {
+	if (rv == S3_SUCCESS)
+	    E_ERROR_SYSTEM("Unable to rename %s to %s", tmpfn, outfn);
+	remove(tmpfn);
+	rv = S3_ERROR;
+    }
+    ckd_free(tmpfn);
+
+    return rv;
+}
+
+static int32
+convert_ctl(int32 text)
+{
+    const char *latdir = cmd_ln_str("-latdir");
+    const char *outdir = cmd_ln_str("-outlatdir");
+    const char **latext = (const char **)cmd_ln_str_list("-latext");
+    int32 offset = cmd_ln_int32("-ctloffset");
+    int32 count = cmd_ln_int32("-ctlcount");
+    uint32 n_done = 0, n_missing = 0, n_fail = 0;
+    char *infn, *outfn, *utt[1];
+    lineiter_t *li;
+    struct stat st;
+    FILE *fp;
+    int32 i, n;
+
+    if (outdir == NULL)
+	outdir = latdir;
+    if ((fp = fopen(cmd_ln_str("-ctlfn"), "r")) == NULL)
+	E_FATAL_SYSTEM("Unable to open %s", cmd_ln_str("-ctlfn"));
+
+    for (li = lineiter_start_clean(fp), n = 0; li;
+	 li = lineiter_next(li), n++) {
+	if (n < offset)
+	    continue;
+	if (count >= 0 && n >= offset + count)
+	    break;
+	if (str2words(li->buf, utt, 1) < 1)
+	    continue;
+	for (i = 0; latext[i]; i++) {
+	    infn = string_join(latdir, "/", utt[0], ".", latext[i], NULL);
+	    outfn = string_join(outdir, "/", utt[0], ".", latext[i], NULL);
+	    /* The lattice conversion skips utterances it could not
+	     * read, so do the same here */
+	    if (stat(infn, &st) < 0) {
+		E_WARN("No lattice %s\n", infn);
+		n_missing++;
+	    }
+	    else if (convert(infn, outfn, text) != S3_SUCCESS) {
+		E_ERROR("Failed to convert %s\n", infn);
+		n_fail++;
+	    }
+	    else
+		n_done++;
+	    ckd_free(infn);
+	    ckd_free(outfn);
+	}
+    }
+    lineiter_free(li);
+    fclose(fp);
+
+    E_INFO("Converted %u lattices, %u missing, %u failed\n",
+	   n_done, n_missing, n_fail);
+
+    return n_fail ? S3_ERROR : S3_SUCCESS;
+}
+
+int
+main(int argc, char *argv[])
+{
+    ptmr_t tm;
+    int32 rv;
+
+    parse_cmd_ln(argc, argv);
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    if (cmd_ln_str("-i")) {
+	if (cmd_ln_str("-o") == NULL)
+	    E_FATAL("-i needs -o\n");
+	rv = convert(cmd_ln_str("-i"), cmd_ln_str("-o"),
+		     cmd_ln_int32("-text"));
+    }
+    else if (cmd_ln_str("-ctlfn")) {
+	if (cmd_ln_str("-latdir") == NULL)
+	    E_FATAL("-ctlfn needs -latdir\n");
+	rv = convert_ctl(cmd_ln_int32("-text"));
+    }
+    else
+	E_FATAL("Specify either -i and -o, or -ctlfn and -latdir\n");
+    ptmr_stop(&tm);
+    E_INFO("Conversion took %.3f sec\n", tm.t_elapsed);
+
+    if (rv != S3_SUCCESS)
+	return 1;
+
+    return 0;
+}
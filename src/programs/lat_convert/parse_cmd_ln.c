@@ -0,0 +1,152 @@
+/* ====================================================================
+ * Copyright (c) 1995-2000 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*********************************************************************
+ *
+ * File: parse_cmd_ln.c
+ * 
+ * Description: 
+ * 	Command line parser for lat_convert
+ *
+ *********************************************************************/
+
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/err.h>
+
+#include "parse_cmd_ln.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+parse_cmd_ln(int argc, char *argv[])
+{
+  uint32      isHelp;
+  uint32      isExample;
+
+  const char helpstr[]=
+"Description:\n\
+Convert MMIE training lattices between the text format written by\n\
+lattice_conv.py and the binary format.  bw reads either, but maps\n\
+binary lattices instead of parsing them on every iteration.  Binary\n\
+lattices are specific to the byte order of the machine which wrote\n\
+them.  Either convert one lattice with -i and -o, or every lattice of\n\
+a control file, in place unless -outlatdir is given.";
+
+  const char examplestr[]=
+"Example:\n\
+\n\
+lat_convert -i an4.denlat -o an4.denlat.bin\n\
+lat_convert -ctlfn train.fileids -latdir lattice -latext numlat,denlat";
+
+    static arg_t defn[] = {
+	{ "-help",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Shows the usage of the tool"},
+
+	{ "-example",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Shows example of how to use the tool"},
+
+	{ "-i",
+	  ARG_STRING,
+	  NULL,
+	  "Input lattice file, text or binary" },
+
+	{ "-o",
+	  ARG_STRING,
+	  NULL,
+	  "Output lattice file" },
+
+	{ "-ctlfn",
+	  ARG_STRING,
+	  NULL,
+	  "Control file of the utterances whose lattices to convert" },
+
+	{ "-ctloffset",
+	  ARG_INT32,
+	  "0",
+	  "Number of control file entries to skip" },
+
+	{ "-ctlcount",
+	  ARG_INT32,
+	  "-1",
+	  "Number of control file entries to convert, or -1 for all" },
+
+	{ "-latdir",
+	  ARG_STRING,
+	  NULL,
+	  "Directory of the input lattices" },
+
+	{ "-latext",
+	  ARG_STRING_LIST,
+	  "numlat,denlat",
+	  "Extensions of the lattices to convert for each utterance" },
+
+	{ "-outlatdir",
+	  ARG_STRING,
+	  NULL,
+	  "Directory of the output lattices (default: -latdir)" },
+
+	{ "-text",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Write the text format instead of the binary one" },
+
+	{ NULL, 0, NULL, NULL }
+    };
+
+    cmd_ln_parse(defn, argc, argv, 1);
+
+    isHelp    = cmd_ln_int32("-help");
+    isExample    = cmd_ln_int32("-example");
+
+    if(isHelp){
+      printf("%s\n\n",helpstr);
+    }
+
+    if(isExample){
+      printf("%s\n\n",examplestr);
+    }
+
+    if(isHelp || isExample){
+      E_INFO("User asked for help or example.\n");
+      exit(0);
+    }
+
+    return 0;
+}
@@ -75,6 +75,7 @@
 
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/err.h>
+#include <sphinxbase/sbthread.h>
 
 #include <s3/model_def_io.h>
 #include <s3/s3mixw_io.h>
@@ -160,42 +161,264 @@ float32    likelhddec(float32 *meana, float32 *vara,
 }
 
 
-/* Find the two closest distributions. We assume 1 gaussian/state */
+/*
+ * Bottom-up clustering state.  Each cluster stays in the slot it
+ * started in (a merged cluster takes over the slot of its first
+ * member), and the likelihood decrease of every pair is cached so that
+ * a merge only costs one new row of decreases.  stamp[] orders the
+ * clusters as a full rescan would visit them (merged clusters last),
+ * and decreases are always computed with the earlier cluster first, so
+ * the pairs chosen are exactly those of an exhaustive search.
+ */
+typedef struct clust_s {
+    float32 **means;
+    float32 **vars;
+    float32 ***mixw;
+    int32   ndensity;
+    int32   nfeat;
+    int32   dim;
+    int32   continuous;
+    int32   nslot;
+    int32   *stamp;	/* Visiting order of each slot, -1 once merged away */
+    float32 **dec;	/* dec[i][j] for stamp[i] < stamp[j] */
+    int32   *best;	/* Closest later cluster to each slot, or -1 */
+} clust_t;
+
+typedef struct clust_job_s {
+    clust_t *cl;
+    int32   first;
+    int32   step;
+    int32   a;		/* Slot of the merged cluster, or -1 to fill the cache */
+    int32   b;		/* Slot merged into a */
+} clust_job_t;
+
+static float32
+clust_dec(clust_t *cl, int32 i, int32 j)
+{
+    if (cl->continuous)
+        return likelhddec(cl->means[i],cl->vars[i],
+                          cl->means[j],cl->vars[j],
+                          cl->mixw[i],cl->mixw[j],
+                          cl->ndensity,cl->nfeat,cl->dim,cl->continuous);
+    else
+        return likelhddec(NULL,NULL,NULL,NULL,
+                          cl->mixw[i],cl->mixw[j],
+                          cl->ndensity,cl->nfeat,cl->dim,cl->continuous);
+}
+
+/* Find the cluster after i with the smallest decrease; the earliest
+   one wins a tie */
+static void
+clust_rescan(clust_t *cl, int32 i)
+{
+    int32 j, bj = -1;
+
+    for (j = 0; j < cl->nslot; j++) {
+        if (cl->stamp[j] <= cl->stamp[i])
+            continue;
+        if (bj < 0
+            || cl->dec[i][j] < cl->dec[i][bj]
+            || (cl->dec[i][j] == cl->dec[i][bj]
+                && cl->stamp[j] < cl->stamp[bj]))
+            bj = j;
+    }
+    cl->best[i] = bj;
+}
+
+static int
+clust_update_job(clust_job_t *job)
+{
+    clust_t *cl = job->cl;
+    int32 i, j, a = job->a;
+
+    for (i = job->first; i < cl->nslot; i += job->step) {
+        if (cl->stamp[i] < 0)
+            continue;
+        if (a < 0) {
+            for (j = i+1; j < cl->nslot; j++)
+                cl->dec[i][j] = clust_dec(cl,i,j);
+            clust_rescan(cl, i);
+        }
+        else if (i != a) {
+            /* Only this thread touches row i */
+            cl->dec[i][a] = clust_dec(cl,i,a);
+            if (cl->best[i] == a || cl->best[i] == job->b)
+                clust_rescan(cl, i);
+            else if (cl->best[i] < 0 || cl->dec[i][a] < cl->dec[i][cl->best[i]])
+                cl->best[i] = a;
+        }
+    }
+    return 0;
+}
+
+static int
+clust_update(sbthread_t *th)
+{
+    return clust_update_job((clust_job_t *)sbthread_arg(th));
+}
+
+/* Bring the cached decreases up to date after merging b into a (or
+   fill them in if a < 0), spreading the rows over threads */
+static void
+clust_refresh(clust_t *cl, int32 a, int32 b)
+{
+    clust_job_t *job;
+    sbthread_t **thread;
+    int32 n_thread, t;
+
+    /* Creating threads costs more than a few rows */
+    n_thread = cmd_ln_int32("-nthreads");
+    if (n_thread > cl->nslot / 8)
+        n_thread = cl->nslot / 8;
+    if (n_thread < 1)
+        n_thread = 1;
+
+    job = (clust_job_t *)ckd_calloc(n_thread, sizeof(*job));
+    thread = (sbthread_t **)ckd_calloc(n_thread, sizeof(*thread));
+    for (t = 0; t < n_thread; t++) {
+        job[t].cl = cl;
+        job[t].first = t;
+        job[t].step = n_thread;
+        job[t].a = a;
+        job[t].b = b;
+    }
+    for (t = 1; t < n_thread; t++)
+        thread[t] = sbthread_start(clust_update, &job[t]);
+    clust_update_job(&job[0]);
+    for (t = 1; t < n_thread; t++)
+        sbthread_free(thread[t]);
+    ckd_free(thread);
+    ckd_free(job);
+}
+
+/* Find the two closest clusters, in visiting order */
+static void
+clust_closest(clust_t *cl, int32 *a, int32 *b)
+{
+    int32 i, bi = -1;
 
-int32  findclosestpair(float32 **pmeans, float32 **pvars,
-                       float32 ***pmixw, int32 nsets, int32 ndensity,
-                       int32 nfeat, int32 dim, int32 *a, int32 *b, int32 continuous)
+    for (i = 0; i < cl->nslot; i++) {
+        if (cl->stamp[i] < 0 || cl->best[i] < 0)
+            continue;
+        if (bi < 0
+            || cl->dec[i][cl->best[i]] < cl->dec[bi][cl->best[bi]]
+            || (cl->dec[i][cl->best[i]] == cl->dec[bi][cl->best[bi]]
+                && cl->stamp[i] < cl->stamp[bi]))
+            bi = i;
+    }
+    *a = bi;
+    *b = cl->best[bi];
+}
+
+
+/* Evaluates every step'th two-way partition of the permuted groups */
+typedef struct perm_job_s {
+    float32 **tmean;
+    float32 **tvar;
+    float32 ***tmixw;
+    char    **identifier;
+    int32   ndensity;
+    int32   nfeat;
+    int32   dim;
+    int32   npermute;
+    int32   continuous;
+    int32   first;
+    int32   step;
+    int32   last;
+    float32 bestdec;
+    int32   bestclust;
+} perm_job_t;
+
+static int
+permute_job(perm_job_t *job)
 {
-    float32    reduction, minreduction;
-    int32      i, j, la=0, lb=0;
-
-    minreduction = 1.0e+32;
-    for (i=0; i<nsets; i++){
-        for (j=i+1;j<nsets;j++){
-            if (i != j){
-                if (continuous) {
-                    reduction = likelhddec(pmeans[i],pvars[i],
-                                           pmeans[j],pvars[j],
-                                           pmixw[i],pmixw[j],
-                                           ndensity,nfeat,dim, continuous);
+    int32 ndensity = job->ndensity, nfeat = job->nfeat, dim = job->dim;
+    float32 *meana=NULL, *vara=NULL, *meanb=NULL;
+    float32 *varb=NULL, **counta=NULL, **countb=NULL;
+    float32 reduction, cnt;
+    int32 i,j,k,m,n;
+
+    counta = (float32 **) ckd_calloc_2d(nfeat,ndensity,sizeof(float32));
+    countb = (float32 **) ckd_calloc_2d(nfeat,ndensity,sizeof(float32));
+    if (job->continuous) {
+        meana = (float32 *)ckd_calloc(dim,sizeof(float32));
+        vara = (float32 *)ckd_calloc(dim,sizeof(float32));
+        meanb = (float32 *)ckd_calloc(dim,sizeof(float32));
+        varb = (float32 *)ckd_calloc(dim,sizeof(float32));
+    }
+
+    job->bestdec = -1.0e+30;
+    job->bestclust = 0;
+    for (i=job->first;i<job->last;i+=job->step){
+        char *id = job->identifier[i];
+
+        memset(counta[0], 0, nfeat*ndensity*sizeof(float32));
+        memset(countb[0], 0, nfeat*ndensity*sizeof(float32));
+        if (job->continuous) {
+            memset(meana, 0, dim*sizeof(float32));
+            memset(vara, 0, dim*sizeof(float32));
+            memset(meanb, 0, dim*sizeof(float32));
+            memset(varb, 0, dim*sizeof(float32));
+            for (j=0;j<job->npermute;j++){
+                float32 *om = job->tmean[j];
+                float32 *ov = job->tvar[j];
+                cnt = job->tmixw[j][0][0];
+                if (id[j]){
+                    counta[0][0] += cnt;
+                    for (k=0;k<dim;k++){
+                        meana[k] += cnt * om[k];
+                        vara[k] += cnt*(ov[k] + om[k]*om[k]);
+                    }
                 }
-                else {
-                    reduction = likelhddec(NULL,NULL,
-                                           NULL,NULL,
-                                           pmixw[i],pmixw[j],
-                                           ndensity,nfeat,dim, continuous);
+                else{
+                    countb[0][0] += cnt;
+                    for (k=0;k<dim;k++){
+                        meanb[k] += cnt * om[k];
+                        varb[k] += cnt*(ov[k] + om[k]*om[k]);
+                    }
                 }
-                if (reduction < minreduction){
-                    minreduction = reduction;
-                    la = i; lb = j;
+            }
+            for (k=0;k<dim;k++){
+                meana[k] /= counta[0][0]; meanb[k] /= countb[0][0];
+                vara[k] = vara[k]/counta[0][0] - meana[k]*meana[k];
+                varb[k] = varb[k]/countb[0][0] - meanb[k]*meanb[k];
+            }
+        }
+        else {
+            for (j=0;j<job->npermute;j++){
+                if (id[j]){
+                    for (m=0;m<nfeat;m++)
+                        for (n=0; n<ndensity; n++)
+                            counta[m][n] += job->tmixw[j][m][n];
+                }
+                else {
+                    for (m=0;m<nfeat;m++)
+                        for (n=0; n<ndensity; n++)
+                            countb[m][n] += job->tmixw[j][m][n];
                 }
             }
         }
+        reduction = likelhddec(meana,vara, meanb,varb,counta,countb,
+                                                      ndensity,nfeat,dim, job->continuous);
+        if (reduction > job->bestdec) {
+            job->bestdec = reduction;
+            job->bestclust = i;
+        }
     }
-    *a = la; *b = lb;
+
+    if (job->continuous) {
+        ckd_free(meana);ckd_free(vara);ckd_free(meanb);ckd_free(varb);
+    }
+    ckd_free_2d((void **)counta); ckd_free_2d((void **)countb);
     return 0;
 }
 
+static int
+permute_worker(sbthread_t *th)
+{
+    return permute_job((perm_job_t *)sbthread_arg(th));
+}
+
 
 /* Permute a list of elements (here groups of phones) to obtain the best
    partitioning of the elements into two groups */
@@ -207,10 +430,13 @@ float32  permute(float32 **means, float32 **vars, float32 ***mixw,
                  int32 *nlclass, int32 *nrclass, int32 continuous)
 {
     float32  **tmean=NULL, **tvar=NULL, ***tmixw=NULL;
-    float32  bestdec,reduction,cnt;
+    float32  bestdec,cnt;
     int32 i,j,k,l,m,n,ncombinations,bestclust=0;
     char  **identifier, *tmpid;
     int32  *llclass,*lrclass,lnlclass,lnrclass,ntot;
+    perm_job_t *job;
+    sbthread_t **thread;
+    int32 n_thread, t;
 
     /* First gather and compute means and variances for the npermute groups */
     tmixw = (float32 ***)ckd_calloc_3d(npermute,nfeat,ndensity,sizeof(float32));
@@ -257,68 +483,43 @@ float32  permute(float32 **means, float32 **vars, float32 ***mixw,
     ckd_free(tmpid);
 
     /* Go through the list and find best pair */
-    for (i=0,bestdec=-1.0e+30;i<ncombinations-1;i++){
-        float32 *meana=NULL, *vara=NULL, *meanb=NULL;
-        float32 *varb=NULL, **counta=NULL, **countb=NULL;
-
-        counta = (float32 **) ckd_calloc_2d(nfeat,ndensity,sizeof(float32));
-        countb = (float32 **) ckd_calloc_2d(nfeat,ndensity,sizeof(float32));
-
-        if (continuous) {
-            meana = (float32 *)ckd_calloc(dim,sizeof(float32));
-            vara = (float32 *)ckd_calloc(dim,sizeof(float32));
-            meanb = (float32 *)ckd_calloc(dim,sizeof(float32));
-            varb = (float32 *)ckd_calloc(dim,sizeof(float32));
-            for (j=0;j<npermute;j++){
-                float32 *om = tmean[j];
-                float32 *ov = tvar[j];
-                cnt = tmixw[j][0][0];
-                if (identifier[i][j]){
-                    counta[0][0] += cnt;
-                    for (k=0;k<dim;k++){
-                        meana[k] += cnt * om[k];
-                        vara[k] += cnt*(ov[k] + om[k]*om[k]);
-                    }
-                }
-                else{
-                    countb[0][0] += cnt;
-                    for (k=0;k<dim;k++){
-                        meanb[k] += cnt * om[k];
-                        varb[k] += cnt*(ov[k] + om[k]*om[k]);
-                    }
-                }
-            }
-            for (k=0;k<dim;k++){
-                meana[k] /= counta[0][0]; meanb[k] /= countb[0][0];
-                vara[k] = vara[k]/counta[0][0] - meana[k]*meana[k];
-                varb[k] = varb[k]/countb[0][0] - meanb[k]*meanb[k];
-            }
-        }
-        else {
-            for (j=0;j<npermute;j++){
-                if (identifier[i][j]){
-                    for (m=0;m<nfeat;m++)
-                        for (n=0; n<ndensity; n++)
-                            counta[m][n] += tmixw[j][m][n];
-                }
-                else {
-                    for (m=0;m<nfeat;m++)
-                        for (n=0; n<ndensity; n++)
-                            countb[m][n] += tmixw[j][m][n];
-                }
-            }
-        }
-        reduction = likelhddec(meana,vara, meanb,varb,counta,countb,
-                                                      ndensity,nfeat,dim, continuous);
-        if (reduction > bestdec) {
-            bestdec = reduction;
-            bestclust = i;
-        }
-        if (continuous) {
-            ckd_free(meana);ckd_free(vara);ckd_free(meanb);ckd_free(varb);
+    n_thread = cmd_ln_int32("-nthreads");
+    if (n_thread > (ncombinations-1) / 16)
+        n_thread = (ncombinations-1) / 16;
+    if (n_thread < 1)
+        n_thread = 1;
+    job = (perm_job_t *)ckd_calloc(n_thread, sizeof(*job));
+    thread = (sbthread_t **)ckd_calloc(n_thread, sizeof(*thread));
+    for (t = 0; t < n_thread; t++) {
+        job[t].tmean = tmean;
+        job[t].tvar = tvar;
+        job[t].tmixw = tmixw;
+        job[t].identifier = identifier;
+        job[t].ndensity = ndensity;
+        job[t].nfeat = nfeat;
+        job[t].dim = dim;
+        job[t].npermute = npermute;
+        job[t].continuous = continuous;
+        job[t].first = t;
+        job[t].step = n_thread;
+        job[t].last = ncombinations-1;
+    }
+    for (t = 1; t < n_thread; t++)
+        thread[t] = sbthread_start(permute_worker, &job[t]);
+    permute_job(&job[0]);
+    for (t = 1; t < n_thread; t++)
+        sbthread_free(thread[t]);
+
+    /* Same winner as a serial scan: the first of any tied partitions */
+    for (t = 0, bestdec = -1.0e+30, bestclust = 0; t < n_thread; t++) {
+        if (job[t].bestdec > bestdec
+            || (job[t].bestdec == bestdec && job[t].bestclust < bestclust)) {
+            bestdec = job[t].bestdec;
+            bestclust = job[t].bestclust;
         }
-        ckd_free_2d((void **)counta); ckd_free_2d((void **)countb);
     }
+    ckd_free(thread);
+    ckd_free(job);
 
     for (i=0,ntot=0;i<npermute;i++) ntot += llists[i];
     llclass = (int32 *) ckd_calloc(ntot,sizeof(int32)); /* Overalloc */
@@ -351,12 +552,13 @@ node *make_simple_tree (float32 **means, float32 **vars, float32 ***mixw,
            int32 *nodephoneids, int32 nphones, int32 ndensity,
            int32 nfeat, int32 ndim, int32 npermute, int32 depth, int32 continuous)
 {
-    float32  **oldmeans=NULL, **oldvars=NULL, **newmeans=NULL, **newvars=NULL;
-    float32  ***oldmixw, ***newmixw, **tmp2d, ***tmp3d;
+    float32  **oldmeans=NULL, **oldvars=NULL;
+    float32  ***oldmixw;
     float32  minvar=0, bestdec;
-    int32    **phoneid, **newphoneid, *numphones, *newnumphones, **it2d, *it1d;
+    int32    **phoneid, *numphones, **clustphoneid, *clustnumphones;
     int32    i,j,k,l,a,b,set,nsets;
     int32    *lphoneids,*rphoneids,lnphones,rnphones;
+    clust_t  cl;
     node     *root;
 
     /* Allocate and set basic root parameters */
@@ -368,18 +570,13 @@ node *make_simple_tree (float32 **means, float32 **vars, float32 ***mixw,
 
     /* Build the node by clustering and partitioning */
     oldmixw = (float32***)ckd_calloc_3d(nphones,nfeat,ndensity,sizeof(float32));
-    newmixw = (float32***)ckd_calloc_3d(nphones,nfeat,ndensity,sizeof(float32));
     phoneid = (int32 **)ckd_calloc_2d(nphones,nphones,sizeof(int32));
     numphones = (int32 *) ckd_calloc(nphones,sizeof(int32));
-    newphoneid = (int32 **)ckd_calloc_2d(nphones,nphones,sizeof(int32));
-    newnumphones = (int32 *) ckd_calloc(nphones,sizeof(int32));
 
     if (continuous) {
         minvar = cmd_ln_float32("-varfloor");
         oldmeans = (float32 **) ckd_calloc_2d(nphones,ndim,sizeof(float32));
         oldvars = (float32 **) ckd_calloc_2d(nphones,ndim,sizeof(float32));
-        newmeans = (float32 **) ckd_calloc_2d(nphones,ndim,sizeof(float32));
-        newvars = (float32 **) ckd_calloc_2d(nphones,ndim,sizeof(float32));
     }
 
     for (i=0;i<nphones;i++){
@@ -395,70 +592,64 @@ node *make_simple_tree (float32 **means, float32 **vars, float32 ***mixw,
             }
         }
     }
+
+    memset(&cl, 0, sizeof(cl));
+    cl.nslot = nphones;
+    cl.stamp = (int32 *) ckd_calloc(nphones,sizeof(int32));
+    for (i=0;i<nphones;i++)
+        cl.stamp[i] = i;
+
     if (nphones > npermute){
+        cl.means = oldmeans;
+        cl.vars = oldvars;
+        cl.mixw = oldmixw;
+        cl.ndensity = ndensity;
+        cl.nfeat = nfeat;
+        cl.dim = ndim;
+        cl.continuous = continuous;
+        cl.dec = (float32 **) ckd_calloc_2d(nphones,nphones,sizeof(float32));
+        cl.best = (int32 *) ckd_calloc(nphones,sizeof(int32));
+        clust_refresh(&cl, -1, -1);
 
         for (nsets = nphones; nsets > npermute; nsets--) {
             /* Find the closest distributions */
-            findclosestpair(oldmeans,oldvars,oldmixw,nsets,ndensity,
-                                                         nfeat,ndim,&a,&b, continuous);
-
-            /* Copy and Merge distributions... */
-            /* Copy unmerged distributions first */
-            for (i=0,set=0;i<nsets;i++){
-                if (i != a && i != b){
-                    newnumphones[set] = numphones[i];
-                    for (l=0;l<numphones[i];l++)
-                        newphoneid[set][l] = phoneid[i][l];
-                    for (j=0;j<nfeat;j++)
-                        for (k=0;k<ndensity;k++)
-                            newmixw[set][j][k] = oldmixw[i][j][k];
-                    if (continuous) {
-                        for (l=0;l<ndim;l++){
-                            newmeans[set][l] = oldmeans[i][l];
-                            newvars[set][l] = oldvars[i][l];
-                        }
-                    }
-                    set++;
-                }
-            }
-            /* Merge a and b */
-            newnumphones[set] =  numphones[a]+numphones[b];
-            for (i=0;i<numphones[a];i++)
-                newphoneid[set][i] = phoneid[a][i];
-            for (l=0;l<numphones[b];l++,i++)
-                newphoneid[set][i] = phoneid[b][l];
+            clust_closest(&cl, &a, &b);
+
+            /* Merge b into a */
+            for (i=0;i<numphones[b];i++)
+                phoneid[a][numphones[a]+i] = phoneid[b][i];
+            numphones[a] += numphones[b];
             if (continuous) {
-                float32 *nm = newmeans[set];
-                float32 *nv = newvars[set];
                 float32 *oma = oldmeans[a];
                 float32 *ova = oldvars[a];
                 float32 *omb = oldmeans[b];
                 float32 *ovb = oldvars[b];
-                float32 cnta, cntb;
+                float32 cnta, cntb, nm, nv;
 
                 cnta = oldmixw[a][0][0]; cntb = oldmixw[b][0][0];
-                newmixw[set][0][0] = cnta + cntb;
+                oldmixw[a][0][0] = cnta + cntb;
                 for (l=0;l<ndim;l++){
-                    nm[l] = (cnta*oma[l] + cntb*omb[l]) / (cnta + cntb);
-                    nv[l] = cnta*(ova[l]+oma[l]*oma[l]) +
+                    nm = (cnta*oma[l] + cntb*omb[l]) / (cnta + cntb);
+                    nv = cnta*(ova[l]+oma[l]*oma[l]) +
                             cntb*(ovb[l]+omb[l]*omb[l]);
-                    nv[l] = nv[l]/(cnta+cntb) - nm[l]*nm[l];
-                    if (nv[l] < minvar) nv[l] = minvar;
+                    nv = nv/(cnta+cntb) - nm*nm;
+                    if (nv < minvar) nv = minvar;
+                    oma[l] = nm; ova[l] = nv;
                 }
             }
             else {
                 for (j=0;j<nfeat;j++)
                     for (k=0;k<ndensity;k++)
-                        newmixw[set][j][k] = oldmixw[a][j][k]+oldmixw[b][j][k];
+                        oldmixw[a][j][k] += oldmixw[b][j][k];
             }
 
-            /* Switch old and new variables */
-            tmp2d = oldmeans; oldmeans = newmeans; newmeans = tmp2d;
-            tmp2d = oldvars;  oldvars = newvars;   newvars = tmp2d;
-            tmp3d = oldmixw;  oldmixw = newmixw;   newmixw = tmp3d;
-            it2d = phoneid;  phoneid = newphoneid; newphoneid = it2d;
-            it1d = numphones; numphones = newnumphones; newnumphones = it1d;
+            /* The merged cluster comes after all the others */
+            cl.stamp[b] = -1;
+            cl.stamp[a] = nphones + (nphones - nsets);
+            cl.best[a] = -1;
+            clust_refresh(&cl, a, b);
         }
+        ckd_free_2d((void **)cl.dec); ckd_free(cl.best);
     }
     else npermute = nphones;
 
@@ -467,17 +658,29 @@ node *make_simple_tree (float32 **means, float32 **vars, float32 ***mixw,
         return(root);
     }
 
-    bestdec = permute(means,vars,mixw,ndensity,nfeat,ndim,phoneid,numphones,
+    /* Hand the surviving clusters to permute() in visiting order */
+    clustphoneid = (int32 **) ckd_calloc(npermute,sizeof(int32 *));
+    clustnumphones = (int32 *) ckd_calloc(npermute,sizeof(int32));
+    for (set=0;set<npermute;set++){
+        for (i=0,j=-1;i<nphones;i++)
+            if (cl.stamp[i] >= 0 && (j < 0 || cl.stamp[i] < cl.stamp[j]))
+                j = i;
+        clustphoneid[set] = phoneid[j];
+        clustnumphones[set] = numphones[j];
+        cl.stamp[j] = -1;
+    }
+
+    bestdec = permute(means,vars,mixw,ndensity,nfeat,ndim,clustphoneid,clustnumphones,
                       npermute,&lphoneids,&rphoneids,&lnphones,&rnphones, continuous);
 
     root->lkhd_dec = bestdec;
 
     if (continuous) {
         ckd_free_2d((void **)oldmeans); ckd_free_2d((void **)oldvars);
-        ckd_free_2d((void **)newmeans); ckd_free_2d((void **)newvars);
     }
-    ckd_free_3d((void ***)oldmixw); ckd_free_3d((void ***)newmixw);
-    ckd_free_2d((void **)newphoneid); ckd_free_2d((void **)phoneid);
+    ckd_free_3d((void ***)oldmixw);
+    ckd_free_2d((void **)phoneid); ckd_free(numphones);
+    ckd_free(clustphoneid); ckd_free(clustnumphones); ckd_free(cl.stamp);
 
     /* Recurse */
     root->left = make_simple_tree(means,vars,mixw,lphoneids,lnphones,
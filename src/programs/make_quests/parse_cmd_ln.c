@@ -146,6 +146,11 @@ questions -type .cont.";
 	  NULL,
 	  "HMM type" },
 
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads used to compute likelihood decreases between clusters and to search partitions" },
+
 	{NULL, 0, NULL, NULL}
 
     };
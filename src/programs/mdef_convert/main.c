@@ -0,0 +1,79 @@
+/* ====================================================================
+ * Copyright (c) 1995-2000 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*********************************************************************
+ *
+ * File: main.c
+ * 
+ * Description: 
+ * 	Convert model definitions between the text and binary formats
+ *
+ *********************************************************************/
+
+#include "parse_cmd_ln.h"
+
+#include <s3/model_def_io.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/err.h>
+#include <s3/s3.h>
+
+int
+main(int argc, char *argv[])
+{
+    model_def_t *mdef;
+    ptmr_t tm;
+    int32 rv;
+
+    parse_cmd_ln(argc, argv);
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    if (model_def_read(&mdef, cmd_ln_str("-i")) != S3_SUCCESS)
+	E_FATAL("Unable to read %s\n", cmd_ln_str("-i"));
+    ptmr_stop(&tm);
+    E_INFO("Read %s in %.3f sec\n", cmd_ln_str("-i"), tm.t_elapsed);
+
+    if (cmd_ln_int32("-text"))
+	rv = model_def_write(mdef, cmd_ln_str("-o"));
+    else
+	rv = model_def_write_bin(mdef, cmd_ln_str("-o"));
+    if (rv != S3_SUCCESS)
+	E_FATAL("Unable to write %s\n", cmd_ln_str("-o"));
+
+    model_def_free(mdef);
+
+    return 0;
+}
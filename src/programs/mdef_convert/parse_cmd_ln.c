@@ -0,0 +1,121 @@
+/* ====================================================================
+ * Copyright (c) 1995-2000 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*********************************************************************
+ *
+ * File: parse_cmd_ln.c
+ * 
+ * Description: 
+ * 	Command line parser for mdef_convert
+ *
+ *********************************************************************/
+
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/err.h>
+
+#include "parse_cmd_ln.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+parse_cmd_ln(int argc, char *argv[])
+{
+  uint32      isHelp;
+  uint32      isExample;
+
+  const char helpstr[]=
+"Description:\n\
+Convert a model definition file between the text format and the binary\n\
+format.  Binary model definitions are read by every tool which reads\n\
+model definitions, without parsing, which saves time on large untied\n\
+triphone sets.  They are specific to the byte order of the machine\n\
+which wrote them.";
+
+  const char examplestr[]=
+"Example:\n\
+\n\
+mdef_convert -i untied.mdef -o untied.mdef.bin\n\
+mdef_convert -text yes -i untied.mdef.bin -o untied.mdef";
+
+    static arg_t defn[] = {
+	{ "-help",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Shows the usage of the tool"},
+
+	{ "-example",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Shows example of how to use the tool"},
+
+	{ "-i",
+	  REQARG_STRING,
+	  NULL,
+	  "Input model definition file, text or binary" },
+
+	{ "-o",
+	  REQARG_STRING,
+	  NULL,
+	  "Output model definition file" },
+
+	{ "-text",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Write the text format instead of the binary one" },
+
+	{ NULL, 0, NULL, NULL }
+    };
+
+    cmd_ln_parse(defn, argc, argv, 1);
+
+    isHelp    = cmd_ln_int32("-help");
+    isExample    = cmd_ln_int32("-example");
+
+    if(isHelp){
+      printf("%s\n\n",helpstr);
+    }
+
+    if(isExample){
+      printf("%s\n\n",examplestr);
+    }
+
+    if(isHelp || isExample){
+      E_INFO("User asked for help or example.\n");
+      exit(0);
+    }
+
+    return 0;
+}
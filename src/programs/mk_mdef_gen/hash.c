@@ -41,91 +41,200 @@
  *********************************************************************/
 
 #include <s3/s3.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
 #include <stdlib.h>
 #include <string.h>
 #include "hash.h"
 
 
-unsigned hash(const char *s0, const char *s1, const char *s2, const char *s3)
+phoneset_t *phoneset_new(void)
 {
-    unsigned   hashval;
+    phoneset_t *ps;
 
-    for (hashval = 0; *s0 != '\0'; s0++)
-        hashval = *s0 + 31*hashval;
-    for (; *s1 != '\0'; s1++)
-        hashval = *s1 + 31*hashval;
-    for (; *s2 != '\0'; s2++)
-        hashval = *s2 + 31*hashval;
-    for (; *s3 != '\0'; s3++)
-        hashval = *s3 + 31*hashval;
+    ps = ckd_calloc(1, sizeof(*ps));
+    ps->ht = hash_table_new(PHNHASHSIZE, HASH_CASE_YES);
 
-    return hashval % HASHSIZE;
+    return ps;
 }
-
 
-hashelement_t *lookup(const char *b, const char *l, const char *r, const char *wp, 
-			hashelement_t **hashtable)
+
+int32 phoneset_find(phoneset_t *ps, const char *name)
 {
-    hashelement_t  *np;
+    void *val;
 
-    for (np = hashtable[hash(b,l,r,wp)]; np != NULL; np = np->next)
-        if (strcmp(b, np->basephone) == 0 && 
-	    strcmp(l, np->leftcontext) == 0 &&
-            strcmp(r, np->rightcontext) == 0 && 
-	    strcmp(wp, np->wordposition) == 0)
-            return np;
+    if (hash_table_lookup(ps->ht, name, &val) < 0)
+	return -1;
 
-    return NULL;
+    return (int32)(size_t)val - 1;
 }
-
 
 
-hashelement_t *install(const char *b, const char *l, const char *r, const char *wp, 
-			hashelement_t **hashtable)
+int32 phoneset_intern(phoneset_t *ps, const char *name)
 {
-    hashelement_t  *np;
-    unsigned hashval;
+    int32 id;
 
-    if ((np = lookup(b, l, r, wp, hashtable)) == NULL)
-    {
-        np = (hashelement_t *) calloc (1,sizeof(*np));
-        if (np == NULL || 
-	    (np->basephone = strdup(b)) == NULL || 
-	    (np->leftcontext = strdup(l)) == NULL ||
-	    (np->rightcontext = strdup(r)) == NULL ||
-	    (np->wordposition = strdup(wp)) == NULL)
-            return NULL;
+    if ((id = phoneset_find(ps, name)) >= 0)
+	return id;
+
+    if (ps->n == MAX_N_PHONE)
+	E_FATAL("More than %d distinct phones\n", MAX_N_PHONE);
+    if (ps->n == ps->max) {
+	ps->max = ps->max ? 2 * ps->max : 64;
+	ps->name = ckd_realloc(ps->name, ps->max * sizeof(*ps->name));
+	ps->filler = ckd_realloc(ps->filler, ps->max * sizeof(*ps->filler));
+    }
+    id = ps->n++;
+    ps->name[id] = ckd_salloc(name);
+    ps->filler[id] = IS_FILLER(name);
+    hash_table_enter(ps->ht, ps->name[id], (void *)(size_t)(id + 1));
+
+    return id;
+}
+
+
+void phoneset_free(phoneset_t *ps)
+{
+    int32 i;
+
+    hash_table_free(ps->ht);
+    for (i = 0; i < ps->n; i++)
+	ckd_free(ps->name[i]);
+    ckd_free(ps->name);
+    ckd_free(ps->filler);
+    ckd_free(ps);
+}
+
+
+static uint64_t hash(uint64_t key)
+{
+    /* 64 bit finalizer from MurmurHash3 */
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return key;
+}
+
+
+tphnhash_t *tphnhash_new(phoneset_t *phones)
+{
+    tphnhash_t *t;
+    uint32 i, j;
+
+    t = ckd_calloc(1, sizeof(*t));
+    t->phones = phones;
+    for (i = 0; i < TPHN_N_SHARD; i++) {
+	t->shard[i].n_slot = 64;
+	t->shard[i].slot = ckd_calloc(64, sizeof(hashelement_t));
+	for (j = 0; j < 64; j++)
+	    t->shard[i].slot[j].key = TPHN_EMPTY;
+    }
+
+    return t;
+}
+
+
+/* Slot for key in a shard: either the one holding it or an empty one */
+static hashelement_t *shard_find(tphnshard_t *sh, uint64_t key, uint64_t h)
+{
+    uint32 mask = sh->n_slot - 1;
+    uint32 i;
+
+    for (i = (uint32)h & mask;
+	 sh->slot[i].key != TPHN_EMPTY && sh->slot[i].key != key;
+	 i = (i + 1) & mask);
+
+    return &sh->slot[i];
+}
+
+
+static void shard_grow(tphnshard_t *sh)
+{
+    hashelement_t *old = sh->slot;
+    uint32 n_old = sh->n_slot;
+    uint32 i;
+
+    sh->n_slot *= 2;
+    sh->slot = ckd_calloc(sh->n_slot, sizeof(hashelement_t));
+    for (i = 0; i < sh->n_slot; i++)
+	sh->slot[i].key = TPHN_EMPTY;
+    for (i = 0; i < n_old; i++) {
+	if (old[i].key != TPHN_EMPTY)
+	    *shard_find(sh, old[i].key, hash(old[i].key)) = old[i];
+    }
+    ckd_free(old);
+}
+
+
+hashelement_t *lookup(int32 b, int32 l, int32 r, int32 wp,
+		      tphnhash_t *hashtable)
+{
+    uint64_t key = TPHN_KEY(b, l, r, wp);
+    uint64_t h = hash(key);
+    hashelement_t *np;
+
+    np = shard_find(&hashtable->shard[h >> 58], key, h);
+    if (np->key == TPHN_EMPTY)
+	return NULL;
+
+    return np;
+}
+
+
+int32 tphnhash_locate(int32 b, int32 l, int32 r, int32 wp,
+		      tphnhash_t *hashtable, uint32 *shard, uint32 *slot)
+{
+    uint64_t key = TPHN_KEY(b, l, r, wp);
+    uint64_t h = hash(key);
+    hashelement_t *np;
+
+    *shard = (uint32)(h >> 58);
+    np = shard_find(&hashtable->shard[*shard], key, h);
+    if (np->key == TPHN_EMPTY)
+	return -1;
+    *slot = (uint32)(np - hashtable->shard[*shard].slot);
 
-        np->dictcount = 0;
+    return 0;
+}
+
+
+hashelement_t *install(int32 b, int32 l, int32 r, int32 wp,
+		       tphnhash_t *hashtable)
+{
+    uint64_t key = TPHN_KEY(b, l, r, wp);
+    uint64_t h = hash(key);
+    tphnshard_t *sh = &hashtable->shard[h >> 58];
+    hashelement_t *np;
+
+    np = shard_find(sh, key, h);
+    if (np->key == TPHN_EMPTY) {
+	/* Keep each shard at most half full */
+	if (2 * (sh->n_used + 1) > sh->n_slot) {
+	    shard_grow(sh);
+	    np = shard_find(sh, key, h);
+	}
+	np->key = key;
+	np->dictcount = 0;
 	np->count = 0;
-        hashval = hash(b,l,r,wp);
-        np->next = hashtable[hashval];
-        hashtable[hashval] = np;
+	sh->n_used++;
     }
+
     return np;
 }
-
 
-void freehash(hashelement_t **hash)
+
+void freehash(tphnhash_t *hash)
 {
     int32 i;
-    hashelement_t *e1, *e2;
 
-    for (i=0; i < HASHSIZE; i++){
-        e1 = hash[i];
-        while (e1 != NULL){
-	   e2 = e1->next;
-	   free(e1->basephone);
-	   if (e1->leftcontext != NULL) free(e1->leftcontext);
-	   if (e1->rightcontext != NULL) free(e1->rightcontext);
-	   if (e1->wordposition != NULL) free(e1->wordposition);
-           free(e1);
-           e1 = e2;
-        }
-    }
-    free(hash);
+    for (i = 0; i < TPHN_N_SHARD; i++)
+	ckd_free(hash->shard[i].slot);
+    ckd_free(hash);
 }
-
+
 
 
 unsigned dicthash(char *s)
@@ -183,8 +292,8 @@ void freedicthash(dicthashelement_t **dicthash)
         while (e1 != NULL){
 	   e2 = e1->next;
 	   free(e1->word);
-	   for (i=0;i<e1->nphns;i++) free(e1->phones[i]);
-	   free(e1->phones);
+	   ckd_free_2d((void **)e1->phones);
+	   ckd_free(e1->phnids);
            free(e1);
            e1 = e2;
         }
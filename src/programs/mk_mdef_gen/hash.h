@@ -49,28 +49,98 @@
 #define HASH_H
 
 #include <sphinxbase/prim_type.h>
+#include <sphinxbase/hash_table.h>
+
+#include <stdint.h>
 
 #define EOLN  -1
-#define HASHSIZE 	24001
+#define IS_FILLER(X)	((X[0]=='+'||strcmp(X,"SIL")==0) ? 1 : 0)
 #define DICTHASHSIZE 	10007
 #define PHNHASHSIZE 	101
 
+/* Phone names (and word position strings) are interned to small
+ * integer IDs, so that triphones are keyed by four IDs rather than
+ * four strings. */
+typedef struct phoneset_t
+{
+    hash_table_t *ht;		/* name -> ID + 1 */
+    char **name;
+    char *filler;		/* Whether each phone is a filler */
+    int32 n, max;
+} phoneset_t;
+
+#define MAX_N_PHONE	0xffff
+
+phoneset_t *phoneset_new(void);
+int32 phoneset_intern(phoneset_t *ps, const char *name);
+int32 phoneset_find(phoneset_t *ps, const char *name);
+void phoneset_free(phoneset_t *ps);
+
+/* Triphones live in a sharded open addressing table keyed by the
+ * packed phone IDs.  Each shard grows independently, and shards can
+ * be visited in parallel. */
 typedef struct hashelement_t
 {
-    char      *basephone;
-    char      *leftcontext;
-    char      *rightcontext;
-    char      *wordposition;
+    uint64_t  key;
     int32     dictcount;
     int32     count;
-    struct hashelement_t  *next;
 } hashelement_t;
 
+#define TPHN_N_SHARD	64
+#define TPHN_EMPTY	(~(uint64_t)0)
+
+typedef struct tphnshard_t
+{
+    hashelement_t *slot;
+    uint32 n_slot;
+    uint32 n_used;
+} tphnshard_t;
+
+typedef struct tphnhash_t
+{
+    tphnshard_t shard[TPHN_N_SHARD];
+    phoneset_t *phones;
+} tphnhash_t;
+
+#define TPHN_KEY(b, l, r, wp) \
+    ((uint64_t)(b) | ((uint64_t)(l) << 16) | ((uint64_t)(r) << 32) | ((uint64_t)(wp) << 48))
+#define TPHN_BASE(k)	((int32)((k) & 0xffff))
+#define TPHN_LEFT(k)	((int32)(((k) >> 16) & 0xffff))
+#define TPHN_RIGHT(k)	((int32)(((k) >> 32) & 0xffff))
+#define TPHN_WPOS(k)	((int32)(((k) >> 48) & 0xffff))
+
+tphnhash_t *tphnhash_new(phoneset_t *phones);
+
+hashelement_t *lookup(int32 basephone,
+		      int32 lctxt,
+		      int32 rctxt,
+		      int32 wordposn,
+		      tphnhash_t *tphnhash);
+
+/* Position of a triphone in the table, for callers that keep their
+ * own per-slot arrays.  Returns -1 if it is not there. */
+int32 tphnhash_locate(int32 basephone,
+		      int32 lctxt,
+		      int32 rctxt,
+		      int32 wordposn,
+		      tphnhash_t *tphnhash,
+		      uint32 *shard,
+		      uint32 *slot);
+
+hashelement_t *install(int32 basephone,
+		       int32 lctxt,
+		       int32 rctxt,
+		       int32 wordposn,
+		       tphnhash_t *tphnhash);
+
+void freehash(tphnhash_t *hash);
+
 
 typedef struct dicthashelement_t
 {
     char      *word;
     char      **phones;
+    int32     *phnids;	/* Interned phones */
     int32     nphns;
     struct dicthashelement_t  *next;
 } dicthashelement_t;
@@ -84,21 +154,6 @@ typedef struct phnhashelement_t
 } phnhashelement_t;
 
 
-hashelement_t *lookup(const char *basephone,
-		      const char *lctxt,
-		      const char *rctxt,
-		      const char *wordposn,
-		      hashelement_t **tphnhash);
-
-hashelement_t *install(const char *basephone,
-		       const char *lctxt,
-		       const char *rctxt,
-		       const char *wordposn,
-		       hashelement_t **tphnhash);
-
-void freehash(hashelement_t **hash);
-
-
 dicthashelement_t *dictlookup(char *word, dicthashelement_t **dicthash);
 dicthashelement_t *dictinstall(char *dictword, dicthashelement_t **dicthash);
 void freedicthash(dicthashelement_t **dicthash);
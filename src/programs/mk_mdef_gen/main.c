@@ -70,8 +70,9 @@
 int main (int argc, char **argv)
 {
     heapelement_t **CDheap=NULL;
-    hashelement_t **CDhash=NULL;
-    phnhashelement_t **CIhash=NULL;
+    tphnhash_t *CDhash=NULL;
+    phoneset_t *phones;
+    int32 *phncount=NULL;
     dicthashelement_t **dicthash=NULL;
     int32  cilistsize=0, cdheapsize=0, threshold, tph_list_given, ncd;
     const char   *phnlist, *incimdef, *triphnlist, *incdmdef;
@@ -81,6 +82,7 @@ int main (int argc, char **argv)
     int32 ignore_wpos;
 
     parse_cmd_ln(argc,argv);
+    phones = phoneset_new();
 
     /* Test all flags before beginning */
     cimdeffn = cmd_ln_str("-ocimdef");
@@ -131,12 +133,12 @@ int main (int argc, char **argv)
 	    incimdef = phnlist = NULL; 
 	}
 	make_ci_list_cd_hash_frm_mdef(incdmdef,&CIlist,&cilistsize,
-							   &CDhash,&ncd);
+						   phones,&CDhash,&ncd);
     }
     else{
         if (phnlist)
 	    make_ci_list_cd_hash_frm_phnlist(phnlist,&CIlist,
-						&cilistsize,&CDhash,&ncd);
+						&cilistsize,phones,&CDhash,&ncd);
 	if (incimdef) {
 	    if (CIlist) ckd_free_2d((void**)CIlist);
 	    make_ci_list_frm_mdef(incimdef,&CIlist,&cilistsize);
@@ -146,9 +148,9 @@ int main (int argc, char **argv)
 	make_mdef_from_list(cimdeffn,CIlist,cilistsize,NULL,0,argv[0]);
 
     if (!tph_list_given && !cimdeffn) {
-	read_dict(dictfn, fillerdictfn, &dicthash);
+	read_dict(dictfn, fillerdictfn, phones, &dicthash);
 	if (CDhash) freehash(CDhash);
-	make_dict_triphone_list (dicthash, &CDhash, ignore_wpos);
+	make_dict_triphone_list (dicthash, phones, &CDhash, ignore_wpos);
     }
 
     if (alltphnmdeffn){
@@ -158,9 +160,10 @@ int main (int argc, char **argv)
 					CDheap,cdheapsize,argv[0]);
     }
     if (countfn || untiedmdeffn) 
-        count_triphones(lsnfile, dicthash, CDhash, &CIhash, ignore_wpos);
+        count_triphones(lsnfile, dicthash, CDhash, &phncount, ignore_wpos,
+			cmd_ln_int32("-nthreads"));
     if (countfn){
-	print_counts(countfn,CIhash,CDhash);
+	print_counts(countfn,phncount,CDhash);
     }
     if (untiedmdeffn){
         threshold = find_threshold(CDhash);
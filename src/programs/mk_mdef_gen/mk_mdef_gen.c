@@ -50,7 +50,10 @@
 #include <sphinxbase/pio.h>
 #include <sphinxbase/cmd_ln.h>
 #include <sphinxbase/err.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/sbthread.h>
 
+#include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -62,7 +65,6 @@
 #include "hash.h"
 
 #define CEILING   10000  
-#define IS_FILLER(X)	((X[0]=='+'||strcmp(X,"SIL")==0) ? 1 : 0)
 
 
 static const char* wordpos2str(word_posn_t wordpos, int ignore_wordpos);
@@ -98,14 +100,16 @@ int32 make_ci_list_frm_mdef(const char  *mdeffile,
 int32 make_ci_list_cd_hash_frm_phnlist(const char  *phnlist,
 		           	    char  ***CIlist, 
                            	    int32 *cilistsize,
-			   	    hashelement_t ***CDhash,
+				    phoneset_t *phones,
+			   	    tphnhash_t **CDhash,
 				    int32 *NCDphones)
 {
     char  bphn[1024],lctx[1024], rctx[1024], wdpos[1024]; 
     char  **cilist, *silence="SIL";
     lineiter_t *line = NULL;
     heapelement_t **heap=NULL, *addciphone;
-    hashelement_t **tphnhash, *tphnptr;
+    tphnhash_t *tphnhash;
+    hashelement_t *tphnptr;
     phnhashelement_t  **phnhash, *phnptr;
 
     int32 swdtphs, bwdtphs, ewdtphs, iwdtphs, maxphnsize, phnsize;
@@ -117,7 +121,7 @@ int32 make_ci_list_cd_hash_frm_phnlist(const char  *phnlist,
 
    /* Initially hash everything to remove duplications */
     phnhash = (phnhashelement_t**)calloc(PHNHASHSIZE,sizeof(phnhashelement_t*));
-    tphnhash = (hashelement_t**) ckd_calloc(HASHSIZE, sizeof(hashelement_t*));
+    tphnhash = tphnhash_new(phones);
     maxphnsize = 0;
     swdtphs = bwdtphs = ewdtphs = iwdtphs = 0;
     /* Always install SIL in phonelist */
@@ -153,7 +157,10 @@ int32 make_ci_list_cd_hash_frm_phnlist(const char  *phnlist,
 		E_WARN("Mapping it to word internal triphone\n");
 		strcpy(wdpos,"i");
 	    }
-            tphnptr = install(bphn,lctx,rctx,wdpos,tphnhash);
+            tphnptr = install(phoneset_intern(phones,bphn),
+			      phoneset_intern(phones,lctx),
+			      phoneset_intern(phones,rctx),
+			      phoneset_intern(phones,wdpos),tphnhash);
 	    if (tphnptr->dictcount == 0){
 	        if (strcmp(wdpos,"s")==0) swdtphs++;
 	        else if (strcmp(wdpos,"b")==0) bwdtphs++;
@@ -196,17 +203,19 @@ int32 make_ci_list_cd_hash_frm_phnlist(const char  *phnlist,
 
     return S3_SUCCESS;
 }
-
+
 
 int32 make_ci_list_cd_hash_frm_mdef(const char  *mdeffile,
 		           	    char  ***CIlist, 
                            	    int32 *cilistsize,
-			   	    hashelement_t ***CDhash,
+				    phoneset_t *phones,
+			   	    tphnhash_t **CDhash,
 				    int32 *NCDphones)
 {
     char  bphn[1024],lctx[1024], rctx[1024], wdpos[1024]; 
     char  **cilist;
-    hashelement_t **tphnhash, *tphnptr;
+    tphnhash_t *tphnhash;
+    hashelement_t *tphnptr;
 
     int32 swdtphs, bwdtphs, ewdtphs, iwdtphs, maxphnsize, phnsize;
     int32 nciphns, id, n_acmod;
@@ -228,12 +237,15 @@ int32 make_ci_list_cd_hash_frm_mdef(const char  *mdeffile,
         strcpy(cilist[id],acmod_set_id2name(mdef->acmod_set,id));
     }
 
-    tphnhash = (hashelement_t**) ckd_calloc(HASHSIZE, sizeof(hashelement_t*));
+    tphnhash = tphnhash_new(phones);
     swdtphs = bwdtphs = ewdtphs = iwdtphs = 0;
     for (;id < n_acmod; id++){
 	sscanf(acmod_set_id2name(mdef->acmod_set, id),"%s %s %s %s",
 		bphn,lctx,rctx,wdpos);
-        tphnptr = install(bphn,lctx,rctx,wdpos,tphnhash);
+        tphnptr = install(phoneset_intern(phones,bphn),
+			  phoneset_intern(phones,lctx),
+			  phoneset_intern(phones,rctx),
+			  phoneset_intern(phones,wdpos),tphnhash);
 	if (tphnptr->dictcount == 0){
 	    if (strcmp(wdpos,"s")==0) swdtphs++;
 	    else if (strcmp(wdpos,"b")==0) bwdtphs++;
@@ -253,9 +265,10 @@ int32 make_ci_list_cd_hash_frm_mdef(const char  *mdeffile,
 
     return S3_SUCCESS;
 }
-
+
 
 int32  read_dict(const char *dictfile, const char *fillerdict, 
+		 phoneset_t *phones,
 		 dicthashelement_t ***dicthash)
 {
     char *dictsent;
@@ -309,10 +322,13 @@ int32  read_dict(const char *dictfile, const char *fillerdict,
 	        E_FATAL("Dictionary word %s has no pronunciation\n",dictword);
             sptr->nphns = nphns; maxphnlen++;
             sptr->phones = (char**)ckd_calloc_2d(nphns,maxphnlen,sizeof(char));
+            sptr->phnids = (int32*)ckd_calloc(nphns,sizeof(int32));
 
             word = strtok(liter->buf," \t\n");
-            for(nphns=0;(phone = strtok(NULL," \t\n")) != NULL;nphns++)
+            for(nphns=0;(phone = strtok(NULL," \t\n")) != NULL;nphns++) {
 	        strcpy(sptr->phones[nphns],phone);
+		sptr->phnids[nphns] = phoneset_intern(phones,phone);
+	    }
 	
             ++vocabsiz;
             
@@ -327,115 +343,100 @@ int32  read_dict(const char *dictfile, const char *fillerdict,
     lineiter_free(liter);
     return(vocabsiz);
 }
-
+
     
 int32 make_dict_triphone_list (dicthashelement_t **dicthash,
-			  hashelement_t ***triphonehash,
+			  phoneset_t *phones,
+			  tphnhash_t **triphonehash,
 			  int ignore_wpos)
 {
-    hashelement_t **tphnhash, *tphnptr;
+    tphnhash_t *tphnhash;
+    hashelement_t *tphnptr;
     dicthashelement_t *word_el;
-    phnhashelement_t *bphnptr, **bphnhash, *ephnptr, **ephnhash;
-    char *bphn, *lctx, *rctx;
-    const char* wpos;
-    char *silencephn = "SIL";
+    int32 *bphns, *ephns, nbphns, nephns;
+    char *isbphn, *isephn;
+    int32 bphn, lctx, rctx, sil, wsng, wbeg, wint, wend;
     int32 totaltphs, totwds, bwdtphs, ewdtphs, iwdtphs, swdtphs, lnphns;
     int32 i,j,k;
 
-    tphnhash = (hashelement_t**) ckd_calloc(HASHSIZE, sizeof(hashelement_t));
-    bphnhash = (phnhashelement_t**)calloc(PHNHASHSIZE,sizeof(phnhashelement_t));
-    ephnhash = (phnhashelement_t**)calloc(PHNHASHSIZE,sizeof(phnhashelement_t));
-    if (bphnhash == NULL || ephnhash == NULL)
-	E_FATAL("Unable to alloc %d size phone hashtables!\n",(int)PHNHASHSIZE);
+    tphnhash = tphnhash_new(phones);
+    sil = phoneset_intern(phones,"SIL");
+    wsng = phoneset_intern(phones,wordpos2str(WORD_POSN_SINGLE, ignore_wpos));
+    wbeg = phoneset_intern(phones,wordpos2str(WORD_POSN_BEGIN, ignore_wpos));
+    wint = phoneset_intern(phones,wordpos2str(WORD_POSN_INTERNAL, ignore_wpos));
+    wend = phoneset_intern(phones,wordpos2str(WORD_POSN_END, ignore_wpos));
+    isbphn = (char*)ckd_calloc(phones->n,sizeof(char));
+    isephn = (char*)ckd_calloc(phones->n,sizeof(char));
+    bphns = (int32*)ckd_calloc(phones->n,sizeof(int32));
+    ephns = (int32*)ckd_calloc(phones->n,sizeof(int32));
 
     /*First count all phones that can begin or end a word (SIL can by default)*/
-    phninstall(silencephn,bphnhash);
-    phninstall(silencephn,ephnhash);
+    isbphn[sil] = isephn[sil] = 1;
     for (i = 0; i < DICTHASHSIZE; i++){
-        word_el = dicthash[i];
-        while (word_el != NULL){
-	    if (!IS_FILLER(word_el->phones[0]))
-	        phninstall(word_el->phones[0],bphnhash);
-	    if (!IS_FILLER(word_el->phones[word_el->nphns - 1]))
-	        phninstall(word_el->phones[word_el->nphns - 1],ephnhash);
-	    word_el = word_el->next;
+        for (word_el = dicthash[i]; word_el != NULL; word_el = word_el->next){
+	    if (!phones->filler[word_el->phnids[0]])
+	        isbphn[word_el->phnids[0]] = 1;
+	    if (!phones->filler[word_el->phnids[word_el->nphns - 1]])
+	        isephn[word_el->phnids[word_el->nphns - 1]] = 1;
         }
     }
+    for (i = nbphns = nephns = 0; i < phones->n; i++){
+	if (isbphn[i]) bphns[nbphns++] = i;
+	if (isephn[i]) ephns[nephns++] = i;
+    }
 
     /* Scan dictionary and make triphone list */
     totwds = bwdtphs = ewdtphs = iwdtphs = swdtphs = 0;
     for (i = 0; i < DICTHASHSIZE; i++){
-        word_el = dicthash[i];
-        while (word_el != NULL){
+        for (word_el = dicthash[i]; word_el != NULL; word_el = word_el->next){
 	    totwds++;
             lnphns = word_el->nphns;
             if (lnphns == 1) {
-                wpos = wordpos2str(WORD_POSN_SINGLE, ignore_wpos);
-                bphn = word_el->phones[0];
-		if (IS_FILLER(bphn)) {word_el = word_el->next; continue;}
-		for (j = 0; j < PHNHASHSIZE; j++){
-		    ephnptr = ephnhash[j];
-		    while (ephnptr != NULL){
-			lctx = ephnptr->phone;
-		        for (k = 0; k < PHNHASHSIZE; k++){
-		    	    bphnptr = bphnhash[k];
-		    	    while (bphnptr != NULL){
-				rctx = bphnptr->phone;
-                                tphnptr = install(bphn,lctx,rctx,wpos,tphnhash);
-				if (tphnptr->dictcount == 0) swdtphs++;
-				tphnptr->dictcount++;
-				bphnptr = bphnptr->next;
-			    }
-			}
-			ephnptr = ephnptr->next;
+                bphn = word_el->phnids[0];
+		if (phones->filler[bphn]) continue;
+		for (j = 0; j < nephns; j++){
+		    lctx = ephns[j];
+		    for (k = 0; k < nbphns; k++){
+			rctx = bphns[k];
+                        tphnptr = install(bphn,lctx,rctx,wsng,tphnhash);
+			if (tphnptr->dictcount == 0) swdtphs++;
+			tphnptr->dictcount++;
 		    }
 		}
             }
             else {
-                wpos = wordpos2str(WORD_POSN_BEGIN, ignore_wpos);
-                bphn = word_el->phones[0];
-		if (IS_FILLER(bphn)) {word_el = word_el->next; continue;}
-		rctx = word_el->phones[1];
-		if (IS_FILLER(rctx)) rctx = silencephn;
-		for (j = 0; j < PHNHASHSIZE; j++){
-		    ephnptr = ephnhash[j];
-		    while (ephnptr != NULL){
-			lctx = ephnptr->phone;
-                        tphnptr = install(bphn,lctx,rctx,wpos,tphnhash);
-			if (tphnptr->dictcount == 0) bwdtphs++;
-			tphnptr->dictcount++;
-			ephnptr = ephnptr->next;
-		    }
+                bphn = word_el->phnids[0];
+		if (phones->filler[bphn]) continue;
+		rctx = word_el->phnids[1];
+		if (phones->filler[rctx]) rctx = sil;
+		for (j = 0; j < nephns; j++){
+		    lctx = ephns[j];
+                    tphnptr = install(bphn,lctx,rctx,wbeg,tphnhash);
+		    if (tphnptr->dictcount == 0) bwdtphs++;
+		    tphnptr->dictcount++;
 		}
-                wpos = wordpos2str(WORD_POSN_INTERNAL, ignore_wpos);
                 for (j=1;j<lnphns-1;j++){
-                    bphn = word_el->phones[j];
-		    if (IS_FILLER(bphn)) continue;
-                    lctx = word_el->phones[j-1];
-		    if (IS_FILLER(lctx)) lctx = silencephn;
-                    rctx = word_el->phones[j+1];
-		    if (IS_FILLER(rctx)) rctx = silencephn;
-                    tphnptr = install(bphn,lctx,rctx,wpos,tphnhash);
+                    bphn = word_el->phnids[j];
+		    if (phones->filler[bphn]) continue;
+                    lctx = word_el->phnids[j-1];
+		    if (phones->filler[lctx]) lctx = sil;
+                    rctx = word_el->phnids[j+1];
+		    if (phones->filler[rctx]) rctx = sil;
+                    tphnptr = install(bphn,lctx,rctx,wint,tphnhash);
 		    if (tphnptr->dictcount == 0) iwdtphs++;
 		    tphnptr->dictcount++;
                 }
-                wpos = wordpos2str(WORD_POSN_END, ignore_wpos);
-                bphn = word_el->phones[lnphns-1];
-		if (IS_FILLER(bphn)) {word_el = word_el->next; continue;}
-		lctx = word_el->phones[lnphns-2];
-		if (IS_FILLER(lctx)) lctx = silencephn;
-		for (j = 0; j < PHNHASHSIZE; j++){
-		    bphnptr = bphnhash[j];
-		    while (bphnptr != NULL){
-			rctx = bphnptr->phone;
-                        tphnptr = install(bphn,lctx,rctx,wpos,tphnhash);
-			if (tphnptr->dictcount == 0) ewdtphs++;
-			tphnptr->dictcount++;
-			bphnptr = bphnptr->next;
-		    }
+                bphn = word_el->phnids[lnphns-1];
+		if (phones->filler[bphn]) continue;
+		lctx = word_el->phnids[lnphns-2];
+		if (phones->filler[lctx]) lctx = sil;
+		for (j = 0; j < nbphns; j++){
+		    rctx = bphns[j];
+                    tphnptr = install(bphn,lctx,rctx,wend,tphnhash);
+		    if (tphnptr->dictcount == 0) ewdtphs++;
+		    tphnptr->dictcount++;
 		}
             }
-	    word_el = word_el->next;
         }
     }
     totaltphs = swdtphs + bwdtphs + iwdtphs + ewdtphs;
@@ -447,164 +448,267 @@ int32 make_dict_triphone_list (dicthashelement_t **dicthash,
 
     *triphonehash = tphnhash;
 
-    freephnhash(bphnhash); freephnhash(ephnhash);
+    ckd_free(isbphn); ckd_free(isephn);
+    ckd_free(bphns); ckd_free(ephns);
 
     return S3_SUCCESS;
 }
-
 
-int32  count_triphones (const char *transfile,
-			dicthashelement_t **dicthash,
-			hashelement_t **tphnhash,
-			phnhashelement_t ***phnhash,
-			int ignore_wpos)
+
+/* One thread's share of the transcript: the lines that start in
+ * [start, end).  Counts go to private arrays that are summed once all
+ * threads are done, so the shared triphone table is only read. */
+typedef struct count_job_s {
+    const char *transfile;
+    long start, end;
+    dicthashelement_t **dicthash;
+    tphnhash_t *tphnhash;
+    int32 wpos[4];	/* Single, begin, internal, end */
+    int32 sil;
+    int32 *phncount;	/* Per phone ID */
+    int32 **tphncount;	/* Per shard and slot */
+    int32 n_totalwds, nswdtphns, nbwdtphns, niwdtphns, newdtphns;
+} count_job_t;
+
+static void
+count_one(count_job_t *job, int32 b, int32 l, int32 r, int32 wp)
 {
-    int32  nbwdtphns, newdtphns, niwdtphns, nswdtphns;
-    int32  nwords, lnphns, n_totalwds;
-    lineiter_t *line = NULL;
-    char *tline;
-    char   *word, *basephone, *lctxt, *rctxt; 
-    char   silencephn[4];
-    const char* wpos;
-    int32  i, j;
+    uint32 shard, slot;
+
+    /* Triphones missing from a given list are not counted */
+    if (tphnhash_locate(b, l, r, wp, job->tphnhash, &shard, &slot) < 0)
+	return;
+    job->tphncount[shard][slot]++;
+}
+
+static void
+count_line(count_job_t *job, char *buf)
+{
+    phoneset_t *phones = job->tphnhash->phones;
+    char **words, *word;
+    int32 nwords, lnphns, bphn, lctx, rctx, sil = job->sil;
+    int32 i, j;
     dicthashelement_t **wordarr;
-    phnhashelement_t **lphnhash, *phnptr;
-    hashelement_t *tphnptr;
-    FILE   *fp;
 
-    strcpy(silencephn,"SIL");
-    if ((fp = fopen(transfile,"r")) == NULL)
-	E_FATAL("Unable to open transcript file %s for reading!\n",transfile);
+    /* strtok() is not reentrant, so split the line in place */
+    if ((nwords = str2words(buf, NULL, 0)) <= 0)
+	return;
+    job->n_totalwds += nwords;
+    words = (char **)ckd_calloc(nwords, sizeof(char *));
+    str2words(buf, words, nwords);
+    wordarr = (dicthashelement_t **)ckd_calloc(nwords+2,sizeof(dicthashelement_t*));
+    if ((wordarr[1] = dictlookup(words[0],job->dicthash)) == NULL) {
+	E_WARN("Word %s not found in dictionary. Mapping to SIL.\n", words[0]);
+    }
+    for (j=2; j<=nwords; j++) {
+	word = words[j-1];
+	if ((wordarr[j] = dictlookup(word,job->dicthash)) == NULL) {
+	    /* If word is surrounded by "()", assume it's the
+	     * utterance ID, and don't report it as an OOV */
+	    if ((word[0] != '(') && (word[strlen(word) - 1] != ')')) {
+		E_WARN("Word %s not found in dictionary. Mapping to SIL.\n", word);
+	    }
+	}
+    }       
+    for (i=1; i<=nwords; i++){/* Indices account for padded wordarr array */
+	if (wordarr[i] == NULL) continue;
+
+	lnphns = wordarr[i]->nphns;
+	bphn = wordarr[i]->phnids[0];
+	job->phncount[bphn]++;
+	if (phones->filler[bphn]) continue;
+	if (wordarr[i-1] != NULL){
+	    lctx = wordarr[i-1]->phnids[wordarr[i-1]->nphns - 1];
+	    if (phones->filler[lctx]) lctx = sil;
+	}
+	else lctx = sil;
+	if (lnphns == 1) {
+	    if (wordarr[i+1] != NULL){
+		rctx = wordarr[i+1]->phnids[0];
+		if (phones->filler[rctx]) rctx = sil;
+	    }
+	    else rctx = sil;
+	    count_one(job,bphn,lctx,rctx,job->wpos[0]);
+	    job->nswdtphns++;
+	    continue;
+	}
 
-    E_INFO("Out of vocabulary words in transcript will be mapped to SIL!\n");
+	rctx = wordarr[i]->phnids[1];
+	if (phones->filler[rctx]) rctx = sil;
+	count_one(job,bphn,lctx,rctx,job->wpos[1]);
+	job->nbwdtphns++;
+
+	for (j=1;j<lnphns-1;j++){
+	    bphn = wordarr[i]->phnids[j];
+	    job->phncount[bphn]++;
+	    if (phones->filler[bphn]) continue;
+	    lctx = wordarr[i]->phnids[j-1];
+	    if (phones->filler[lctx]) lctx = sil;
+	    rctx = wordarr[i]->phnids[j+1];
+	    if (phones->filler[rctx]) rctx = sil;
+	    count_one(job,bphn,lctx,rctx,job->wpos[2]);
+	    job->niwdtphns++;
+	}
 
-    lphnhash = (phnhashelement_t**)calloc(PHNHASHSIZE,sizeof(phnhashelement_t));
+	bphn = wordarr[i]->phnids[lnphns-1];
+	job->phncount[bphn]++;
+	if (phones->filler[bphn]) continue;
+	lctx = wordarr[i]->phnids[lnphns-2];
+	if (phones->filler[lctx]) lctx = sil;
+	if (wordarr[i+1] != NULL){
+	    rctx = wordarr[i+1]->phnids[0];
+	    if (phones->filler[rctx]) rctx = sil;
+	}
+	else rctx = sil;
+	count_one(job,bphn,lctx,rctx,job->wpos[3]);
+	job->newdtphns++;
+    }
+    ckd_free(wordarr);
+    ckd_free(words);
+}
 
-    n_totalwds = 0;
-    nbwdtphns = newdtphns = niwdtphns = nswdtphns = 0;
+static int
+count_job(count_job_t *job)
+{
+    lineiter_t *line = NULL;
+    FILE *fp;
+    long pos;
+    int c;
+
+    if ((fp = fopen(job->transfile,"r")) == NULL)
+	E_FATAL_SYSTEM("Unable to open transcript file %s for reading",
+		       job->transfile);
+
+    /* A line belongs to the chunk it starts in */
+    if (job->start > 0) {
+	fseek(fp, job->start - 1, SEEK_SET);
+	while ((c = fgetc(fp)) != EOF && c != '\n');
+    }
+    while ((pos = ftell(fp)) < job->end) {
+	line = line ? lineiter_next(line) : lineiter_start(fp);
+	if (line == NULL)
+	    break;
+	/* Skip what lineiter_start_clean() would: a leading comment,
+	 * later comments and blank lines */
+	if (pos == 0 && line->buf[0] == '#')
+	    continue;
+	string_trim(line->buf, STRING_BOTH);
+	if (line->buf[0] == '\0' || (pos > 0 && line->buf[0] == '#'))
+	    continue;
+	count_line(job, line->buf);
+    }
+    lineiter_free(line);
+    fclose(fp);
 
-    for (line = lineiter_start_clean(fp); line; line = lineiter_next(line)) {
+    return 0;
+}
 
-	tline = strdup(line->buf);
-        if (strtok(tline," \t\n") == NULL) {
-           free(tline);
-    	   continue;
-        }
+static int
+count_worker(sbthread_t *th)
+{
+    return count_job((count_job_t *)sbthread_arg(th));
+}
 
-        /* Count number of phones in pronunciation */
-        for(nwords=1; strtok(NULL," \t\n") != NULL; nwords++);
-	n_totalwds += nwords;
-	wordarr = (dicthashelement_t **)ckd_calloc(nwords+2,sizeof(dicthashelement_t*));
-        word = strtok(line->buf," \t\n"); 
-        if ((wordarr[1] = dictlookup(word,dicthash)) == NULL) {
-            E_WARN("Word %s not found in dictionary. Mapping to SIL.\n", word);
-        }
-        for (j=2; (word = strtok(NULL," \t\n")) != NULL; j++) {
-            if ((wordarr[j] = dictlookup(word,dicthash)) == NULL) {
-                /* If word is surrounded by "()", assume it's the
-                 * utterance ID, and don't report it as an OOV */
-                if ((word[0] != '(') && (word[strlen(word) - 1] != ')')) {
-                    E_WARN("Word %s not found in dictionary. Mapping to SIL.\n", word);
-                }
-            }
-        }       
-	for (i=1; i<=nwords; i++){/* Indices account for padded wordarr array */
-	    if (wordarr[i] == NULL) continue;
-
-	    lnphns = wordarr[i]->nphns;
-	    if (lnphns == 1) {
-		wpos = wordpos2str(WORD_POSN_SINGLE, ignore_wpos);
-		basephone = wordarr[i]->phones[0];
-		phnptr = phninstall(basephone,lphnhash);
-		phnptr->count++;
-		if (IS_FILLER(basephone)) continue;
-		if (wordarr[i-1] != NULL){
-		    lctxt = wordarr[i-1]->phones[wordarr[i-1]->nphns - 1];
-		    if (IS_FILLER(lctxt)) lctxt = silencephn;
-		}
-		else lctxt = silencephn;
-		if (wordarr[i+1] != NULL){
-		    rctxt = wordarr[i+1]->phones[0];
-		    if (IS_FILLER(rctxt)) rctxt = silencephn;
-		}
-		else rctxt = silencephn;
-		tphnptr = lookup(basephone,lctxt,rctxt,wpos,tphnhash);
-		(tphnptr->count)++;
-		nswdtphns++;
-	    }
-	    else {
-		wpos = wordpos2str(WORD_POSN_BEGIN, ignore_wpos);
-		basephone = wordarr[i]->phones[0];
-		phnptr = phninstall(basephone,lphnhash);
-		phnptr->count++;
-		if (IS_FILLER(basephone)) continue;
-                if (!IS_FILLER(basephone)){
-		    if (wordarr[i-1] != NULL){
-		        lctxt = wordarr[i-1]->phones[wordarr[i-1]->nphns - 1];
-		        if (IS_FILLER(lctxt)) lctxt = silencephn;
-		    }
-		    else lctxt = silencephn;
-		    rctxt = wordarr[i]->phones[1];
-		    if (IS_FILLER(rctxt)) rctxt = silencephn;
-		    tphnptr = lookup(basephone,lctxt,rctxt,wpos,tphnhash);
-		    (tphnptr->count)++; 
-                    nbwdtphns++;
-	        }
-		wpos = wordpos2str(WORD_POSN_INTERNAL, ignore_wpos);
-		for (j=1;j<lnphns-1;j++){
-		    basephone = wordarr[i]->phones[j];
-		    phnptr = phninstall(basephone,lphnhash);
-		    phnptr->count++;
-		    if (IS_FILLER(basephone)) continue;
-		    lctxt = wordarr[i]->phones[j-1];
-		    if (IS_FILLER(lctxt)) lctxt = silencephn;
-		    rctxt = wordarr[i]->phones[j+1];
-		    if (IS_FILLER(rctxt)) rctxt = silencephn;
-		    tphnptr = lookup(basephone,lctxt,rctxt,wpos,tphnhash);
-		    (tphnptr->count)++;
-		    niwdtphns++;
-		}
+int32  count_triphones (const char *transfile,
+			dicthashelement_t **dicthash,
+			tphnhash_t *tphnhash,
+			int32 **phncount,
+			int ignore_wpos,
+			int32 n_thread)
+{
+    phoneset_t *phones = tphnhash->phones;
+    count_job_t *job;
+    sbthread_t **thread;
+    hashelement_t *slot;
+    struct stat st;
+    int32 t, i, k, sil;
+    int32 wpos[4];
+
+    if (stat(transfile, &st) < 0)
+	E_FATAL_SYSTEM("Unable to open transcript file %s for reading",
+		       transfile);
 
-		wpos = wordpos2str(WORD_POSN_END, ignore_wpos);
-		basephone = wordarr[i]->phones[lnphns-1];
-		phnptr = phninstall(basephone,lphnhash);
-		phnptr->count++;
-		if (IS_FILLER(basephone)) continue;
-
-		lctxt = wordarr[i]->phones[lnphns-2];
-		if (IS_FILLER(lctxt)) lctxt = silencephn;
-		if (wordarr[i+1] != NULL){
-		    rctxt = wordarr[i+1]->phones[0];
-		    if (IS_FILLER(rctxt)) rctxt = silencephn;
-		}
-		else rctxt = silencephn;
-		tphnptr = lookup(basephone,lctxt,rctxt,wpos,tphnhash);
-		(tphnptr->count)++;
-		newdtphns++;
-	    }
+    E_INFO("Out of vocabulary words in transcript will be mapped to SIL!\n");
+
+    /* The phone set must not grow while the threads read it */
+    sil = phoneset_intern(phones,"SIL");
+    wpos[0] = phoneset_intern(phones,wordpos2str(WORD_POSN_SINGLE, ignore_wpos));
+    wpos[1] = phoneset_intern(phones,wordpos2str(WORD_POSN_BEGIN, ignore_wpos));
+    wpos[2] = phoneset_intern(phones,wordpos2str(WORD_POSN_INTERNAL, ignore_wpos));
+    wpos[3] = phoneset_intern(phones,wordpos2str(WORD_POSN_END, ignore_wpos));
+
+    if (n_thread < 1)
+	n_thread = 1;
+    /* Threads are not worth it for small transcripts */
+    if (n_thread > st.st_size / 65536 + 1)
+	n_thread = st.st_size / 65536 + 1;
+
+    job = (count_job_t *)ckd_calloc(n_thread, sizeof(*job));
+    thread = (sbthread_t **)ckd_calloc(n_thread, sizeof(*thread));
+    for (t = 0; t < n_thread; t++) {
+	job[t].transfile = transfile;
+	job[t].start = (long)((double)st.st_size * t / n_thread);
+	job[t].end = (long)((double)st.st_size * (t + 1) / n_thread);
+	job[t].dicthash = dicthash;
+	job[t].tphnhash = tphnhash;
+	memcpy(job[t].wpos, wpos, sizeof(wpos));
+	job[t].sil = sil;
+	job[t].phncount = (int32 *)ckd_calloc(phones->n, sizeof(int32));
+	job[t].tphncount = (int32 **)ckd_calloc(TPHN_N_SHARD, sizeof(int32 *));
+	for (k = 0; k < TPHN_N_SHARD; k++)
+	    job[t].tphncount[k] =
+		(int32 *)ckd_calloc(tphnhash->shard[k].n_slot, sizeof(int32));
+    }
+    for (t = 1; t < n_thread; t++)
+	thread[t] = sbthread_start(count_worker, &job[t]);
+    count_job(&job[0]);
+    for (t = 1; t < n_thread; t++)
+	sbthread_free(thread[t]);
+
+    /* Sum the per-thread counts into job 0 and the triphone table */
+    for (t = 1; t < n_thread; t++) {
+	for (i = 0; i < phones->n; i++)
+	    job[0].phncount[i] += job[t].phncount[i];
+	job[0].n_totalwds += job[t].n_totalwds;
+	job[0].nswdtphns += job[t].nswdtphns;
+	job[0].nbwdtphns += job[t].nbwdtphns;
+	job[0].niwdtphns += job[t].niwdtphns;
+	job[0].newdtphns += job[t].newdtphns;
+    }
+    for (k = 0; k < TPHN_N_SHARD; k++) {
+	slot = tphnhash->shard[k].slot;
+	for (t = 0; t < n_thread; t++) {
+	    for (i = 0; i < tphnhash->shard[k].n_slot; i++)
+		slot[i].count += job[t].tphncount[k][i];
 	}
-        free(wordarr);
-        free(tline);
     }
-    fclose(fp);
-    lineiter_free(line);
 
-    *phnhash = lphnhash;
-    E_INFO("%d words in transcripts\n",n_totalwds);
-    E_INFO("%d single word triphones in transcripts\n",nswdtphns);
-    E_INFO("%d word beginning triphones in transcripts\n",nbwdtphns);
-    E_INFO("%d word internal triphones in transcripts\n",niwdtphns);
-    E_INFO("%d word ending triphones in transcripts\n",newdtphns);
+    *phncount = job[0].phncount;
+    E_INFO("%d words in transcripts\n",job[0].n_totalwds);
+    E_INFO("%d single word triphones in transcripts\n",job[0].nswdtphns);
+    E_INFO("%d word beginning triphones in transcripts\n",job[0].nbwdtphns);
+    E_INFO("%d word internal triphones in transcripts\n",job[0].niwdtphns);
+    E_INFO("%d word ending triphones in transcripts\n",job[0].newdtphns);
+
+    for (t = 0; t < n_thread; t++) {
+	if (t > 0)
+	    ckd_free(job[t].phncount);
+	for (k = 0; k < TPHN_N_SHARD; k++)
+	    ckd_free(job[t].tphncount[k]);
+	ckd_free(job[t].tphncount);
+    }
+    ckd_free(thread);
+    ckd_free(job);
 
     return S3_SUCCESS;
 }
-
 
-int32 find_threshold(hashelement_t  **triphonehash)
+
+int32 find_threshold(tphnhash_t  *triphonehash)
 {
-    hashelement_t *triphone_el;
+    tphnshard_t *sh;
     int32 tottph, ltottph, mincnt, maxtph, *countofcounts, *lcountofcounts;
-    int32 i, cnt, unique, threshold, ceiling;
+    int32 i, k, cnt, unique, threshold, ceiling;
 
     mincnt = cmd_ln_int32("-minocc");
     maxtph = cmd_ln_int32("-maxtriphones");
@@ -614,10 +718,11 @@ int32 find_threshold(hashelement_t  **triphonehash)
     tottph = ltottph = unique = 0;
     countofcounts = (int32 *) ckd_calloc(ceiling+1,sizeof(int32));
     lcountofcounts = (int32 *) ckd_calloc(ceiling+1,sizeof(int32));
-    for (i = 0; i < HASHSIZE; i++){
-	triphone_el = triphonehash[i];
-	while (triphone_el != NULL){
-	    cnt = triphone_el->count;
+    for (k = 0; k < TPHN_N_SHARD; k++){
+	sh = &triphonehash->shard[k];
+	for (i = 0; i < sh->n_slot; i++){
+	    if (sh->slot[i].key == TPHN_EMPTY) continue;
+	    cnt = sh->slot[i].count;
 	    if (cnt > 0) {
 	        tottph += cnt;
 	        if (cnt >= mincnt) {
@@ -627,7 +732,6 @@ int32 find_threshold(hashelement_t  **triphonehash)
 	        }
 	        countofcounts[cnt]++; unique++;
 	    }
-	    triphone_el = triphone_el->next;
 	}
     }
 
@@ -648,32 +752,43 @@ int32 find_threshold(hashelement_t  **triphonehash)
     ckd_free(lcountofcounts); ckd_free(countofcounts);
     return(threshold);
 }
-
 
-int32 make_CD_heap(hashelement_t  **triphonehash,
+
+static heapelement_t *tphn_heapelement(tphnhash_t *triphonehash,
+				       hashelement_t *triphone_el)
+{
+    char **name = triphonehash->phones->name;
+    heapelement_t *addtriphone;
+
+    addtriphone = (heapelement_t *) calloc(1,sizeof(heapelement_t));
+    if (addtriphone == NULL)
+	E_FATAL("Heap install error. Out of memory!\n");
+    addtriphone->basephone = strdup(name[TPHN_BASE(triphone_el->key)]);
+    addtriphone->leftcontext = strdup(name[TPHN_LEFT(triphone_el->key)]);
+    addtriphone->rightcontext = strdup(name[TPHN_RIGHT(triphone_el->key)]);
+    addtriphone->wordposition = strdup(name[TPHN_WPOS(triphone_el->key)]);
+    addtriphone->count = triphone_el->count;
+
+    return addtriphone;
+}
+
+
+int32 make_CD_heap(tphnhash_t  *triphonehash,
 		   int32  threshold,
 		   heapelement_t ***CDheap,
 		   int32  *cdheapsize)
 {
-    heapelement_t **heap=NULL, *addtriphone;
-    hashelement_t *triphone_el;
-    int32 i, heapsize;
+    heapelement_t **heap=NULL;
+    tphnshard_t *sh;
+    int32 i, k, heapsize;
 
     heapsize = 0;
-    for (i = 0; i < HASHSIZE; i++){
-	triphone_el = triphonehash[i];
-	while (triphone_el != NULL){
-	    if (triphone_el->count >= threshold) {
-		addtriphone = (heapelement_t *) calloc(1,sizeof(heapelement_t));
-		if (addtriphone == NULL)
-		    E_FATAL("Heap install error. Out of memory!\n");
-		addtriphone->basephone = strdup(triphone_el->basephone);
-		addtriphone->leftcontext = strdup(triphone_el->leftcontext);
-		addtriphone->rightcontext = strdup(triphone_el->rightcontext);
-	        addtriphone->wordposition = strdup(triphone_el->wordposition);
-		heapsize = insert(&heap, heapsize, addtriphone);
-            }
-	    triphone_el = triphone_el->next;
+    for (k = 0; k < TPHN_N_SHARD; k++){
+	sh = &triphonehash->shard[k];
+	for (i = 0; i < sh->n_slot; i++){
+	    if (sh->slot[i].key != TPHN_EMPTY && sh->slot[i].count >= threshold)
+		heapsize = insert(&heap, heapsize,
+				  tphn_heapelement(triphonehash, &sh->slot[i]));
         }
     }
     *CDheap = heap;
@@ -681,15 +796,14 @@ int32 make_CD_heap(hashelement_t  **triphonehash,
 
     return S3_SUCCESS;
 }
-
 
-int32   print_counts(const char *countfn, phnhashelement_t  **CIhash,
-		     hashelement_t **CDhash)
+
+int32   print_counts(const char *countfn, int32 *phncount,
+		     tphnhash_t *CDhash)
 {
     heapelement_t **CDheap=NULL, **CIheap=NULL, *addphone, *addtriphone;
-    hashelement_t *triphone_el; 
-    phnhashelement_t *ciphone_el;
-    int32 i, heapsize,cdheapsize,ciheapsize;
+    tphnshard_t *sh;
+    int32 i, k, heapsize,cdheapsize,ciheapsize;
     FILE  *ofp;
 
     if ((ofp = fopen(countfn,"w")) == NULL){
@@ -699,19 +813,13 @@ int32   print_counts(const char *countfn, phnhashelement_t  **CIhash,
     fprintf(ofp,"base\tleft\tright\twdpos\tcount\n");
 
     ciheapsize = 0;
-    for (i = 0; i < PHNHASHSIZE; i++){
-	ciphone_el = CIhash[i];
-	while (ciphone_el != NULL){
-	    if (ciphone_el->count < 1) {
-		ciphone_el = ciphone_el->next;
-		continue;
-	    }
-	    addphone = (heapelement_t *) ckd_calloc(1,sizeof(heapelement_t));
-	    addphone->basephone = strdup(ciphone_el->phone);
-	    addphone->count = ciphone_el->count;
-	    ciheapsize = insert(&CIheap, ciheapsize, addphone);
-	    ciphone_el = ciphone_el->next;
-        }
+    for (i = 0; i < CDhash->phones->n; i++){
+	if (phncount[i] < 1)
+	    continue;
+	addphone = (heapelement_t *) ckd_calloc(1,sizeof(heapelement_t));
+	addphone->basephone = strdup(CDhash->phones->name[i]);
+	addphone->count = phncount[i];
+	ciheapsize = insert(&CIheap, ciheapsize, addphone);
     }
     heapsize = ciheapsize;
     for (i = 0; i < heapsize; i++) {
@@ -721,21 +829,12 @@ int32   print_counts(const char *countfn, phnhashelement_t  **CIhash,
     }
 
     cdheapsize = 0;
-    for (i = 0; i < HASHSIZE; i++){
-	triphone_el = CDhash[i];
-	while (triphone_el != NULL){
-	    if (triphone_el->count < 1) {
-		triphone_el = triphone_el->next;
-		continue;
-	    }
-	    addtriphone = (heapelement_t *) ckd_calloc(1,sizeof(heapelement_t));
-	    addtriphone->basephone = strdup(triphone_el->basephone);
-	    addtriphone->leftcontext = strdup(triphone_el->leftcontext);
-	    addtriphone->rightcontext = strdup(triphone_el->rightcontext);
-	    addtriphone->wordposition = strdup(triphone_el->wordposition);
-	    addtriphone->count = triphone_el->count;
-	    cdheapsize = insert(&CDheap, cdheapsize, addtriphone);
-	    triphone_el = triphone_el->next;
+    for (k = 0; k < TPHN_N_SHARD; k++){
+	sh = &CDhash->shard[k];
+	for (i = 0; i < sh->n_slot; i++){
+	    if (sh->slot[i].key != TPHN_EMPTY && sh->slot[i].count >= 1)
+		cdheapsize = insert(&CDheap, cdheapsize,
+				    tphn_heapelement(CDhash, &sh->slot[i]));
         }
     }
     heapsize = cdheapsize;
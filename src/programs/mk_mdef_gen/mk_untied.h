@@ -48,16 +48,19 @@ int32 make_ci_list_frm_mdef(const char  *mdeffile,
 int32 make_ci_list_cd_hash_frm_phnlist(const char  *phnlist,
                                     char  ***CIlist,
                                     int32 *cilistsize,
-                                    hashelement_t ***CDhash,
+                                    phoneset_t *phones,
+                                    tphnhash_t **CDhash,
                                     int32 *NCDphones);
 
 int32 make_ci_list_cd_hash_frm_mdef(const char  *mdeffile,
                                     char  ***CIlist,
                                     int32 *cilistsize,
-                                    hashelement_t ***CDhash,
+                                    phoneset_t *phones,
+                                    tphnhash_t **CDhash,
                                     int32 *NCDphones);
 
 int32  read_dict(const char *dictfile, const char *fillerdictfile,
+		 phoneset_t *phones,
 		 dicthashelement_t ***dicthash);
 
 int32 make_mdef_from_list(const char *mdeffile,
@@ -68,22 +71,24 @@ int32 make_mdef_from_list(const char *mdeffile,
                         char  *pgm);
 
 int32 make_dict_triphone_list (dicthashelement_t **dicthash,
-                          hashelement_t ***triphonehash,
+                          phoneset_t *phones,
+                          tphnhash_t **triphonehash,
                           int ignore_wpos);
 
-int32 make_CD_heap(hashelement_t  **triphonehash,
+int32 make_CD_heap(tphnhash_t  *triphonehash,
                    int32  threshold,
                    heapelement_t ***CDheap,
                    int32  *cdheapsize);
 
-int32 find_threshold(hashelement_t  **triphonehash);
+int32 find_threshold(tphnhash_t  *triphonehash);
 
 int32  count_triphones (const char *transfile,
                         dicthashelement_t **dicthash,
-                        hashelement_t **tphnhash,
-			phnhashelement_t ***CIhash,
-			int ignore_wpos);
+                        tphnhash_t *tphnhash,
+			int32 **phncount,
+			int ignore_wpos,
+			int32 n_thread);
 
-int32   print_counts(const char *countfn, phnhashelement_t  **CIhash,
-                     hashelement_t **CDhash);
+int32   print_counts(const char *countfn, int32 *phncount,
+                     tphnhash_t *CDhash);
 #endif
@@ -170,6 +170,10 @@ mk_mdef_gen -phnlstfn rawphone -oalltphnmdef untie_mdef -dictfn dict \n\
 	  ARG_INT32,
 	  "100000",
 	  "Max. number of triphones desired in mdef file"},
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads counting triphones in the transcripts"},
 	{ NULL,
 	  0,
 	  NULL,
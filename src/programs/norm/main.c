@@ -258,6 +258,15 @@ normalize()
 	}
     }
 
+    /* Tying sums the variance counts as they are.  One-pass counts
+     * would also need the Chan correction for the spread of the
+     * density means, which the tying does not apply */
+    if (pass2var == GAUCNT_PASS2VAR_CENTERED && out_var_fn
+	&& cmd_ln_boolean("-tiedvar")) {
+	E_FATAL("-tiedvar cannot be used with counts from init_gau -onepass; "
+		"use two-pass init_gau or set -tiedvar no\n");
+    }
+
     if (oaccum_dir && mixw_acc) {
 	/* write the total mixing weight reest. accumulators */
 
@@ -48,7 +48,12 @@
 #include "phone_cnt.h"
 
 #include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/err.h>
 #include <sphinxbase/prim_type.h>
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/pio.h>
 
 #include <s3/mk_sseq.h>
 #include <s3/ck_seg.h>
@@ -58,105 +63,258 @@
 #include <s3/s3.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 
-int
-enum_corpus(lexicon_t *lex,
-	    model_def_t *mdef,
-	    uint32 *cnt,
-	    cnt_fn_t cnt_fn)
+/* Shared by all the counting threads.  Utterances are read one at a
+ * time under the lock; everything else is done outside it. */
+typedef struct enum_ctx_s {
+    lexicon_t *lex;
+    model_def_t *mdef;
+    cnt_fn_t cnt_fn;
+    sbmtx_t *mtx;
+    lineiter_t *lsn;		/* Transcript-only mode */
+    int lsn_mode;
+    int lsn_read;		/* Whether lsn->buf was consumed */
+    int32 lsn_left;		/* Lines still to count, or -1 for all */
+    int done;			/* corpus_next_utt() has returned FALSE */
+    uint32 tick_cnt;
+} enum_ctx_t;
+
+typedef struct enum_job_s {
+    enum_ctx_t *ctx;
+    uint32 *cnt;		/* Private counts, summed at the end */
+} enum_job_t;
+
+/* Cut a trailing "(uttid)" off a transcript line, returning the id */
+static char *
+strip_uttid(char *line)
 {
-    uint32 tick_cnt = 0;
-    char *trans = NULL;
-    uint16 *seg = NULL;
-    int32 n_frame;
-    char **word = NULL;
-    uint32 n_word;
-    acmod_id_t *phone = NULL;
-    uint32 n_phone;
-    char *btw_mark = NULL;
+    char *s, *e;
 
-    while (corpus_next_utt()) {
-	if (trans) {
-	    free(trans);
-	    trans = NULL;
-	}
-	if (seg) {
-	    free(seg);
-	    seg = NULL;
-	}
-	if (word) {
-	    ckd_free(word);
-	    word = NULL;
-	}
-	if (phone) {
-	    ckd_free(phone);
-	    phone = NULL;
+    if ((e = strrchr(line, ')')) == NULL
+	|| e[1 + strspn(e + 1, " \t\r\n")] != '\0')
+	return NULL;
+    for (s = e; s >= line && *s != '('; s--);
+    if (s < line)
+	return NULL;
+    *e = '\0';
+    *s = '\0';
+    for (e = s - 1; e >= line && isspace((unsigned char)*e); e--)
+	*e = '\0';
+
+    return s + 1;
+}
+
+/* Fetch the next utterance; returns FALSE at the end of the corpus */
+static int
+next_utt(enum_ctx_t *ctx,
+	 char **trans,
+	 char **uttid,
+	 uint16 **seg,
+	 int32 *n_frame)
+{
+    char *id;
+    int more;
+
+    sbmtx_lock(ctx->mtx);
+    if (ctx->lsn_mode) {
+	if (ctx->lsn_read && ctx->lsn)
+	    ctx->lsn = lineiter_next(ctx->lsn);
+	ctx->lsn_read = TRUE;
+	more = (ctx->lsn != NULL && ctx->lsn_left != 0);
+	if (more) {
+	    if (ctx->lsn_left > 0)
+		--ctx->lsn_left;
+	    *trans = ckd_salloc(ctx->lsn->buf);
+	    id = strip_uttid(*trans);
+	    *uttid = ckd_salloc(id ? id : "");
 	}
-	if (btw_mark) {
-	    ckd_free(btw_mark);
-	    btw_mark = NULL;
+    }
+    else if (ctx->done)
+	more = FALSE;
+    else if (!(more = corpus_next_utt()))
+	ctx->done = TRUE;
+    else {
+	if (corpus_get_sent(trans) != S3_SUCCESS) {
+	    E_FATAL("Unable to read word transcript for %s\n", corpus_utt_brief_name());
 	}
-	
-	if ((++tick_cnt % 1000) == 0) {
-	    fprintf(stderr, "[%u] ", tick_cnt);
-	    fflush(stderr);
+	if (ctx->cnt_fn != phone_cnt){
+	    if (corpus_get_seg(seg, n_frame) != S3_SUCCESS) {
+		E_FATAL("Unable to read Viterbi state segmentation for %s\n",
+			corpus_utt_brief_name());
+	    }
 	}
+	*uttid = ckd_salloc(corpus_utt());
+    }
+    if (more && (++ctx->tick_cnt % 1000) == 0) {
+	fprintf(stderr, "[%u] ", ctx->tick_cnt);
+	fflush(stderr);
+    }
+    sbmtx_unlock(ctx->mtx);
 
-	if (corpus_get_sent(&trans) != S3_SUCCESS) {
-	    E_FATAL("Unable to read word transcript for %s\n", corpus_utt_brief_name());
-	}
+    return more;
+}
+
+/* Open the transcripts and position them on the first utterance of
+ * the -nskip/-runlen interval or the -part/-npart partition, which are
+ * worked out over transcript lines as corpus_set_interval() and
+ * corpus_set_partition() do over control file lines */
+static FILE *
+lsn_open(enum_ctx_t *ctx, const char *lsnfn)
+{
+    FILE *fp;
+    lineiter_t *li;
+    int32 n_skip, run_len, part, n_part, n_line;
+
+    if ((fp = fopen(lsnfn, "r")) == NULL)
+	E_FATAL_SYSTEM("Unable to open %s for reading", lsnfn);
+
+    n_skip = cmd_ln_int32("-nskip");
+    run_len = cmd_ln_int32("-runlen");
+    part = cmd_ln_int32("-part");
+    n_part = cmd_ln_int32("-npart");
+    if (n_skip && run_len) {
+	if (n_skip < 0 || run_len < 0)
+	    E_FATAL("-nskip and -runlen must not be negative\n");
+    }
+    else if (part && n_part) {
+	if (n_part < 1 || part < 1 || part > n_part)
+	    E_FATAL("-part must be in the range 1..%d\n", n_part);
+	for (n_line = 0, li = lineiter_start_clean(fp); li;
+	     li = lineiter_next(li))
+	    n_line++;
+	rewind(fp);
+	run_len = n_line / n_part;
+	n_skip = (part - 1) * run_len;
+	if (part == n_part)
+	    run_len = -1;
+    }
+    else {
+	n_skip = 0;
+	run_len = -1;
+    }
+
+    ctx->lsn = lineiter_start_clean(fp);
+    for (; n_skip > 0 && ctx->lsn; --n_skip)
+	ctx->lsn = lineiter_next(ctx->lsn);
+    ctx->lsn_left = run_len;
+    ctx->lsn_mode = TRUE;
+
+    return fp;
+}
+
+static int
+enum_job(enum_job_t *job)
+{
+    enum_ctx_t *ctx = job->ctx;
+    char *trans, *uttid;
+    uint16 *seg;
+    int32 n_frame;
+    char **word;
+    uint32 n_word;
+    acmod_id_t *phone;
+    uint32 n_phone;
+    char *btw_mark;
+
+    for (;;) {
+	trans = uttid = NULL;
+	seg = NULL;
+	n_frame = 0;
+	phone = NULL;
+	btw_mark = NULL;
+	if (!next_utt(ctx, &trans, &uttid, &seg, &n_frame))
+	    break;
 
-        if (cnt_fn != phone_cnt){
-	    if (corpus_get_seg(&seg, &n_frame) != S3_SUCCESS) {
-	        E_FATAL("Unable to read Viterbi state segmentation for %s\n",
-		    corpus_utt_brief_name());
-            }
-	}
-	    
 	n_word = str2words(trans, NULL, 0);
 	word = ckd_calloc(n_word, sizeof(char*));
 	str2words(trans, word, n_word);
 
-	phone = mk_phone_list(&btw_mark, &n_phone, word, n_word, lex);
+	phone = mk_phone_list(&btw_mark, &n_phone, word, n_word, ctx->lex);
 	if (phone == NULL) {
-	    E_WARN("Unable to produce phone sequence; skipping utt %s\n", corpus_utt());
-	    continue;
+	    E_WARN("Unable to produce phone sequence; skipping utt %s\n", uttid);
 	}
-
-        if (cnt_fn != phone_cnt){
-	    /* check to see whether the word transcript and dictionary entries
-	       agree with the state segmentation */
-	    if (ck_seg(mdef->acmod_set, phone, n_phone, seg, n_frame, corpus_utt()) != S3_SUCCESS) {
-	        continue;
-            }
+	/* check to see whether the word transcript and dictionary entries
+	   agree with the state segmentation */
+	else if (ctx->cnt_fn == phone_cnt
+		 || ck_seg(ctx->mdef->acmod_set, phone, n_phone,
+			   seg, n_frame, uttid) == S3_SUCCESS) {
+	    (*ctx->cnt_fn)(job->cnt,		/* observation counts */
+			   ctx->mdef,		/* model definitions */
+			   seg, n_frame,	/* Viterbi state segmentation */
+			   phone, btw_mark, n_phone);	/* list of phones */
 	}
 
-	(*cnt_fn)(cnt,				/* observation counts */
-		  mdef,				/* model definitions */
-		  seg, n_frame,			/* Viterbi state segmentation */
-		  phone, btw_mark, n_phone);	/* list of phones */
-    }
-
-    /* free the per utterance data structures from the last utt */
-    if (trans) {
+	/* free the per utterance data structures */
 	free(trans);
-	trans = NULL;
+	ckd_free(uttid);
+	if (seg)
+	    free(seg);
+	ckd_free(word);
+	ckd_free(phone);
+	ckd_free(btw_mark);
     }
-    if (seg) {
-	free(seg);
-	seg = NULL;
+
+    return 0;
+}
+
+static int
+enum_worker(sbthread_t *th)
+{
+    return enum_job((enum_job_t *)sbthread_arg(th));
+}
+
+int
+enum_corpus(lexicon_t *lex,
+	    model_def_t *mdef,
+	    uint32 *cnt,
+	    uint32 n_cnt,
+	    cnt_fn_t cnt_fn,
+	    const char *lsnfn,
+	    int32 n_thread)
+{
+    enum_ctx_t ctx;
+    enum_job_t *job;
+    sbthread_t **thread;
+    FILE *fp = NULL;
+    uint32 i;
+    int32 t;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.lex = lex;
+    ctx.mdef = mdef;
+    ctx.cnt_fn = cnt_fn;
+    ctx.mtx = sbmtx_init();
+    if (lsnfn) {
+	/* Read the transcripts directly; no control file or
+	   segmentations are needed to count phones */
+	fp = lsn_open(&ctx, lsnfn);
     }
-    if (word) {
-	ckd_free(word);
-	word = NULL;
+
+    if (n_thread < 1)
+	n_thread = 1;
+    job = ckd_calloc(n_thread, sizeof(*job));
+    thread = ckd_calloc(n_thread, sizeof(*thread));
+    for (t = 0; t < n_thread; t++) {
+	job[t].ctx = &ctx;
+	job[t].cnt = (t == 0) ? cnt : ckd_calloc(n_cnt, sizeof(uint32));
     }
-    if (phone) {
-	ckd_free(phone);
-	phone = NULL;
+    for (t = 1; t < n_thread; t++)
+	thread[t] = sbthread_start(enum_worker, &job[t]);
+    enum_job(&job[0]);
+    for (t = 1; t < n_thread; t++) {
+	sbthread_free(thread[t]);
+	for (i = 0; i < n_cnt; i++)
+	    cnt[i] += job[t].cnt[i];
+	ckd_free(job[t].cnt);
     }
-    if (btw_mark) {
-	ckd_free(btw_mark);
-	btw_mark = NULL;
+    ckd_free(thread);
+    ckd_free(job);
+
+    sbmtx_free(ctx.mtx);
+    if (fp) {
+	lineiter_free(ctx.lsn);
+	fclose(fp);
     }
     
     return S3_SUCCESS;
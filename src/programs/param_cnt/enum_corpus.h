@@ -55,6 +55,9 @@ int
 enum_corpus(lexicon_t *lex,
 	    model_def_t *mdef,
 	    uint32 *cnt,
-	    cnt_fn_t cnt_fn);
+	    uint32 n_cnt,
+	    cnt_fn_t cnt_fn,
+	    const char *lsnfn,
+	    int32 n_thread);
 
 #endif /* ENUM_CORPUS_H */ 
@@ -78,28 +78,42 @@ initialize(lexicon_t **out_lex,
     /* define, parse and (partially) validate the command line */
     parse_cmd_ln(argc, argv);
 
-    corpus_set_seg_dir(cmd_ln_str("-segdir"));
-    corpus_set_seg_ext(cmd_ln_str("-segext"));
-
-    if (cmd_ln_str("-lsnfn"))
-	corpus_set_lsn_filename(cmd_ln_str("-lsnfn"));
-    else {
-	corpus_set_sent_dir(cmd_ln_str("-sentdir"));
-	corpus_set_sent_ext(cmd_ln_str("-sentext"));
+    if (cmd_ln_str("-ctlfn") == NULL) {
+	/* Phone counts need nothing but the transcripts */
+	if (strcmp(cmd_ln_str("-paramtype"), "phone") != 0
+	    || cmd_ln_str("-lsnfn") == NULL) {
+	    E_ERROR("-ctlfn is required unless counting phones from -lsnfn\n");
+	    return S3_ERROR;
+	}
+	E_INFO("Counting phones in %s without a control file\n",
+	       cmd_ln_str("-lsnfn"));
     }
+    else {
+	if (cmd_ln_str("-segdir")) {
+	    corpus_set_seg_dir(cmd_ln_str("-segdir"));
+	    corpus_set_seg_ext(cmd_ln_str("-segext"));
+	}
 
-    corpus_set_ctl_filename(cmd_ln_str("-ctlfn"));
+	if (cmd_ln_str("-lsnfn"))
+	    corpus_set_lsn_filename(cmd_ln_str("-lsnfn"));
+	else {
+	    corpus_set_sent_dir(cmd_ln_str("-sentdir"));
+	    corpus_set_sent_ext(cmd_ln_str("-sentext"));
+	}
 
-    if (cmd_ln_int32("-nskip") && cmd_ln_int32("-runlen")) {
-        corpus_set_interval(cmd_ln_int32("-nskip"),
-			    cmd_ln_int32("-runlen"));
-    } else if (cmd_ln_int32("-part") && cmd_ln_int32("-npart")) {
-	corpus_set_partition(cmd_ln_int32("-part"),
-			     cmd_ln_int32("-npart"));
-    }
+	corpus_set_ctl_filename(cmd_ln_str("-ctlfn"));
+
+	if (cmd_ln_int32("-nskip") && cmd_ln_int32("-runlen")) {
+	    corpus_set_interval(cmd_ln_int32("-nskip"),
+				cmd_ln_int32("-runlen"));
+	} else if (cmd_ln_int32("-part") && cmd_ln_int32("-npart")) {
+	    corpus_set_partition(cmd_ln_int32("-part"),
+				 cmd_ln_int32("-npart"));
+	}
     
-    if (corpus_init() != S3_SUCCESS) {
-	return S3_ERROR;
+	if (corpus_init() != S3_SUCCESS) {
+	    return S3_ERROR;
+	}
     }
     
     E_INFO("Reading: %s\n", cmd_ln_str("-moddeffn"));
@@ -56,6 +56,7 @@
 
 #include <s3/acmod_set.h>
 #include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmd_ln.h>
 
 #include <string.h>
 
@@ -92,7 +93,10 @@ param_cnt(FILE *out_fp,
 
     E_INFO("Scanning corpus\n");
 
-    enum_corpus(lex, mdef, cnt, cnt_fn);
+    /* Without a control file, phones are counted from -lsnfn alone */
+    enum_corpus(lex, mdef, cnt, n_cnt, cnt_fn,
+		cmd_ln_str("-ctlfn") ? NULL : cmd_ln_str("-lsnfn"),
+		cmd_ln_int32("-nthreads"));
 
     if (strcmp(param_type, "phone") != 0) {
 	for (i = 0; i < n_cnt; i++)
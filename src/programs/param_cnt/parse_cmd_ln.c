@@ -97,7 +97,7 @@ transcripts -dictfn dict -fdictfn fillerdict -paramtype phone";
 	{ "-ctlfn",
 	  ARG_STRING,
 	  NULL,
-	  "Control file of the training corpus"},
+	  "Control file of the training corpus.  May be omitted with -paramtype phone, in which case only -lsnfn is read"},
 
 	{ "-part",
 	  ARG_INT32,
@@ -134,6 +134,11 @@ transcripts -dictfn dict -fdictfn fillerdict -paramtype phone";
 	  NULL,
 	  "Dictionary for the filler words"},
 
+	{ "-dictcache",
+	  ARG_STRING,
+	  NULL,
+	  "Directory for binary caches of the dictionaries, which are built on first use"},
+
 	{ "-segdir",
 	  ARG_STRING,
 	  NULL,
@@ -154,6 +159,11 @@ transcripts -dictfn dict -fdictfn fillerdict -paramtype phone";
 	  NULL,
 	  "If specified, write counts to this file"},
 
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads counting utterances"},
+
 	{NULL, 0, NULL, NULL}
     };
 
@@ -90,6 +90,7 @@ ts_cnt(uint32 *cnt,		/* observation counts */
 	    E_WARN("Conversion from CI phones to triphones failed\n");
 	}
 	
+	ckd_free(ci_sseq);
 	return S3_SUCCESS;
     }
 
@@ -101,6 +102,9 @@ ts_cnt(uint32 *cnt,		/* observation counts */
 	if (ci_sseq[i] != sseq[i])
 	    cnt[sseq[i]]++;
     }
+
+    ckd_free(ci_sseq);
+    ckd_free(sseq);
     
     return S3_SUCCESS;
 }
@@ -48,6 +48,7 @@
 
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/err.h>
+#include <sphinxbase/pio.h>
 
 #include <s3/dtree.h>
 #include <s3/model_def_io.h>
@@ -56,6 +57,8 @@
 #include <s3/s3.h>
 #include <sys_compat/file.h>
 
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 static int
@@ -94,7 +97,7 @@ heap_ok(uint32 *hkey,
 
 	uint32 *phn,
 	uint32 *st,
-	uint32 *nd,
+	dtree_node_t **nd,
 	model_def_t *mdef)
 {
     uint32 i, k_i;
@@ -117,13 +120,11 @@ heap_ok(uint32 *hkey,
 	    if (phn[k_j] == NO_ID)
 		continue;
 
-	    if ((phn[k_i] == phn[k_j]) &&
-		(st[k_i] == st[k_j]) &&
-		(nd[k_i] == nd[k_j])) {
+	    if (nd[k_i] == nd[k_j]) {
 		E_ERROR("tree (%s %u) node %u on heap more than once\n",
 			acmod_set_id2name(mdef->acmod_set, phn[k_i]),
 			st[k_i],
-			nd[k_i]);
+			nd[k_i]->node_id);
 		ok = FALSE;
 	    }
 	}
@@ -139,42 +140,63 @@ heap_ok(uint32 *hkey,
 }
 
 static int
-read_phone_trees(model_def_t *mdef,
-		 const char *itreedir,
-		 const char *pname,
-		 uint32 p,
-		 uint32 n_state,
-		 pset_t *pset,
-		 uint32 n_pset,
-		 dtree_t ***out_tree,
-		 uint32 *out_n_seno,
-		 uint32 *out_n_twig,
-		 uint32 *out_n_node)
+read_trees(model_def_t *mdef,
+	   const char *itreedir,
+	   int allphones,
+	   pset_t *pset,
+	   uint32 n_pset,
+	   dtree_t ***tree,
+	   uint32 *n_state_ci,
+	   uint32 *out_n_ci,
+	   uint32 *out_n_seno,
+	   uint32 *out_n_twig)
 {
-    uint32 s;
+    char fn[MAXPATHLEN+1];
+    const char **tree_fn;
+    dtree_t **tree_buf, *tr;
+    uint32 n_ci, n_tree, p, s, n, lt_minocc;
+    int err;
 
-    out_tree[p] = (dtree_t **)ckd_calloc(n_state, sizeof(dtree_t *));
-    for (s = 0; s < n_state; s++) {
-	char fn[MAXPATHLEN+1];
-	dtree_t *tr;
-	FILE *fp;
+    n_ci = acmod_set_n_ci(mdef->acmod_set);
+    if (allphones) {
+	n_state_ci[0] = mdef->defn[n_ci].n_state-1;
+	n_ci = 1;
+    }
+    else {
+	for (p = 0; p < n_ci; p++) {
+	    if (!acmod_set_has_attrib(mdef->acmod_set, (acmod_id_t)p, "filler"))
+		n_state_ci[p] = mdef->defn[p].n_state-1;
+	}
+    }
+    *out_n_ci = n_ci;
 
-	sprintf(fn, "%s/%s-%u.dtree",
-		itreedir, pname, s);
+    /* Read every tree in parallel, then post-process them in order */
+    tree_fn = ckd_calloc(n_ci * mdef->max_n_state, sizeof(char *));
+    tree_buf = ckd_calloc(n_ci * mdef->max_n_state, sizeof(dtree_t *));
+    for (p = 0, n_tree = 0; p < n_ci; p++) {
+	const char *pname;
 
-	fp = fopen(fn, "r");
-	if (fp == NULL) {
-	    E_FATAL_SYSTEM("Unable to open %s for reading",fn);
+	pname = allphones ? "ALLPHONES" :
+	    acmod_set_id2name(mdef->acmod_set, (acmod_id_t)p);
+	for (s = 0; s < n_state_ci[p]; s++) {
+	    sprintf(fn, "%s/%s-%u.dtree", itreedir, pname, s);
+	    tree_fn[n_tree++] = ckd_salloc(fn);
 	}
+    }
 
-	out_tree[p][s] = tr = read_final_tree(fp, pset, n_pset);
+    err = (read_final_trees(tree_fn, n_tree, pset, n_pset, tree_buf,
+			    cmd_ln_int32("-nthreads")) != S3_SUCCESS);
 
-	if (tr == NULL) {
-	    E_ERROR("Error(s) while reading tree\n");
-	    return -1;
-	}
-	else {
-	    uint32 n, lt_minocc;
+    for (p = 0, n_tree = 0; !err && p < n_ci; p++) {
+	const char *pname;
+
+	if (n_state_ci[p] == 0)
+	    continue;
+	pname = allphones ? "ALLPHONES" :
+	    acmod_set_id2name(mdef->acmod_set, (acmod_id_t)p);
+	tree[p] = (dtree_t **)ckd_calloc(n_state_ci[p], sizeof(dtree_t *));
+	for (s = 0; s < n_state_ci[p]; s++) {
+	    tree[p][s] = tr = tree_buf[n_tree++];
 
 	    lt_minocc = prune_lowcnt(&tr->node[0], cmd_ln_float32("-minocc"));
 	    n = 0;
@@ -184,12 +206,128 @@ read_phone_trees(model_def_t *mdef,
 		   pname, s, n, lt_minocc,
 		   cmd_ln_float32("-minocc"));
 	    *out_n_twig += cnt_twig(&tr->node[0]);
-	    *out_n_node += cnt_node(&tr->node[0]);
 	}
+    }
+
+    for (p = 0; p < n_tree; p++)
+	ckd_free((char *)tree_fn[p]);
+    ckd_free(tree_fn);
+    ckd_free(tree_buf);
+
+    return err ? -1 : 0;
+}
+
+/*
+ * Like ins_twigs(), but keeps the nodes themselves on the heap so
+ * that trees can be reindexed and written between pruning targets.
+ */
+static void
+ins_twig_nodes(dtree_node_t *node,
+	       uint32 phnid,
+	       uint32 state,
+	       float32 *twig_heap,
+	       uint32 *twig_hkey,
+	       uint32 *phnidlst,
+	       uint32 *statelst,
+	       dtree_node_t **nodelst,
+	       uint32 *free_key)
+{
+    uint32 fk;
+
+    if (IS_LEAF(node))
+	return;
+
+    if (IS_LEAF(node->y) && IS_LEAF(node->n)) {
+	fk = *free_key;
+
+	phnidlst[fk] = phnid;
+	statelst[fk] = state;
+	nodelst[fk] = node;
 
-	fclose(fp);
+	heap32b_ins(twig_heap, twig_hkey, fk,
+		    node->wt_ent_dec, fk,
+		    heap32b_min_comp);
+
+	(*free_key)++;
     }
-    return 0;
+    else {
+	ins_twig_nodes(node->y, phnid, state, twig_heap, twig_hkey,
+		       phnidlst, statelst, nodelst, free_key);
+	ins_twig_nodes(node->n, phnid, state, twig_heap, twig_hkey,
+		       phnidlst, statelst, nodelst, free_key);
+    }
+}
+
+/* Substitute the senone count for "%d" in an output path */
+static void
+seno_path(char *out, const char *pattern, uint32 n_seno)
+{
+    const char *d;
+
+    d = strstr(pattern, "%d");
+    if (d == NULL)
+	strcpy(out, pattern);
+    else
+	sprintf(out, "%.*s%u%s", (int)(d - pattern), pattern, n_seno, d + 2);
+}
+
+static int
+write_trees(model_def_t *mdef,
+	    dtree_t ***tree,
+	    uint32 n_ci,
+	    uint32 *n_state_ci,
+	    int allphones,
+	    pset_t *pset,
+	    const char *otreedir)
+{
+    char fn[MAXPATHLEN+1];
+    FILE *fp;
+    dtree_t *tr;
+    uint32 p, s, n, free_idx;
+    int binary;
+
+    binary = cmd_ln_int32("-binary");
+    for (p = 0; p < n_ci; p++) {
+	const char *pname;
+
+	if (allphones)
+	    pname = "ALLPHONES";
+	else
+	    pname = acmod_set_id2name(mdef->acmod_set, (acmod_id_t)p);
+
+	for (s = 0; s < n_state_ci[p]; s++) {
+	    tr = tree[p][s];
+
+	    free_idx = 0;
+	    n = reindex(&tr->node[0], &free_idx);
+
+	    E_INFO("%s-%u\t%u\n", pname, s, n);
+
+	    sprintf(fn, "%s/%s-%u.dtree", otreedir, pname, s);
+
+	    if (binary) {
+		if (write_final_tree_bin(fn, &tr->node[0], pset) != S3_SUCCESS)
+		    return S3_ERROR;
+		continue;
+	    }
+	    fp = fopen(fn, "w");
+	    if (fp == NULL) {
+		E_FATAL_SYSTEM("Unable to open %s for writing", fn);
+	    }
+	    print_final_tree(fp, &tr->node[0], pset);
+	    fclose(fp);
+	}
+    }
+
+    return S3_SUCCESS;
+}
+
+static int
+cmp_seno_desc(const void *a, const void *b)
+{
+    uint32 x = *(const uint32 *)a, y = *(const uint32 *)b;
+
+    return (x < y) - (x > y);
 }
 
 static int
@@ -197,120 +335,108 @@ prune_tree(model_def_t *mdef,
 	   pset_t *pset,
 	   uint32 n_pset)
 {
-    const char *itreedir;
     const char *otreedir;
+    const char *omoddeffn;
+    char dir[MAXPATHLEN+1];
     char fn[MAXPATHLEN+1];
-    FILE *fp;
+    const char *nseno;
+    char *ep;
 
     dtree_t ***tree;	/* Decision trees indexed by phone and state */
-    dtree_t *tr;
     dtree_node_t *node, *prnt;
-    float32 *twig_heap;	/* Heap of wt_ent_dec of split quest */
-    uint32 *twig_hkey;	/* Key's for items in the heap */
-    uint32 *twig_phnid;	/* Phone id of items on heap */
-    uint32 *twig_state;	/* State id of items on heap */
-    uint32 *twig_nid;	/* Node id of items on heap */
+    float32 *twig_heap = NULL;	/* Heap of wt_ent_dec of split quest */
+    uint32 *twig_hkey = NULL;	/* Key's for items in the heap */
+    uint32 *twig_phnid = NULL;	/* Phone id of items on heap */
+    uint32 *twig_state = NULL;	/* State id of items on heap */
+    dtree_node_t **twig_node = NULL; /* Nodes on heap */
     uint32 free_key;	/* Next unused heap key */
-    uint32 free_idx;	/* Next unused node index */
-    uint32 n_ci, p, s, n;
+    uint32 n_ci, p, s;
     uint32 *n_state_ci;	/* # of state of models in the same base phone class */
     uint32 n_seno;
-    uint32 n_seno_wanted;
+    uint32 *n_seno_wanted;
+    uint32 n_target, t;
     uint32 n_twig;
-    uint32 n_node;
     float32 wt_ent_dec;
     uint32 key;
     uint32 sz;
     uint32 i;
     int allphones;
-    int err;
 
-    itreedir = cmd_ln_str("-itreedir");
     allphones = cmd_ln_int32("-allphones");
-    n_ci = acmod_set_n_ci(mdef->acmod_set);
+    otreedir = cmd_ln_str("-otreedir");
+    omoddeffn = cmd_ln_str("-omoddeffn");
+
+    /* Senone counts to produce, largest first, since each is
+     * pruned from the trees left by the previous one */
+    nseno = cmd_ln_str("-nseno");
+    if (nseno == NULL)
+	E_FATAL("Specify -nseno\n");
+    n_seno_wanted = ckd_calloc(strlen(nseno) + 1, sizeof(uint32));
+    for (n_target = 0; *nseno; n_target++) {
+	n_seno_wanted[n_target] = (uint32)strtoul(nseno, &ep, 10);
+	if (ep == nseno || (*ep != '\0' && *ep != ','))
+	    E_FATAL("Bad -nseno list %s\n", cmd_ln_str("-nseno"));
+	nseno = (*ep == ',') ? ep + 1 : ep;
+    }
+    qsort(n_seno_wanted, n_target, sizeof(uint32), cmp_seno_desc);
+    if (n_target > 1 && strstr(otreedir, "%d") == NULL)
+	E_FATAL("-otreedir must contain %%d when -nseno lists several counts\n");
+    if (n_target > 1 && omoddeffn && strstr(omoddeffn, "%d") == NULL)
+	E_FATAL("-omoddeffn must contain %%d when -nseno lists several counts\n");
 
+    n_ci = acmod_set_n_ci(mdef->acmod_set);
     tree = (dtree_t ***)ckd_calloc(n_ci, sizeof(dtree_t **));
     n_state_ci = (uint32 *)ckd_calloc(n_ci, sizeof(uint32));
 
-    err = FALSE;
-    if (allphones) {
-	uint32 n_state;
-
-	n_state = mdef->defn[n_ci].n_state-1;
-	n_state_ci[0] = n_state;
-	n_ci = 1;
-	n_seno = 0;
-	n_twig = 0;
-	if (read_phone_trees(mdef, itreedir, "ALLPHONES", 0, n_state,
-			     pset, n_pset, tree, &n_seno, &n_twig, &n_node) < 0)
-	    err = TRUE;
-    }
-    else {
-	for (p = 0, err = FALSE, n_seno = 0, n_twig = 0; p < n_ci; p++) {
-	    if (!acmod_set_has_attrib(mdef->acmod_set, (acmod_id_t)p, "filler")) {
-		const char *pname;
-		uint32 n_state;
-
-		pname = acmod_set_id2name(mdef->acmod_set, (acmod_id_t)p);
-		n_state = mdef->defn[p].n_state-1;
-		n_state_ci[p] = n_state;
-		if (read_phone_trees(mdef, itreedir, pname, p, n_state,
-				     pset, n_pset, tree,
-				     &n_seno, &n_twig, &n_node) < 0)
-		    err = TRUE;
-	    }
-	}
-    }
-
-    if (err) {
+    n_seno = 0;
+    n_twig = 0;
+    if (read_trees(mdef, cmd_ln_str("-itreedir"), allphones, pset, n_pset,
+		   tree, n_state_ci, &n_ci, &n_seno, &n_twig) < 0) {
 	E_ERROR("Error(s) while reading trees; pruning not done\n");
 	return S3_ERROR;
     }
 
     E_INFO("Prior to pruning n_seno= %u\n", n_seno);
 
-    n_seno_wanted = cmd_ln_int32("-nseno");
-    if (n_seno < n_seno_wanted) {
-	E_WARN("n_seno_wanted= %u, but only %u defined by trees\n",
-	       n_seno_wanted, n_seno);
-    }
-
     E_INFO("n_twig= %u\n", n_twig);
-    
-    if (n_seno_wanted < n_seno) {
+
+    if (n_seno_wanted[n_target-1] < n_seno) {
 	/* Heap of wt_ent_dec for each "twig" question */
 	twig_heap  = (float32 *)ckd_calloc(n_twig, sizeof(float32));
 	twig_hkey  = (uint32 *)ckd_calloc(n_twig, sizeof(uint32));
 
 	twig_phnid = (uint32 *)ckd_calloc(n_twig, sizeof(uint32));
 	twig_state = (uint32 *)ckd_calloc(n_twig, sizeof(uint32));
-	twig_nid   = (uint32 *)ckd_calloc(n_twig, sizeof(uint32));
+	twig_node  = (dtree_node_t **)ckd_calloc(n_twig, sizeof(dtree_node_t *));
     
 	/* Insert all twig questions over all trees into the heap */
 	for (p = 0, free_key = 0; p < n_ci; p++) {
 	    for (s = 0; s < n_state_ci[p]; s++) {
-		if (allphones
-		    || !acmod_set_has_attrib(mdef->acmod_set, (acmod_id_t)p, "filler")) {
-		    tr = tree[p][s];
-
-		    ins_twigs(&tr->node[0],
-			      p, s,
-			      twig_heap,
-			      twig_hkey,
-			      twig_phnid,
-			      twig_state,
-			      twig_nid,
-			      &free_key);
-		}
+		ins_twig_nodes(&tree[p][s]->node[0],
+			       p, s,
+			       twig_heap,
+			       twig_hkey,
+			       twig_phnid,
+			       twig_state,
+			       twig_node,
+			       &free_key);
 	    }
 	}
+    }
 
-	E_INFO("Pruning %u nodes\n", n_seno - n_seno_wanted);
+    for (t = 0, i = n_seno, sz = n_twig; t < n_target; t++) {
+	if (n_seno < n_seno_wanted[t]) {
+	    E_WARN("n_seno_wanted= %u, but only %u defined by trees\n",
+		   n_seno_wanted[t], n_seno);
+	}
+	else if (i > n_seno_wanted[t]) {
+	    E_INFO("Pruning %u nodes\n", i - n_seno_wanted[t]);
+	}
 
-	for (i = n_seno, sz = n_twig; (i > n_seno_wanted) && (sz > 0); i--) {
+	for (; (i > n_seno_wanted[t]) && (sz > 0); i--) {
 #if 0
 	    if (!heap_ok(twig_hkey, sz,
-			 twig_phnid, twig_state, twig_nid,
+			 twig_phnid, twig_state, twig_node,
 			 mdef)) {
 		E_FATAL("heap problems; bug.\n");
 	    }
@@ -324,9 +450,7 @@ prune_tree(model_def_t *mdef,
 	    /* Get the node to prune */
 	    p = twig_phnid[key];
 	    s = twig_state[key];
-	    n = twig_nid[key];
-	    tr = tree[p][s];
-	    node = get_node(&tr->node[0], n);
+	    node = twig_node[key];
 
 	    assert(IS_TWIG(node));
 
@@ -345,7 +469,7 @@ prune_tree(model_def_t *mdef,
 	    if (prnt && IS_TWIG(prnt)) {
 		/* Put it on the heap and reuse the heap-key for the child */
 
-		twig_nid[key] = prnt->node_id;
+		twig_node[key] = prnt;
 		
 		sz = heap32b_ins(twig_heap, twig_hkey, sz,
 				 prnt->wt_ent_dec, key, heap32b_min_comp);
@@ -357,51 +481,48 @@ prune_tree(model_def_t *mdef,
 		 * cause a seg fault if used as an index */
 		twig_phnid[key] = NO_ID;
 		twig_state[key] = NO_ID;
-		twig_nid[key] = NO_ID;
+		twig_node[key] = NULL;
 	    }
 	}
 
-	if ((sz == 0) && (i > n_seno_wanted)) {
-	    E_WARN("%u seno's not generated because heap ran out\n", n_seno_wanted);
+	if ((sz == 0) && (i > n_seno_wanted[t])) {
+	    E_WARN("%u seno's not generated because heap ran out\n", n_seno_wanted[t]);
 	}
-    }
-
-    otreedir = cmd_ln_str("-otreedir");
-    for (p = 0, n_node = 0; p < n_ci; p++) {
-	const char *pname;
-
-	if (allphones)
-	    pname = "ALLPHONES";
-	else
-	    pname = acmod_set_id2name(mdef->acmod_set, (acmod_id_t)p);
-
-	for (s = 0; s < n_state_ci[p]; s++) {
-	    if (allphones
-		|| !acmod_set_has_attrib(mdef->acmod_set, (acmod_id_t)p, "filler")) {
-		tr = tree[p][s];
-
-		free_idx = 0;
-		n_node += n = reindex(&tr->node[0], &free_idx);
 
-		E_INFO("%s-%u\t%u\n", pname, s, n);
-
-		sprintf(fn, "%s/%s-%u.dtree", otreedir, pname, s);
-		
-		fp = fopen(fn, "w");
-		if (fp == NULL) {
-		    E_FATAL_SYSTEM("Unable to open %s for writing", fn);
-		}
-		print_final_tree(fp, &tr->node[0], pset);
-		fclose(fp);
-
-	    }
+	seno_path(dir, otreedir, n_seno_wanted[t]);
+	if (n_target > 1) {
+	    E_INFO("Writing %u senone trees to %s\n", i, dir);
+	    build_directory(dir);
+	}
+	if (write_trees(mdef, tree, n_ci, n_state_ci, allphones,
+			pset, dir) != S3_SUCCESS)
+	    return S3_ERROR;
+
+	if (omoddeffn) {
+	    model_def_t *omdef;
+
+	    seno_path(fn, omoddeffn, n_seno_wanted[t]);
+	    omdef = tie_states(mdef, tree, pset, allphones);
+	    if (model_def_write(omdef, fn) != S3_SUCCESS)
+		return S3_ERROR;
+	    /* The acoustic model set belongs to mdef */
+	    for (p = 0; p < mdef->n_defn; p++)
+		ckd_free(omdef->defn[p].state);
+	    ckd_free(omdef->defn);
+	    ckd_free(omdef);
 	}
     }
 
+    ckd_free(twig_heap);
+    ckd_free(twig_hkey);
+    ckd_free(twig_phnid);
+    ckd_free(twig_state);
+    ckd_free(twig_node);
+    ckd_free(n_seno_wanted);
 
     return S3_SUCCESS;
 }
-
+
 int
 main(int argc, char *argv[])
 {
@@ -415,7 +536,8 @@ main(int argc, char *argv[])
 	E_FATAL("Initialization failed\n");
     }
 
-    prune_tree(mdef, pset, n_pset);
+    if (prune_tree(mdef, pset, n_pset) != S3_SUCCESS)
+	return 1;
     
     return 0;
 }
@@ -73,7 +73,15 @@ prunetree \n\
   -otreedir output_tree_dir \n\
   -moddefn mdef \n\
   -psetfn questions \n\
-  -minocc 100 ";
+  -minocc 100 \n\
+\n\
+prunetree \n\
+  -itreedir input_tree_dir \n\
+  -nseno 1000,2000,4000 \n\
+  -otreedir output_tree_dir.%d \n\
+  -omoddeffn tied.%d.mdef \n\
+  -moddeffn mdef \n\
+  -psetfn questions ";
 
   static arg_t defn[] = {
 	{ "-help",
@@ -89,7 +97,7 @@ prunetree \n\
 	{ "-moddeffn",
 	  ARG_STRING,
 	  NULL,
-	  "CI model definition file" },
+	  "Untied-state model definition file" },
 
 	{ "-psetfn",
 	  ARG_STRING,
@@ -103,12 +111,22 @@ prunetree \n\
 	{ "-otreedir",
 	  ARG_STRING,
 	  NULL,
-	  "Output tree directory" },
+	  "Output tree directory; %d is replaced by the # of senones" },
+
+	{ "-omoddeffn",
+	  ARG_STRING,
+	  NULL,
+	  "If given, also write the tied-state model definition here; %d is replaced by the # of senones" },
 
 	{ "-nseno",
-	  ARG_INT32,
+	  ARG_STRING,
 	  NULL,
-	  "# of senones defined by the output trees"},
+	  "# of senones defined by the output trees, or a comma-separated list of them, each written to its own -otreedir"},
+
+	{ "-binary",
+	  ARG_BOOLEAN,
+	  "no",
+	  "Write the output trees in binary format"},
 
 	{ "-minocc",
 	  ARG_FLOAT32,
@@ -119,6 +137,11 @@ prunetree \n\
 	  ARG_BOOLEAN,
 	  "no",
 	  "Prune a single tree for each state of all phones"},
+
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads reading trees"},
 	  
 	{NULL, 0, NULL, NULL}
     };
@@ -194,7 +194,8 @@ approx_mgau_eval(gs_t * gs,       /**< In: The Gaussian Selector. If Null, Gauss
                  float32 * feat,       /**< In: feature vector */
                  int32 best_cid,        /**< In: The best codebok index used in Gaussian Selector*/
                  int32 svq_beam,        /**< In: Beam for Sub-vector quantizor */
-                 int32 fr        /**< In: the frame number in question */
+                 int32 fr,       /**< In: the frame number in question */
+                 mgau_blk_t * blk       /**< In/Out: If not NULL, frame-blocked score cache */
     )
 {
     int32 ng = 0;
@@ -251,6 +252,8 @@ approx_mgau_eval(gs_t * gs,       /**< In: The Gaussian Selector. If Null, Gauss
 
     if (svq && fastgmm->svq4svq)
         senscr[s] = subvq_mgau_eval(g, svq, s, mgau_n_comp(g, s), mgau_sl);
+    else if (blk && !mgau_sl)
+        senscr[s] = mgau_blk_eval(g, blk, s, fr);
     else
         senscr[s] = mgau_eval(g, s, mgau_sl, feat, fr, 1);
 
@@ -283,12 +286,20 @@ approx_mgau_eval(gs_t * gs,       /**< In: The Gaussian Selector. If Null, Gauss
     return ng;
 }
 
-int32 *ci;
-
-static int
-intcmp(const void *v1, const void *v2)
+/** Sort idx[0..n-1] by decreasing scr[idx[]].  The order of equal scores
+    does not matter to the caller.  qsort() would need scr in a global,
+    which is not thread-safe. */
+static void
+sort_idx_by_score(int32 * idx, int32 n, int32 * scr)
 {
-    return (ci[*(int32 *) v2] - ci[*(int32 *) v1]);
+    int32 i, j, k;
+
+    for (i = 1; i < n; i++) {
+        k = idx[i];
+        for (j = i; j > 0 && scr[idx[j - 1]] < scr[k]; j--)
+            idx[j] = idx[j - 1];
+        idx[j] = k;
+    }
 }
 
 
@@ -315,8 +326,6 @@ approx_compute_dyn_ci_pbeam(mdef_t * mdef,      /**< In: model definition */
     int32 total;
     int32 is_ciphone;
 
-    ci = cache_ci_senscr;
-
     idx = fastgmm->gmms->idx;
 
     for (s = 0; s < g->n_mgau; s++) {
@@ -336,8 +345,7 @@ approx_compute_dyn_ci_pbeam(mdef_t * mdef,      /**< In: model definition */
        for sorting. How about Chinese then? Hmm. We'll think about that
        later...... */
 
-    /* FIXME : sorting is too slow */
-    qsort(idx, mdef->n_ci_sen, sizeof(int32), intcmp);
+    sort_idx_by_score(idx, mdef->n_ci_sen, cache_ci_senscr);
 
     total = 0;
     pbest = cache_ci_senscr[idx[0]];
@@ -373,7 +381,8 @@ approx_cont_mgau_ci_eval(subvq_t * svq,
                          int32 * ci_senscr,      /** Input/Output : ci senone score, a one dimension array */
                          int32 * best_score,      /** Input/Output: the best score, a scalar */
                          int32 fr,       /** In : The frame number */
-                         logmath_t * logmath
+                         logmath_t * logmath,
+                         mgau_blk_t * blk      /** In/Out: If not NULL, frame-blocked score cache */
     )
 {
     int32 s;
@@ -402,7 +411,7 @@ approx_cont_mgau_ci_eval(subvq_t * svq,
     for (s = 0; mdef_is_cisenone(mdef, s); s++) {
         n_cig +=
             approx_mgau_eval(gs, svq, g, fg, s, ci_senscr, feat, best_cid,
-                             svq_beam, fr);
+                             svq_beam, fr, blk);
         n_cis++;
     }
 #else
@@ -441,7 +450,8 @@ approx_cont_mgau_frame_eval(mdef_t * mdef,
                             int32 frame,
                             int32 * cache_ci_senscr,
                             ptmr_t * tm_ovrhd,
-                            logmath_t * logmath)
+                            logmath_t * logmath,
+                            mgau_blk_t * blk)
 {
     int32 s;
     int32 best, ns, ng, n_cis, n_cig;
@@ -540,7 +550,8 @@ approx_cont_mgau_frame_eval(mdef_t * mdef,
                 if ((senscr[cd2cisen[s]] >= pbest + dyn_ci_pbeam)) {
                     ng +=
                         approx_mgau_eval(gs, svq, g, fastgmm, s, senscr,
-                                         feat, best_cid, svq_beam, frame);
+                                         feat, best_cid, svq_beam, frame,
+                                         blk);
                     ns++;
                 }
                 else {
@@ -232,7 +232,10 @@ int32 approx_cont_mgau_frame_eval (mdef_t *mdef,
 				   int32 frame,         /**< Input: The frame number */
 				   int32 *cache_ci_senscr, /**< Input: The cache CI scores for this frame */
 				   ptmr_t *tm_ovrhd,        /**< Output: the timer used for computing overhead */
-				   logmath_t *logmath
+				   logmath_t *logmath,
+				   mgau_blk_t *blk      /**< In/Out: If not NULL, take full
+							   evaluations of g from this
+							   frame-blocked cache */
     );
 
 
@@ -256,7 +259,8 @@ void approx_cont_mgau_ci_eval (
     int32 *ci_senscr, /** Input/Output : ci senone score, a one dimension array */
     int32 *best_score, /** Input/Output: the best score, a scalar */
     int32 fr, /** In : The frame number */
-    logmath_t *logmath
+    logmath_t *logmath,
+    mgau_blk_t *blk /** In/Out: If not NULL, frame-blocked score cache for g */
     );
 
 #if 0
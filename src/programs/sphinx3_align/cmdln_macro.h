@@ -355,6 +355,10 @@ us a better architecture.
       ARG_INT32, \
       "3", \
       "Number of subvectors to use for SubVQ-based frame evaluation (3 for all)"}, \
+    { "-svqpack", \
+      ARG_BOOLEAN, \
+      "no", \
+      "Compute SubVQ codeword distances in float32 over packed codebooks, and build shortlists without branching (faster, but scores and shortlists may differ slightly from the default double-precision ones)"}, \
     { "-kdtree",\
       ARG_STRING,\
       NULL,\
@@ -1258,3 +1258,192 @@ mgau_free(mgau_model_t * g)
         ckd_free((void *) g);
     }
 }
+
+mgau_model_t *
+mgau_clone(mgau_model_t * g)
+{
+    mgau_model_t *c;
+
+    c = (mgau_model_t *) ckd_malloc(sizeof(*c));
+    *c = *g;
+    c->mgau = (mgau_t *) ckd_malloc(g->n_mgau * sizeof(mgau_t));
+    memcpy(c->mgau, g->mgau, g->n_mgau * sizeof(mgau_t));
+    mgau_reset_bstidx(c);
+
+    return c;
+}
+
+void
+mgau_clone_free(mgau_model_t * g)
+{
+    if (g) {
+        ckd_free(g->mgau);
+        ckd_free(g);
+    }
+}
+
+void
+mgau_reset_bstidx(mgau_model_t * g)
+{
+    int32 i;
+
+    for (i = 0; i < g->n_mgau; i++) {
+        g->mgau[i].bstidx = NO_BSTIDX;
+        g->mgau[i].bstscr = S3_LOGPROB_ZERO;
+        g->mgau[i].updatetime = NOT_UPDATED;
+    }
+}
+
+mgau_blk_t *
+mgau_blk_init(mgau_model_t * g, int32 n_frm)
+{
+    mgau_blk_t *b;
+
+    assert(n_frm > 0);
+
+    b = (mgau_blk_t *) ckd_calloc(1, sizeof(*b));
+    b->n_mgau = mgau_n_mgau(g);
+    b->n_frm = n_frm;
+    b->cur_blk = -1;
+    b->xt = (float32 *) ckd_calloc(mgau_veclen(g) * n_frm, sizeof(float32));
+    b->dval = (float64 *) ckd_calloc(n_frm, sizeof(float64));
+    b->first = (int32 *) ckd_calloc(mgau_n_mgau(g), sizeof(int32));
+    b->scr = (int32 **) ckd_calloc_2d(mgau_n_mgau(g), n_frm, sizeof(int32));
+    b->bstidx = (int32 **) ckd_calloc_2d(mgau_n_mgau(g), n_frm, sizeof(int32));
+    b->bstscr = (int32 **) ckd_calloc_2d(mgau_n_mgau(g), n_frm, sizeof(int32));
+    memset(b->first, -1, mgau_n_mgau(g) * sizeof(int32));
+
+    return b;
+}
+
+void
+mgau_blk_set_utt(mgau_blk_t * b, float32 *** feat, int32 n_utt_frm)
+{
+    b->feat = feat;
+    b->n_utt_frm = n_utt_frm;
+    b->cur_blk = -1;
+    memset(b->first, -1, b->n_mgau * sizeof(int32));
+}
+
+/**
+ * Evaluate mixture m at frames t0..t1-1 of the block in b->xt.  Same
+ * arithmetic, in the same order, as mgau_eval_all() for each frame.
+ */
+static void
+mgau_eval_blk(mgau_model_t * g, mgau_blk_t * b, int32 m, int32 t0, int32 t1)
+{
+    mgau_t *mgau;
+    float32 *mean, *var, *x;
+    float32 mi;
+    float64 *dval, diff, vi, f;
+    int32 *scr, *bstidx, *bstscr;
+    int32 veclen, n_frm, gauscr, i, c, t;
+
+    mgau = &(g->mgau[m]);
+    veclen = mgau_veclen(g);
+    n_frm = b->n_frm;
+    dval = b->dval;
+    scr = b->scr[m];
+    bstidx = b->bstidx[m];
+    bstscr = b->bstscr[m];
+    f = 1.0 / log(logmath_get_base(g->logmath));
+
+    for (t = t0; t < t1; t++) {
+        scr[t] = S3_LOGPROB_ZERO;
+        bstidx[t] = NO_BSTIDX;
+        bstscr[t] = S3_LOGPROB_ZERO;
+    }
+
+    for (c = 0; c < mgau->n_comp; c++) {
+        mean = mgau->mean[c];
+        var = mgau->var[c];
+
+        for (t = t0; t < t1; t++)
+            dval[t] = mgau->lrd[c];
+        for (i = 0; i < veclen; i++) {
+            x = b->xt + i * n_frm;
+            mi = mean[i];
+            vi = var[i];
+            for (t = t0; t < t1; t++) {
+                diff = x[t] - mi;
+                dval[t] -= diff * diff * vi;
+            }
+        }
+
+        /* Convert the whole block to logs3 and mix it in */
+        for (t = t0; t < t1; t++) {
+            if (dval[t] < g->distfloor)
+                dval[t] = g->distfloor;
+            gauscr = (int32) (f * dval[t]) + mgau->mixw[c];
+            scr[t] = logmath_add(g->logmath, scr[t], gauscr);
+            if (gauscr > bstscr[t]) {
+                bstidx[t] = c;
+                bstscr[t] = gauscr;
+            }
+        }
+    }
+
+    for (t = t0; t < t1; t++) {
+        if (scr[t] <= S3_LOGPROB_ZERO)
+            scr[t] = S3_LOGPROB_ZERO;
+    }
+}
+
+int32
+mgau_blk_eval(mgau_model_t * g, mgau_blk_t * b, int32 m, int32 fr)
+{
+    mgau_t *mgau;
+    float32 *x;
+    int32 blk, sf, t, t1, i, j;
+
+    mgau = &(g->mgau[m]);
+    assert(g->comp_type == MIX_INT_FLOAT_COMP);
+    assert(fr < b->n_utt_frm);
+
+    /* Full covariances are not blocked */
+    if (mgau->fullvar)
+        return mgau_eval(g, m, NULL, b->feat[fr][0], fr, 1);
+
+    blk = fr / b->n_frm;
+    sf = blk * b->n_frm;
+    t = fr - sf;
+    if ((b->first[m] < sf) || (b->first[m] > fr)) {     /* Not cached */
+        t1 = b->n_frm;
+        if (sf + t1 > b->n_utt_frm)
+            t1 = b->n_utt_frm - sf;
+
+        if (b->cur_blk != blk) {
+            for (i = 0; i < t1; i++) {
+                x = b->feat[sf + i][0];
+                for (j = 0; j < mgau_veclen(g); j++)
+                    b->xt[j * b->n_frm + i] = x[j];
+            }
+            b->cur_blk = blk;
+        }
+
+        mgau_eval_blk(g, b, m, t, t1);
+        b->first[m] = fr;
+    }
+
+    /* Leave the same best-index state behind as mgau_eval() would */
+    mgau->bstidx = b->bstidx[m][t];
+    mgau->bstscr = b->bstscr[m][t];
+    mgau->updatetime = fr;
+
+    return b->scr[m][t];
+}
+
+void
+mgau_blk_free(mgau_blk_t * b)
+{
+    if (b == NULL)
+        return;
+
+    ckd_free(b->xt);
+    ckd_free(b->dval);
+    ckd_free(b->first);
+    ckd_free_2d((void **) b->scr);
+    ckd_free_2d((void **) b->bstidx);
+    ckd_free_2d((void **) b->bstscr);
+    ckd_free(b);
+}
@@ -354,6 +354,76 @@ S3DECODER_EXPORT
 void mgau_free (mgau_model_t *g /**< In: A set of model to free */
     );
 
+/**
+ * Make a copy of g that shares its parameters but keeps its own
+ * best-index state (bstidx, bstscr, updatetime), so that it can be
+ * evaluated in another thread.  Free it with mgau_clone_free(), which
+ * leaves the shared parameters alone.
+ */
+mgau_model_t *mgau_clone(mgau_model_t *g /**< In: The model to copy */
+    );
+
+/** Free a copy made by mgau_clone() */
+void mgau_clone_free(mgau_model_t *g /**< In: A copy made by mgau_clone() */
+    );
+
+/**
+ * Forget the best Gaussian of every mixture, so that scores do not
+ * depend on what was evaluated before (e.g. the previous utterance).
+ */
+void mgau_reset_bstidx(mgau_model_t *g /**< In/Out: A set of mixture Gaussians */
+    );
+
+/**
+ * \struct mgau_blk_t
+ * \brief Mixture Gaussian scores for blocks of consecutive frames.
+ *
+ * The first time a mixture is needed in a block of n_frm frames, it is
+ * evaluated for the rest of that block in one pass, with the features
+ * transposed so that the innermost loop runs over frames.  This only pays
+ * off when all the features of an utterance are known in advance, as in
+ * forced alignment.  The scores are the same as mgau_eval()'s.
+ */
+typedef struct {
+    int32 n_mgau;       /**< Number of mixtures */
+    int32 n_frm;        /**< Frames per block */
+    float32 ***feat;    /**< Feature vectors of the current utterance */
+    int32 n_utt_frm;    /**< Number of frames in feat */
+    int32 cur_blk;      /**< Block held in xt, -1 if none */
+    float32 *xt;        /**< Features of cur_blk (stream 0), transposed: veclen x n_frm */
+    float64 *dval;      /**< Scratch: component log densities, n_frm */
+    int32 *first;       /**< Per mixture: first frame in scr, -1 if none */
+    int32 **scr;        /**< Per mixture and frame in block: the mgau_eval() score */
+    int32 **bstidx;     /**< Best component in each frame */
+    int32 **bstscr;     /**< ... and its score */
+} mgau_blk_t;
+
+/** Allocate block scoring state for g with blocks of n_frm frames */
+mgau_blk_t *mgau_blk_init(mgau_model_t *g, /**< In: The model to be evaluated */
+                          int32 n_frm      /**< In: Frames per block */
+    );
+
+/** Start an utterance; forgets all cached scores */
+void mgau_blk_set_utt(mgau_blk_t *b,     /**< In/Out: Block scoring state */
+                      float32 ***feat,   /**< In: Features for the whole utterance */
+                      int32 n_utt_frm    /**< In: Number of frames in feat */
+    );
+
+/**
+ * Same as mgau_eval(g, m, NULL, feat[fr][0], fr, 1), but taken from (and
+ * if necessary added to) the block cache.  Frames must be visited in
+ * non-decreasing order within an utterance.
+ * @return the senone score.
+ */
+int32 mgau_blk_eval(mgau_model_t *g, /**< In/Out: The mixture Gaussian model */
+                    mgau_blk_t *b,   /**< In/Out: Block scoring state */
+                    int32 m,         /**< In: The chosen mixture */
+                    int32 fr         /**< In: Frame number */
+    );
+
+/** Free block scoring state */
+void mgau_blk_free(mgau_blk_t *b);
+
 
 /** 
  * Reloading the means. This is particularly useful for speaker adaptation. 
@@ -0,0 +1,464 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*
+ * feat_cache.c -- Memory-mapped caches of computed features
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/fe.h>
+
+#include "cmdln_macro.h"
+#include "feat_cache.h"
+
+/*
+ * Feature caches are in native 32-bit words:
+ *
+ *	FEAT_CACHE_MAGIC (8 bytes)
+ *	byte order, version, key (2 words), veclen, n_utt,
+ *	index offset (2 words), n_str_word
+ *	frame data: veclen float32 per frame, utterance after utterance
+ *	index: per utterance, name offset, #frames, data offset (2 words)
+ *	strings: NUL terminated utterance names, padded to n_str_word words
+ *
+ * Offsets are in words from the start of the file, except name offsets,
+ * which are in bytes from the start of the strings.  Utterances are named
+ * by their control file entry, "uttfile sf ef".
+ */
+#define FEAT_CACHE_MAGIC	"s3featc\n"
+#define FEAT_CACHE_VERSION	1
+#define FEAT_CACHE_BYTE_ORDER	0x11223344
+#define FEAT_CACHE_HDR_WORDS	9
+#define FEAT_CACHE_ENTRY_WORDS	4
+#define FEAT_CACHE_DATA_START	(2 + FEAT_CACHE_HDR_WORDS)
+
+static uint64_t
+fc_hash(uint64_t h, const void *buf, size_t len)
+{
+    const unsigned char *s = (const unsigned char *) buf;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= s[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+static uint64_t
+fc_hash_str(uint64_t h, const char *s)
+{
+    return fc_hash(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+/* Every option that can change the feature stream: the front end, the
+ * feature computation and where the input comes from. */
+static const arg_t feat_cache_args[] = {
+    waveform_to_cepstral_command_line_macro(),
+    cepstral_to_feature_command_line_macro(),
+    cepstral_input_handling_command_line_macro(),
+    {NULL, 0, NULL, NULL}
+};
+
+/*
+ * Hash of everything that decides what the features of an utterance
+ * look like, including the contents of the LDA/MLLT transform.
+ */
+static uint64_t
+feat_cache_key(feat_t *fcb, cmd_ln_t *config)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const arg_t *a;
+    const char *lda;
+    const char **list;
+    mmio_file_t *mf;
+    struct stat st;
+    int32 i, v[1];
+    long iv;
+    double fv;
+
+    for (a = feat_cache_args; a->name; a++) {
+        if (strcmp(a->name, "-verbose") == 0
+            || !cmd_ln_exists_r(config, a->name))
+            continue;
+        h = fc_hash_str(h, a->name);
+        switch (a->type & ~ARG_REQUIRED) {
+        case ARG_INTEGER:
+        case ARG_BOOLEAN:
+            iv = cmd_ln_int_r(config, a->name);
+            h = fc_hash(h, &iv, sizeof(iv));
+            break;
+        case ARG_FLOATING:
+            fv = cmd_ln_float_r(config, a->name);
+            h = fc_hash(h, &fv, sizeof(fv));
+            break;
+        case ARG_STRING:
+            h = fc_hash_str(h, cmd_ln_str_r(config, a->name));
+            break;
+        case ARG_STRING_LIST:
+            list = cmd_ln_str_list_r(config, a->name);
+            for (; list && *list; list++)
+                h = fc_hash_str(h, *list);
+            h = fc_hash_str(h, NULL);
+            break;
+        }
+    }
+
+    v[0] = feat_dimension1(fcb);
+    h = fc_hash(h, v, sizeof(v));
+    for (i = 0; i < feat_dimension1(fcb); i++) {
+        v[0] = feat_dimension2(fcb, i);
+        h = fc_hash(h, v, sizeof(v[0]));
+    }
+
+    if ((lda = cmd_ln_str_r(config, "-lda")) != NULL
+        && stat(lda, &st) == 0 && st.st_size > 0
+        && (mf = mmio_file_read(lda)) != NULL) {
+        h = fc_hash(h, mmio_file_ptr(mf), st.st_size);
+        mmio_file_unmap(mf);
+    }
+
+    return h;
+}
+
+static feat_cache_t *
+feat_cache_new(feat_t *fcb, cmd_ln_t *config)
+{
+    feat_cache_t *fc;
+    int32 i;
+
+    fc = (feat_cache_t *) ckd_calloc(1, sizeof(*fc));
+    fc->fcb = fcb;
+    for (i = 0; i < feat_dimension1(fcb); i++)
+        fc->veclen += feat_dimension2(fcb, i);
+    fc->key = feat_cache_key(fcb, config);
+
+    return fc;
+}
+
+static char *
+utt_name(const char *uttfile, int32 sf, int32 ef)
+{
+    char buf[32];
+
+    sprintf(buf, " %d %d", sf, ef);
+    return string_join(uttfile, buf, NULL);
+}
+
+feat_cache_t *
+feat_cache_read(const char *filename, feat_t *fcb, cmd_ln_t *config)
+{
+    feat_cache_t *fc;
+    struct stat st;
+    const uint32 *hdr, *e;
+    const char *str;
+    uint64_t n_word, idx_off, off;
+    int32 i, n_str;
+
+    if (stat(filename, &st) < 0) {
+        E_WARN("Feature cache %s does not exist\n", filename);
+        return NULL;
+    }
+    fc = feat_cache_new(fcb, config);
+    if ((fc->mf = mmio_file_read(filename)) == NULL) {
+        E_WARN("Cannot map feature cache %s\n", filename);
+        ckd_free(fc);
+        return NULL;
+    }
+
+    fc->data = (const float32 *) mmio_file_ptr(fc->mf);
+    hdr = (const uint32 *) fc->data + 2;
+    n_word = st.st_size / 4;
+    if (st.st_size % 4 != 0
+        || n_word < FEAT_CACHE_DATA_START
+        || memcmp(fc->data, FEAT_CACHE_MAGIC, 8) != 0
+        || hdr[0] != FEAT_CACHE_BYTE_ORDER
+        || hdr[1] != FEAT_CACHE_VERSION)
+        goto bad;
+    if (hdr[2] != (uint32) fc->key || hdr[3] != (uint32) (fc->key >> 32)
+        || (int32) hdr[4] != fc->veclen) {
+        E_WARN("Feature cache %s was made with different features; not using it\n",
+               filename);
+        goto fail;
+    }
+    fc->n_utt = hdr[5];
+    idx_off = hdr[6] | ((uint64_t) hdr[7] << 32);
+    n_str = hdr[8];
+    if (idx_off < FEAT_CACHE_DATA_START
+        || idx_off + (uint64_t) FEAT_CACHE_ENTRY_WORDS * fc->n_utt + n_str
+        != n_word || n_str == 0)
+        goto bad;
+    fc->index = (const uint32 *) fc->data + idx_off;
+    str = (const char *) (fc->index + FEAT_CACHE_ENTRY_WORDS * fc->n_utt);
+    if (str[n_str * 4 - 1] != '\0')
+        goto bad;
+
+    fc->utt = hash_table_new(fc->n_utt, HASH_CASE_YES);
+    for (i = 0; i < fc->n_utt; i++) {
+        e = fc->index + i * FEAT_CACHE_ENTRY_WORDS;
+        off = e[2] | ((uint64_t) e[3] << 32);
+        if (e[0] >= (uint32) n_str * 4
+            || off < FEAT_CACHE_DATA_START
+            || off + (uint64_t) e[1] * fc->veclen > idx_off)
+            goto bad;
+        (void) hash_table_enter_int32(fc->utt, str + e[0], i);
+    }
+    E_INFO("Read feature cache %s: %d utterances\n", filename, fc->n_utt);
+
+    return fc;
+
+  bad:
+    E_WARN("Feature cache %s is corrupt; not using it\n", filename);
+  fail:
+    if (fc->utt)
+        hash_table_free(fc->utt);
+    mmio_file_unmap(fc->mf);
+    ckd_free(fc);
+    return NULL;
+}
+
+int32
+feat_cache_find(feat_cache_t *fc, const char *uttfile, int32 sf,
+                int32 ef, int32 *out_nfr)
+{
+    char *name;
+    int32 id;
+
+    name = utt_name(uttfile, sf, ef);
+    if (hash_table_lookup_int32(fc->utt, name, &id) < 0)
+        id = -1;
+    else
+        *out_nfr = fc->index[id * FEAT_CACHE_ENTRY_WORDS + 1];
+    ckd_free(name);
+
+    return id;
+}
+
+void
+feat_cache_copy(feat_cache_t *fc, int32 id, mfcc_t ***feat)
+{
+    const uint32 *e;
+    const float32 *d;
+    int32 f, s, nfr, len;
+
+    e = fc->index + id * FEAT_CACHE_ENTRY_WORDS;
+    nfr = e[1];
+    d = fc->data + (e[2] | ((uint64_t) e[3] << 32));
+    for (f = 0; f < nfr; f++) {
+        for (s = 0; s < feat_dimension1(fc->fcb); s++) {
+            len = feat_dimension2(fc->fcb, s);
+            memcpy(feat[f][s], d, len * sizeof(float32));
+            d += len;
+        }
+    }
+}
+
+feat_cache_t *
+feat_cache_open(const char *filename, feat_t *fcb, cmd_ln_t *config)
+{
+    feat_cache_t *fc;
+    uint32 hdr[FEAT_CACHE_HDR_WORDS];
+    char pid[24];
+
+    fc = feat_cache_new(fcb, config);
+    fc->filename = ckd_salloc(filename);
+
+    /* Write to a private name and rename, so that a partial cache is
+     * never read */
+#ifndef _WIN32
+    sprintf(pid, ".tmp%d", (int) getpid());
+#else
+    strcpy(pid, ".tmp");
+#endif
+    fc->tmpfn = string_join(filename, pid, NULL);
+    if ((fc->fp = fopen(fc->tmpfn, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Unable to write feature cache %s", fc->tmpfn);
+        ckd_free(fc->tmpfn);
+        ckd_free(fc->filename);
+        ckd_free(fc);
+        return NULL;
+    }
+
+    /* The real header goes in when the cache is closed */
+    memset(hdr, 0, sizeof(hdr));
+    if (fwrite(FEAT_CACHE_MAGIC, 1, 8, fc->fp) != 8
+        || fwrite(hdr, 4, FEAT_CACHE_HDR_WORDS, fc->fp)
+        != FEAT_CACHE_HDR_WORDS) {
+        E_ERROR_SYSTEM("Failed to write feature cache %s", fc->tmpfn);
+        fc->err = TRUE;
+    }
+    fc->n_w_word = FEAT_CACHE_DATA_START;
+    fc->frame = (float32 *) ckd_calloc(fc->veclen, sizeof(float32));
+
+    return fc;
+}
+
+int32
+feat_cache_put(feat_cache_t *fc, const char *uttfile, int32 sf,
+               int32 ef, mfcc_t ***feat, int32 nfr)
+{
+    char *name;
+    uint32 *e;
+    int32 f, s, k, len;
+
+    /* Once a write has failed the offsets no longer match the file */
+    if (fc->err)
+        return -1;
+    for (f = 0; f < nfr; f++) {
+        for (s = 0, k = 0; s < feat_dimension1(fc->fcb); s++) {
+            len = feat_dimension2(fc->fcb, s);
+            memcpy(fc->frame + k, feat[f][s], len * sizeof(float32));
+            k += len;
+        }
+        if (fwrite(fc->frame, sizeof(float32), fc->veclen, fc->fp)
+            != (size_t) fc->veclen) {
+            E_ERROR_SYSTEM("Failed to write feature cache %s", fc->tmpfn);
+            fc->err = TRUE;
+            return -1;
+        }
+    }
+
+    if (fc->n_w_utt == fc->n_w_alloc) {
+        fc->n_w_alloc = fc->n_w_alloc ? 2 * fc->n_w_alloc : 1024;
+        fc->w_index = (uint32 *) ckd_realloc(fc->w_index,
+                                             fc->n_w_alloc
+                                             * FEAT_CACHE_ENTRY_WORDS
+                                             * sizeof(uint32));
+    }
+    name = utt_name(uttfile, sf, ef);
+    len = strlen(name) + 1;
+    if (fc->n_str + len > fc->n_str_alloc) {
+        fc->n_str_alloc = 2 * (fc->n_str + len) + 4096;
+        fc->w_str = (char *) ckd_realloc(fc->w_str, fc->n_str_alloc);
+    }
+    e = fc->w_index + fc->n_w_utt * FEAT_CACHE_ENTRY_WORDS;
+    e[0] = fc->n_str;
+    e[1] = nfr;
+    e[2] = (uint32) fc->n_w_word;
+    e[3] = (uint32) (fc->n_w_word >> 32);
+    memcpy(fc->w_str + fc->n_str, name, len);
+    fc->n_str += len;
+    fc->n_w_utt++;
+    fc->n_w_word += (uint64_t) nfr * fc->veclen;
+    ckd_free(name);
+
+    return 0;
+}
+
+static int32
+feat_cache_finish(feat_cache_t *fc)
+{
+    uint32 hdr[FEAT_CACHE_HDR_WORDS];
+    int32 n_str, err;
+
+    if (fc->err) {
+        fclose(fc->fp);
+        remove(fc->tmpfn);
+        E_ERROR("Feature cache %s is incomplete; not writing it\n",
+                fc->filename);
+        return -1;
+    }
+
+    /* At least one padding NUL */
+    n_str = (fc->n_str + 4) / 4;
+    fc->w_str = (char *) ckd_realloc(fc->w_str, n_str * 4);
+    memset(fc->w_str + fc->n_str, 0, n_str * 4 - fc->n_str);
+
+    hdr[0] = FEAT_CACHE_BYTE_ORDER;
+    hdr[1] = FEAT_CACHE_VERSION;
+    hdr[2] = (uint32) fc->key;
+    hdr[3] = (uint32) (fc->key >> 32);
+    hdr[4] = fc->veclen;
+    hdr[5] = fc->n_w_utt;
+    hdr[6] = (uint32) fc->n_w_word;
+    hdr[7] = (uint32) (fc->n_w_word >> 32);
+    hdr[8] = n_str;
+
+    err = (fwrite(fc->w_index, 4, fc->n_w_utt * FEAT_CACHE_ENTRY_WORDS,
+                  fc->fp) != (size_t) fc->n_w_utt * FEAT_CACHE_ENTRY_WORDS);
+    err |= (fwrite(fc->w_str, 4, n_str, fc->fp) != (size_t) n_str);
+    err |= (fseek(fc->fp, 8, SEEK_SET) < 0);
+    err |= (fwrite(hdr, 4, FEAT_CACHE_HDR_WORDS, fc->fp)
+            != FEAT_CACHE_HDR_WORDS);
+    err |= (fclose(fc->fp) != 0);
+    if (err) {
+        E_ERROR_SYSTEM("Failed to write feature cache %s", fc->tmpfn);
+        remove(fc->tmpfn);
+        return -1;
+    }
+    if (rename(fc->tmpfn, fc->filename) < 0) {
+        E_ERROR_SYSTEM("Failed to rename %s to %s", fc->tmpfn, fc->filename);
+        remove(fc->tmpfn);
+        return -1;
+    }
+    E_INFO("Wrote feature cache %s: %d utterances\n", fc->filename,
+           fc->n_w_utt);
+
+    return 0;
+}
+
+int32
+feat_cache_close(feat_cache_t *fc)
+{
+    int32 rv = 0;
+
+    if (fc == NULL)
+        return 0;
+    if (fc->fp) {
+        rv = feat_cache_finish(fc);
+        ckd_free(fc->w_index);
+        ckd_free(fc->w_str);
+        ckd_free(fc->frame);
+        ckd_free(fc->tmpfn);
+        ckd_free(fc->filename);
+    }
+    if (fc->mf) {
+        hash_table_free(fc->utt);
+        mmio_file_unmap(fc->mf);
+    }
+    ckd_free(fc);
+
+    return rv;
+}
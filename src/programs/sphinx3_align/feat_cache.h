@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*
+ * feat_cache.h -- Memory-mapped caches of computed features
+ *
+ * A feature cache holds the final features (after CMN, AGC, dynamic
+ * features, LDA/MLLT and subvector projection) of a set of utterances,
+ * keyed by control file entry.  sphinx3_align writes one with
+ * -featcache_out and reads it back with -featcache, so that repeated
+ * alignment passes over the same data skip the front end.
+ */
+
+#ifndef _S3_FEAT_CACHE_H_
+#define _S3_FEAT_CACHE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <sphinxbase/feat.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/hash_table.h>
+#include <sphinxbase/cmd_ln.h>
+
+#include "s3types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+} /* Fool Emacs into not indenting things. */
+#endif
+
+typedef struct {
+    feat_t *fcb;                /**< Feature type */
+    int32 veclen;               /**< Values per frame, over all streams */
+    uint64_t key;               /**< Hash of the front end configuration */
+
+    /* Reading */
+    mmio_file_t *mf;
+    const uint32 *index;        /**< Per utterance: name, #frames, data offset */
+    const float32 *data;        /**< Start of the file, as float32 words */
+    hash_table_t *utt;          /**< Name to index entry */
+    int32 n_utt;
+
+    /* Writing */
+    FILE *fp;
+    char *filename;
+    char *tmpfn;
+    uint32 *w_index;
+    char *w_str;
+    int32 n_str, n_str_alloc;
+    int32 n_w_utt, n_w_alloc;
+    uint64_t n_w_word;          /**< Words written so far */
+    float32 *frame;             /**< One frame, for writing */
+    int32 err;                  /**< A write failed; the cache is not published */
+} feat_cache_t;
+
+/**
+ * Map a feature cache for reading.  Returns NULL, with a warning, if it
+ * cannot be read or was made with a different front end configuration.
+ */
+feat_cache_t *feat_cache_read(const char *filename, feat_t *fcb,
+                              cmd_ln_t *config);
+
+/**
+ * Look up an utterance (as given in the control file).  Returns its
+ * index and sets *out_nfr, or returns -1 if it is not in the cache.
+ */
+int32 feat_cache_find(feat_cache_t *fc, const char *uttfile, int32 sf,
+                      int32 ef, int32 *out_nfr);
+
+/**
+ * Copy the features of utterance id into feat, which must have room
+ * for all its frames.
+ */
+void feat_cache_copy(feat_cache_t *fc, int32 id, mfcc_t ***feat);
+
+/**
+ * Start writing a feature cache.  It is written to a temporary file and
+ * only renamed to filename by feat_cache_close().
+ */
+feat_cache_t *feat_cache_open(const char *filename, feat_t *fcb,
+                              cmd_ln_t *config);
+
+/**
+ * Append the features of an utterance to a cache being written.  Not
+ * thread-safe; callers must serialize writes.  Returns -1 if this or
+ * an earlier write failed, in which case feat_cache_close() deletes the
+ * partial cache instead of publishing it.
+ */
+int32 feat_cache_put(feat_cache_t *fc, const char *uttfile, int32 sf,
+                     int32 ef, mfcc_t ***feat, int32 nfr);
+
+/**
+ * Finish writing a cache or unmap one being read, and free fc.  Returns
+ * -1 if the cache could not be written.
+ */
+int32 feat_cache_close(feat_cache_t *fc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*
+ * feat_pool.c -- Reusable feature buffers in frame count size classes
+ */
+
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+#include "feat_pool.h"
+
+static int32
+class_frames(feat_pool_t *pool, int32 cls)
+{
+    int32 nfr;
+
+    nfr = FEAT_POOL_MIN_FRAMES << cls;
+    return (nfr < pool->max_frames) ? nfr : pool->max_frames;
+}
+
+feat_pool_t *
+feat_pool_init(feat_t *fcb, int32 max_frames)
+{
+    feat_pool_t *pool;
+
+    pool = (feat_pool_t *) ckd_calloc(1, sizeof(*pool));
+    pool->fcb = fcb;
+    pool->max_frames = max_frames;
+    for (pool->n_class = 1;
+         class_frames(pool, pool->n_class - 1) < max_frames;
+         pool->n_class++);
+    pool->free_list = (feat_pool_buf_t **) ckd_calloc(pool->n_class,
+                                                      sizeof(*pool->free_list));
+    pool->mtx = sbmtx_init();
+
+    return pool;
+}
+
+feat_pool_buf_t *
+feat_pool_get(feat_pool_t *pool, int32 nfr)
+{
+    feat_pool_buf_t *buf;
+    int32 cls;
+
+    /* Longer utterances get a buffer of their own, which is freed
+       again rather than kept for later ones */
+    if (nfr > pool->max_frames) {
+        buf = (feat_pool_buf_t *) ckd_calloc(1, sizeof(*buf));
+        buf->cls = -1;
+        buf->n_frame = nfr;
+        buf->feat = feat_array_alloc(pool->fcb, nfr);
+        return buf;
+    }
+
+    for (cls = 0; cls < pool->n_class - 1 && class_frames(pool, cls) < nfr;
+         cls++);
+
+    sbmtx_lock(pool->mtx);
+    if ((buf = pool->free_list[cls]) != NULL) {
+        pool->free_list[cls] = buf->next;
+        sbmtx_unlock(pool->mtx);
+        return buf;
+    }
+    pool->n_alloc++;
+    sbmtx_unlock(pool->mtx);
+
+    buf = (feat_pool_buf_t *) ckd_calloc(1, sizeof(*buf));
+    buf->cls = cls;
+    buf->n_frame = class_frames(pool, cls);
+    buf->feat = feat_array_alloc(pool->fcb, buf->n_frame);
+
+    return buf;
+}
+
+void
+feat_pool_put(feat_pool_t *pool, feat_pool_buf_t *buf)
+{
+    if (buf == NULL)
+        return;
+    if (buf->cls < 0) {
+        feat_array_free(buf->feat);
+        ckd_free(buf);
+        return;
+    }
+    sbmtx_lock(pool->mtx);
+    buf->next = pool->free_list[buf->cls];
+    pool->free_list[buf->cls] = buf;
+    sbmtx_unlock(pool->mtx);
+}
+
+void
+feat_pool_free(feat_pool_t *pool)
+{
+    feat_pool_buf_t *buf, *next;
+    int32 cls;
+
+    if (pool == NULL)
+        return;
+    for (cls = 0; cls < pool->n_class; cls++) {
+        for (buf = pool->free_list[cls]; buf; buf = next) {
+            next = buf->next;
+            feat_array_free(buf->feat);
+            ckd_free(buf);
+        }
+    }
+    E_INFO("Feature buffer pool: %d buffers allocated\n", pool->n_alloc);
+    ckd_free(pool->free_list);
+    sbmtx_free(pool->mtx);
+    ckd_free(pool);
+}
@@ -0,0 +1,108 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
+/*
+ * feat_pool.h -- Reusable feature buffers in frame count size classes
+ *
+ * Feature arrays (see feat_array_alloc()) are handed out by size class,
+ * the smallest power of two frames that holds an utterance, and go back
+ * on a free list for that class when the utterance is done.  After the
+ * first few utterances aligning a corpus allocates nothing, and each
+ * thread only holds as much as its current utterance needs.
+ */
+
+#ifndef _S3_FEAT_POOL_H_
+#define _S3_FEAT_POOL_H_
+
+#include <sphinxbase/feat.h>
+#include <sphinxbase/sbthread.h>
+
+#include "s3types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+} /* Fool Emacs into not indenting things. */
+#endif
+
+#define FEAT_POOL_MIN_FRAMES	256	/**< Smallest size class */
+
+/** A pooled feature array */
+typedef struct feat_pool_buf_s {
+    mfcc_t ***feat;             /**< Feature array, see feat_array_alloc() */
+    int32 n_frame;              /**< Frames in feat */
+    int32 cls;                  /**< Size class, or -1 if not pooled */
+    struct feat_pool_buf_s *next;
+} feat_pool_buf_t;
+
+typedef struct {
+    feat_t *fcb;                /**< Feature type of the buffers */
+    int32 max_frames;           /**< Largest pooled buffer */
+    int32 n_class;
+    feat_pool_buf_t **free_list; /**< Free buffers by size class */
+    sbmtx_t *mtx;
+    int32 n_alloc;              /**< Buffers allocated so far */
+} feat_pool_t;
+
+/**
+ * Create a pool of feature arrays for fcb.  Buffers of up to max_frames
+ * frames are kept for reuse.
+ */
+feat_pool_t *feat_pool_init(feat_t *fcb, int32 max_frames);
+
+/**
+ * Get a feature array of at least nfr frames.  Above max_frames it is
+ * allocated for this request only and freed by feat_pool_put().
+ * Thread-safe.
+ */
+feat_pool_buf_t *feat_pool_get(feat_pool_t *pool, int32 nfr);
+
+/**
+ * Return a buffer obtained from feat_pool_get().  Thread-safe.
+ */
+void feat_pool_put(feat_pool_t *pool, feat_pool_buf_t *buf);
+
+/**
+ * Free a pool and all the buffers in it; those still in use must have
+ * been returned first.
+ */
+void feat_pool_free(feat_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
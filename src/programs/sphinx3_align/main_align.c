@@ -51,6 +51,8 @@
 #include <sphinxbase/cmd_ln.h>
 #include <sphinxbase/agc.h>
 #include <sphinxbase/cmn.h>
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/strfuncs.h>
 
 #include "s3types.h"
 #include "logs3.h"
@@ -73,6 +75,8 @@
 #include "cmdln_macro.h"
 #include "corpus.h"
 #include "kbcore.h"
+#include "feat_pool.h"
+#include "feat_cache.h"
 
 /** \file main_align.c
    \brief Main driver routine for time alignment.
@@ -102,6 +106,14 @@ static arg_t defn[] = {
      ARG_FLOAT64,
      "1e-64",
      "Main pruning beam applied to triphones in forward search"},
+    {"-blockfrm",
+     ARG_INT32,
+     "8",
+     "With .cont. models, score each Gaussian mixture for this many frames at a time; the scores are the same, only faster (0 scores frame by frame)"},
+    {"-traceback_int",
+     ARG_INT32,
+     "0",
+     "Every this many frames, commit the part of the best path shared by all active states and discard dead history, which bounds memory on long utterances without changing the alignment and lifts the limit on utterance length (0 keeps the full history)"},
     {"-insent",
      REQARG_STRING,
      NULL,
@@ -146,6 +158,18 @@ static arg_t defn[] = {
      ARG_INT32,
      "1",
      "Whether to insert optional silences and fillers between words."},
+    {"-nthreads",
+     ARG_INT32,
+     "1",
+     "Number of threads aligning utterances in parallel.  The output does not depend on it."},
+    {"-featcache",
+     ARG_STRING,
+     NULL,
+     "Read the features of utterances found in this cache (written by -featcache_out with the same front end settings) instead of computing them"},
+    {"-featcache_out",
+     ARG_STRING,
+     NULL,
+     "Write the features of all aligned utterances to this cache, for -featcache in later passes"},
     fast_GMM_computation_command_line_macro(),
     {NULL, ARG_INT32, NULL, NULL}
 };
@@ -155,16 +179,12 @@ static arg_t defn[] = {
 
 static kbcore_t *kbc;           /* A kbcore structure */
 static fe_t *fe;                /* Waveform data handling ('-adcin') */
-static ascr_t *ascr;            /* An acoustic score structure.  */
-static fast_gmm_t *fastgmm;     /* A fast GMM parameter structure.  */
 static adapt_am_t *adapt_am;    /* An adaptation structure. */
 /*
  * Load and cross-check all models (acoustic/lexical/linguistic).
  */
 static dict_t *dict;
 
-static float32 ***feat = NULL;  /* Speech feature data */
-
 static int32 ctloffset;
 
 static const char *outsentfile;
@@ -175,29 +195,78 @@ static FILE *outctlfp = NULL;
 static const char *sentfile;
 static FILE *sentfp = NULL;
 
-static int32 n_align_outsent_fallback;
-
 static char *s2stsegdir = NULL;
 static char *stsegdir = NULL;
 static char *phsegdir = NULL;
 static char *phlabdir = NULL;
 static char *wdsegdir = NULL;
 
+/*
+ * Utterances are handed out to the aligner threads in control file order
+ * under ctl_mtx.  The control, MLLR control and transcript files and the
+ * feature computation are only touched under it; -outsent and -outctl
+ * lines are written in the same order once each utterance is done.
+ */
+static sbmtx_t *ctl_mtx;
+static FILE *ctlfp = NULL;
+static FILE *ctlmllrfp = NULL;
+static int32 ctlcount;
+static int32 n_utt_read;        /* Sequence no. of the next utterance */
+
+static feat_pool_t *feat_pool;  /* Feature arrays for the utterances in flight */
+static int32 max_nfr;           /* Longest utterance, or -1 for no limit */
+static feat_cache_t *feat_cache;        /* -featcache, or NULL */
+static feat_cache_t *feat_cache_out;    /* -featcache_out, or NULL */
+
+typedef struct {
+    char *sent;                 /* -outsent line, or NULL */
+    char *ctl;                  /* -outctl line, or NULL */
+    int32 done;
+} utt_output_t;
+static utt_output_t *utt_output;        /* Indexed by sequence no. */
+static int32 n_utt_output_alloc;
+static int32 n_utt_written;
 
 /* For profiling/timing */
 enum { tmr_utt, tmr_gauden, tmr_senone, tmr_align };
-ptmr_t timers[5];
 
-static int32 tot_nfr;
-static ptmr_t tm_utt;
-static ptmr_t tm_ovrhd;
+/* One utterance handed to an aligner thread */
+typedef struct {
+    int32 seq_no;
+    char uttfile[16384];
+    char uttid[4096];
+    char sent[16384];
+    char regmatname[4096];
+    char cb2mllrname[4096];
+    int32 has_mllr;
+    int32 nfr;
+    feat_pool_buf_t *fbuf;      /* Features, or NULL if they could not be read */
+    char *outsent;              /* Line for -outsent, or NULL */
+    char *outctl;               /* Line for -outctl, or NULL */
+} align_utt_t;
+
+/* An aligner thread.  Thread 0 scores with the models in kbc; the others
+ * have their own copies of the mutable parts of the Gaussian models. */
+typedef struct {
+    align_t *al;                /* Aligner */
+    ascr_t *ascr;               /* An acoustic score structure.  */
+    fast_gmm_t *fastgmm;        /* A fast GMM parameter structure.  */
+    mgau_model_t *mgau;
+    mgau_blk_t *mgau_blk;       /* Frame-blocked scores for mgau, or NULL */
+    subvq_t *svq;               /* SubVQ model with this thread's scratch space */
+    ms_mgau_model_t *ms_mgau;
+    align_utt_t utt;
+    ptmr_t timers[5];
+    ptmr_t tm_utt;
+    ptmr_t tm_ovrhd;
+    int32 tot_nfr;
+    int32 n_outsent_fallback;
+} align_job_t;
 
 
 static void
 models_init(cmd_ln_t *config)
 {
-    int32 cisencnt;
-
     kbc = New_kbcore(config);
 
     kbc->logmath = logs3_init(cmd_ln_float64_r(config, "-logbase"), 1,
@@ -235,25 +304,6 @@ models_init(cmd_ln_t *config)
 
 
 
-    for (cisencnt = 0; cisencnt == kbc->mdef->cd2cisen[cisencnt];
-         cisencnt++);
-
-    ascr = ascr_init(kbc->mdef->n_sen, 0,       /* No composite senone */
-                     mdef_n_sseq(kbc->mdef), 0, /* No composite senone sequence */
-                     1,         /* Phoneme lookahead window =1. Not enabled phoneme lookahead at this moment */
-                     cisencnt);
-
-    fastgmm = fast_gmm_init(cmd_ln_int32_r(config, "-ds"),
-                            cmd_ln_int32_r(config, "-cond_ds"),
-                            cmd_ln_int32_r(config, "-dist_ds"),
-                            cmd_ln_int32_r(config, "-gs4gs"),
-                            cmd_ln_int32_r(config, "-svq4svq"),
-                            cmd_ln_float64_r(config, "-subvqbeam"),
-                            cmd_ln_float64_r(config, "-ci_pbeam"),
-                            cmd_ln_float64_r(config, "-tighten_factor"),
-                            cmd_ln_int32_r(config, "-maxcdsenpf"),
-                            kbc->mdef->n_ci_sen,
-                            kbc->logmath);
     adapt_am = adapt_am_init();
 }
 
@@ -261,10 +311,6 @@ static void models_free(void)
 {
     if (adapt_am)
         adapt_am_free(adapt_am);
-    if (fastgmm)
-        fast_gmm_free(fastgmm);
-    if (ascr)
-        ascr_free(ascr);
     if (dict)
         dict_free(dict);
 
@@ -272,6 +318,72 @@ static void models_free(void)
 }
 
 
+/*
+ * Set up an aligner thread.  Only the first one may use the Gaussian
+ * models in kbc directly, as scoring updates them.
+ */
+static void
+align_job_init(align_job_t * job, int32 first, cmd_ln_t *config)
+{
+    int32 cisencnt;
+
+    memset(job, 0, sizeof(*job));
+
+    for (cisencnt = 0; cisencnt == kbc->mdef->cd2cisen[cisencnt];
+         cisencnt++);
+
+    job->ascr = ascr_init(kbc->mdef->n_sen, 0,       /* No composite senone */
+                          mdef_n_sseq(kbc->mdef), 0, /* No composite senone sequence */
+                          1,         /* Phoneme lookahead window =1. Not enabled phoneme lookahead at this moment */
+                          cisencnt);
+
+    job->fastgmm = fast_gmm_init(cmd_ln_int32_r(config, "-ds"),
+                                 cmd_ln_int32_r(config, "-cond_ds"),
+                                 cmd_ln_int32_r(config, "-dist_ds"),
+                                 cmd_ln_int32_r(config, "-gs4gs"),
+                                 cmd_ln_int32_r(config, "-svq4svq"),
+                                 cmd_ln_float64_r(config, "-subvqbeam"),
+                                 cmd_ln_float64_r(config, "-ci_pbeam"),
+                                 cmd_ln_float64_r(config, "-tighten_factor"),
+                                 cmd_ln_int32_r(config, "-maxcdsenpf"),
+                                 kbc->mdef->n_ci_sen,
+                                 kbc->logmath);
+
+    if (kbc->mgau) {
+        job->mgau = first ? kbc->mgau : mgau_clone(kbc->mgau);
+        if (cmd_ln_int32_r(config, "-blockfrm") > 0)
+            job->mgau_blk = mgau_blk_init(job->mgau,
+                                          cmd_ln_int32_r(config, "-blockfrm"));
+        if (kbc->svq)
+            job->svq = first ? kbc->svq : subvq_clone(kbc->svq);
+    }
+    if (kbc->ms_mgau)
+        job->ms_mgau = first ? kbc->ms_mgau : ms_mgau_clone(kbc->ms_mgau);
+
+    job->al = align_init(kbc->mdef, kbc->tmat, dict, config, kbc->logmath);
+
+    job->timers[tmr_utt].name = "U";
+    job->timers[tmr_gauden].name = "G";
+    job->timers[tmr_senone].name = "S";
+    job->timers[tmr_align].name = "A";
+}
+
+static void
+align_job_free(align_job_t * job)
+{
+    align_free(job->al);
+    mgau_blk_free(job->mgau_blk);
+    if (job->svq && job->svq != kbc->svq)
+        subvq_clone_free(job->svq);
+    if (job->mgau && job->mgau != kbc->mgau)
+        mgau_clone_free(job->mgau);
+    if (job->ms_mgau && job->ms_mgau != kbc->ms_mgau)
+        ms_mgau_clone_free(job->ms_mgau);
+    fast_gmm_free(job->fastgmm);
+    ascr_free(job->ascr);
+}
+
+
 /*
  * Build a filename int buf as follows (without file extension):
  *     if dir ends with ,CTLand ctlspec does not begin with /, filename is dir/ctlspec
@@ -325,8 +437,11 @@ write_s2stseg(char *dir, align_stseg_t * stseg, char *uttid, char *ctlspec, int3
     s3cipid_t ci[3];
     word_posn_t wpos;
     int16 s2_info;
-    char buf[8];
-    static int32 byterev = -1;  /* Whether to byte reverse output data */
+    int32 byterev;              /* Whether to byte reverse output data */
+
+    /* If the lsB of BYTE_ORDER_MAGIC comes first, we are little-endian.  Need to byterev */
+    k = (int32) BYTE_ORDER_MAGIC;
+    byterev = (*(char *) &k == (BYTE_ORDER_MAGIC & 0x000000ff)) ? 1 : 0;
 
     build_output_uttfile(filename, dir, uttid, ctlspec);
     strcat(filename, ".v8_seg");        /* .v8_seg for compatibility */
@@ -344,32 +459,6 @@ write_s2stseg(char *dir, align_stseg_t * stseg, char *uttid, char *ctlspec, int3
         return;
     }
 
-    if (byterev < 0) {
-        /* Byte ordering of host machine unknown; first figure it out */
-        k = (int32) BYTE_ORDER_MAGIC;
-        if (fwrite(&k, sizeof(int32), 1, fp) != 1)
-            goto write_error;
-
-        fclose(fp);
-        if ((fp = fopen(filename, "rb")) == NULL) {
-            E_ERROR_SYSTEM("Failed to open file %s for reading", filename);
-            return;
-        }
-        if (fread(buf, 1, sizeof(int32), fp) != sizeof(int32)) {
-            E_ERROR_SYSTEM("Failed to read from the file %s", filename);
-            return;
-        }
-        fclose(fp);
-
-        /* If buf[0] == lsB of BYTE_ORDER_MAGIC, we are little-endian.  Need to byterev */
-        byterev = (buf[0] == (BYTE_ORDER_MAGIC & 0x000000ff)) ? 1 : 0;
-
-        if ((fp = fopen(filename, "wb")) == NULL) {
-            E_ERROR_SYSTEM("Failed to open file %s for writing", filename);
-            return;
-        }
-    }
-
     /* Write #frames */
     for (k = 0, tmp = stseg; tmp; k++, tmp = tmp->next);
     if (byterev)
@@ -644,22 +733,70 @@ write_wdseg(char *dir, align_wdseg_t * wdseg, char *uttid, char *ctlspec)
 }
 
 
-/* Write exact transcription (pronunciation and silence/noise words included) */
-static void
-write_outsent(FILE * fp, align_wdseg_t * wdseg, char *uttid)
+/* Build exact transcription (pronunciation and silence/noise words included) */
+static char *
+build_outsent(align_wdseg_t * wdseg, char *uttid)
 {
+    align_wdseg_t *tmp;
+    char *line, *p;
+    size_t len;
+
+    len = strlen(uttid) + 5;
+    for (tmp = wdseg; tmp; tmp = tmp->next)
+        len += strlen(dict_wordstr(dict, tmp->wid)) + 1;
+    line = p = ckd_calloc(len, 1);
     for (; wdseg; wdseg = wdseg->next)
-        fprintf(fp, "%s ", dict_wordstr(dict, wdseg->wid));
-    fprintf(fp, " (%s)\n", uttid);
-    fflush(fp);
+        p += sprintf(p, "%s ", dict_wordstr(dict, wdseg->wid));
+    sprintf(p, " (%s)\n", uttid);
+
+    return line;
 }
 
-/* Write output ctlfile entry */
+/* Output ctlfile entry */
+static char *
+build_outctl(char *uttctl)
+{
+    return string_join(uttctl, "\n", NULL);
+}
+
+/*
+ * Hand over the -outsent and -outctl lines of an utterance (either may be
+ * NULL) and write out those of all utterances done so far, in order.
+ */
 static void
-write_outctl(FILE * fp, char *uttctl)
+write_utt_output(int32 seq_no, char *sent, char *ctl)
 {
-    fprintf(fp, "%s\n", uttctl);
-    fflush(fp);
+    utt_output_t *o;
+
+    sbmtx_lock(ctl_mtx);
+    if (seq_no >= n_utt_output_alloc) {
+        int32 n = n_utt_output_alloc;
+
+        n_utt_output_alloc = (seq_no + 1) * 2;
+        utt_output = ckd_realloc(utt_output,
+                                 n_utt_output_alloc * sizeof(*utt_output));
+        memset(utt_output + n, 0,
+               (n_utt_output_alloc - n) * sizeof(*utt_output));
+    }
+    utt_output[seq_no].sent = sent;
+    utt_output[seq_no].ctl = ctl;
+    utt_output[seq_no].done = TRUE;
+
+    for (; n_utt_written < n_utt_output_alloc
+         && utt_output[n_utt_written].done; n_utt_written++) {
+        o = utt_output + n_utt_written;
+        if (o->sent) {
+            fputs(o->sent, outsentfp);
+            fflush(outsentfp);
+            ckd_free(o->sent);
+        }
+        if (o->ctl) {
+            fputs(o->ctl, outctlfp);
+            fflush(outctlfp);
+            ckd_free(o->ctl);
+        }
+    }
+    sbmtx_unlock(ctl_mtx);
 }
 
 static void
@@ -683,14 +820,13 @@ trim_spaces(char *s)
  * so downstream jobs stay line-aligned with -ctl (one line per utterance).
  */
 static void
-write_outsent_insent_fallback(FILE * fp, char *sent, const char *uttid)
+write_outsent_insent_fallback(align_job_t * job, char *sent, const char *uttid)
 {
-    if (!fp)
+    if (!outsentfp)
         return;
     trim_spaces(sent);
-    fprintf(fp, "%s (%s)\n", sent, uttid);
-    fflush(fp);
-    ++n_align_outsent_fallback;
+    job->utt.outsent = string_join(sent, " (", uttid, ")\n", NULL);
+    ++job->n_outsent_fallback;
     E_INFO("Wrote -outsent fallback (reference text) for %s\n", uttid);
 }
 
@@ -699,7 +835,8 @@ write_outsent_insent_fallback(FILE * fp, char *sent, const char *uttid)
  * Find Viterbi alignment.
  */
 static void
-align_utt(char *sent,           /* In: Reference transcript */
+align_utt(align_job_t * job,    /* In/Out: Aligner thread */
+          char *sent,           /* In: Reference transcript */
           int32 nfr,            /* In: #frames of input */
           char *ctlspec,        /* In: Utt specifiction from control file */
           char *uttid)
@@ -709,35 +846,45 @@ align_utt(char *sent,           /* In: Reference transcript */
     align_phseg_t *phseg;
     align_wdseg_t *wdseg;
     int32 w;
+    align_t *al = job->al;
+    ascr_t *ascr = job->ascr;
+    float32 ***feat = job->utt.fbuf->feat;
+    ptmr_t *timers = job->timers;
 
     w = feat_window_size(kbcore_fcb(kbc));  /* #MFC vectors needed on either side of current
                                    frame to compute one feature vector */
     if (nfr <= (w << 1)) {
         E_ERROR("Utterance %s < %d frames (%d); ignored\n", uttid,
                 (w << 1) + 1, nfr);
-        write_outsent_insent_fallback(outsentfp, sent, uttid);
+        write_outsent_insent_fallback(job, sent, uttid);
         return;
     }
 
     ptmr_reset_all(timers);
 
-    ptmr_reset(&tm_utt);
-    ptmr_start(&tm_utt);
-    ptmr_reset(&tm_ovrhd);
-    ptmr_start(&tm_ovrhd);
+    ptmr_reset(&job->tm_utt);
+    ptmr_start(&job->tm_utt);
+    ptmr_reset(&job->tm_ovrhd);
+    ptmr_start(&job->tm_ovrhd);
     ptmr_start(timers + tmr_utt);
 
 
-    if (align_build_sent_hmm(sent, cmd_ln_int32_r(kbc->config, "-insert_sil")) != 0) {
-        align_destroy_sent_hmm();
+    if (align_build_sent_hmm(al, sent, cmd_ln_int32_r(kbc->config, "-insert_sil")) != 0) {
+        align_destroy_sent_hmm(al);
         ptmr_stop(timers + tmr_utt);
 
         E_ERROR("No sentence HMM; no alignment for %s\n", uttid);
-        write_outsent_insent_fallback(outsentfp, sent, uttid);
+        write_outsent_insent_fallback(job, sent, uttid);
         return;
     }
 
-    align_start_utt(uttid);
+    align_start_utt(al, uttid);
+
+    /* Scores must not depend on which utterances this thread did before */
+    if (job->mgau)
+        mgau_reset_bstidx(job->mgau);
+    if (job->mgau_blk)
+        mgau_blk_set_utt(job->mgau_blk, feat, nfr);
 
     for (i = 0; i < nfr; i++) {
         ptmr_start(timers + tmr_utt);
@@ -746,39 +893,40 @@ align_utt(char *sent,           /* In: Reference transcript */
         ptmr_start(timers + tmr_gauden);
         ptmr_start(timers + tmr_senone);
 
-        align_sen_active(ascr->sen_active, ascr->n_sen);
+        align_sen_active(al, ascr->sen_active, ascr->n_sen);
 
         /* Bah, there ought to be a function for this. */
-        if (kbc->ms_mgau) {
+        if (job->ms_mgau) {
             ms_cont_mgau_frame_eval(ascr,
-				    kbc->ms_mgau,
+				    job->ms_mgau,
 				    kbc->mdef, feat[i], i);
         }
         else if (kbc->s2_mgau) {
             s2_semi_mgau_frame_eval(kbc->s2_mgau,
-				    ascr, fastgmm, feat[i],
+				    ascr, job->fastgmm, feat[i],
 				    i);
         }
-        else if (kbc->mgau) {
-            approx_cont_mgau_ci_eval(kbcore_svq(kbc),
+        else if (job->mgau) {
+            approx_cont_mgau_ci_eval(job->svq,
                                      kbcore_gs(kbc),
-                                     kbcore_mgau(kbc),
-                                     fastgmm,
+                                     job->mgau,
+                                     job->fastgmm,
                                      kbc->mdef,
                                      feat[i][0],
                                      ascr->cache_ci_senscr[0],
                                      &(ascr->cache_best_list[0]), i,
-                                     kbcore_logmath(kbc));
+                                     kbcore_logmath(kbc), job->mgau_blk);
             approx_cont_mgau_frame_eval(kbcore_mdef(kbc),
-					kbcore_svq(kbc),
+					job->svq,
 					kbcore_gs(kbc),
-					kbcore_mgau(kbc),
-					fastgmm, ascr,
+					job->mgau,
+					job->fastgmm, ascr,
 					feat[i][0], i,
 					ascr->
 					cache_ci_senscr[0],
-					&tm_ovrhd,
-					kbcore_logmath(kbc));
+					&job->tm_ovrhd,
+					kbcore_logmath(kbc),
+					job->mgau_blk);
         }
 
         ptmr_stop(timers + tmr_gauden);
@@ -786,28 +934,28 @@ align_utt(char *sent,           /* In: Reference transcript */
 
         /* Step alignment one frame forward */
         ptmr_start(timers + tmr_align);
-        if (align_frame(ascr->senscr) < 0) {
+        if (align_frame(al, ascr->senscr) < 0) {
             ptmr_stop(timers + tmr_align);
             ptmr_stop(timers + tmr_utt);
-            ptmr_stop(&tm_utt);
-            ptmr_stop(&tm_ovrhd);
+            ptmr_stop(&job->tm_utt);
+            ptmr_stop(&job->tm_ovrhd);
             E_ERROR("Alignment failed mid-utterance for %s\n", uttid);
-            write_outsent_insent_fallback(outsentfp, sent, uttid);
-            align_destroy_sent_hmm();
+            write_outsent_insent_fallback(job, sent, uttid);
+            align_destroy_sent_hmm(al);
             return;
         }
         ptmr_stop(timers + tmr_align);
         ptmr_stop(timers + tmr_utt);
     }
-    ptmr_stop(&tm_utt);
-    ptmr_stop(&tm_ovrhd);
+    ptmr_stop(&job->tm_utt);
+    ptmr_stop(&job->tm_ovrhd);
 
     printf("\n");
 
     /* Wind up alignment for this utterance */
-    if (align_end_utt(&stseg, &phseg, &wdseg) < 0) {
+    if (align_end_utt(al, &stseg, &phseg, &wdseg) < 0) {
         E_ERROR("Final state not reached; no alignment for %s\n\n", uttid);
-        write_outsent_insent_fallback(outsentfp, sent, uttid);
+        write_outsent_insent_fallback(job, sent, uttid);
     }
     else {
         if (s2stsegdir)
@@ -821,21 +969,21 @@ align_utt(char *sent,           /* In: Reference transcript */
         if (wdsegdir)
             write_wdseg(wdsegdir, wdseg, uttid, ctlspec);
         if (outsentfp)
-            write_outsent(outsentfp, wdseg, uttid);
+            job->utt.outsent = build_outsent(wdseg, uttid);
         if (outctlfp)
-            write_outctl(outctlfp, ctlspec);
+            job->utt.outctl = build_outctl(ctlspec);
     }
 
-    align_destroy_sent_hmm();
+    align_destroy_sent_hmm(al);
 
     ptmr_print_all(stdout, timers, nfr * 0.1);
 
     printf
         ("EXECTIME: %5d frames, %7.2f sec CPU, %6.2f xRT; %7.2f sec elapsed, %6.2f xRT\n",
-         nfr, tm_utt.t_cpu, tm_utt.t_cpu * 100.0 / nfr, tm_utt.t_elapsed,
-         tm_utt.t_elapsed * 100.0 / nfr);
+         nfr, job->tm_utt.t_cpu, job->tm_utt.t_cpu * 100.0 / nfr, job->tm_utt.t_elapsed,
+         job->tm_utt.t_elapsed * 100.0 / nfr);
 
-    tot_nfr += nfr;
+    job->tot_nfr += nfr;
 }
 
 
@@ -858,23 +1006,51 @@ id_cmp(char *str1, char *str2)
     }
 }
 
-static void
-utt_align(void *data, utt_res_t * ur, int32 sf, int32 ef, char *uttid)
+/*
+ * Read the next utterance of the control file, its transcript and its
+ * features into job.  Returns FALSE at the end of the control file.
+ */
+static int
+align_next_utt(align_job_t * job, cmd_ln_t *config)
 {
-    int32 nfr;
+    align_utt_t *utt = &job->utt;
+    int32 sf, ef, tmp1, tmp2;
+    int32 nfr, id;
     int k, i;
     const char *cepdir;
     const char *cepext;
-    char sent[16384];
-    cmd_ln_t *config = (cmd_ln_t*) data;
+    char *sent = utt->sent;
+    char *uttid = utt->uttid;
 
     cepdir = cmd_ln_str_r(kbc->config, "-cepdir");
     cepext = cmd_ln_str_r(kbc->config, "-cepext");
 
+    sbmtx_lock(ctl_mtx);
+    if (ctlcount <= 0
+        || ctl_read_entry(ctlfp, utt->uttfile, &sf, &ef, uttid) < 0) {
+        sbmtx_unlock(ctl_mtx);
+        return FALSE;
+    }
+    --ctlcount;
+
+    utt->has_mllr = FALSE;
+    if (ctlmllrfp) {
+        if (ctl_read_entry(ctlmllrfp, utt->regmatname, &tmp1, &tmp2,
+                           utt->cb2mllrname) < 0) {
+            E_ERROR("MLLR control file is specified but MLLR cannot be read for %s\n",
+                    uttid);
+            ctlcount = 0;
+            sbmtx_unlock(ctl_mtx);
+            return FALSE;
+        }
+        if (tmp2 == -1)
+            strcpy(utt->cb2mllrname, ".1cls.");
+        utt->has_mllr = TRUE;
+    }
 
     /* UGLY! */
     /* Read utterance transcript and match it with the control file. */
-    if (fgets(sent, sizeof(sent), sentfp) == NULL) {
+    if (fgets(sent, sizeof(utt->sent), sentfp) == NULL) {
         E_FATAL("EOF(%s) of the transcription\n", sentfile);
     }
     /*  E_INFO("SENT %s\n",sent); */
@@ -900,79 +1076,163 @@ utt_align(void *data, utt_res_t * ur, int32 sf, int32 ef, char *uttid)
         }
     }
 
+    /* Take the features from the cache if it has them, or else compute
+       them, into a pooled buffer of the right size */
+    utt->fbuf = NULL;
+    nfr = -1;
+    id = -1;
+    if (feat_cache)
+        id = feat_cache_find(feat_cache, utt->uttfile, sf, ef, &nfr);
+    if (id >= 0 && (max_nfr < 0 || nfr <= max_nfr)) {
+        utt->fbuf = feat_pool_get(feat_pool, nfr);
+        feat_cache_copy(feat_cache, id, utt->fbuf->feat);
+    }
     /* Convert input file to cepstra if waveform input is selected */
-    if (cmd_ln_boolean_r(config, "-adcin")) {
+    else if (cmd_ln_boolean_r(config, "-adcin")) {
         int16 *adcdata;
         size_t nsamps = 0;
         mfcc_t **mfcc;
 
         if ((adcdata = bio_read_wavfile(cmd_ln_str_r(config, "-cepdir"),
-    				        ur->uttfile,
+    				        utt->uttfile,
     				        cmd_ln_str_r(config, "-cepext"),
     				        cmd_ln_int32_r(config, "-adchdr"),
     				        strcmp(cmd_ln_str_r(config, "-input_endian"), "big"),
     				        &nsamps)) == NULL) {
-            E_FATAL("Cannot read file %s\n", ur->uttfile);
+            E_FATAL("Cannot read file %s\n", utt->uttfile);
         }
         fe_start_utt(fe);
         if (fe_process_utt(fe, adcdata, nsamps, &mfcc, &nfr) < 0) {
-            E_FATAL("MFCC calculation failed\n", ur->uttfile);
+            E_FATAL("MFCC calculation failed\n", utt->uttfile);
         }
         ckd_free(adcdata);
-        if (nfr > S3_MAX_FRAMES) {
-            E_FATAL("Maximum number of frames (%d) exceeded\n", S3_MAX_FRAMES);
+        if (max_nfr >= 0 && nfr > max_nfr) {
+            E_FATAL("Maximum number of frames (%d) exceeded; "
+                    "use -traceback_int for longer utterances\n", max_nfr);
         }
+        utt->fbuf = feat_pool_get(feat_pool, nfr);
         if ((nfr = feat_s2mfc2feat_live(kbcore_fcb(kbc),
 						mfcc,
 						&nfr,
 						TRUE, TRUE,
-						feat)) < 0) {
+						utt->fbuf->feat)) < 0) {
             E_FATAL("Feature computation failed\n");
         }
         if (mfcc)
             ckd_free_2d((void **)mfcc);
     }
     else {
+        /* Only the file header is read to size the buffer */
         nfr =
-            feat_s2mfc2feat(kbcore_fcb(kbc), ur->uttfile, cepdir, cepext, sf, ef, feat,
-                            S3_MAX_FRAMES);
+            feat_s2mfc2feat(kbcore_fcb(kbc), utt->uttfile, cepdir, cepext, sf, ef, NULL,
+                            max_nfr);
+        if (nfr > 0) {
+            utt->fbuf = feat_pool_get(feat_pool, nfr);
+            nfr =
+                feat_s2mfc2feat(kbcore_fcb(kbc), utt->uttfile, cepdir, cepext, sf, ef,
+                                utt->fbuf->feat, utt->fbuf->n_frame);
+        }
     }
 
-    if (ur->regmatname) {
-        if (kbc->mgau)
-            adapt_set_mllr(adapt_am, kbc->mgau, ur->regmatname,
-                           ur->cb2mllrname, kbc->mdef, kbc->config);
-        else if (kbc->ms_mgau)
-            model_set_mllr(kbc->ms_mgau, ur->regmatname, ur->cb2mllrname,
-                           kbcore_fcb(kbc), kbc->mdef, kbc->config);
-        else
-            E_WARN("Can't use MLLR matrices with .s2semi. yet\n");
+    if (nfr <= 0) {
+        feat_pool_put(feat_pool, utt->fbuf);
+        utt->fbuf = NULL;
+    }
+    else if (feat_cache_out
+             && feat_cache_put(feat_cache_out, utt->uttfile, sf, ef,
+                               utt->fbuf->feat, nfr) < 0) {
+        /* Drop the partial cache and stop writing it */
+        feat_cache_close(feat_cache_out);
+        feat_cache_out = NULL;
     }
 
-    if (nfr <= 0) {
-        if (cepdir != NULL) {
-            E_ERROR
-                ("Utt %s: Input file read (%s) with dir (%s) and extension (%s) failed \n",
-                 uttid, ur->uttfile, cepdir, cepext);
+    utt->nfr = nfr;
+    utt->seq_no = n_utt_read++;
+    sbmtx_unlock(ctl_mtx);
+
+    return TRUE;
+}
+
+static int
+align_job(align_job_t * job, cmd_ln_t *config)
+{
+    align_utt_t *utt = &job->utt;
+    const char *cepdir;
+    const char *cepext;
+    ptmr_t tm;
+
+    cepdir = cmd_ln_str_r(kbc->config, "-cepdir");
+    cepext = cmd_ln_str_r(kbc->config, "-cepext");
+    ptmr_init(&tm);
+
+    while (align_next_utt(job, config)) {
+        ptmr_reset(&tm);
+        ptmr_start(&tm);
+        utt->outsent = NULL;
+        utt->outctl = NULL;
+
+        /* Only done with a single thread, see main() */
+        if (utt->has_mllr) {
+            if (kbc->mgau)
+                adapt_set_mllr(adapt_am, kbc->mgau, utt->regmatname,
+                               utt->cb2mllrname, kbc->mdef, kbc->config);
+            else if (kbc->ms_mgau)
+                model_set_mllr(kbc->ms_mgau, utt->regmatname, utt->cb2mllrname,
+                               kbcore_fcb(kbc), kbc->mdef, kbc->config);
+            else
+                E_WARN("Can't use MLLR matrices with .s2semi. yet\n");
+        }
+
+        if (utt->nfr <= 0) {
+            if (cepdir != NULL) {
+                E_ERROR
+                    ("Utt %s: Input file read (%s) with dir (%s) and extension (%s) failed \n",
+                     utt->uttid, utt->uttfile, cepdir, cepext);
+            }
+            else {
+                E_ERROR
+                    ("Utt %s: Input file read (%s) with extension (%s) failed \n",
+                     utt->uttid, utt->uttfile, cepext);
+            }
+            write_outsent_insent_fallback(job, utt->sent, utt->uttid);
         }
         else {
-            E_ERROR
-                ("Utt %s: Input file read (%s) with extension (%s) failed \n",
-                 uttid, ur->uttfile, cepext);
+            E_INFO("%s: %d input frames\n", utt->uttid, utt->nfr);
+            align_utt(job, utt->sent, utt->nfr, utt->uttfile, utt->uttid);
         }
-        write_outsent_insent_fallback(outsentfp, sent, uttid);
-    }
-    else {
-        E_INFO("%s: %d input frames\n", uttid, nfr);
-        align_utt(sent, nfr, ur->uttfile, uttid);
+        feat_pool_put(feat_pool, utt->fbuf);
+        utt->fbuf = NULL;
+        write_utt_output(utt->seq_no, utt->outsent, utt->outctl);
+        ptmr_stop(&tm);
+
+        E_INFO
+            ("%s: %6.1f sec CPU, %6.1f sec Clk\n\n",
+             utt->uttid, tm.t_cpu, tm.t_elapsed);
     }
 
+    return 0;
+}
+
+static int
+align_worker(sbthread_t * th)
+{
+    align_job_t *job = (align_job_t *) sbthread_arg(th);
+
+    return align_job(job, kbc->config);
 }
+
 int
 main(int32 argc, char *argv[])
 {
     char sent[16384];
+    char uttfile[16384], uttid[4096];
+    int32 sf, ef;
     cmd_ln_t *config;
+    align_job_t *job;
+    sbthread_t **thread;
+    int32 n_thread, i;
+    int32 tot_nfr, n_align_outsent_fallback;
+    ptmr_t tm_run;
 
     cmd_ln_appl_enter(argc, argv, "default.arg", defn);
 
@@ -1002,7 +1262,7 @@ main(int32 argc, char *argv[])
        to solve but currently I just to remove process_ctl because it
        duplicates badly with ctl_process.  
 
-       The call back function will take care of matching the uttfile
+       The utterance reader will take care of matching the uttfile
        names. We don't need to worry too much about inconsistency. 
      */
 
@@ -1032,19 +1292,12 @@ main(int32 argc, char *argv[])
         (cmd_ln_str_r(config, "-outsent") == NULL))
         E_FATAL("Missing output file/directory argument(s)\n");
 
+    if (cmd_ln_str_r(config, "-ctl") == NULL)
+        E_FATAL(" -ctl are not specified.\n");
+
     /* Read in input databases */
     models_init(config);
 
-    if (!feat)
-        feat = feat_array_alloc(kbcore_fcb(kbc), S3_MAX_FRAMES);
-
-    timers[tmr_utt].name = "U";
-    timers[tmr_gauden].name = "G";
-    timers[tmr_senone].name = "S";
-    timers[tmr_align].name = "A";
-
-    /* Initialize align module */
-    align_init(kbc->mdef, kbc->tmat, dict, config, kbc->logmath);
     printf("\n");
 
     if (cmd_ln_str_r(config, "-mllr") != NULL) {
@@ -1058,38 +1311,109 @@ main(int32 argc, char *argv[])
             E_WARN("Can't use MLLR matrices with .s2semi. yet\n");
     }
 
-    tot_nfr = 0;
+    /* Open the control files; when -ctl_mllr is specified, each utterance
+       gets the corresponding MLLR transform */
+    if ((ctlfp = fopen(cmd_ln_str_r(config, "-ctl"), "r")) == NULL)
+        E_FATAL_SYSTEM("Failed to open file %s for reading", cmd_ln_str_r(config, "-ctl"));
+    if (cmd_ln_str_r(config, "-ctl_mllr") != NULL) {
+        if ((ctlmllrfp = fopen(cmd_ln_str_r(config, "-ctl_mllr"), "r")) == NULL)
+            E_FATAL_SYSTEM("Failed to open file %s for reading",
+                           cmd_ln_str_r(config, "-ctl_mllr"));
+    }
+    ctlcount = cmd_ln_int32_r(config, "-ctlcount");
+    for (i = cmd_ln_int32_r(config, "-ctloffset"); i > 0; --i) {
+        if (ctl_read_entry(ctlfp, uttfile, &sf, &ef, uttid) < 0) {
+            ctlcount = 0;
+            break;
+        }
+        if (ctlmllrfp
+            && ctl_read_entry(ctlmllrfp, uttfile, &sf, &ef, uttid) < 0) {
+            E_ERROR("MLLR control file is specified but MLLR cannot be read when skipping the %d-th sentence\n", i);
+            ctlcount = 0;
+            break;
+        }
+    }
 
-    /*  process_ctlfile (); */
+    /* Each thread aligns whole utterances with its own aligner and its
+       own copy of the mutable parts of the models.  Per-utterance MLLR
+       and the Sphinx-II semi-continuous models modify the shared models,
+       and Gaussian selection shares its scratch space, so they are
+       limited to one thread. */
+    n_thread = cmd_ln_int32_r(config, "-nthreads");
+    if (n_thread < 1)
+        n_thread = 1;
+    if (n_thread > 1 && (ctlmllrfp || kbc->s2_mgau || kbc->gs)) {
+        E_WARN("-nthreads %d is not supported with %s; using 1 thread\n",
+               n_thread, ctlmllrfp ? "-ctl_mllr"
+               : kbc->s2_mgau ? ".s2semi. models" : "-gs");
+        n_thread = 1;
+    }
 
-    if (cmd_ln_str_r(config, "-ctl")) {
-        /* When -ctlfile is speicified, corpus.c will look at -ctl_mllr to get
-           the corresponding  MLLR for the utterance */
-        ctl_process(cmd_ln_str_r(config, "-ctl"),
-                    NULL,
-                    cmd_ln_str_r(config, "-ctl_mllr"),
-                    cmd_ln_int32_r(config, "-ctloffset"),
-                    cmd_ln_int32_r(config, "-ctlcount"),
-                    utt_align, config);
+    /* Only the partial traceback keeps the history bounded; without
+       it, utterances stay within the usual limit */
+    max_nfr = (cmd_ln_int32_r(config, "-traceback_int") > 0)
+        ? -1 : S3_MAX_FRAMES;
+    feat_pool = feat_pool_init(kbcore_fcb(kbc), S3_MAX_FRAMES);
+    if (cmd_ln_str_r(config, "-featcache"))
+        feat_cache = feat_cache_read(cmd_ln_str_r(config, "-featcache"),
+                                     kbcore_fcb(kbc), config);
+    if (cmd_ln_str_r(config, "-featcache_out")) {
+        if ((feat_cache_out =
+             feat_cache_open(cmd_ln_str_r(config, "-featcache_out"),
+                             kbcore_fcb(kbc), config)) == NULL)
+            E_FATAL("Cannot write feature cache %s\n",
+                    cmd_ln_str_r(config, "-featcache_out"));
     }
-    else {
-        E_FATAL(" -ctl are not specified.\n");
+
+    ctl_mtx = sbmtx_init();
+    job = ckd_calloc(n_thread, sizeof(*job));
+    thread = ckd_calloc(n_thread, sizeof(*thread));
+    for (i = 0; i < n_thread; i++)
+        align_job_init(&job[i], (i == 0), config);
+
+    ptmr_init(&tm_run);
+    ptmr_start(&tm_run);
+    for (i = 1; i < n_thread; i++)
+        thread[i] = sbthread_start(align_worker, &job[i]);
+    align_job(&job[0], config);
+    tot_nfr = n_align_outsent_fallback = 0;
+    for (i = 0; i < n_thread; i++) {
+        if (i > 0)
+            sbthread_free(thread[i]);
+        tot_nfr += job[i].tot_nfr;
+        n_align_outsent_fallback += job[i].n_outsent_fallback;
     }
+    ptmr_stop(&tm_run);
 
     if (tot_nfr > 0) {
         printf("\n");
         printf("TOTAL FRAMES:       %8d\n", tot_nfr);
         printf("TOTAL CPU TIME:     %11.2f sec, %7.2f xRT\n",
-               tm_utt.t_tot_cpu, tm_utt.t_tot_cpu / (tot_nfr * 0.01));
+               tm_run.t_tot_cpu, tm_run.t_tot_cpu / (tot_nfr * 0.01));
         printf("TOTAL ELAPSED TIME: %11.2f sec, %7.2f xRT\n",
-               tm_utt.t_tot_elapsed,
-               tm_utt.t_tot_elapsed / (tot_nfr * 0.01));
+               tm_run.t_tot_elapsed,
+               tm_run.t_tot_elapsed / (tot_nfr * 0.01));
     }
 
     if (n_align_outsent_fallback > 0)
         E_INFO("Utterances with -outsent reference fallback (alignment skipped): %d\n",
                n_align_outsent_fallback);
 
+    for (i = 0; i < n_thread; i++)
+        align_job_free(&job[i]);
+    ckd_free(job);
+    feat_cache_close(feat_cache);
+    if (feat_cache_close(feat_cache_out) < 0)
+        E_ERROR("Failed to write feature cache %s\n",
+                cmd_ln_str_r(config, "-featcache_out"));
+    feat_pool_free(feat_pool);
+    ckd_free(thread);
+    sbmtx_free(ctl_mtx);
+    ckd_free(utt_output);
+
+    fclose(ctlfp);
+    if (ctlmllrfp)
+        fclose(ctlmllrfp);
     if (outsentfp)
         fclose(outsentfp);
     if (outctlfp)
@@ -1100,10 +1424,9 @@ main(int32 argc, char *argv[])
     ckd_free(s2stsegdir);
     ckd_free(stsegdir);
     ckd_free(phsegdir);
+    ckd_free(phlabdir);
     ckd_free(wdsegdir);
 
-    feat_array_free(feat);
-    align_free();
     models_free();
 
     cmd_ln_free_r(config);
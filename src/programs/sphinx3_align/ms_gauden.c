@@ -132,7 +132,6 @@ static float64 min_density;     /* Density values, once converted to (int32)logs
                                    around.  To avoid underflow, use this floor value */
 
 /*
- * FIXME: This breaks reentrancy and thread safety!
  * Temporary structure for computing density values.  The only difference between
  * this and gauden_dist_t is the use of float64 for dist.
  */
@@ -143,8 +142,8 @@ typedef struct {
     float64 dist;               /* Can probably use float32 */
 } dist_t;
 
-static dist_t *dist;
-static int32 n_dist = 0;
+/* gauden_dist() keeps up to this many distances on the stack */
+#define GAUDEN_DIST_STACK	32
 
 
 void
@@ -438,8 +437,6 @@ gauden_free(gauden_t * g)
         ckd_free_3d((void *) g->det);
     if (g->featlen)
         ckd_free(g->featlen);
-    if (dist)
-        ckd_free(dist);
     ckd_free(g);
 }
 
@@ -603,17 +600,17 @@ gauden_dist(gauden_t * g,
             s3mgauid_t mgau,
             int32 n_top, vector_t * obs, gauden_dist_t ** out_dist)
 {
+    dist_t dist_buf[GAUDEN_DIST_STACK], *dist;
     int32 f, t;
 
     assert((n_top > 0) && (n_top <= g->n_density));
 
-    /* Allocate temporary space for distance computation, if necessary */
-    if (n_dist < n_top) {
-        if (n_dist > 0)
-            ckd_free(dist);
-        n_dist = n_top;
-        dist = (dist_t *) ckd_calloc(n_dist, sizeof(dist_t));
-    }
+    /* Temporary space for distance computation; local, so that several
+     * threads may call this at once */
+    if (n_top <= GAUDEN_DIST_STACK)
+        dist = dist_buf;
+    else
+        dist = (dist_t *) ckd_calloc(n_top, sizeof(dist_t));
 
     for (f = 0; f < g->n_feat; f++) {
         compute_dist(dist, n_top,
@@ -642,6 +639,8 @@ gauden_dist(gauden_t * g,
         }
     }
 
+    if (dist != dist_buf)
+        ckd_free(dist);
     return 0;
 }
 #endif
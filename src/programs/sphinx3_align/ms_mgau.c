@@ -252,6 +252,34 @@ ms_mgau_free(ms_mgau_model_t * msg)
     ckd_free(msg);
 }
 
+ms_mgau_model_t *
+ms_mgau_clone(ms_mgau_model_t * msg)
+{
+    ms_mgau_model_t *c;
+    gauden_t *g;
+
+    g = ms_mgau_gauden(msg);
+    c = (ms_mgau_model_t *) ckd_malloc(sizeof(*c));
+    *c = *msg;
+    c->dist = (gauden_dist_t ***)
+        ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
+                      sizeof(gauden_dist_t));
+    c->mgau_active = ckd_calloc(g->n_mgau, sizeof(int8));
+
+    return c;
+}
+
+void
+ms_mgau_clone_free(ms_mgau_model_t * msg)
+{
+    if (msg == NULL)
+        return;
+
+    ckd_free_3d((void *) msg->dist);
+    ckd_free(msg->mgau_active);
+    ckd_free(msg);
+}
+
 int32
 ms_cont_mgau_frame_eval(ascr_t * ascr,
                         ms_mgau_model_t * msg,
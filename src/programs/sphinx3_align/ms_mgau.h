@@ -163,6 +163,18 @@ ms_mgau_model_t* ms_mgau_init (const char *meanfile,	/**< In: File containing me
 void ms_mgau_free(ms_mgau_model_t *g /**< In: A set of models to free */
     );
 
+/**
+ * Make a copy of g that shares its codebooks and senones but has its own
+ * scratch space, so that it can be evaluated in another thread.  Free
+ * it with ms_mgau_clone_free().
+ */
+ms_mgau_model_t *ms_mgau_clone(ms_mgau_model_t *g /**< In: The model to copy */
+    );
+
+/** Free a copy made by ms_mgau_clone() */
+void ms_mgau_clone_free(ms_mgau_model_t *g /**< In: A copy made by ms_mgau_clone() */
+    );
+
 S3DECODER_EXPORT
 int32 ms_cont_mgau_frame_eval (ascr_t *ascr,   /**< In: An ascr object*/
 			       ms_mgau_model_t *msg, /**< In: A multi-stream mgau mode */
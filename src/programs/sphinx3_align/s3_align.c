@@ -153,26 +153,28 @@ typedef struct plink_s {
 
 
 /**
- * Viterbi search history for each state at each time.
+ * Viterbi search history for each state at each time.  History nodes are
+ * allocated from a per-utterance arena and refer to states and to each other
+ * by index.  A node's predecessor always has a smaller index.
  */
 typedef struct history_s {
     int32 score;
-    struct snode_s *snode;              /** State for which this history node created */
-    struct history_s *pred;             /** Previous frame history */
-    struct history_s *alloc_next;       /** Linear list of all allocated history nodes */
+    int32 snode;                /** State (compiled DAG index) for which this node created */
+    int32 pred;                 /** Previous frame history, NO_HIST if none */
 } history_t;
-static history_t *hist_head;            /** Head of list of all history nodes */
+
+#define NO_HIST                 -1
 
 /**
- * State DAG structures similar to phone DAG structures.
+ * State DAG structures similar to phone DAG structures.  The linked form is
+ * only used while building the sentence HMM; it is then compiled into the
+ * flat arrays in align_t that the search runs on.
  */
 typedef struct snode_s {
     pnode_t *pnode;             /** Parent phone node */
     struct slink_s *succlist;   /** List of successor states */
     struct slink_s *predlist;   /** List of predecessor states */
-    int32 score, newscore;      /** Score at start, end of each frame */
-    history_t *hist, *newhist;  /** Path history at start, end of each frame */
-    int32 active_frm;           /** Frame no. most recently active */
+    int32 id;                   /** Index in the compiled DAG */
     s3senid_t sen;              /** Senone id, BAD_S3SENID if dummy node (head/tail) */
     int8 state;                 /** Local state no. (within parent HMM) */
 } snode_t;
@@ -183,43 +185,87 @@ typedef struct slink_s {
     int32 prob;
 } slink_t;
 
-static pnode_t phead, ptail;    /** Dummies at the beginning and end of the sent hmm */
-static pnode_t *pnode_list;     /** List of all dynamically allocated pnodes */
-static int32 n_pnode;           /** #pnodes allocated (used to ID each pnode) */
-
-static snode_t shead, stail;    /** State-level DAG head and tail */
-
-static dict_t *dict;            /** The dictionary */
-static mdef_t *mdef;            /** Model definition */
-static tmat_t *tmat;            /** Transition probability matrices */
-
-static s3wid_t *fillwid;        /** BAD_S3WID terminated array of optional filler basewid */
-
-static snode_t **cur_active;    /** NULL-terminated active state list for current frame */
-static snode_t **next_active;   /** Similar list for next frame */
-static int32 active_list_size = 0;
 #define ACTIVE_LIST_SIZE_INCR   16380
-static int32 n_active;
-
-static int32 curfrm;            /** Current frame */
-static int32 beam;              /** Pruning beamwidth */
-static int32 *score_scale;      /** Score by which state scores scaled in each frame */
+#define HIST_ALLOC_INIT         65536
 
-/** Lists of state, phone and word-level alignments for most recent utterance */
-static align_stseg_t *align_stseg;
-static align_phseg_t *align_phseg;
-static align_wdseg_t *align_wdseg;
+/**
+ * Aligner context.  The models are shared (read-only); everything else is
+ * private to one aligner, so several of them can run in parallel.
+ */
+struct align_s {
+    dict_t *dict;               /** The dictionary */
+    mdef_t *mdef;               /** Model definition */
+    tmat_t *tmat;               /** Transition probability matrices */
+
+    s3wid_t *fillwid;           /** BAD_S3WID terminated array of optional filler basewid */
+    int32 beam;                 /** Pruning beamwidth */
+
+    pnode_t phead, ptail;       /** Dummies at the beginning and end of the sent hmm */
+    pnode_t *pnode_list;        /** List of all dynamically allocated pnodes */
+    int32 n_pnode;              /** #pnodes allocated (used to ID each pnode) */
+
+    snode_t shead, stail;       /** State-level DAG head and tail */
+
+    /*
+     * Compiled state DAG.  Emitting states are numbered 0..n_snode-1 and shead
+     * is n_snode.  The predecessors of state s are pred_idx[pred_off[s]] ..
+     * pred_idx[pred_off[s+1]-1], with transition probs in pred_prob[], and
+     * likewise for (emitting) successors.  Links into stail are kept apart.
+     */
+    int32 n_snode;
+    pnode_t **st_pnode;         /** Parent phone node */
+    s3senid_t *st_sen;          /** Senone id */
+    int8 *st_state;             /** Local state no. (within parent HMM) */
+    int32 *st_score;            /** Score at start of each frame */
+    int32 *st_newscore;         /** Score at end of each frame */
+    int32 *st_hist;             /** Path history at start of each frame */
+    int32 *st_newhist;          /** Path history at end of each frame */
+    int32 *st_active_frm;       /** Frame no. most recently active */
+    int32 *pred_off, *pred_idx, *pred_prob;
+    int32 *succ_off, *succ_idx;
+    int32 n_pred_alloc, n_succ_alloc;
+    int32 *tail_pred, *tail_prob;
+    int32 n_tail, n_tail_alloc;
+
+    int32 *cur_active;          /** Active states for current frame */
+    int32 *next_active;         /** Similar list for next frame */
+    int32 active_list_size;     /** Allocated size of all the per-state arrays */
+    int32 n_cur_active;
+    int32 n_active;
+
+    history_t *hist;            /** History arena for the current utterance */
+    int32 n_hist, n_hist_alloc;
+    int32 *hist_cnt;            /** Scratch for commit_history(), n_hist_alloc entries */
+    int32 traceback_int;        /** Frames between commit_history() calls, 0 to never call it */
+
+    /**
+     * Best path so far, one state per frame: the prefix shared by all active
+     * states, moved out of the history arena by commit_history(), and at the
+     * end of the utterance the whole path.
+     */
+    int32 *path_snode;
+    int32 *path_score;
+    int32 n_path, n_path_alloc;
+    int32 curfrm;               /** Current frame */
+    int32 *score_scale;         /** Score by which state scores scaled in each frame */
+    int32 n_score_scale_alloc;
+
+    /** Lists of state, phone and word-level alignments for most recent utterance */
+    align_stseg_t *align_stseg;
+    align_phseg_t *align_phseg;
+    align_wdseg_t *align_wdseg;
+};
 
 /** Free all allocated pnodes */
 static void
-pnodes_free(void)
+pnodes_free(align_t * al)
 {
     pnode_t *p;
 
-    while (pnode_list) {
-        p = pnode_list->alloc_next;
-        ckd_free((char *) pnode_list);
-        pnode_list = p;
+    while (al->pnode_list) {
+        p = al->pnode_list->alloc_next;
+        ckd_free((char *) al->pnode_list);
+        al->pnode_list = p;
     }
 }
 
@@ -254,11 +300,11 @@ append_pnode(plink_t * list, pnode_t * node)
 
 
 /**
- * Allocate a pnode with the given attributes and automatically link it to the global
+ * Allocate a pnode with the given attributes and automatically link it to the aligner's
  * list.  Return the allocated node pointer.
  */
 static pnode_t *
-alloc_pnode(s3wid_t w, int32 pos,
+alloc_pnode(align_t * al, s3wid_t w, int32 pos,
             s3cipid_t ci, s3cipid_t lc, s3cipid_t rc, word_posn_t wpos)
 {
     pnode_t *p;
@@ -270,18 +316,18 @@ alloc_pnode(s3wid_t w, int32 pos,
     p->rc = rc;
     p->pos = pos;
 
-    p->pid = mdef_phone_id_nearest(mdef, ci, lc, rc, wpos);
+    p->pid = mdef_phone_id_nearest(al->mdef, ci, lc, rc, wpos);
 
     p->succlist = NULL;
     p->predlist = NULL;
     p->next = NULL;
 
-    p->id = n_pnode++;
+    p->id = al->n_pnode++;
 
     p->startstate = NULL;
 
-    p->alloc_next = pnode_list;
-    pnode_list = p;
+    p->alloc_next = al->pnode_list;
+    al->pnode_list = p;
 
     return p;
 }
@@ -305,7 +351,7 @@ link_pnodes(pnode_t * src, pnode_t * dst)
  * Return a list of the final HMM nodes for the single word appended.
  */
 static pnode_t *
-append_word(s3wid_t w,
+append_word(align_t * al, s3wid_t w,
             pnode_t * prev_end, s3cipid_t * pred_ci, s3cipid_t * succ_ci)
 {
     int32 i, M, N, m, n, pronlen, pron;
@@ -317,14 +363,14 @@ append_word(s3wid_t w,
     for (i = 0; IS_S3CIPID(succ_ci[i]); i++);
     N = (i > 0) ? i : 1;        /* #successor CI phones */
 
-    if ((pronlen = dict->word[w].pronlen) == 1) {
+    if ((pronlen = al->dict->word[w].pronlen) == 1) {
         /* Single phone case; replicated MxN times for all possible contexts */
         nodelist = NULL;
 
         for (m = 0; m < M; m++) {
             for (n = 0; n < N; n++) {
-                node = alloc_pnode(w, 0,
-                                   dict->word[w].ciphone[0], pred_ci[m],
+                node = alloc_pnode(al, w, 0,
+                                   al->dict->word[w].ciphone[0], pred_ci[m],
                                    succ_ci[n], WORD_POSN_SINGLE);
                 /* Link to all predecessor nodes matching context requirements */
                 for (p = prev_end; p; p = p->next) {
@@ -345,10 +391,10 @@ append_word(s3wid_t w,
     /* Multi-phone case.  First phone, replicated M times */
     nodelist = NULL;
     for (m = 0; m < M; m++) {
-        node = alloc_pnode(w, 0,
-                           dict->word[w].ciphone[0],
+        node = alloc_pnode(al, w, 0,
+                           al->dict->word[w].ciphone[0],
                            pred_ci[m],
-                           dict->word[w].ciphone[1], WORD_POSN_BEGIN);
+                           al->dict->word[w].ciphone[1], WORD_POSN_BEGIN);
         /* Link to predecessor node(s) matching context requirements */
         for (p = prev_end; p; p = p->next) {
             if ((p->ci == node->lc) &&
@@ -362,10 +408,10 @@ append_word(s3wid_t w,
 
     /* Intermediate phones */
     for (pron = 1; pron < pronlen - 1; pron++) {
-        node = alloc_pnode(w, pron,
-                           dict->word[w].ciphone[pron],
-                           dict->word[w].ciphone[pron - 1],
-                           dict->word[w].ciphone[pron + 1],
+        node = alloc_pnode(al, w, pron,
+                           al->dict->word[w].ciphone[pron],
+                           al->dict->word[w].ciphone[pron - 1],
+                           al->dict->word[w].ciphone[pron + 1],
                            WORD_POSN_INTERNAL);
         for (p = nodelist; p; p = p->next)
             link_pnodes(p, node);
@@ -376,9 +422,9 @@ append_word(s3wid_t w,
     prev_end = nodelist;
     nodelist = NULL;
     for (n = 0; n < N; n++) {
-        node = alloc_pnode(w, pron,
-                           dict->word[w].ciphone[pron],
-                           dict->word[w].ciphone[pron - 1],
+        node = alloc_pnode(al, w, pron,
+                           al->dict->word[w].ciphone[pron],
+                           al->dict->word[w].ciphone[pron - 1],
                            succ_ci[n], WORD_POSN_END);
         for (p = prev_end; p; p = p->next)
             link_pnodes(p, node);
@@ -391,12 +437,12 @@ append_word(s3wid_t w,
 
 
 static void
-build_pred_ci(pnode_t * nodelist, s3cipid_t * pred_ci)
+build_pred_ci(align_t * al, pnode_t * nodelist, s3cipid_t * pred_ci)
 {
     int32 i, p;
     pnode_t *node;
 
-    for (p = 0; p < mdef->n_ciphone; p++)
+    for (p = 0; p < al->mdef->n_ciphone; p++)
         pred_ci[p] = 0;
 
     for (node = nodelist; node; node = node->next)
@@ -404,7 +450,7 @@ build_pred_ci(pnode_t * nodelist, s3cipid_t * pred_ci)
             pred_ci[(unsigned) node->ci] = 1;
 
     i = 0;
-    for (p = 0; p < mdef->n_ciphone; p++) {
+    for (p = 0; p < al->mdef->n_ciphone; p++) {
         if (pred_ci[p])
             pred_ci[i++] = p;
     }
@@ -413,24 +459,24 @@ build_pred_ci(pnode_t * nodelist, s3cipid_t * pred_ci)
 
 
 static void
-build_succ_ci(s3wid_t w, int32 append_filler, s3cipid_t * succ_ci)
+build_succ_ci(align_t * al, s3wid_t w, int32 append_filler, s3cipid_t * succ_ci)
 {
     int32 i, p;
 
-    for (p = 0; p < mdef->n_ciphone; p++)
+    for (p = 0; p < al->mdef->n_ciphone; p++)
         succ_ci[p] = 0;
 
-    for (; IS_S3WID(w); w = dict->word[w].alt)
-        succ_ci[(unsigned) dict->word[w].ciphone[0]] = 1;
+    for (; IS_S3WID(w); w = al->dict->word[w].alt)
+        succ_ci[(unsigned) al->dict->word[w].ciphone[0]] = 1;
 
     if (append_filler) {
-        for (i = 0; IS_S3WID(fillwid[i]); i++)
-            for (w = fillwid[i]; IS_S3WID(w); w = dict->word[w].alt)
-                succ_ci[(unsigned) dict->word[w].ciphone[0]] = 1;
+        for (i = 0; IS_S3WID(al->fillwid[i]); i++)
+            for (w = al->fillwid[i]; IS_S3WID(w); w = al->dict->word[w].alt)
+                succ_ci[(unsigned) al->dict->word[w].ciphone[0]] = 1;
     }
 
     i = 0;
-    for (p = 0; p < mdef->n_ciphone; p++) {
+    for (p = 0; p < al->mdef->n_ciphone; p++) {
         if (succ_ci[p])
             succ_ci[i++] = p;
     }
@@ -447,7 +493,7 @@ build_succ_ci(s3wid_t w, int32 append_filler, s3cipid_t * succ_ci)
  * the global node list.)
  */
 static pnode_t *
-append_transcript_word(s3wid_t w,
+append_transcript_word(align_t * al, s3wid_t w,
                                 /** Transcript word to be appended */
                        pnode_t * prev_end,
                                 /** Previous end points to be attached to w */
@@ -463,21 +509,21 @@ append_transcript_word(s3wid_t w,
     s3cipid_t pred_ci[256], succ_ci[256];
     s3wid_t fw;
 
-    if (mdef->n_ciphone >= 256)
+    if (al->mdef->n_ciphone >= 256)
         E_FATAL
             ("Increase pred_ci, succ_ci array sizes to > #CIphones (%d)\n",
-             mdef->n_ciphone);
+             al->mdef->n_ciphone);
     assert(prev_end != NULL);
 
     /* Add optional silence/filler words before w, if indicated */
     if (prefix_filler) {
-        build_pred_ci(prev_end, pred_ci);       /* Predecessor CI list for fillers */
-        build_succ_ci(w, 0, succ_ci);   /* Successor CI list for fillers */
+        build_pred_ci(al, prev_end, pred_ci);       /* Predecessor CI list for fillers */
+        build_succ_ci(al, w, 0, succ_ci);   /* Successor CI list for fillers */
 
         new_end = NULL;
-        for (i = 0; IS_S3WID(fillwid[i]); i++) {
-            for (fw = fillwid[i]; IS_S3WID(fw); fw = dict->word[fw].alt) {
-                tmp_end = append_word(fw, prev_end, pred_ci, succ_ci);
+        for (i = 0; IS_S3WID(al->fillwid[i]); i++) {
+            for (fw = al->fillwid[i]; IS_S3WID(fw); fw = al->dict->word[fw].alt) {
+                tmp_end = append_word(al, fw, prev_end, pred_ci, succ_ci);
 
                 for (node = tmp_end; node->next; node = node->next);
                 node->next = new_end;
@@ -491,12 +537,12 @@ append_transcript_word(s3wid_t w,
     }
 
     /* Add w */
-    build_pred_ci(prev_end, pred_ci);   /* Predecessor CI list for w */
-    build_succ_ci(nextw, append_filler, succ_ci);       /* Successor CI list for w */
+    build_pred_ci(al, prev_end, pred_ci);   /* Predecessor CI list for w */
+    build_succ_ci(al, nextw, append_filler, succ_ci);       /* Successor CI list for w */
 
     new_end = NULL;
-    for (; IS_S3WID(w); w = dict->word[w].alt) {
-        tmp_end = append_word(w, prev_end, pred_ci, succ_ci);
+    for (; IS_S3WID(w); w = al->dict->word[w].alt) {
+        tmp_end = append_word(al, w, prev_end, pred_ci, succ_ci);
 
         for (node = tmp_end; node->next; node = node->next);
         node->next = new_end;
@@ -510,50 +556,50 @@ append_transcript_word(s3wid_t w,
 #if _DEBUG_ALIGN_
 
 static void
-dump_pnode_info(pnode_t * p)
+dump_pnode_info(align_t * al, pnode_t * p)
 {
     if (NOT_S3WID(p->wid))
         printf("%s", (p->id == -1) ? "<head>" : "<tail>");
     else
         printf("%s.%d.",
-               dict_wordstr(p->wid), p->pos, mdef_ciphone_str(mdef,
+               dict_wordstr(p->wid), p->pos, mdef_ciphone_str(al->mdef,
                                                               p->ci));
-    printf("%s", IS_CIPID(p->lc) ? mdef_ciphone_str(mdef, p->lc) : "-");
-    printf("(%s)", IS_CIPID(p->ci) ? mdef_ciphone_str(mdef, p->ci) : "-");
-    printf("%s", IS_CIPID(p->rc) ? mdef_ciphone_str(mdef, p->rc) : "-");
+    printf("%s", IS_CIPID(p->lc) ? mdef_ciphone_str(al->mdef, p->lc) : "-");
+    printf("(%s)", IS_CIPID(p->ci) ? mdef_ciphone_str(al->mdef, p->ci) : "-");
+    printf("%s", IS_CIPID(p->rc) ? mdef_ciphone_str(al->mdef, p->rc) : "-");
 }
 
 
 static void
-dump_pnode_succ_dag(pnode_t * p)
+dump_pnode_succ_dag(align_t * al, pnode_t * p)
 {
     plink_t *l;
 
     for (l = p->succlist; l; l = l->next) {
-        dump_pnode_info(p);
+        dump_pnode_info(al, p);
         printf("\t\t");
-        dump_pnode_info(l->node);
+        dump_pnode_info(al, l->node);
         printf(";\n");
     }
 }
 
 
 static void
-dump_pnode_succ(pnode_t * p)
+dump_pnode_succ(align_t * al, pnode_t * p)
 {
     plink_t *l;
 
     printf("  %5d", p->id);
     if (IS_S3WID(p->wid))
         printf(" %20s %02d %6d %4s",
-               dict_wordstr(p->wid), p->pos, p->pid, mdef_ciphone_str(mdef,
+               dict_wordstr(p->wid), p->pos, p->pid, mdef_ciphone_str(al->mdef,
                                                                       p->
                                                                       ci));
     else
-        printf(" %20s %02d %6d %4s", "<phead>", 0, BAD_S3PID, "");
+        printf(" %20s %02d %6d %4s", "<al->phead>", 0, BAD_S3PID, "");
     printf(" %4s %4s",
-           IS_CIPID(p->lc) ? mdef_ciphone_str(mdef, p->lc) : "-",
-           IS_CIPID(p->rc) ? mdef_ciphone_str(mdef, p->rc) : "-");
+           IS_CIPID(p->lc) ? mdef_ciphone_str(al->mdef, p->lc) : "-",
+           IS_CIPID(p->rc) ? mdef_ciphone_str(al->mdef, p->rc) : "-");
     printf("\t");
 
     for (l = p->succlist; l; l = l->next)
@@ -564,21 +610,21 @@ dump_pnode_succ(pnode_t * p)
 
 
 static void
-dump_pdag(void)
+dump_pdag(align_t * al)
 {
     pnode_t *p;
 
     printf("SUCCESSOR LIST (DAG format):\n");
     printf(".GS 5 5 fill\n");
-    dump_pnode_succ_dag(&phead);
-    for (p = pnode_list; p; p = p->alloc_next)
-        dump_pnode_succ_dag(p);
+    dump_pnode_succ_dag(al, &al->phead);
+    for (p = al->pnode_list; p; p = p->alloc_next)
+        dump_pnode_succ_dag(al, p);
     printf(".GE\n");
 
     printf("SUCCESSOR LIST:\n");
-    dump_pnode_succ(&phead);
-    for (p = pnode_list; p; p = p->alloc_next)
-        dump_pnode_succ(p);
+    dump_pnode_succ(al, &al->phead);
+    for (p = al->pnode_list; p; p = p->alloc_next)
+        dump_pnode_succ(al, p);
 }
 
 #endif
@@ -657,7 +703,7 @@ slinks_free(slink_t * l)
  * searched.
  */
 static int32
-build_state_dag(void)
+build_state_dag(align_t * al)
 {
     pnode_t *p;
     plink_t *pl;
@@ -667,10 +713,10 @@ build_state_dag(void)
     int32 i, j;
     int32 **tp, prob;
 
-    n_state = mdef->n_emit_state + 1;
+    n_state = al->mdef->n_emit_state + 1;
     final_state = n_state - 1;
 
-    for (p = pnode_list; p; p = p->alloc_next) {
+    for (p = al->pnode_list; p; p = p->alloc_next) {
         /* Allocate states for p */
         s = (snode_t *) ckd_calloc(n_state, sizeof(snode_t));
         p->startstate = s;
@@ -679,16 +725,14 @@ build_state_dag(void)
             s[i].pnode = p;
             s[i].succlist = NULL;
             s[i].predlist = NULL;
-            s[i].score = S3_LOGPROB_ZERO;
-            s[i].hist = NULL;
-            s[i].active_frm = -1;
+            s[i].id = -1;
             /* s[i].sen = mdef->phone[p->pid].state[i]; */
-            s[i].sen = mdef->sseq[mdef->phone[p->pid].ssid][i];
+            s[i].sen = al->mdef->sseq[al->mdef->phone[p->pid].ssid][i];
             s[i].state = i;
         }
 
         /* Create transitions between states */
-        tp = tmat->tp[mdef->phone[p->pid].tmat];
+        tp = al->tmat->tp[al->mdef->phone[p->pid].tmat];
         for (i = 0; i < final_state; i++) {     /* #from states excludes final state */
             for (j = 0; j < n_state; j++) {
                 if (tp[i][j] > S3_LOGPROB_ZERO) /* Link from i to j */
@@ -698,13 +742,13 @@ build_state_dag(void)
     }
 
     /* Eliminate non-emitting nodes (final states of HMMs) from state DAG structure */
-    for (p = pnode_list; p; p = p->alloc_next) {
+    for (p = al->pnode_list; p; p = p->alloc_next) {
         fs = p->startstate + final_state;
         assert(!fs->succlist);
 
         /*
          * Link predecessor states of fs to start states of followers of parent pnode
-         * with the appropriate prob.  (Avoid linking to the dummy node ptail).
+         * with the appropriate prob.  (Avoid linking to the dummy node al->ptail).
          */
         for (sl = fs->predlist; sl; sl = sl->next) {
             /* Unlink successor link between this predecessor and final state */
@@ -715,7 +759,7 @@ build_state_dag(void)
                 if (pl->node->startstate)
                     link_snodes(sl->node, pl->node->startstate, prob);
                 else
-                    link_snodes(sl->node, &stail, prob);
+                    link_snodes(sl->node, &al->stail, prob);
             }
         }
 
@@ -724,23 +768,23 @@ build_state_dag(void)
     }
 
     /* Link shead to initial states */
-    for (pl = phead.succlist; pl; pl = pl->next)
-        link_snodes(&shead, pl->node->startstate, 0);
+    for (pl = al->phead.succlist; pl; pl = pl->next)
+        link_snodes(&al->shead, pl->node->startstate, 0);
 
     return 0;
 }
 
 
 static void
-destroy_state_dag(void)
+destroy_state_dag(align_t * al)
 {
     pnode_t *p;
     snode_t *s;
     int32 i, n_state;
 
-    n_state = mdef->n_emit_state + 1;
+    n_state = al->mdef->n_emit_state + 1;
 
-    for (p = pnode_list; p; p = p->alloc_next) {
+    for (p = al->pnode_list; p; p = p->alloc_next) {
         if ((s = p->startstate) != NULL) {      /* Maybe NULL if state dag not built */
             for (i = 0; i < n_state; i++) {
                 slinks_free(s[i].succlist);
@@ -752,15 +796,135 @@ destroy_state_dag(void)
         }
     }
 
-    slinks_free(shead.succlist);
-    slinks_free(stail.predlist);
+    slinks_free(al->shead.succlist);
+    slinks_free(al->stail.predlist);
+    al->shead.succlist = NULL;
+    al->stail.predlist = NULL;
+}
+
+
+/**
+ * Compile the linked state DAG into the flat arrays in al, in which the
+ * search touches only contiguous memory.  Links keep their list order, so
+ * that ties are broken the same way as in the linked form.
+ */
+static void
+compile_state_dag(align_t * al)
+{
+    pnode_t *p;
+    snode_t *s;
+    slink_t *l;
+    int32 i, n, n_emit, n_pred, n_succ, e;
+
+    n_emit = al->mdef->n_emit_state;
+    n = al->n_pnode * n_emit;
+
+    /* Number the emitting states and count links */
+    n_pred = n_succ = 0;
+    i = 0;
+    for (p = al->pnode_list; p; p = p->alloc_next) {
+        for (s = p->startstate; s < p->startstate + n_emit; s++) {
+            s->id = i++;
+            for (l = s->predlist; l; l = l->next)
+                n_pred++;
+            for (l = s->succlist; l; l = l->next)
+                n_succ++;
+        }
+    }
+    assert(i == n);
+    al->shead.id = n;
+    for (l = al->shead.succlist; l; l = l->next)
+        n_succ++;
+    al->n_snode = n;
+
+    if (n + 1 > al->active_list_size) {
+        for (; al->active_list_size <= n + 1;
+             al->active_list_size += ACTIVE_LIST_SIZE_INCR);
+        i = al->active_list_size;
+        al->st_pnode = ckd_realloc(al->st_pnode, i * sizeof(pnode_t *));
+        al->st_sen = ckd_realloc(al->st_sen, i * sizeof(s3senid_t));
+        al->st_state = ckd_realloc(al->st_state, i * sizeof(int8));
+        al->st_score = ckd_realloc(al->st_score, i * sizeof(int32));
+        al->st_newscore = ckd_realloc(al->st_newscore, i * sizeof(int32));
+        al->st_hist = ckd_realloc(al->st_hist, i * sizeof(int32));
+        al->st_newhist = ckd_realloc(al->st_newhist, i * sizeof(int32));
+        al->st_active_frm = ckd_realloc(al->st_active_frm, i * sizeof(int32));
+        al->pred_off = ckd_realloc(al->pred_off, (i + 1) * sizeof(int32));
+        al->succ_off = ckd_realloc(al->succ_off, (i + 1) * sizeof(int32));
+        al->cur_active = ckd_realloc(al->cur_active, i * sizeof(int32));
+        al->next_active = ckd_realloc(al->next_active, i * sizeof(int32));
+    }
+    if (n_pred > al->n_pred_alloc) {
+        al->n_pred_alloc = n_pred;
+        al->pred_idx = ckd_realloc(al->pred_idx, n_pred * sizeof(int32));
+        al->pred_prob = ckd_realloc(al->pred_prob, n_pred * sizeof(int32));
+    }
+    if (n_succ > al->n_succ_alloc) {
+        al->n_succ_alloc = n_succ;
+        al->succ_idx = ckd_realloc(al->succ_idx, n_succ * sizeof(int32));
+    }
+
+    /* Per-state attributes and links, in state number order */
+    n_pred = n_succ = 0;
+    for (p = al->pnode_list; p; p = p->alloc_next) {
+        for (s = p->startstate; s < p->startstate + n_emit; s++) {
+            i = s->id;
+            al->st_pnode[i] = p;
+            al->st_sen[i] = s->sen;
+            al->st_state[i] = s->state;
+            al->st_score[i] = S3_LOGPROB_ZERO;
+            al->st_hist[i] = NO_HIST;
+            al->st_active_frm[i] = -1;
+
+            al->pred_off[i] = n_pred;
+            for (l = s->predlist; l; l = l->next) {
+                assert(l->node->id >= 0);
+                al->pred_idx[n_pred] = l->node->id;
+                al->pred_prob[n_pred++] = l->prob;
+            }
+            al->succ_off[i] = n_succ;
+            for (l = s->succlist; l; l = l->next) {
+                /* Only emitting successors get activated */
+                if (IS_S3SENID(l->node->sen))
+                    al->succ_idx[n_succ++] = l->node->id;
+            }
+        }
+    }
+
+    /* shead: no predecessors; its successors are the initial states */
+    al->st_pnode[n] = &al->phead;
+    al->st_sen[n] = BAD_S3SENID;
+    al->st_state[n] = al->shead.state;
+    al->st_score[n] = S3_LOGPROB_ZERO;
+    al->st_hist[n] = NO_HIST;
+    al->st_active_frm[n] = -1;
+    al->pred_off[n] = n_pred;
+    al->succ_off[n] = n_succ;
+    for (l = al->shead.succlist; l; l = l->next)
+        al->succ_idx[n_succ++] = l->node->id;
+    al->pred_off[n + 1] = n_pred;
+    al->succ_off[n + 1] = n_succ;
+
+    /* Links into stail, for the final traceback */
+    for (e = 0, l = al->stail.predlist; l; l = l->next)
+        e++;
+    if (e > al->n_tail_alloc) {
+        al->n_tail_alloc = e;
+        al->tail_pred = ckd_realloc(al->tail_pred, e * sizeof(int32));
+        al->tail_prob = ckd_realloc(al->tail_prob, e * sizeof(int32));
+    }
+    for (e = 0, l = al->stail.predlist; l; l = l->next, e++) {
+        al->tail_pred[e] = l->node->id;
+        al->tail_prob[e] = l->prob;
+    }
+    al->n_tail = e;
 }
 
 
 #if _DEBUG_ALIGN_
 
 static void
-dump_snode_succ(snode_t * s)
+dump_snode_succ(align_t * al, snode_t * s)
 {
     slink_t *l;
     pnode_t *p;
@@ -775,28 +939,28 @@ dump_snode_succ(snode_t * s)
 
 
 static void
-dump_sdag(void)
+dump_sdag(align_t * al)
 {
     pnode_t *p;
     snode_t *s;
     int32 i;
 
     printf("STATE DAG:\n");
-    for (p = pnode_list; p; p = p->alloc_next) {
+    for (p = al->pnode_list; p; p = p->alloc_next) {
         s = p->startstate;
-        for (i = 0; i <= mdef->n_emit_state; i++)
-            dump_snode_succ(s + i);
+        for (i = 0; i <= al->mdef->n_emit_state; i++)
+            dump_snode_succ(al, s + i);
     }
 }
 
 
 static void
-dump_sent_hmm(void)
+dump_sent_hmm(align_t * al)
 {
-    dump_pdag();
-    dump_sdag();
-    E_INFO("%d pnodes, %d snodes\n", n_pnode,
-           n_pnode * mdef->n_emit_state);
+    dump_pdag(al);
+    dump_sdag(al);
+    E_INFO("%d pnodes, %d snodes\n", al->n_pnode,
+           al->n_pnode * al->mdef->n_emit_state);
 }
 
 #endif
@@ -816,7 +980,7 @@ dump_sent_hmm(void)
  * Return 0 if successful, \<0 if any error (eg, OOV word encountered).
  */
 int32
-align_build_sent_hmm(char *wordstr, int insert_sil)
+align_build_sent_hmm(align_t * al, char *wordstr, int insert_sil)
 {
     s3wid_t w, nextw;
     int32 k, oov;
@@ -824,63 +988,63 @@ align_build_sent_hmm(char *wordstr, int insert_sil)
     char *wd, delim, *wdcopy = NULL;
 
     /* Initialize dummy head and tail entries of sent hmm */
-    phead.wid = BAD_S3WID;
-    phead.ci = BAD_S3CIPID;
-    phead.lc = BAD_S3CIPID;     /* No predecessor */
-    phead.rc = BAD_S3CIPID;     /* Any phone can follow head */
-    phead.pid = BAD_S3PID;
-    phead.succlist = NULL;
-    phead.predlist = NULL;
-    phead.next = NULL;          /* Will ultimately be the head of list of all pnodes */
-    phead.id = -1;              /* Hardwired */
-    phead.startstate = NULL;
-
-    ptail.wid = BAD_S3WID;
-    ptail.ci = BAD_S3CIPID;
-    ptail.lc = BAD_S3CIPID;     /* Any phone can precede tail */
-    ptail.rc = BAD_S3CIPID;     /* No successor */
-    ptail.pid = BAD_S3PID;
-    ptail.succlist = NULL;
-    ptail.predlist = NULL;
-    ptail.next = NULL;
-    ptail.id = -2;              /* Hardwired */
-    ptail.startstate = NULL;
-
-    n_pnode = 0;
-    pnode_list = NULL;
+    al->phead.wid = BAD_S3WID;
+    al->phead.ci = BAD_S3CIPID;
+    al->phead.lc = BAD_S3CIPID;     /* No predecessor */
+    al->phead.rc = BAD_S3CIPID;     /* Any phone can follow head */
+    al->phead.pid = BAD_S3PID;
+    al->phead.succlist = NULL;
+    al->phead.predlist = NULL;
+    al->phead.next = NULL;          /* Will ultimately be the head of list of all pnodes */
+    al->phead.id = -1;              /* Hardwired */
+    al->phead.startstate = NULL;
+
+    al->ptail.wid = BAD_S3WID;
+    al->ptail.ci = BAD_S3CIPID;
+    al->ptail.lc = BAD_S3CIPID;     /* Any phone can precede tail */
+    al->ptail.rc = BAD_S3CIPID;     /* No successor */
+    al->ptail.pid = BAD_S3PID;
+    al->ptail.succlist = NULL;
+    al->ptail.predlist = NULL;
+    al->ptail.next = NULL;
+    al->ptail.id = -2;              /* Hardwired */
+    al->ptail.startstate = NULL;
+
+    al->n_pnode = 0;
+    al->pnode_list = NULL;
     oov = 0;
 
     /* State-level DAG initialization should be here in case the build is aborted */
-    shead.pnode = &phead;
-    shead.succlist = NULL;
-    shead.predlist = NULL;
-    shead.sen = BAD_S3SENID;
-    shead.state = mdef->n_emit_state;
-    shead.hist = NULL;
-
-    stail.pnode = &ptail;
-    stail.succlist = NULL;
-    stail.predlist = NULL;
-    stail.sen = BAD_S3SENID;
-    stail.state = 0;
-    stail.hist = NULL;
+    al->shead.pnode = &al->phead;
+    al->shead.succlist = NULL;
+    al->shead.predlist = NULL;
+    al->shead.sen = BAD_S3SENID;
+    al->shead.state = al->mdef->n_emit_state;
+    al->shead.id = -1;
+
+    al->stail.pnode = &al->ptail;
+    al->stail.succlist = NULL;
+    al->stail.predlist = NULL;
+    al->stail.sen = BAD_S3SENID;
+    al->stail.state = 0;
+    al->stail.id = -1;
 
     /* Obtain the first transcript word */
     k = nextword(wordstr, " \t\n", &wd, &delim);
     if (k < 0)
-        nextw = dict->finishwid;
+        nextw = al->dict->finishwid;
     else {
         wordstr = wd + k;
         wdcopy = ckd_salloc(wd);
         *wordstr = delim;
-        nextw = dict_wordid(dict, wdcopy);
+        nextw = dict_wordid(al->dict, wdcopy);
         if (IS_S3WID(nextw))
-            nextw = dict_basewid(dict, nextw);
+            nextw = dict_basewid(al->dict, nextw);
     }
 
     /* Create node(s) for <s> before any transcript word */
     word_end =
-        append_transcript_word(dict->startwid, &phead, nextw, 0,
+        append_transcript_word(al, al->dict->startwid, &al->phead, nextw, 0,
                                insert_sil);
 
     /* Append each word in transcription to partial sent HMM created so far */
@@ -890,24 +1054,24 @@ align_build_sent_hmm(char *wordstr, int insert_sil)
             E_ERROR("%s not in dictionary\n", wdcopy);
             oov = 1;
             /* Hack!! Temporarily set w to some dummy just to run through sentence */
-            w = dict->finishwid;
+            w = al->dict->finishwid;
         }
         ckd_free(wdcopy);
 
         k = nextword(wordstr, " \t\n", &wd, &delim);
         if (k < 0)
-            nextw = dict->finishwid;
+            nextw = al->dict->finishwid;
         else {
             wordstr = wd + k;
             wdcopy = ckd_salloc(wd);
             *wordstr = delim;
-            nextw = dict_wordid(dict, wdcopy);
+            nextw = dict_wordid(al->dict, wdcopy);
             if (IS_S3WID(nextw))
-                nextw = dict_basewid(dict, nextw);
+                nextw = dict_basewid(al->dict, nextw);
         }
 
         word_end =
-            append_transcript_word(w, word_end, nextw, insert_sil,
+            append_transcript_word(al, w, word_end, nextw, insert_sil,
                                    insert_sil);
     }
     if (oov)
@@ -915,86 +1079,199 @@ align_build_sent_hmm(char *wordstr, int insert_sil)
 
     /* Append phone HMMs for </s> at the end; link to tail node */
     word_end =
-        append_transcript_word(dict->finishwid, word_end, BAD_S3WID,
+        append_transcript_word(al, al->dict->finishwid, word_end, BAD_S3WID,
                                insert_sil, 0);
     for (node = word_end; node; node = node->next)
-        link_pnodes(node, &ptail);
+        link_pnodes(node, &al->ptail);
 
     /* Build state-level DAG from the phone-level one */
-    build_state_dag();
+    build_state_dag(al);
     /* Dag must begin and end at shead and stail, respectively */
-    assert(shead.succlist);
-    assert(stail.predlist);
-    assert(!shead.predlist);
-    assert(!stail.succlist);
+    assert(al->shead.succlist);
+    assert(al->stail.predlist);
+    assert(!al->shead.predlist);
+    assert(!al->stail.succlist);
 
 #if _DEBUG_ALIGN_
-    dump_sent_hmm();            /* For debugging */
+    dump_sent_hmm(al);            /* For debugging */
 #endif
 
-    k = n_pnode * mdef->n_emit_state;
-    if (k > active_list_size) { /* Need to grow active list arrays */
-        if (active_list_size > 0) {
-            ckd_free(cur_active);
-            ckd_free(next_active);
-        }
-        for (; active_list_size <= k;
-             active_list_size += ACTIVE_LIST_SIZE_INCR);
-        cur_active =
-            (snode_t **) ckd_calloc(active_list_size, sizeof(snode_t *));
-        next_active =
-            (snode_t **) ckd_calloc(active_list_size, sizeof(snode_t *));
-    }
+    /* Search on the compiled form; the linked one is no longer needed */
+    compile_state_dag(al);
+    destroy_state_dag(al);
 
     return 0;
 }
 
 
 int32
-align_destroy_sent_hmm(void)
+align_destroy_sent_hmm(align_t * al)
 {
     pnode_t *p;
 
-    destroy_state_dag();
+    destroy_state_dag(al);
+    al->n_snode = 0;
 
-    for (p = pnode_list; p; p = p->alloc_next) {
+    for (p = al->pnode_list; p; p = p->alloc_next) {
         plinks_free(p->succlist);
         plinks_free(p->predlist);
     }
-    pnodes_free();
+    pnodes_free(al);
 
-    plinks_free(phead.succlist);
-    plinks_free(ptail.predlist);
+    plinks_free(al->phead.succlist);
+    plinks_free(al->ptail.predlist);
 
     return 0;
 }
 
 
-static history_t *
-lat_entry(snode_t * s)
+static int32
+lat_entry(align_t * al, int32 s)
 {
     history_t *h;
 
-    h = (history_t *) ckd_calloc(1, sizeof(*h));
+    if (al->n_hist == al->n_hist_alloc) {
+        al->n_hist_alloc =
+            (al->n_hist_alloc > 0) ? al->n_hist_alloc * 2 : HIST_ALLOC_INIT;
+        al->hist = (history_t *) ckd_realloc(al->hist,
+                                             al->n_hist_alloc *
+                                             sizeof(history_t));
+        al->hist_cnt = (int32 *) ckd_realloc(al->hist_cnt,
+                                             al->n_hist_alloc *
+                                             sizeof(int32));
+    }
+
+    h = al->hist + al->n_hist;
     h->snode = s;
-    h->score = s->newscore;
-    h->pred = s->newhist;
+    h->score = al->st_newscore[s];
+    h->pred = al->st_newhist[s];
+
+    return al->n_hist++;
+}
+
+
+/** Make room for n entries in the best path */
+static void
+grow_path(align_t * al, int32 n)
+{
+    if (n > al->n_path_alloc) {
+        while (al->n_path_alloc < n)
+            al->n_path_alloc =
+                (al->n_path_alloc > 0) ? al->n_path_alloc * 2 : 1024;
+        al->path_snode = (int32 *) ckd_realloc(al->path_snode,
+                                               al->n_path_alloc *
+                                               sizeof(int32));
+        al->path_score = (int32 *) ckd_realloc(al->path_score,
+                                               al->n_path_alloc *
+                                               sizeof(int32));
+    }
+}
+
+/** Make room for the score scale of frame n-1 */
+static void
+grow_score_scale(align_t * al, int32 n)
+{
+    if (n > al->n_score_scale_alloc) {
+        while (al->n_score_scale_alloc < n)
+            al->n_score_scale_alloc =
+                (al->n_score_scale_alloc > 0) ?
+                al->n_score_scale_alloc * 2 : 1024;
+        al->score_scale = (int32 *) ckd_realloc(al->score_scale,
+                                                al->n_score_scale_alloc *
+                                                sizeof(int32));
+    }
+}
 
-    h->alloc_next = hist_head;
-    hist_head = h;
 
-    return h;
+/**
+ * Partial traceback.  Every path that can still win passes through the
+ * history of some state in the current active list.  History nodes that are
+ * ancestors of all of them are on the final best path, so move them to
+ * al->path; nodes that are ancestors of none are dead.  Compact the rest.
+ * This keeps the arena at about (active states x frames since the paths last
+ * converged), independent of utterance length, and does not change the result.
+ */
+static void
+commit_history(align_t * al)
+{
+    int32 i, h, n_leaf, root, n_commit, n_keep;
+    int32 *cnt;
+    history_t *hist;
+
+    if (al->n_hist == 0)
+        return;
+
+    hist = al->hist;
+    cnt = al->hist_cnt;
+    memset(cnt, 0, al->n_hist * sizeof(int32));
+
+    /* Number of active paths through each node; preds precede their nodes */
+    n_leaf = 0;
+    for (i = 0; i < al->n_cur_active; i++) {
+        h = al->st_hist[al->cur_active[i]];
+        if (h != NO_HIST) {
+            cnt[h]++;
+            n_leaf++;
+        }
+    }
+    if (n_leaf == 0)
+        return;
+    root = NO_HIST;
+    for (h = al->n_hist - 1; h >= 0; --h) {
+        if (cnt[h] == 0)
+            continue;
+        if ((cnt[h] == n_leaf) && (root == NO_HIST))
+            root = h;           /* Most recent common ancestor */
+        if (hist[h].pred != NO_HIST)
+            cnt[hist[h].pred] += cnt[h];
+    }
+
+    /* Commit the ancestors of root; root itself may still be extended */
+    if (root != NO_HIST) {
+        n_commit = 0;
+        for (h = hist[root].pred; h != NO_HIST; h = hist[h].pred)
+            n_commit++;
+        grow_path(al, al->n_path + n_commit);
+        al->n_path += n_commit;
+        i = al->n_path;
+        for (h = hist[root].pred; h != NO_HIST; h = hist[h].pred) {
+            --i;
+            al->path_snode[i] = hist[h].snode;
+            al->path_score[i] = hist[h].score;
+            cnt[h] = 0;
+        }
+        hist[root].pred = NO_HIST;
+    }
+
+    /* Compact the live nodes, reusing cnt as the old-to-new index map */
+    n_keep = 0;
+    for (h = 0; h < al->n_hist; h++) {
+        if (cnt[h] == 0) {
+            cnt[h] = NO_HIST;
+            continue;
+        }
+        hist[n_keep] = hist[h];
+        if (hist[n_keep].pred != NO_HIST)
+            hist[n_keep].pred = cnt[hist[n_keep].pred];
+        cnt[h] = n_keep++;
+    }
+    for (i = 0; i < al->n_cur_active; i++) {
+        h = al->st_hist[al->cur_active[i]];
+        if (h != NO_HIST)
+            al->st_hist[al->cur_active[i]] = cnt[h];
+    }
+    al->n_hist = n_keep;
 }
 
 
 static void
-activate(snode_t * s, int32 frm)
+activate(align_t * al, int32 s, int32 frm)
 {
-    if (s->active_frm != frm) {
-        assert(s->active_frm < frm);
+    if (al->st_active_frm[s] != frm) {
+        assert(al->st_active_frm[s] < frm);
 
-        s->active_frm = frm;
-        next_active[n_active++] = s;
+        al->st_active_frm[s] = frm;
+        al->next_active[al->n_active++] = s;
     }
 }
 
@@ -1003,16 +1280,16 @@ activate(snode_t * s, int32 frm)
  * Flag the active senones. 
  */
 void
-align_sen_active(uint8 * senlist, int32 n_sen)
+align_sen_active(align_t * al, uint8 * senlist, int32 n_sen)
 {
     int32 i, sen;
 
     for (sen = 0; sen < n_sen; sen++)
         senlist[sen] = 0;
 
-    for (i = 0; cur_active[i]; i++) {
-        assert(IS_S3SENID(cur_active[i]->sen));
-        senlist[cur_active[i]->sen] = 1;
+    for (i = 0; i < al->n_cur_active; i++) {
+        assert(IS_S3SENID(al->st_sen[al->cur_active[i]]));
+        senlist[al->st_sen[al->cur_active[i]]] = 1;
     }
 }
 
@@ -1023,22 +1300,28 @@ align_sen_active(uint8 * senlist, int32 n_sen)
  * initialized during sentence HMM building.
  */
 int32
-align_start_utt(char *uttid)
+align_start_utt(align_t * al, char *uttid)
 {
-    slink_t *l;
-
-    curfrm = 0;
-    shead.score = 0;
-    shead.hist = NULL;
-    hist_head = NULL;
-
-    n_active = 0;
-    for (l = shead.succlist; l; l = l->next) {
-        assert(l->node->active_frm < 0);
-        l->node->active_frm = 0;
-        cur_active[n_active++] = l->node;
+    int32 e, s, head;
+
+    al->curfrm = 0;
+    al->n_hist = 0;
+    al->n_path = 0;
+
+    /* shead is the (only) predecessor active before the first frame */
+    head = al->n_snode;
+    al->st_score[head] = 0;
+    al->st_hist[head] = NO_HIST;
+    al->st_active_frm[head] = 0;
+
+    al->n_active = 0;
+    for (e = al->succ_off[head]; e < al->succ_off[head + 1]; e++) {
+        s = al->succ_idx[e];
+        assert(al->st_active_frm[s] < 0);
+        al->st_active_frm[s] = 0;
+        al->cur_active[al->n_active++] = s;
     }
-    cur_active[n_active++] = NULL;
+    al->n_cur_active = al->n_active;
 
     return 0;
 }
@@ -1048,33 +1331,39 @@ align_start_utt(char *uttid)
  * One frame of Viterbi time alignment.
  */
 int32
-align_frame(int32 * senscr)
+align_frame(align_t * al, int32 * senscr)
 {
-    int32 i, scr, tmpbest, bestscore, nf, thresh;
-    snode_t *s, *ps;
-    slink_t *l;
-    history_t *tmphist = NULL;
-    snode_t **tmpswap;
+    int32 i, e, s, ps, scr, tmpbest, bestscore, nf, thresh, curfrm;
+    int32 tmphist = NO_HIST;
+    int32 *tmpswap;
+    const int32 *pred_idx, *pred_prob, *active_frm, *score, *hist;
 
+    curfrm = al->curfrm;
     nf = curfrm + 1;
-    n_active = 0;
+    al->n_active = 0;
+
+    pred_idx = al->pred_idx;
+    pred_prob = al->pred_prob;
+    active_frm = al->st_active_frm;
+    score = al->st_score;
+    hist = al->st_hist;
 
     /* For each active state update state score and history */
     bestscore = (int32) 0x80000000;
-    for (i = 0; cur_active[i]; i++) {
-        s = cur_active[i];
-        assert(IS_S3SENID(s->sen));
+    for (i = 0; i < al->n_cur_active; i++) {
+        s = al->cur_active[i];
+        assert(IS_S3SENID(al->st_sen[s]));
 
         tmpbest = (int32) 0x80000000;
-        for (l = s->predlist; l; l = l->next) {
-            ps = l->node;
+        for (e = al->pred_off[s]; e < al->pred_off[s + 1]; e++) {
+            ps = pred_idx[e];
 
-            if (ps->active_frm == curfrm) {
-                scr = ps->score + l->prob;
+            if (active_frm[ps] == curfrm) {
+                scr = score[ps] + pred_prob[e];
 
                 if (scr > tmpbest) {
                     tmpbest = scr;
-                    tmphist = ps->hist;
+                    tmphist = hist[ps];
                 }
             }
         }
@@ -1085,126 +1374,129 @@ align_frame(int32 * senscr)
             return -1;
         }
 
-        s->newscore = tmpbest + senscr[s->sen];
-        s->newhist = tmphist;
+        scr = tmpbest + senscr[al->st_sen[s]];
+        al->st_newscore[s] = scr;
+        al->st_newhist[s] = tmphist;
 
-        if (s->newscore > bestscore)
-            bestscore = s->newscore;
+        if (scr > bestscore)
+            bestscore = scr;
     }
 
     if (bestscore <= S3_LOGPROB_ZERO)
         E_ERROR("Bestscore= %d in frame %d\n", bestscore, curfrm);
-    score_scale[curfrm] = bestscore;
-    thresh = bestscore + beam;
+    grow_score_scale(al, curfrm + 1);
+    al->score_scale[curfrm] = bestscore;
+    thresh = bestscore + al->beam;
 
     /* Update history lattice for each active state */
-    for (i = 0; cur_active[i]; i++) {
-        s = cur_active[i];
+    for (i = 0; i < al->n_cur_active; i++) {
+        s = al->cur_active[i];
 
-        if (s->newscore >= thresh) {
-            s->newscore -= bestscore;   /* Scale, to avoid underflow */
-            s->score = s->newscore;
+        if (al->st_newscore[s] >= thresh) {
+            al->st_newscore[s] -= bestscore;    /* Scale, to avoid underflow */
+            al->st_score[s] = al->st_newscore[s];
 
-            s->hist = lat_entry(s);
-            activate(s, nf);
+            al->st_hist[s] = lat_entry(al, s);
+            activate(al, s, nf);
 
             /* Also activate successor nodes of s as they are reachable next frame */
-            for (l = s->succlist; l; l = l->next) {
-                if (IS_S3SENID(l->node->sen))
-                    activate(l->node, nf);
-            }
+            for (e = al->succ_off[s]; e < al->succ_off[s + 1]; e++)
+                activate(al, al->succ_idx[e], nf);
         }
         else {
-            s->score = S3_LOGPROB_ZERO;
-            s->hist = NULL;
+            al->st_score[s] = S3_LOGPROB_ZERO;
+            al->st_hist[s] = NO_HIST;
         }
     }
 
     /* Update active state list */
-    next_active[n_active] = NULL;
-    tmpswap = cur_active;
-    cur_active = next_active;
-    next_active = tmpswap;
+    tmpswap = al->cur_active;
+    al->cur_active = al->next_active;
+    al->next_active = tmpswap;
+    al->n_cur_active = al->n_active;
+
+    al->curfrm = nf;
 
-    curfrm = nf;
+    if ((al->traceback_int > 0) && (nf % al->traceback_int == 0))
+        commit_history(al);
 
     return 0;
 }
 
 
 static void
-build_stseg(history_t * rooth)
+build_stseg(align_t * al)
 {
-    history_t *h, *prevh;
     align_stseg_t *stseg, *tail = NULL;
-    int32 f, prevscr;
+    int32 f, s, prevscr;
 
-    assert(align_stseg == NULL);
+    assert(al->align_stseg == NULL);
 
     prevscr = 0;
-    prevh = NULL;
-    for (f = 0, h = rooth; h; h = h->pred, f++) {
+    for (f = 0; f < al->n_path; f++) {
+        s = al->path_snode[f];
+
         stseg = (align_stseg_t *) ckd_calloc(1, sizeof(*stseg));
-        if (!align_stseg)
-            align_stseg = stseg;
+        if (!al->align_stseg)
+            al->align_stseg = stseg;
         else
             tail->next = stseg;
         tail = stseg;
         stseg->next = NULL;
 
-        stseg->pid = h->snode->pnode->pid;
-        stseg->sen = h->snode->sen;
-        stseg->state = h->snode->state;
-        stseg->start = ((!prevh)
-                        || (prevh->snode->pnode->id !=
-                            h->snode->pnode->id));
-        stseg->score = h->score - prevscr + score_scale[f];
-        stseg->bsdiff = h->score;
-
-        prevscr = h->score;
-        prevh = h;
+        stseg->pid = al->st_pnode[s]->pid;
+        stseg->sen = al->st_sen[s];
+        stseg->state = al->st_state[s];
+        stseg->start = ((f == 0)
+                        || (al->st_pnode[al->path_snode[f - 1]]->id !=
+                            al->st_pnode[s]->id));
+        stseg->score = al->path_score[f] - prevscr + al->score_scale[f];
+        stseg->bsdiff = al->path_score[f];
+
+        prevscr = al->path_score[f];
     }
 }
 
 
 static void
-build_phseg(history_t * rooth)
+build_phseg(align_t * al)
 {
-    history_t *h, *nh;
     align_phseg_t *phseg, *tail = NULL;
+    pnode_t *p;
     int32 f, prevf, prevscr, scale, bsdiff;
 
-    assert(align_phseg == NULL);
+    assert(al->align_phseg == NULL);
 
     prevscr = 0;
     bsdiff = 0;
     scale = 0;
     prevf = -1;
 
-    for (f = 0, h = rooth; h; h = h->pred, f++) {
-        bsdiff += h->score;
-        scale += score_scale[f];
+    for (f = 0; f < al->n_path; f++) {
+        bsdiff += al->path_score[f];
+        scale += al->score_scale[f];
 
-        nh = h->pred;
-        if ((!nh) || (nh->snode->pnode->id != h->snode->pnode->id)) {
+        p = al->st_pnode[al->path_snode[f]];
+        if ((f + 1 == al->n_path)
+            || (al->st_pnode[al->path_snode[f + 1]]->id != p->id)) {
             phseg =
                 (align_phseg_t *) ckd_calloc(1, sizeof(*phseg));
-            if (!align_phseg)
-                align_phseg = phseg;
+            if (!al->align_phseg)
+                al->align_phseg = phseg;
             else
                 tail->next = phseg;
             tail = phseg;
             phseg->next = NULL;
 
-            phseg->pid = h->snode->pnode->pid;
+            phseg->pid = p->pid;
             phseg->sf = prevf + 1;
             phseg->ef = f;
-            phseg->score = h->score - prevscr + scale,
+            phseg->score = al->path_score[f] - prevscr + scale,
                 phseg->bsdiff = bsdiff;
 
             bsdiff = 0;
             scale = 0;
-            prevscr = h->score;
+            prevscr = al->path_score[f];
             prevf = f;
         }
     }
@@ -1212,171 +1504,208 @@ build_phseg(history_t * rooth)
 
 
 static void
-build_wdseg(history_t * rooth)
+build_wdseg(align_t * al)
 {
-    history_t *h, *nh;
     align_wdseg_t *wdseg, *tail = NULL;
+    pnode_t *p, *np;
     int32 f, prevf, prevscr, scale, bsdiff;
 
-    assert(align_wdseg == NULL);
+    assert(al->align_wdseg == NULL);
 
     prevscr = 0;
     bsdiff = 0;
     scale = 0;
     prevf = -1;
 
-    for (f = 0, h = rooth; h; h = h->pred, f++) {
-        bsdiff += h->score;
-        scale += score_scale[f];
+    for (f = 0; f < al->n_path; f++) {
+        bsdiff += al->path_score[f];
+        scale += al->score_scale[f];
 
-        nh = h->pred;
-        if ((!nh) || ((nh->snode->pnode->id != h->snode->pnode->id) && (nh->snode->pnode->pos == 0))) { /* End of current word */
+        p = al->st_pnode[al->path_snode[f]];
+        np = (f + 1 < al->n_path) ? al->st_pnode[al->path_snode[f + 1]] : NULL;
+        if ((!np) || ((np->id != p->id) && (np->pos == 0))) { /* End of current word */
 
             wdseg =
                 (align_wdseg_t *) ckd_calloc(1, sizeof(*wdseg));
-            if (!align_wdseg)
-                align_wdseg = wdseg;
+            if (!al->align_wdseg)
+                al->align_wdseg = wdseg;
             else
                 tail->next = wdseg;
             tail = wdseg;
             wdseg->next = NULL;
 
-            wdseg->wid = h->snode->pnode->wid;
+            wdseg->wid = p->wid;
             wdseg->sf = prevf + 1;
             wdseg->ef = f;
-            wdseg->score = h->score - prevscr + scale,
+            wdseg->score = al->path_score[f] - prevscr + scale,
                 wdseg->bsdiff = bsdiff;
 
             bsdiff = 0;
             scale = 0;
-            prevscr = h->score;
+            prevscr = al->path_score[f];
             prevf = f;
         }
     }
 }
 
 
-/**
- * All frames consumed.  Trace back best Viterbi state sequence and dump it out.
- */
-int32
-align_end_utt(align_stseg_t ** stseg_out,
-              align_phseg_t ** phseg_out, align_wdseg_t ** wdseg_out)
+/** Free the segmentations of the most recent utterance */
+static void
+free_segs(align_t * al)
 {
-    slink_t *l;
-    snode_t *s;
-    history_t *h, *ph, *nh;
     align_stseg_t *stseg;
     align_phseg_t *phseg;
     align_wdseg_t *wdseg;
 
-    /* Free up previous result, if any */
-    while (align_stseg) {
-        stseg = align_stseg->next;
-        ckd_free((char *) align_stseg);
-        align_stseg = stseg;
+    while (al->align_stseg) {
+        stseg = al->align_stseg->next;
+        ckd_free((char *) al->align_stseg);
+        al->align_stseg = stseg;
     }
-    while (align_phseg) {
-        phseg = align_phseg->next;
-        ckd_free((char *) align_phseg);
-        align_phseg = phseg;
+    while (al->align_phseg) {
+        phseg = al->align_phseg->next;
+        ckd_free((char *) al->align_phseg);
+        al->align_phseg = phseg;
     }
-    while (align_wdseg) {
-        wdseg = align_wdseg->next;
-        ckd_free((char *) align_wdseg);
-        align_wdseg = wdseg;
+    while (al->align_wdseg) {
+        wdseg = al->align_wdseg->next;
+        ckd_free((char *) al->align_wdseg);
+        al->align_wdseg = wdseg;
     }
+}
+
+
+/**
+ * All frames consumed.  Trace back best Viterbi state sequence and dump it out.
+ */
+int32
+align_end_utt(align_t * al, align_stseg_t ** stseg_out,
+              align_phseg_t ** phseg_out, align_wdseg_t ** wdseg_out)
+{
+    int32 e, s, bestscore, besthist, h, n;
+
+    /* Free up previous result, if any */
+    free_segs(al);
 
     /* First find best ending history and link to stail */
-    stail.score = (int32) 0x80000000;
-    stail.hist = NULL;
-    for (l = stail.predlist; l; l = l->next) {
-        s = l->node;
-        if ((s->active_frm == curfrm)
-            && (s->score + l->prob > stail.score)) {
-            stail.score = s->score + l->prob;
-            stail.hist = s->hist;
+    bestscore = (int32) 0x80000000;
+    besthist = NO_HIST;
+    for (e = 0; e < al->n_tail; e++) {
+        s = al->tail_pred[e];
+        if ((al->st_active_frm[s] == al->curfrm)
+            && (al->st_score[s] + al->tail_prob[e] > bestscore)) {
+            bestscore = al->st_score[s] + al->tail_prob[e];
+            besthist = al->st_hist[s];
         }
     }
 
-    if (stail.hist) {
-        /* Reverse the best Viterbi path (back trace) so it is forward in time */
-        nh = NULL;
-        for (h = stail.hist; h; h = ph) {
-            ph = h->pred;
-            h->pred = nh;
-            nh = h;
+    if (besthist != NO_HIST) {
+        /* Back trace the rest of the best Viterbi path onto the committed part */
+        n = 0;
+        for (h = besthist; h != NO_HIST; h = al->hist[h].pred)
+            n++;
+        grow_path(al, al->n_path + n);
+        al->n_path += n;
+        e = al->n_path;
+        for (h = besthist; h != NO_HIST; h = al->hist[h].pred) {
+            --e;
+            al->path_snode[e] = al->hist[h].snode;
+            al->path_score[e] = al->hist[h].score;
         }
+        assert(al->n_path == al->curfrm);
 
         /* Trace state, phone, and word segmentations */
-        build_stseg(nh);
-        build_phseg(nh);
-        build_wdseg(nh);
+        build_stseg(al);
+        build_phseg(al);
+        build_wdseg(al);
     }
 
-    *stseg_out = align_stseg;
-    *phseg_out = align_phseg;
-    *wdseg_out = align_wdseg;
+    *stseg_out = al->align_stseg;
+    *phseg_out = al->align_phseg;
+    *wdseg_out = al->align_wdseg;
 
-    /* delete history list */
-    while (hist_head) {
-        h = hist_head->alloc_next;
-        ckd_free((char *) hist_head);
-        hist_head = h;
-    }
+    /* Release the history arena for the next utterance */
+    al->n_hist = 0;
 
-    return (stail.hist ? 0 : -1);
+    return (besthist != NO_HIST ? 0 : -1);
 }
 
 
-int32
+align_t *
 align_init(mdef_t * _mdef, tmat_t * _tmat, dict_t * _dict, cmd_ln_t *_config, logmath_t * _logmath)
 {
+    align_t *al;
     int32 k;
     s3wid_t w;
 
-    mdef = _mdef;
-    tmat = _tmat;
-    dict = _dict;
+    al = (align_t *) ckd_calloc(1, sizeof(*al));
+    al->mdef = _mdef;
+    al->tmat = _tmat;
+    al->dict = _dict;
 
-    assert(mdef);
-    assert(tmat);
-    assert(dict);
+    assert(al->mdef);
+    assert(al->tmat);
+    assert(al->dict);
 
     /* Create list of optional filler words to be inserted between transcript words */
-    fillwid =
-        (s3wid_t *) ckd_calloc((dict->filler_end - dict->filler_start + 3),
+    al->fillwid =
+        (s3wid_t *) ckd_calloc((al->dict->filler_end - al->dict->filler_start + 3),
                                sizeof(s3wid_t));
     k = 0;
-    if (IS_S3WID(dict->silwid))
-        fillwid[k++] = dict->silwid;
-    for (w = dict->filler_start; w <= dict->filler_end; w++) {
-        if ((dict_basewid(dict, w) == w) &&
-            (w != dict->silwid) && (w != dict->startwid)
-            && (w != dict->finishwid))
-            fillwid[k++] = w;
+    if (IS_S3WID(al->dict->silwid))
+        al->fillwid[k++] = al->dict->silwid;
+    for (w = al->dict->filler_start; w <= al->dict->filler_end; w++) {
+        if ((dict_basewid(al->dict, w) == w) &&
+            (w != al->dict->silwid) && (w != al->dict->startwid)
+            && (w != al->dict->finishwid))
+            al->fillwid[k++] = w;
     }
-    fillwid[k] = BAD_S3WID;
+    al->fillwid[k] = BAD_S3WID;
 
-    beam = logs3(_logmath, cmd_ln_float64_r(_config, "-beam"));
-    E_INFO("logs3(beam)= %d\n", beam);
+    al->beam = logs3(_logmath, cmd_ln_float64_r(_config, "-beam"));
+    E_INFO("logs3(beam)= %d\n", al->beam);
 
-    score_scale = (int32 *) ckd_calloc(S3_MAX_FRAMES, sizeof(int32));
+    al->traceback_int = cmd_ln_int32_r(_config, "-traceback_int");
 
-    hist_head = NULL;
+    al->score_scale = NULL;
+    al->n_score_scale_alloc = 0;
 
-    align_stseg = NULL;
-    align_phseg = NULL;
-    align_wdseg = NULL;
+    al->align_stseg = NULL;
+    al->align_phseg = NULL;
+    al->align_wdseg = NULL;
 
-    return 0;
+    return al;
 }
 
 void
-align_free(void)
+align_free(align_t * al)
 {
-    if (fillwid)
-        ckd_free(fillwid);
-    if (score_scale)
-        ckd_free(score_scale);
+    if (al == NULL)
+        return;
+
+    free_segs(al);
+    ckd_free(al->st_pnode);
+    ckd_free(al->st_sen);
+    ckd_free(al->st_state);
+    ckd_free(al->st_score);
+    ckd_free(al->st_newscore);
+    ckd_free(al->st_hist);
+    ckd_free(al->st_newhist);
+    ckd_free(al->st_active_frm);
+    ckd_free(al->pred_off);
+    ckd_free(al->pred_idx);
+    ckd_free(al->pred_prob);
+    ckd_free(al->succ_off);
+    ckd_free(al->succ_idx);
+    ckd_free(al->tail_pred);
+    ckd_free(al->tail_prob);
+    ckd_free(al->cur_active);
+    ckd_free(al->next_active);
+    ckd_free(al->hist);
+    ckd_free(al->hist_cnt);
+    ckd_free(al->path_snode);
+    ckd_free(al->path_score);
+    ckd_free(al->fillwid);
+    ckd_free(al->score_scale);
+    ckd_free(al);
 }
@@ -174,11 +174,11 @@ typedef int32		s3latid_t;	/** Lattice entry id */
 #define IS_S3LATID(l)	((l)>=0)
 #define MAX_S3LATID	((int32)0x7ffffffe)
 
-typedef int16   	s3frmid_t;	/** Frame id (must be SIGNED integer) */
+typedef int32   	s3frmid_t;	/** Frame id (must be SIGNED integer) */
 #define BAD_S3FRMID	((s3frmid_t) -1)
 #define NOT_S3FRMID(f)	((f)<0)
 #define IS_S3FRMID(f)	((f)>=0)
-#define MAX_S3FRMID	((int32)0x7ffe)
+#define MAX_S3FRMID	((int32)0x7ffffffe)
 
 typedef int16   	s3senid_t;	/** Senone id */
 #define BAD_S3SENID	((s3senid_t) -1)
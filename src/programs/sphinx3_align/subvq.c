@@ -200,6 +200,79 @@ subvq_map_linearize(subvq_t * vq)
     }
 }
 
+/*
+ * Build the packed codebooks and the shortlist subvector weights (see
+ * subvq.h) from gautbl.
+ */
+static void
+subvq_pack(subvq_t * vq)
+{
+    int32 s, d, r;
+    vector_gautbl_t *gautbl;
+
+    vq->pk_mean = (float32 **) ckd_calloc(vq->n_sv, sizeof(float32 *));
+    vq->pk_var = (float32 **) ckd_calloc(vq->n_sv, sizeof(float32 *));
+    for (s = 0; s < vq->n_sv; s++) {
+        gautbl = &(vq->gautbl[s]);
+        vq->pk_mean[s] = (float32 *) ckd_calloc(gautbl->veclen * vq->vqsize,
+                                                sizeof(float32));
+        vq->pk_var[s] = (float32 *) ckd_calloc(gautbl->veclen * vq->vqsize,
+                                               sizeof(float32));
+        for (r = 0; r < vq->vqsize; r++) {
+            for (d = 0; d < gautbl->veclen; d++) {
+                vq->pk_mean[s][d * vq->vqsize + r] = gautbl->mean[r][d];
+                vq->pk_var[s][d * vq->vqsize + r] = gautbl->var[r][d];
+            }
+        }
+    }
+
+    /* Same weighting as the n_sv == 3 special case in subvq_mgau_shortlist() */
+    vq->sv_wt = (int32 *) ckd_calloc(vq->n_sv, sizeof(int32));
+    for (s = 0; s < vq->n_sv; s++)
+        vq->sv_wt[s] = 1;
+    if (vq->n_sv == 3) {
+        if (vq->VQ_EVAL == 1)
+            vq->sv_wt[1] = vq->sv_wt[2] = 0;
+        else if (vq->VQ_EVAL == 2) {
+            vq->sv_wt[1] = 2;
+            vq->sv_wt[2] = 0;
+        }
+    }
+}
+
+
+/* Allocate the working space of vq */
+static void
+subvq_alloc_work(subvq_t * vq)
+{
+    int32 s, n;
+
+    n = 0;
+    for (s = 0; s < vq->n_sv; s++) {
+        if (vq->gautbl[s].veclen > n)
+            n = vq->gautbl[s].veclen;
+    }
+    assert(n > 0);
+    vq->subvec = (float32 *) ckd_calloc(n, sizeof(float32));
+    vq->vqdist =
+        (int32 **) ckd_calloc_2d(vq->n_sv, vq->vqsize, sizeof(int32));
+    vq->gauscore = (int32 *) ckd_calloc(vq->origsize.c, sizeof(int32));
+    vq->mgau_sl = (int32 *) ckd_calloc(vq->origsize.c + 1, sizeof(int32));
+    vq->pk_dist = (float32 *) ckd_calloc(vq->vqsize, sizeof(float32));
+}
+
+
+static void
+subvq_free_work(subvq_t * vq)
+{
+    ckd_free(vq->subvec);
+    ckd_free_2d((void **) vq->vqdist);
+    ckd_free(vq->gauscore);
+    ckd_free(vq->mgau_sl);
+    ckd_free(vq->pk_dist);
+}
+
+
 subvq_t *
 subvq_init(const char *file, float64 varfloor, int32 max_sv, mgau_model_t * g, cmd_ln_t *config, logmath_t * logmath)
 {
@@ -349,24 +422,131 @@ subvq_init(const char *file, float64 varfloor, int32 max_sv, mgau_model_t * g, c
 
     subvq_maha_precomp(vq, varfloor);
     subvq_map_compact(vq, g);
+    subvq_pack(vq);
     subvq_map_linearize(vq);
+    vq->packed = cmd_ln_boolean_r(config, "-svqpack");
 
-    n = 0;
-    for (s = 0; s < n_sv; s++) {
-        if (vq->gautbl[s].veclen > n)
-            n = vq->gautbl[s].veclen;
-    }
-    assert(n > 0);
-    vq->subvec = (float32 *) ckd_calloc(n, sizeof(float32));
-    vq->vqdist =
-        (int32 **) ckd_calloc_2d(vq->n_sv, vq->vqsize, sizeof(int32));
-    vq->gauscore = (int32 *) ckd_calloc(vq->origsize.c, sizeof(int32));
-    vq->mgau_sl = (int32 *) ckd_calloc(vq->origsize.c + 1, sizeof(int32));
+    subvq_alloc_work(vq);
 
     return vq;
 }
 
 
+subvq_t *
+subvq_clone(subvq_t * vq)
+{
+    subvq_t *c;
+
+    c = (subvq_t *) ckd_malloc(sizeof(*c));
+    *c = *vq;
+    subvq_alloc_work(c);
+
+    return c;
+}
+
+
+void
+subvq_clone_free(subvq_t * vq)
+{
+    if (vq) {
+        subvq_free_work(vq);
+        ckd_free(vq);
+    }
+}
+
+
+/*
+ * subvq_mgau_shortlist() for packed models: score the components with
+ * the subvector weights in one branch-free pass, and build the shortlist
+ * without a data-dependent branch per component.
+ */
+static int32
+subvq_mgau_shortlist_packed(subvq_t * vq, int32 m, int32 n, int32 beam)
+{
+    int32 *gauscore, *map, *vqdist, *wt, *sl;
+    int32 i, s, v, w0, w1, w2, bv, th, nc, n_sv;
+
+    vqdist = vq->vqdist[0];
+    gauscore = vq->gauscore;
+    map = vq->map[m][0];
+    wt = vq->sv_wt;
+    n_sv = vq->n_sv;
+    bv = MAX_NEG_INT32;
+    if (n_sv == 3) {
+        w0 = wt[0];
+        w1 = wt[1];
+        w2 = wt[2];
+        for (i = 0; i < n; i++, map += 3) {
+            v = w0 * vqdist[map[0]] + w1 * vqdist[map[1]]
+                + w2 * vqdist[map[2]];
+            gauscore[i] = v;
+            bv = (v > bv) ? v : bv;
+        }
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            for (v = 0, s = 0; s < n_sv; s++)
+                v += wt[s] * vqdist[*(map++)];
+            gauscore[i] = v;
+            bv = (v > bv) ? v : bv;
+        }
+    }
+    th = bv + beam;
+
+    /* Branch-free compaction: always store, advance only on a hit */
+    sl = vq->mgau_sl;
+    nc = 0;
+    for (i = 0; i < n; i++) {
+        sl[nc] = i;
+        nc += (gauscore[i] >= th);
+    }
+    sl[nc] = -1;
+
+    return nc;
+}
+
+
+/*
+ * vector_gautbl_eval_logs3() for packed codebooks: Mahalanobis distances
+ * of x from all the codewords of subvector s, in float32, with the inner
+ * loop running over codewords.
+ */
+static void
+subvq_subvec_eval_packed(subvq_t * vq, int32 s, float32 * x, int32 * score,
+                         logmath_t * logmath)
+{
+    vector_gautbl_t *gautbl;
+    float32 *mean, *var, *dist;
+    float32 xd, diff, floor, f;
+    int32 d, r, vqsize;
+
+    gautbl = &(vq->gautbl[s]);
+    vqsize = vq->vqsize;
+    dist = vq->pk_dist;
+    floor = (float32) gautbl->distfloor;
+    f = (float32) (1.0 / log(logmath_get_base(logmath)));
+
+    for (r = 0; r < vqsize; r++)
+        dist[r] = gautbl->lrd[r];
+
+    for (d = 0; d < gautbl->veclen; d++) {
+        xd = x[d];
+        mean = vq->pk_mean[s] + d * vqsize;
+        var = vq->pk_var[s] + d * vqsize;
+        for (r = 0; r < vqsize; r++) {
+            diff = xd - mean[r];
+            dist[r] -= diff * diff * var[r];
+        }
+    }
+
+    for (r = 0; r < vqsize; r++) {
+        if (dist[r] < floor)
+            dist[r] = floor;
+        score[r] = (int32) (f * dist[r]);
+    }
+}
+
+
 
 
 /*
@@ -386,6 +566,9 @@ subvq_mgau_shortlist(subvq_t * vq, int32 m,     /* In: Mixture index */
     int32 *vqdist;
     int32 sv_id;
 
+    if (vq->packed)
+        return subvq_mgau_shortlist_packed(vq, m, n, beam);
+
     vqdist = vq->vqdist[0];     /* Since map is linearized for efficiency, must also
                                    look at vqdist[][] as vqdist[] */
     gauscore = vq->gauscore;
@@ -478,8 +661,11 @@ subvq_subvec_eval_logs3(subvq_t * vq, float32 * feat, int32 s, logmath_t * logma
         vq->subvec[i] = feat[featdim[i]];
 
     /* Evaluate distances between extracted subvector and corresponding codebook */
-    vector_gautbl_eval_logs3(&(vq->gautbl[s]), 0, vq->vqsize, vq->subvec,
-                             vq->vqdist[s], logmath);
+    if (vq->packed)
+        subvq_subvec_eval_packed(vq, s, vq->subvec, vq->vqdist[s], logmath);
+    else
+        vector_gautbl_eval_logs3(&(vq->gautbl[s]), 0, vq->vqsize,
+                                 vq->subvec, vq->vqdist[s], logmath);
 }
 
 
@@ -497,7 +683,12 @@ subvq_gautbl_eval_logs3(subvq_t * vq, float32 * feat, logmath_t * logmath)
 
         /* Evaluate distances between extracted subvector and corresponding codebook */
         /* RAH, only evaluate the first VQ_EVAL set of features */
-        if (s < vq->VQ_EVAL)
+        if (s >= vq->VQ_EVAL)
+            continue;
+        if (vq->packed)
+            subvq_subvec_eval_packed(vq, s, vq->subvec, vq->vqdist[s],
+                                     logmath);
+        else
             vector_gautbl_eval_logs3(&(vq->gautbl[s]), 0, vq->vqsize,
                                      vq->subvec, vq->vqdist[s], logmath);
     }
@@ -661,17 +852,17 @@ subvq_free(subvq_t * s)
         if (s->map)
             ckd_free_3d((void ***) s->map);
 
-        if (s->subvec)
-            ckd_free((void *) s->subvec);
-
-        if (s->vqdist)
-            ckd_free_2d((void **) s->vqdist);
+        subvq_free_work(s);
 
-        if (s->gauscore)
-            ckd_free((void *) s->gauscore);
-
-        if (s->mgau_sl)
-            ckd_free((void *) s->mgau_sl);
+        if (s->pk_mean) {
+            for (i = 0; i < s->n_sv; i++) {
+                ckd_free(s->pk_mean[i]);
+                ckd_free(s->pk_var[i]);
+            }
+            ckd_free(s->pk_mean);
+            ckd_free(s->pk_var);
+        }
+        ckd_free(s->sv_wt);
 
 
         ckd_free((void *) s);
@@ -136,6 +136,18 @@ typedef struct {
      */
 
     int32 VQ_EVAL;              /** Number of sub-vector to be computed */
+
+    /*
+     * Packed form of the above, used if packed is set.  pk_mean[s][d*vqsize+r]
+     * is dimension d of codeword r of subvector s (pk_var likewise), so that
+     * the distances to all the codewords of a subvector are accumulated one
+     * dimension at a time over contiguous float32 arrays.
+     */
+    int32 packed;               /**< Use the packed codebooks and branch-free shortlists */
+    float32 **pk_mean;          /**< Codeword means, by subvector, dimension-major */
+    float32 **pk_var;           /**< Codeword 1/(2*var), same layout */
+    int32 *sv_wt;               /**< Weight of each subvector in shortlist scores (see VQ_EVAL) */
+    float32 *pk_dist;           /**< Working space: distances for one subvector, vqsize */
 } subvq_t;
 
 
@@ -179,6 +191,18 @@ subvq_t *subvq_init (const char *file,	/**< In: Subvector model file */
 void subvq_free (subvq_t *vq /**< In: A sub-vector model */
     );
 
+/**
+ * Make a copy of vq that shares its codebooks and maps but has its own
+ * working space, so that it can be evaluated in another thread.  Free it
+ * with subvq_clone_free().
+ */
+subvq_t *subvq_clone (subvq_t *vq /**< In: A sub-vector model */
+    );
+
+/** Free a copy made by subvq_clone() */
+void subvq_clone_free (subvq_t *vq /**< In: A copy made by subvq_clone() */
+    );
+
 
 /**
  * Evaluate senone scores for one frame.  If subvq model is available, for each senone, first
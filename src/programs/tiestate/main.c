@@ -57,28 +57,25 @@
 #include <sys_compat/file.h>
 
 #include <string.h>
-#include <assert.h>
 
 
 int
 init(model_def_t **out_imdef,
      pset_t **out_pset,
      uint32 *out_n_pset,
-     dtree_t ****out_tree,
-     uint32 *out_n_seno)
+     dtree_t ****out_tree)
 {
     model_def_t *imdef;
     uint32 p, s;
     uint32 n_ci, n_state;
     char fn[MAXPATHLEN+1];
     const char *a_fn;
-    FILE *fp;
-    dtree_t ***tree, *tr;
+    const char **tree_fn;
+    dtree_t ***tree, **tree_buf;
     pset_t *pset;
     uint32 n_pset;
-    uint32 n_seno;
+    uint32 n_tree;
     const char *treedir;
-    uint32 ts_id;
     int allphones;
 
     a_fn = cmd_ln_str("-imoddeffn");
@@ -104,8 +101,13 @@ init(model_def_t **out_imdef,
     tree = (dtree_t ***)ckd_calloc(n_ci, sizeof(dtree_t **));
     *out_tree = tree;
 
-    ts_id = imdef->n_tied_ci_state;
-    for (p = 0, n_seno = 0; p < n_ci; p++) {
+    /* Gather the tree files so they can be read in parallel */
+    n_state = allphones ?
+	imdef->defn[acmod_set_n_ci(imdef->acmod_set)].n_state :
+	imdef->max_n_state;
+    tree_fn = ckd_calloc(n_ci * n_state, sizeof(char *));
+    tree_buf = ckd_calloc(n_ci * n_state, sizeof(dtree_t *));
+    for (p = 0, n_tree = 0; p < n_ci; p++) {
 	if (allphones || !acmod_set_has_attrib(imdef->acmod_set, p, "filler")) {
 	    const char *pname;
 
@@ -120,31 +122,30 @@ init(model_def_t **out_imdef,
 	    tree[p] = (dtree_t **)ckd_calloc(n_state, sizeof(dtree_t *));
 
 	    for (s = 0; s < n_state-1; s++) {
-		E_INFO("%s-%u: offset %u\n",
-		       pname, s, ts_id);
-
 		sprintf(fn, "%s/%s-%u.dtree",
 			treedir, pname, s);
-		fp = fopen(fn, "r");
-		if (fp == NULL) {
-		    E_FATAL_SYSTEM("Unable to open %s for reading", fn);
-		}
-		tree[p][s] = tr = read_final_tree(fp, pset, n_pset);
-
-		label_leaves(&tr->node[0], &ts_id);
-
-		fclose(fp);
-
-		n_seno += cnt_leaf(&tr->node[0]);
+		tree_fn[n_tree++] = ckd_salloc(fn);
 	    }
 	}
     }
 
-    assert(n_seno == (ts_id - imdef->n_tied_ci_state));
-
-    E_INFO("n_seno= %u\n", ts_id);
-
-    *out_n_seno = n_seno;
+    if (read_final_trees(tree_fn, n_tree, pset, n_pset, tree_buf,
+			 cmd_ln_int32("-nthreads")) != S3_SUCCESS)
+	E_FATAL("Unable to read trees from %s\n", treedir);
+
+    for (p = 0, n_tree = 0; p < n_ci; p++) {
+	if (tree[p] == NULL)
+	    continue;
+	n_state = allphones ?
+	    imdef->defn[acmod_set_n_ci(imdef->acmod_set)].n_state :
+	    imdef->defn[p].n_state;
+	for (s = 0; s < n_state-1; s++)
+	    tree[p][s] = tree_buf[n_tree++];
+    }
+    for (p = 0; p < n_tree; p++)
+	ckd_free((char *)tree_fn[p]);
+    ckd_free(tree_fn);
+    ckd_free(tree_buf);
 
     return S3_SUCCESS;
 }
@@ -157,105 +158,13 @@ main(int argc, char *argv[])
     pset_t *pset;
     uint32 n_pset;
     dtree_t ***tree;
-    uint32 n_seno;
-    uint32 n_ci;
-    uint32 n_acmod;
-    uint32 p;
-    uint32 s;
-    model_def_entry_t *idefn, *odefn;
-    acmod_id_t b, l, r;
-    word_posn_t wp;
-    int allphones;
 
     parse_cmd_ln(argc, argv);
 
-    if (init(&imdef, &pset, &n_pset, &tree, &n_seno) != S3_SUCCESS)
+    if (init(&imdef, &pset, &n_pset, &tree) != S3_SUCCESS)
 	return 1;
 
-    omdef = (model_def_t *)ckd_calloc(1, sizeof(model_def_t));
-
-    omdef->acmod_set = imdef->acmod_set; /* same set of acoustic models */
-
-    omdef->n_total_state = imdef->n_total_state;
-
-    omdef->n_tied_ci_state = imdef->n_tied_ci_state;
-    omdef->n_tied_state = imdef->n_tied_ci_state + n_seno;
-
-    omdef->n_tied_tmat = imdef->n_tied_tmat;
-
-    omdef->defn = (model_def_entry_t *)ckd_calloc(imdef->n_defn,
-						  sizeof(model_def_entry_t));
-
-    /*
-     * Define the context-independent models
-     */
-    n_ci = acmod_set_n_ci(imdef->acmod_set);
-    for (p = 0; p < n_ci; p++) {
-	idefn = &imdef->defn[p];
-	odefn = &omdef->defn[p];
-	
-	odefn->p    = idefn->p;
-	odefn->tmat = idefn->tmat;
-
-	odefn->state = ckd_calloc(idefn->n_state, sizeof(uint32));
-	odefn->n_state = idefn->n_state;
-
-	for (s = 0; s < idefn->n_state; s++) {
-	    if (idefn->state[s] == NO_ID)
-		odefn->state[s] = NO_ID;
-	    else {
-		odefn->state[s] = idefn->state[s];
-	    }
-	}
-    }
-
-    /*
-     * Define the rest of the models
-     */
-    allphones = cmd_ln_int32("-allphones");
-    n_acmod = acmod_set_n_acmod(omdef->acmod_set);
-    for (; p < n_acmod; p++) {
-	b = acmod_set_base_phone(omdef->acmod_set, p);
-
-	assert(p != b);
-
-	idefn = &imdef->defn[p];
-	odefn = &omdef->defn[p];
-
-	odefn->p    = idefn->p;
-	odefn->tmat = idefn->tmat;
-
-	odefn->state = ckd_calloc(idefn->n_state, sizeof(uint32));
-	odefn->n_state = idefn->n_state;
-	for (s = 0; s < idefn->n_state; s++) {
-	    if (idefn->state[s] == NO_ID)
-		/* Non-emitting state */
-		odefn->state[s] = NO_ID;
-	    else {
-		uint32 bb;
-
-		/* emitting state: find the tied state */
-		acmod_set_id2tri(omdef->acmod_set,
-				 &b, &l, &r, &wp,
-				 p);
-#ifdef HORRIBLY_VERBOSE
-		fprintf(stderr, "%s %u ",
-			acmod_set_id2name(omdef->acmod_set, p), s);
-#endif
-
-		bb = allphones ? 0 : b;
-		odefn->state[s] = tied_state(&tree[bb][s]->node[0],
-					     b, l, r, wp,
-					     pset);
-
-#ifdef HORRIBLY_VERBOSE
-		fprintf(stderr, "\t-> %u\n", odefn->state[s]);
-
-		fprintf(stderr, "\n");
-#endif
-	    }
-	}
-    }
+    omdef = tie_states(imdef, tree, pset, cmd_ln_int32("-allphones"));
 
     if (model_def_write(omdef, cmd_ln_str("-omoddeffn")) != S3_SUCCESS) {
 	return 1;
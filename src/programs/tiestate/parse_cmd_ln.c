@@ -92,7 +92,7 @@ parse_cmd_ln(int argc, char *argv[])
 	{ "-treedir",
 	  ARG_STRING,
 	  NULL,
-	  "SPHINX-III tree directory containing pruned trees"},
+	  "SPHINX-III tree directory containing pruned trees (text or binary)"},
 
 	{ "-psetfn",
 	  ARG_STRING,
@@ -104,6 +104,11 @@ parse_cmd_ln(int argc, char *argv[])
 	  "no",
 	  "Use a single tree for each state of all phones"},
 
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads reading trees"},
+
 	{NULL, 0, NULL, NULL}
 	  
     };
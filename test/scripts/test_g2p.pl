@@ -0,0 +1,68 @@
+#!/usr/local/bin/perl
+
+use strict;
+require './scripts/testlib.pl';
+
+chomp(my $host=`../config.guess | xargs ../config.sub`);
+my $bindir="../bin.$host/";
+my $train="${bindir}g2p_train";
+my $eval="${bindir}g2p_eval";
+my $dictfn="./res/communicator.dic.cmu.full";
+my $g2pdict="./g2p.dict";
+
+# The G2P tools are only built with -DBUILD_G2P=ON, against OpenFst
+if (! -x $train) {
+    printf("Test g2p_train SKIPPED, not built\n");
+    exit 0;
+}
+
+# Single spaces and no alternate pronunciations or fillers, as
+# g2p_train.pl prepares the dictionary
+open(IN,"<$dictfn")||die "can't read $dictfn\n";
+open(OUT,">$g2pdict")||die "can't write $g2pdict\n";
+while (<IN>) {
+    next if m/^[+<]/;
+    s/\(\d+\)//;
+    s/^\s*//;
+    s/\s*$//;
+    s/\s+/ /g;
+    print OUT "$_\n";
+}
+close(OUT);
+close(IN);
+
+# Neither the number of expectation threads nor the FSA storage may
+# change the alignments or the model
+my @runs=(["memory",1],["memory",4],["arena",1],["arena",4],["mmap",4]);
+foreach my $run (@runs)
+{
+    my ($store,$n)=@$run;
+    test_this("$train -ifile $g2pdict -prefix g2p.$store.$n -iter 3 -fsa_store $store -nthreads $n",
+	      "g2p_train","DRY RUN -fsa_store $store, $n threads");
+}
+foreach my $run (@runs[1..$#runs])
+{
+    my ($store,$n)=@$run;
+    foreach my $ext ("corpus.aligned","fst.txt") {
+	compare_these_two("g2p.memory.1.$ext","g2p.$store.$n.$ext","g2p_train",
+			  "$ext, -fsa_store $store, $n threads",0);
+    }
+}
+
+# Nor may the number of g2p_eval threads change its hypotheses for the
+# held out words
+open(IN,"<g2p.memory.1.test")||die "can't read g2p.memory.1.test\n";
+open(OUT,">g2p.words")||die "can't write g2p.words\n";
+while (<IN>) {
+    print OUT "$1\n" if m/^(\S+)/;
+}
+close(OUT);
+close(IN);
+foreach my $n (1,4)
+{
+    test_this("$eval -model g2p.memory.1.fst -input g2p.words -isfile yes -words yes -nbest 3 -output_cost yes -nthreads $n -output g2p.$n.hyp",
+	      "g2p_eval","DRY RUN $n threads");
+}
+compare_these_two("g2p.1.hyp","g2p.4.hyp","g2p_eval","1 and 4 threads",0);
+
+unlink(glob("g2p.*"));
@@ -0,0 +1,62 @@
+#!/usr/local/bin/perl
+
+use strict;
+require './scripts/testlib.pl';
+
+chomp(my $host=`../config.guess | xargs ../config.sub`);
+my $bindir="../bin.$host/";
+my $exec_resdir="mdef_convert";
+my $bin="$bindir$exec_resdir";
+my $matchdir="mk_mdef_gen";
+
+test_help($bindir,$exec_resdir);
+test_example($bindir,$exec_resdir);
+
+# Text to binary and back must give the same definitions, for CI,
+# untied and all-triphone model definitions
+foreach my $mdef ("3st.ci","3st.ut","2st.all")
+{
+    test_this("$bin -i ${matchdir}/${mdef}.mdef -o ${mdef}.bin",
+	      $exec_resdir,"DRY RUN $mdef text to binary");
+    test_this("$bin -i ${mdef}.bin -o ${mdef}.txt -text yes",
+	      $exec_resdir,"DRY RUN $mdef binary to text");
+    compare_these_two("${mdef}.txt","${matchdir}/${mdef}.mdef",$exec_resdir,
+		      "$mdef text to binary to text",0);
+    unlink("${mdef}.txt");
+}
+
+# Damaged binary files must be refused, not read out of bounds.  The
+# file is the 8 byte magic, 14 header words, n_str words of strings,
+# then 4 words per model.
+open(BIN,"<3st.ut.bin")||die "can't read 3st.ut.bin\n";
+binmode(BIN);
+my $good=do { local $/; <BIN> };
+close(BIN);
+my @hdr=unpack("L14",substr($good,8,56));
+my $str_off=64;
+my $rec_off=$str_off+4*$hdr[11];
+my $tri_off=$rec_off+16*$hdr[2];
+
+sub damaged
+{
+    my ($name,$off,$bytes)=@_;
+    my $bad=$good;
+    substr($bad,$off,length($bytes))=$bytes if defined $bytes;
+    $bad=substr($bad,0,$off) unless defined $bytes;
+    open(BAD,">$name.bin")||die "can't write $name.bin\n";
+    binmode(BAD);
+    print BAD $bad;
+    close(BAD);
+    test_this("$bin -i $name.bin -o $name.txt -text yes",
+	      $exec_resdir,"$name is rejected",256);
+    unlink("$name.bin","$name.txt");
+}
+
+damaged("truncated",length($good)-4);
+damaged("tri_shift",8+4*12,pack("L",40));
+damaged("unterminated_strings",$str_off,"x" x (4*$hdr[11]));
+damaged("attrib_id",$rec_off+12,pack("L",0xffffffff));
+damaged("base_id",$tri_off,pack("L",0xff000000));
+damaged("n_state",$rec_off+8,pack("L",0x7fffffff));
+
+unlink("3st.ci.bin","3st.ut.bin","2st.all.bin");
@@ -0,0 +1,54 @@
+#!/usr/local/bin/perl
+
+use strict;
+require './scripts/testlib.pl';
+
+chomp(my $host=`../config.guess | xargs ../config.sub`);
+my $bindir="../bin.$host/";
+my $exec_resdir="param_cnt";
+my $bin="$bindir$exec_resdir";
+my $mdeffn="./res/hmm/CFS3.untied.mdef";
+my $dictfn="./res/communicator.dic.cmu.full";
+my $transfn="./res/training.trans.falign.1of10";
+my $ctlfn="./param_cnt.ctl";
+
+test_help($bindir,$exec_resdir);
+test_example($bindir,$exec_resdir);
+
+# Phone counts only read the transcripts, so the utterance ids will do
+# for a control file
+open(TRANS,"<$transfn")||die "can't read $transfn\n";
+open(CTL,">$ctlfn")||die "can't write $ctlfn\n";
+while (<TRANS>) {
+    print CTL "$1\n" if m/\(([^()]+)\)\s*$/;
+}
+close(CTL);
+close(TRANS);
+
+my $cmd="$bin ";
+$cmd .= "-moddeffn $mdeffn -ts2cbfn .cont. ";
+$cmd .= "-dictfn $dictfn -paramtype phone ";
+$cmd .= "-ctlfn $ctlfn -lsnfn $transfn ";
+
+# Every part has to come out the same whatever the number of threads,
+# including the threads that keep asking for utterances after the
+# end of their part
+my $i;
+for($i=1;$i<=3;$i++)
+{
+    test_this("$cmd -part $i -npart 3 -nthreads 1 -outputfn ${i}.1.cnt",
+	      $exec_resdir,"DRY RUN part $i of 3, 1 thread");
+    test_this("$cmd -part $i -npart 3 -nthreads 4 -outputfn ${i}.4.cnt",
+	      $exec_resdir,"DRY RUN part $i of 3, 4 threads");
+    compare_these_two("${i}.1.cnt","${i}.4.cnt",$exec_resdir,
+		      "part $i of 3, 1 and 4 threads",0);
+    unlink("${i}.1.cnt","${i}.4.cnt");
+}
+
+test_this("$cmd -nskip 10 -runlen 7 -nthreads 1 -outputfn skip.1.cnt",
+	  $exec_resdir,"DRY RUN -nskip 10 -runlen 7, 1 thread");
+test_this("$cmd -nskip 10 -runlen 7 -nthreads 8 -outputfn skip.8.cnt",
+	  $exec_resdir,"DRY RUN -nskip 10 -runlen 7, 8 threads");
+compare_these_two("skip.1.cnt","skip.8.cnt",$exec_resdir,
+		  "-nskip 10 -runlen 7, 1 and 8 threads",0);
+unlink("skip.1.cnt","skip.8.cnt",$ctlfn);